@@ -11,6 +11,7 @@
  */
 
 #include <cantrip.h>
+#include <clock.h>
 #include <stdint.h>
 
 // How many Fibonacci numbers to write to the log.
@@ -49,46 +50,24 @@ void wait(interrupt_count_t interrupt_count_to_wait,
   }
 }
 
-float virtual_seconds(interrupt_count_t interrupt_count) {
+uint64_t virtual_seconds(interrupt_count_t interrupt_count) {
   return interrupt_count / INTERRUPTS_PER_VIRT_SEC;
 }
 
-uint64_t rdtime(void) {
-  uint32_t upper, lower, upper_reread;
-  while (1) {
-    asm volatile(
-        "rdtimeh %0\n"
-        "rdtime  %1\n"
-        "rdtimeh %2\n"
-        : "=r"(upper), "=r"(lower), "=r"(upper_reread));
-    if (upper_reread == upper) {
-      return ((uint64_t)upper << 32) | lower;
-    }
-  }
-}
-
 void fibonacci_log(const fibonacci_state_t *fibonacci_state,
                    interrupt_count_t interrupt_count) {
-// TODO(sleffler): bring in snprintf
-#if 0
-  char log_buf[128];
-  snprintf(log_buf, sizeof(log_buf) / sizeof(char),
-           "\nfibonacci: n == %llu; f == %llu; interrupt_count == "
-           "%llu; rdtime == %llu; virt_sec ~= %.2f\n",
-           fibonacci_state->n, fibonacci_state->f1, interrupt_count, rdtime(),
-           virtual_seconds(interrupt_count));
-  debug_printf(log_buf);
-#else
   debug_printf(
-      "n == %d; "
-      "f == %x; "
-      "interrupt_count == %d; "
-      "rdtime == %d; "
-      "virt_sec ~= %d\n",
-      (uint32_t)fibonacci_state->n, (uint32_t)fibonacci_state->f1,
-      (uint32_t)interrupt_count, (uint32_t)rdtime(),
-      (uint32_t)virtual_seconds(interrupt_count));
-#endif
+      "n == %llu; "
+      "f == %llu; "
+      "interrupt_count == %llu; "
+      "rdtime == %llu; "
+      "virt_sec ~= %llu; "
+      "clock_ms == %llu\n",
+      (unsigned long long)fibonacci_state->n,
+      (unsigned long long)fibonacci_state->f1,
+      (unsigned long long)interrupt_count, (unsigned long long)clock_ticks(),
+      (unsigned long long)virtual_seconds(interrupt_count),
+      (unsigned long long)(clock_ns() / 1000000));
 }
 
 int main() {
@@ -0,0 +1,43 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "clock.h"
+
+#include <stdbool.h>
+
+#include "sdk.h"
+
+// The calibrated rate doesn't change so it is fetched once. As with the
+// sdk_* calls the caller is responsible for synchronizing access.
+static uint64_t cached_hz;
+static bool have_hz;
+
+uint64_t clock_hz(void) {
+  if (!have_hz) {
+    if (sdk_clock_hz(&cached_hz) != SDKSuccess) {
+      cached_hz = 0;
+    }
+    have_hz = true;
+  }
+  return cached_hz;
+}
+
+uint64_t clock_ticks_to_ns(uint64_t ticks) {
+  const uint64_t hz = clock_hz();
+  if (hz == 0) {
+    return 0;
+  }
+  // NB: the same split as clock_ticks_to_ns in cantrip-os-common's clock.
+  return (ticks / hz) * 1000000000u + (ticks % hz) * 1000000000u / hz;
+}
@@ -19,19 +19,37 @@
 #include <kernel/gen_config.h>
 #include <sel4/arch/syscalls.h>
 #include <stdarg.h>
+#include <stddef.h>
 
 extern __thread seL4_IPCBuffer *__sel4_ipc_buffer;
 
+// printf-style formatting into a buffer (see printf.c for the supported
+// conversions). Returns the length the full output would have had.
+extern int snprintf(char *buf, size_t size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+extern int vsnprintf(char *buf, size_t size, const char *fmt, va_list ap)
+    __attribute__((format(printf, 3, 0)));
+
+// Console output is collected per thread and written out a line at a time;
+// lines longer than this are split.
+#define DEBUG_LINE_MAX 128
+
 #ifdef CONFIG_PRINTING
-extern void _debug_printf(const char *fmt, ...);
+extern void _debug_printf(const char *fmt, ...)
+    __attribute__((format(printf, 1, 2)));
 #define debug_printf(args...) \
   do {                        \
     _debug_printf(args);      \
   } while (0)
+// Writes out a partial line left by debug_printf (e.g. a prompt).
+extern void debug_flush(void);
 #else
 #define debug_printf(args...) \
   do {                        \
   } while (0)
+#define debug_flush() \
+  do {                \
+  } while (0)
 #warning Apps will not log to console because CONFIG_PRINTING is not defined!
 #endif  // CONFIG_PRINTING
 
@@ -0,0 +1,70 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Monotonic clock for applications.
+//
+// Time comes from the cpu's free-running time counter (rdtime on RISC-V),
+// which is read directly from user space without a syscall. The counter's
+// rate is calibrated by the TimerService against its hardware timer at
+// boot and published through the SDKRuntime; clock_ns fetches it on first
+// use so after that a timestamp costs only a counter read. This is the
+// same clock as the Rust sdk_clock_* calls.
+
+// NOLINT(build/header_guard)
+#ifndef CANTRIP_CLOCK_H
+#define CANTRIP_CLOCK_H
+
+#include <stdint.h>
+
+#include "sdk.h"
+
+// Returns the cpu time counter; 0 where there is no such counter.
+// C apps do not link the Rust runtime, so this is a transcription of
+// clock_ticks in apps/system/components/cantrip-os-common/src/clock;
+// see there for how the counter is read and keep the two in sync.
+static inline uint64_t clock_ticks(void) {
+#if defined(__riscv) && __riscv_xlen == 32
+  uint32_t upper, lower, upper_reread;
+  while (1) {
+    asm volatile(
+        "rdtimeh %0\n"
+        "rdtime  %1\n"
+        "rdtimeh %2\n"
+        : "=r"(upper), "=r"(lower), "=r"(upper_reread));
+    if (upper_reread == upper) {
+      return ((uint64_t)upper << 32) | lower;
+    }
+  }
+#elif defined(__riscv)
+  uint64_t ticks;
+  asm volatile("rdtime %0" : "=r"(ticks));
+  return ticks;
+#else
+  return 0;
+#endif
+}
+
+// Returns the rate of clock_ticks in ticks per second, or 0 if there is no
+// clock. Only the first call makes an SDKRuntime request.
+extern uint64_t clock_hz(void);
+
+// Converts |ticks| of clock_ticks to nanoseconds (0 if there is no clock).
+extern uint64_t clock_ticks_to_ns(uint64_t ticks);
+
+// Returns monotonic time in nanoseconds since the counter started.
+static inline uint64_t clock_ns(void) {
+  return clock_ticks_to_ns(clock_ticks());
+}
+
+#endif  // CANTRIP_CLOCK_H
@@ -0,0 +1,207 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// C client-side bindings for the SDKRuntime.
+//
+// These speak the same protocol as the Rust sdk-interface crate: requests
+// are postcard-encoded into the first half of the CANTRIP_SDK_PARAMS page,
+// the frame is attached to the IPC buffer, and the reply (if any) comes back
+// in the second half of the page with an SDKRuntimeError in the MessageInfo
+// label. Keep the enums below in sync with sdk-interface/src/{lib,error}.rs.
+//
+// As with the Rust bindings the caller is responsible for synchronizing
+// access to the CANTRIP_SDK_* state and the IPC buffer.
+
+// NOLINT(build/header_guard)
+#ifndef CANTRIP_SDK_H
+#define CANTRIP_SDK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// SDKRuntimeRequest: the request token sent in the MessageInfo label.
+typedef enum {
+  SDKRuntimeRequest_Ping = 0,
+  SDKRuntimeRequest_Log,
+  SDKRuntimeRequest_ReadKey,
+  SDKRuntimeRequest_WriteKey,
+  SDKRuntimeRequest_DeleteKey,
+  SDKRuntimeRequest_OneshotTimer,
+  SDKRuntimeRequest_PeriodicTimer,
+  SDKRuntimeRequest_CancelTimer,
+  SDKRuntimeRequest_WaitForTimers,
+  SDKRuntimeRequest_PollForTimers,
+  SDKRuntimeRequest_OneshotModel,
+  SDKRuntimeRequest_PeriodicModel,
+  SDKRuntimeRequest_CancelModel,
+  SDKRuntimeRequest_WaitForModel,
+  SDKRuntimeRequest_PollForModels,
+  SDKRuntimeRequest_Batch,
+  SDKRuntimeRequest_ClockHz,
+  SDKRuntimeRequest_ModelResults,
+  SDKRuntimeRequest_ReadKeys,
+  SDKRuntimeRequest_SyncKeys,
+} SDKRuntimeRequest;
+
+// SDKRuntimeError: the status returned in the reply MessageInfo label.
+typedef enum {
+  SDKSuccess = 0,
+  SDKDeserializeFailed,
+  SDKSerializeFailed,
+  SDKInvalidBadge,
+  SDKInvalidString,
+  SDKReadKeyFailed,
+  SDKWriteKeyFailed,
+  SDKDeleteKeyFailed,
+  SDKMapPageFailed,
+  SDKUnknownRequest,
+  SDKUnknownResponse,
+  SDKNoSuchTimer,
+  SDKTimerAlreadyExists,
+  SDKNoPlatformSupport,
+  SDKNoSuchModel,
+  SDKInvalidTimer,
+  SDKLoadModelFailed,
+  SDKOutOfResources,
+} SDKRuntimeError;
+
+// Size of the request half of the CANTRIP_SDK_PARAMS page.
+#define SDKRUNTIME_REQUEST_DATA_SIZE 2048
+
+// Maximum size of a key-value store value.
+#define KEY_VALUE_DATA_SIZE 100
+
+// Maximum keys read by one sdk_read_keys; must match sdk-interface.
+#define MAX_READ_KEYS 16
+
+typedef uint32_t TimerId;
+typedef uint32_t TimerDuration;
+typedef uint32_t TimerMask;
+
+typedef uint32_t ModelId;
+typedef uint32_t ModelMask;
+
+// Outcome of one model run; must match sdk_interface::ModelResult.
+#define MAX_MODEL_RESULTS 8
+typedef struct {
+  uint32_t return_code;
+  uint32_t epc;  // Fault pc if return_code is non-zero
+  uint32_t output_length;
+} ModelResult;
+typedef struct {
+  uint32_t completed;  // Runs completed since the last request
+  uint32_t count;      // Valid entries in |results|, oldest first
+  ModelResult results[MAX_MODEL_RESULTS];
+} ModelResults;
+
+// Checks the SDKRuntime is alive.
+extern SDKRuntimeError sdk_ping(void);
+
+// Logs |msg| through the system logger.
+extern SDKRuntimeError sdk_log(const char *msg);
+
+// Reads the value of |key| in the app's private key-value store into
+// |keyval| (KEY_VALUE_DATA_SIZE bytes) and sets |*len| to its length.
+extern SDKRuntimeError sdk_read_key(const char *key, uint8_t *keyval,
+                                    size_t *len);
+// Writes |len| bytes of |value| for |key| in the app's private key-value
+// store; |len| must be at most KEY_VALUE_DATA_SIZE.
+extern SDKRuntimeError sdk_write_key(const char *key, const uint8_t *value,
+                                     size_t len);
+// Deletes |key| from the app's private key-value store.
+extern SDKRuntimeError sdk_delete_key(const char *key);
+// Reads the values of |count| (at most MAX_READ_KEYS) |keys| with one
+// request. keyvals[i] (KEY_VALUE_DATA_SIZE bytes) is filled and bit i of
+// |*found| set for each key that exists.
+extern SDKRuntimeError sdk_read_keys(const char *const *keys, size_t count,
+                                     uint8_t (*keyvals)[KEY_VALUE_DATA_SIZE],
+                                     uint32_t *found);
+// Key writes may be cached by the system; this forces the app's writes out
+// to storage.
+extern SDKRuntimeError sdk_sync_keys(void);
+
+// Creates a one-shot or periodic timer named |id| of |duration_ms|.
+extern SDKRuntimeError sdk_timer_oneshot(TimerId id, TimerDuration duration_ms);
+extern SDKRuntimeError sdk_timer_periodic(TimerId id,
+                                          TimerDuration duration_ms);
+// Cancels a previously created timer.
+extern SDKRuntimeError sdk_timer_cancel(TimerId id);
+// Waits (blocking) or polls for timers that have expired.
+extern SDKRuntimeError sdk_timer_wait(TimerMask *mask);
+extern SDKRuntimeError sdk_timer_poll(TimerMask *mask);
+
+// Sleeps (blocking) for at least |duration_ms| of the calibrated clock (see
+// clock.h). The thread idles in wfi and checks the clock when it wakes;
+// no SDKRuntime request is made after the first so other apps are not held
+// off. Returns SDKNoPlatformSupport if there is no clock.
+//
+// NB: the thread still wakes on every kernel tick; sleeping on a timer
+//   needs a per-app timer notification (or WaitForTimers replies that
+//   don't block the SDKRuntime), neither of which exists yet.
+extern SDKRuntimeError sdk_sleep_ms(TimerDuration duration_ms);
+
+// Returns the rate of the cpu time counter in |*hz| (see clock.h).
+extern SDKRuntimeError sdk_clock_hz(uint64_t *hz);
+
+// Starts a one-shot or periodic run of |model_id| and returns its id.
+extern SDKRuntimeError sdk_model_oneshot(const char *model_id, ModelId *id);
+extern SDKRuntimeError sdk_model_periodic(const char *model_id,
+                                          TimerDuration duration_ms,
+                                          ModelId *id);
+// Cancels a running model.
+extern SDKRuntimeError sdk_model_cancel(ModelId id);
+// Waits (blocking) or polls for running models that have completed.
+extern SDKRuntimeError sdk_model_wait(ModelMask *mask);
+extern SDKRuntimeError sdk_model_poll(ModelMask *mask);
+// Collects (and clears) the results of the runs of |id| that completed
+// since the last call; a periodic model may complete several per wakeup.
+extern SDKRuntimeError sdk_model_results(ModelId id, ModelResults *results);
+
+// Request batching: Log and WriteKey operations are encoded into caller
+// storage and sent to the SDKRuntime with a single sdk_batch_submit, so a
+// burst of operations costs one IPC round-trip instead of one per operation.
+// The SDKRuntime runs the operations in order and stops at the first one
+// that fails.
+//
+//   uint8_t storage[256];
+//   sdk_batch batch;
+//   sdk_batch_init(&batch, storage, sizeof(storage));
+//   sdk_batch_log(&batch, "sample");
+//   sdk_batch_write_key(&batch, "last", value, value_len);
+//   uint32_t completed;
+//   SDKRuntimeError status = sdk_batch_submit(&batch, &completed);
+typedef struct {
+  uint8_t *buf;
+  size_t size;
+  size_t len;
+  uint32_t count;
+} sdk_batch;
+
+// Largest useful sdk_batch storage: the request area less the op count.
+#define SDK_BATCH_MAX_SIZE (SDKRUNTIME_REQUEST_DATA_SIZE - 5)
+
+// Starts an empty batch encoded into |size| bytes of |buf|.
+extern void sdk_batch_init(sdk_batch *batch, uint8_t *buf, size_t size);
+// Appends an operation; returns false (leaving the batch unchanged) if it
+// does not fit, in which case submit the batch and retry.
+extern bool sdk_batch_log(sdk_batch *batch, const char *msg);
+extern bool sdk_batch_write_key(sdk_batch *batch, const char *key,
+                                const uint8_t *value, size_t len);
+// Sends the batch and empties it for re-use. |*completed| (if non-NULL) is
+// set to the number of operations that succeeded; on failure the status is
+// that of the first operation that failed (or of the request itself).
+extern SDKRuntimeError sdk_batch_submit(sdk_batch *batch, uint32_t *completed);
+
+#endif  // CANTRIP_SDK_H
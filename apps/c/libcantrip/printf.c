@@ -12,42 +12,378 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Minimal printf-family formatting for apps (there is no libc).
+//
+// Supports the conversions d i u x X o c s p %, the flags - 0 + # and space,
+// field width and precision (both may be *), and the length modifiers hh h l
+// ll z t j. Floating point is not supported; %f and friends print as '?'.
+
 #include <cantrip.h>
+#include <sel4/sel4.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <stdio.h>
 
-#ifdef CONFIG_PRINTING
-// only prints 32-bit "%x" hex values
-void _debug_printf(const char *fmt, ...) {
-  va_list args;
-  va_start(args, fmt);
+// Formatter output sink: called once per character.
+typedef void (*putc_fn)(void *ctx, char c);
+
+typedef struct {
+  putc_fn putc;
+  void *ctx;
+  int count;  // characters produced, including any that were dropped
+} fmt_out;
+
+static void out_char(fmt_out *out, char c) {
+  out->putc(out->ctx, c);
+  out->count++;
+}
+
+static void out_repeat(fmt_out *out, char c, int n) {
+  while (n-- > 0) {
+    out_char(out, c);
+  }
+}
+
+// Formatting state for one conversion.
+typedef struct {
+  bool left;   // '-'
+  bool zero;   // '0'
+  bool alt;    // '#'
+  char sign;   // '+', ' ' or 0
+  int width;
+  int precision;  // -1 if not given
+} fmt_spec;
+
+// Emits |len| characters of |s| padded to the field width.
+static void out_field(fmt_out *out, const fmt_spec *spec, const char *s,
+                      int len) {
+  int pad = spec->width - len;
+  if (!spec->left) {
+    out_repeat(out, ' ', pad);
+  }
+  for (int i = 0; i < len; i++) {
+    out_char(out, s[i]);
+  }
+  if (spec->left) {
+    out_repeat(out, ' ', pad);
+  }
+}
+
+// Emits an integer given its magnitude, sign and radix.
+static void out_number(fmt_out *out, const fmt_spec *spec, uint64_t value,
+                       bool negative, unsigned base, bool upper,
+                       const char *prefix) {
+  const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  char buf[24];  // 2^64 in octal is 22 digits
+  int len = 0;
+  while (value != 0) {
+    buf[len++] = digits[value % base];
+    value /= base;
+  }
+  // C requires "%.0d" of 0 to print nothing; otherwise at least one digit.
+  int precision = spec->precision < 0 ? 1 : spec->precision;
+  int zeros = precision > len ? precision - len : 0;
+  // "%#o" forces a leading zero.
+  if (spec->alt && base == 8 && zeros == 0) {
+    zeros = 1;
+  }
+
+  char sign = negative ? '-' : spec->sign;
+  int prefix_len = 0;
+  while (prefix[prefix_len] != '\0') {
+    prefix_len++;
+  }
+  int total = (sign ? 1 : 0) + prefix_len + zeros + len;
+  int pad = spec->width > total ? spec->width - total : 0;
+  // The '0' flag is ignored with a precision or '-'.
+  if (spec->zero && spec->precision < 0 && !spec->left) {
+    zeros += pad;
+    pad = 0;
+  }
+
+  if (!spec->left) {
+    out_repeat(out, ' ', pad);
+  }
+  if (sign) {
+    out_char(out, sign);
+  }
+  for (int i = 0; i < prefix_len; i++) {
+    out_char(out, prefix[i]);
+  }
+  out_repeat(out, '0', zeros);
+  while (len > 0) {
+    out_char(out, buf[--len]);
+  }
+  if (spec->left) {
+    out_repeat(out, ' ', pad);
+  }
+}
+
+// Length modifiers, in increasing size.
+enum { LEN_HH, LEN_H, LEN_DEFAULT, LEN_L, LEN_LL, LEN_Z, LEN_T, LEN_J };
+
+static int64_t signed_arg(va_list *ap, int length) {
+  switch (length) {
+    case LEN_HH:
+      return (signed char)va_arg(*ap, int);
+    case LEN_H:
+      return (short)va_arg(*ap, int);
+    case LEN_L:
+      return va_arg(*ap, long);
+    case LEN_LL:
+      return va_arg(*ap, long long);
+    case LEN_Z:
+    case LEN_T:
+      return va_arg(*ap, ptrdiff_t);
+    case LEN_J:
+      return va_arg(*ap, intmax_t);
+    default:
+      return va_arg(*ap, int);
+  }
+}
+
+static uint64_t unsigned_arg(va_list *ap, int length) {
+  switch (length) {
+    case LEN_HH:
+      return (unsigned char)va_arg(*ap, unsigned int);
+    case LEN_H:
+      return (unsigned short)va_arg(*ap, unsigned int);
+    case LEN_L:
+      return va_arg(*ap, unsigned long);
+    case LEN_LL:
+      return va_arg(*ap, unsigned long long);
+    case LEN_Z:
+    case LEN_T:
+      return va_arg(*ap, size_t);
+    case LEN_J:
+      return va_arg(*ap, uintmax_t);
+    default:
+      return va_arg(*ap, unsigned int);
+  }
+}
+
+// The formatter shared by vsnprintf and _debug_printf. Returns the number of
+// characters produced.
+static int format(putc_fn putc, void *ctx, const char *fmt, va_list ap_in) {
+  fmt_out out = {putc, ctx, 0};
+  va_list ap;
+  va_copy(ap, ap_in);
+
   for (; *fmt; fmt++) {
-    if (*fmt == '%') {
+    if (*fmt != '%') {
+      out_char(&out, *fmt);
+      continue;
+    }
+    fmt++;
+
+    fmt_spec spec = {false, false, false, 0, 0, -1};
+    for (;; fmt++) {
+      if (*fmt == '-') {
+        spec.left = true;
+      } else if (*fmt == '0') {
+        spec.zero = true;
+      } else if (*fmt == '#') {
+        spec.alt = true;
+      } else if (*fmt == '+') {
+        spec.sign = '+';
+      } else if (*fmt == ' ') {
+        if (spec.sign != '+') {
+          spec.sign = ' ';
+        }
+      } else {
+        break;
+      }
+    }
+    if (*fmt == '*') {
+      spec.width = va_arg(ap, int);
+      if (spec.width < 0) {
+        spec.left = true;
+        spec.width = -spec.width;
+      }
+      fmt++;
+    } else {
+      while (*fmt >= '0' && *fmt <= '9') {
+        spec.width = spec.width * 10 + (*fmt++ - '0');
+      }
+    }
+    if (*fmt == '.') {
       fmt++;
-      if (*fmt == 'd') {
-        uint32_t arg = va_arg(args, uint32_t);
-        // TODO(sleffler): total hack
-        int printing = 0;
-        for (int d = 1000000000; d > 1; d /= 10) {
-          int n = (arg / d) % 10;
-          if (printing || n > 0) {
-            seL4_DebugPutChar('0' + n);
-            printing = 1;
-          }
+      spec.precision = 0;
+      if (*fmt == '*') {
+        spec.precision = va_arg(ap, int);
+        fmt++;
+      } else {
+        while (*fmt >= '0' && *fmt <= '9') {
+          spec.precision = spec.precision * 10 + (*fmt++ - '0');
+        }
+      }
+    }
+
+    int length = LEN_DEFAULT;
+    switch (*fmt) {
+      case 'h':
+        length = fmt[1] == 'h' ? LEN_HH : LEN_H;
+        fmt += length == LEN_HH ? 2 : 1;
+        break;
+      case 'l':
+        length = fmt[1] == 'l' ? LEN_LL : LEN_L;
+        fmt += length == LEN_LL ? 2 : 1;
+        break;
+      case 'z':
+        length = LEN_Z;
+        fmt++;
+        break;
+      case 't':
+        length = LEN_T;
+        fmt++;
+        break;
+      case 'j':
+        length = LEN_J;
+        fmt++;
+        break;
+    }
+
+    switch (*fmt) {
+      case 'd':
+      case 'i': {
+        int64_t v = signed_arg(&ap, length);
+        uint64_t mag = v < 0 ? -(uint64_t)v : (uint64_t)v;
+        out_number(&out, &spec, mag, v < 0, 10, false, "");
+        break;
+      }
+      case 'u':
+        out_number(&out, &spec, unsigned_arg(&ap, length), false, 10, false,
+                   "");
+        break;
+      case 'x':
+      case 'X': {
+        spec.sign = 0;
+        uint64_t v = unsigned_arg(&ap, length);
+        // "%#x" prefixes non-zero values only.
+        const char *prefix = "";
+        if (spec.alt && v != 0) {
+          prefix = *fmt == 'X' ? "0X" : "0x";
         }
-        seL4_DebugPutChar('0' + (arg % 10));
-      } else if (*fmt == 'x') {
-        uint32_t arg = va_arg(args, uint32_t);
-        for (int i = 7; i >= 0; i--) {
-          int n = (arg >> (4 * i)) & 0xF;
-          seL4_DebugPutChar(n > 9 ? 'A' + n - 10 : '0' + n);
+        out_number(&out, &spec, v, false, 16, *fmt == 'X', prefix);
+        break;
+      }
+      case 'o':
+        spec.sign = 0;
+        out_number(&out, &spec, unsigned_arg(&ap, length), false, 8, false,
+                   "");
+        break;
+      case 'p':
+        spec.sign = 0;
+        out_number(&out, &spec, (uintptr_t)va_arg(ap, void *), false, 16,
+                   false, "0x");
+        break;
+      case 'c': {
+        char c = (char)va_arg(ap, int);
+        out_field(&out, &spec, &c, 1);
+        break;
+      }
+      case 's': {
+        const char *s = va_arg(ap, const char *);
+        if (s == NULL) {
+          s = "(null)";
+        }
+        int len = 0;
+        while (s[len] != '\0' && (spec.precision < 0 || len < spec.precision)) {
+          len++;
         }
+        out_field(&out, &spec, s, len);
+        break;
       }
-    } else {
-      seL4_DebugPutChar(*fmt);
+      case '%':
+        out_char(&out, '%');
+        break;
+      case 'e':
+      case 'E':
+      case 'f':
+      case 'F':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+        (void)va_arg(ap, double);
+        out_char(&out, '?');
+        break;
+      case '\0':
+        // Truncated conversion at the end of the format.
+        fmt--;
+        break;
+      default:
+        // Unknown conversion: echo it.
+        out_char(&out, '%');
+        out_char(&out, *fmt);
+        break;
     }
   }
-  va_end(args);
+  va_end(ap);
+  return out.count;
+}
+
+typedef struct {
+  char *buf;
+  size_t size;
+  size_t len;
+} string_sink;
+
+static void string_putc(void *ctx, char c) {
+  string_sink *sink = ctx;
+  if (sink->len + 1 < sink->size) {
+    sink->buf[sink->len] = c;
+  }
+  sink->len++;
+}
+
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list ap) {
+  string_sink sink = {buf, size, 0};
+  int n = format(string_putc, &sink, fmt, ap);
+  if (size > 0) {
+    buf[sink.len < size ? sink.len : size - 1] = '\0';
+  }
+  return n;
+}
+
+int snprintf(char *buf, size_t size, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, size, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+#ifdef CONFIG_PRINTING
+// Per-thread console line buffer, written out at each newline, when full, or
+// by debug_flush. The extra byte holds the NUL for seL4_DebugPutString.
+static __thread char line_buf[DEBUG_LINE_MAX + 1];
+static __thread size_t line_len;
+
+// Writes out the console line buffer with one seL4_DebugPutString.
+void debug_flush(void) {
+  line_buf[line_len] = '\0';
+  seL4_DebugPutString(line_buf);
+  line_len = 0;
+}
+
+static void line_putc(void *ctx, char c) {
+  (void)ctx;
+  // NB: a NUL would cut the line short at seL4_DebugPutString; drop it.
+  if (c == '\0') {
+    return;
+  }
+  line_buf[line_len++] = c;
+  if (c == '\n' || line_len == DEBUG_LINE_MAX) {
+    debug_flush();
+  }
+}
+
+void _debug_printf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  format(line_putc, NULL, fmt, ap);
+  va_end(ap);
 }
 #endif  // CONFIG_PRINTING
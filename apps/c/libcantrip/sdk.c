@@ -0,0 +1,451 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// SDKRuntime client-side request processing (see sdk.h).
+//
+// Arguments are hand-encoded in postcard's wire format, which is all the
+// SDK requests need: unsigned integers are LEB128 varints and byte slices &
+// strings are a varint length followed by the bytes. Structs are their
+// fields in order and enum variants are prefixed by a varint index.
+
+#include <clock.h>
+#include <sdk.h>
+#include <sel4/sel4.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+_Static_assert(SDKRUNTIME_REQUEST_DATA_SIZE == (1 << seL4_PageBits) / 2,
+               "SDKRUNTIME_REQUEST_DATA_SIZE must match sdk-interface");
+
+// SDKRuntime client-side state setup by ProcessManager and crt0.
+extern seL4_CPtr CANTRIP_SDK_ENDPOINT;  // IPC connection to SDKRuntime
+extern seL4_CPtr CANTRIP_SDK_FRAME;     // RPC parameters frame
+extern uint8_t *CANTRIP_SDK_PARAMS;     // Virtual address of CANTRIP_SDK_FRAME
+
+#define PAGE_SIZE (1 << seL4_PageBits)
+
+// Batched operations; must match sdk_interface::BatchOp.
+enum { BATCH_OP_LOG = 0, BATCH_OP_WRITE_KEY = 1 };
+
+// Bytes needed to encode |v| as a varint.
+static size_t varint_len(uint32_t v) {
+  size_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+// Encoder over a fixed-size region; |ok| goes false on overflow.
+typedef struct {
+  uint8_t *p;
+  uint8_t *end;
+  bool ok;
+} encoder;
+
+static void put_varint(encoder *e, uint32_t v) {
+  do {
+    if (e->p == e->end) {
+      e->ok = false;
+      return;
+    }
+    uint8_t b = v & 0x7f;
+    v >>= 7;
+    *e->p++ = v ? (b | 0x80) : b;
+  } while (v);
+}
+
+static void put_bytes(encoder *e, const void *data, size_t len) {
+  size_t room = e->end - e->p;
+  if (len > room || varint_len(len) > room - len) {
+    e->ok = false;
+    return;
+  }
+  put_varint(e, len);
+  const uint8_t *src = data;
+  for (size_t i = 0; i < len; i++) {
+    *e->p++ = src[i];
+  }
+}
+
+static size_t c_strlen(const char *s) {
+  size_t n = 0;
+  while (s[n] != '\0') {
+    n++;
+  }
+  return n;
+}
+
+static void put_str(encoder *e, const char *s) { put_bytes(e, s, c_strlen(s)); }
+
+// Decoder over the reply half of the page.
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+  bool ok;
+} decoder;
+
+static uint64_t get_varint64(decoder *d) {
+  uint64_t v = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (d->p == d->end) {
+      break;
+    }
+    uint8_t b = *d->p++;
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return v;
+    }
+  }
+  d->ok = false;
+  return 0;
+}
+
+static uint32_t get_varint(decoder *d) {
+  uint64_t v = get_varint64(d);
+  if (v > UINT32_MAX) {
+    d->ok = false;
+    return 0;
+  }
+  return (uint32_t)v;
+}
+
+static encoder request_encoder(void) {
+  encoder e = {CANTRIP_SDK_PARAMS,
+               CANTRIP_SDK_PARAMS + SDKRUNTIME_REQUEST_DATA_SIZE, true};
+  return e;
+}
+
+static decoder reply_decoder(void) {
+  decoder d = {CANTRIP_SDK_PARAMS + SDKRUNTIME_REQUEST_DATA_SIZE,
+               CANTRIP_SDK_PARAMS + PAGE_SIZE, true};
+  return d;
+}
+
+// Sends |request| with the arguments already encoded in the request half of
+// the page and waits (blocking) for the reply.
+static SDKRuntimeError sdk_call(SDKRuntimeRequest request) {
+  // NB: the reply is decoded as if zero-filled past what the server wrote.
+  uint8_t *reply = CANTRIP_SDK_PARAMS + SDKRUNTIME_REQUEST_DATA_SIZE;
+  for (size_t i = 0; i < PAGE_SIZE - SDKRUNTIME_REQUEST_DATA_SIZE; i++) {
+    reply[i] = 0;
+  }
+
+  // Attach params & call the SDKRuntime; then wait (block) for a reply.
+  seL4_SetCap(0, CANTRIP_SDK_FRAME);
+  seL4_MessageInfo_t info = seL4_Call(
+      CANTRIP_SDK_ENDPOINT, seL4_MessageInfo_new(/*label=*/request,
+                                                 /*capsUnwrapped=*/0,
+                                                 /*extraCaps=*/1,
+                                                 /*length=*/0));
+  seL4_SetCap(0, 0);
+
+  seL4_Word status = seL4_MessageInfo_get_label(info);
+  return status <= SDKOutOfResources ? (SDKRuntimeError)status
+                                     : SDKUnknownResponse;
+}
+
+// Like sdk_call for requests that return a single u32 (a mask or an id).
+static SDKRuntimeError sdk_call_u32(SDKRuntimeRequest request, uint32_t *v) {
+  SDKRuntimeError status = sdk_call(request);
+  if (status != SDKSuccess) {
+    return status;
+  }
+  decoder d = reply_decoder();
+  *v = get_varint(&d);
+  return d.ok ? SDKSuccess : SDKDeserializeFailed;
+}
+
+SDKRuntimeError sdk_ping(void) { return sdk_call(SDKRuntimeRequest_Ping); }
+
+SDKRuntimeError sdk_log(const char *msg) {
+  encoder e = request_encoder();
+  put_str(&e, msg);
+  if (!e.ok) {
+    return SDKSerializeFailed;
+  }
+  return sdk_call(SDKRuntimeRequest_Log);
+}
+
+SDKRuntimeError sdk_read_key(const char *key, uint8_t *keyval, size_t *len) {
+  encoder e = request_encoder();
+  put_str(&e, key);
+  if (!e.ok) {
+    return SDKSerializeFailed;
+  }
+  SDKRuntimeError status = sdk_call(SDKRuntimeRequest_ReadKey);
+  if (status != SDKSuccess) {
+    return status;
+  }
+  decoder d = reply_decoder();
+  uint32_t n = get_varint(&d);
+  if (!d.ok || n > KEY_VALUE_DATA_SIZE || n > (size_t)(d.end - d.p)) {
+    return SDKDeserializeFailed;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    keyval[i] = d.p[i];
+  }
+  *len = n;
+  return SDKSuccess;
+}
+
+SDKRuntimeError sdk_write_key(const char *key, const uint8_t *value,
+                              size_t len) {
+  if (len > KEY_VALUE_DATA_SIZE) {
+    return SDKWriteKeyFailed;
+  }
+  encoder e = request_encoder();
+  put_str(&e, key);
+  put_bytes(&e, value, len);
+  if (!e.ok) {
+    return SDKSerializeFailed;
+  }
+  return sdk_call(SDKRuntimeRequest_WriteKey);
+}
+
+SDKRuntimeError sdk_delete_key(const char *key) {
+  encoder e = request_encoder();
+  put_str(&e, key);
+  if (!e.ok) {
+    return SDKSerializeFailed;
+  }
+  return sdk_call(SDKRuntimeRequest_DeleteKey);
+}
+
+SDKRuntimeError sdk_read_keys(const char *const *keys, size_t count,
+                              uint8_t (*keyvals)[KEY_VALUE_DATA_SIZE],
+                              uint32_t *found) {
+  if (count > MAX_READ_KEYS) {
+    return SDKReadKeyFailed;
+  }
+  encoder e = request_encoder();
+  put_varint(&e, count);
+  for (size_t i = 0; i < count; i++) {
+    put_str(&e, keys[i]);
+  }
+  if (!e.ok) {
+    return SDKSerializeFailed;
+  }
+  SDKRuntimeError status = sdk_call(SDKRuntimeRequest_ReadKeys);
+  if (status != SDKSuccess) {
+    return status;
+  }
+  // NB: the reply has MAX_READ_KEYS values; only the first |count| are used.
+  decoder d = reply_decoder();
+  uint32_t mask = get_varint(&d);
+  for (size_t i = 0; d.ok && i < count; i++) {
+    uint32_t n = get_varint(&d);
+    if (!d.ok || n > KEY_VALUE_DATA_SIZE || n > (size_t)(d.end - d.p)) {
+      return SDKDeserializeFailed;
+    }
+    if (mask & ((uint32_t)1 << i)) {
+      for (uint32_t j = 0; j < n; j++) {
+        keyvals[i][j] = d.p[j];
+      }
+    }
+    d.p += n;
+  }
+  if (!d.ok) {
+    return SDKDeserializeFailed;
+  }
+  *found = mask;
+  return SDKSuccess;
+}
+
+SDKRuntimeError sdk_sync_keys(void) {
+  return sdk_call(SDKRuntimeRequest_SyncKeys);
+}
+
+static SDKRuntimeError timer_start(SDKRuntimeRequest request, TimerId id,
+                                   TimerDuration duration_ms) {
+  encoder e = request_encoder();
+  put_varint(&e, id);
+  put_varint(&e, duration_ms);
+  return sdk_call(request);
+}
+
+SDKRuntimeError sdk_timer_oneshot(TimerId id, TimerDuration duration_ms) {
+  return timer_start(SDKRuntimeRequest_OneshotTimer, id, duration_ms);
+}
+
+SDKRuntimeError sdk_timer_periodic(TimerId id, TimerDuration duration_ms) {
+  return timer_start(SDKRuntimeRequest_PeriodicTimer, id, duration_ms);
+}
+
+SDKRuntimeError sdk_timer_cancel(TimerId id) {
+  encoder e = request_encoder();
+  put_varint(&e, id);
+  return sdk_call(SDKRuntimeRequest_CancelTimer);
+}
+
+SDKRuntimeError sdk_timer_wait(TimerMask *mask) {
+  return sdk_call_u32(SDKRuntimeRequest_WaitForTimers, mask);
+}
+
+SDKRuntimeError sdk_timer_poll(TimerMask *mask) {
+  return sdk_call_u32(SDKRuntimeRequest_PollForTimers, mask);
+}
+
+SDKRuntimeError sdk_sleep_ms(TimerDuration duration_ms) {
+  // NB: not WaitForTimers; that blocks the SDKRuntime (and so every app)
+  //   until the timer expires.
+  const uint64_t hz = clock_hz();
+  if (hz == 0) {
+    return SDKNoPlatformSupport;
+  }
+  const uint64_t deadline =
+      clock_ticks() + (uint64_t)duration_ms * (hz / 1000) +
+      (uint64_t)duration_ms * (hz % 1000) / 1000;
+  while (clock_ticks() < deadline) {
+    // TODO(sleffler): not portable but works for aarch64 & riscv
+    asm volatile("wfi");
+  }
+  return SDKSuccess;
+}
+
+SDKRuntimeError sdk_clock_hz(uint64_t *hz) {
+  SDKRuntimeError status = sdk_call(SDKRuntimeRequest_ClockHz);
+  if (status != SDKSuccess) {
+    return status;
+  }
+  decoder d = reply_decoder();
+  *hz = get_varint64(&d);
+  return d.ok ? SDKSuccess : SDKDeserializeFailed;
+}
+
+SDKRuntimeError sdk_model_oneshot(const char *model_id, ModelId *id) {
+  encoder e = request_encoder();
+  put_str(&e, model_id);
+  if (!e.ok) {
+    return SDKSerializeFailed;
+  }
+  return sdk_call_u32(SDKRuntimeRequest_OneshotModel, id);
+}
+
+SDKRuntimeError sdk_model_periodic(const char *model_id,
+                                   TimerDuration duration_ms, ModelId *id) {
+  encoder e = request_encoder();
+  put_str(&e, model_id);
+  put_varint(&e, duration_ms);
+  if (!e.ok) {
+    return SDKSerializeFailed;
+  }
+  return sdk_call_u32(SDKRuntimeRequest_PeriodicModel, id);
+}
+
+SDKRuntimeError sdk_model_cancel(ModelId id) {
+  encoder e = request_encoder();
+  put_varint(&e, id);
+  return sdk_call(SDKRuntimeRequest_CancelModel);
+}
+
+SDKRuntimeError sdk_model_wait(ModelMask *mask) {
+  return sdk_call_u32(SDKRuntimeRequest_WaitForModel, mask);
+}
+
+SDKRuntimeError sdk_model_poll(ModelMask *mask) {
+  return sdk_call_u32(SDKRuntimeRequest_PollForModels, mask);
+}
+
+SDKRuntimeError sdk_model_results(ModelId id, ModelResults *results) {
+  encoder e = request_encoder();
+  put_varint(&e, id);
+  SDKRuntimeError status = sdk_call(SDKRuntimeRequest_ModelResults);
+  if (status != SDKSuccess) {
+    return status;
+  }
+  decoder d = reply_decoder();
+  results->completed = get_varint(&d);
+  results->count = get_varint(&d);
+  for (size_t i = 0; i < MAX_MODEL_RESULTS; i++) {
+    results->results[i].return_code = get_varint(&d);
+    results->results[i].epc = get_varint(&d);
+    results->results[i].output_length = get_varint(&d);
+  }
+  return d.ok ? SDKSuccess : SDKDeserializeFailed;
+}
+
+// Batches are encoded as sdk_interface::BatchRequest: an op count followed
+// by that many BatchOp's. The ops are accumulated in caller storage and the
+// count is prepended by sdk_batch_submit.
+
+void sdk_batch_init(sdk_batch *batch, uint8_t *buf, size_t size) {
+  batch->buf = buf;
+  batch->size = size < SDK_BATCH_MAX_SIZE ? size : SDK_BATCH_MAX_SIZE;
+  batch->len = 0;
+  batch->count = 0;
+}
+
+static encoder batch_encoder(sdk_batch *batch) {
+  encoder e = {batch->buf + batch->len, batch->buf + batch->size, true};
+  return e;
+}
+
+static bool batch_commit(sdk_batch *batch, const encoder *e) {
+  if (!e->ok) {
+    return false;  // NB: the partial op past len is ignored
+  }
+  batch->len = e->p - batch->buf;
+  batch->count++;
+  return true;
+}
+
+bool sdk_batch_log(sdk_batch *batch, const char *msg) {
+  encoder e = batch_encoder(batch);
+  put_varint(&e, BATCH_OP_LOG);
+  put_str(&e, msg);
+  return batch_commit(batch, &e);
+}
+
+bool sdk_batch_write_key(sdk_batch *batch, const char *key,
+                         const uint8_t *value, size_t len) {
+  if (len > KEY_VALUE_DATA_SIZE) {
+    return false;
+  }
+  encoder e = batch_encoder(batch);
+  put_varint(&e, BATCH_OP_WRITE_KEY);
+  put_str(&e, key);
+  put_bytes(&e, value, len);
+  return batch_commit(batch, &e);
+}
+
+SDKRuntimeError sdk_batch_submit(sdk_batch *batch, uint32_t *completed) {
+  uint32_t done = 0;
+  SDKRuntimeError status = SDKSuccess;
+  if (batch->count > 0) {
+    encoder e = request_encoder();
+    put_varint(&e, batch->count);
+    for (size_t i = 0; i < batch->len; i++) {
+      *e.p++ = batch->buf[i];  // NB: fits, see SDK_BATCH_MAX_SIZE
+    }
+    status = sdk_call(SDKRuntimeRequest_Batch);
+    // NB: the BatchResponse is returned on failure too.
+    decoder d = reply_decoder();
+    done = get_varint(&d);
+    if (!d.ok) {
+      done = 0;
+      if (status == SDKSuccess) {
+        status = SDKDeserializeFailed;
+      }
+    }
+  }
+  batch->len = 0;
+  batch->count = 0;
+  if (completed != NULL) {
+    *completed = done;
+  }
+  return status;
+}
@@ -37,8 +37,11 @@ impl Fibonacci {
         self.n = 0;
     }
 
+    // Logs the next number with the elapsed time counted in timer
+    // intervals and as measured by the clock.
     pub fn log(&self, time_ms: TimerDuration) {
-        info!("[{:2}] {:20}  {}", self.n, self.f1, time_ms);
+        let clock_ms = sdk_clock_ns() / 1_000_000;
+        info!("[{:2}] {:20}  {} {}", self.n, self.f1, time_ms, clock_ms);
     }
 }
 
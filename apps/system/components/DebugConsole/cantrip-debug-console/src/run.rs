@@ -25,10 +25,17 @@
 
 #![no_std]
 #![allow(clippy::missing_safety_doc)]
+#![feature(linkage)]
 
+extern crate alloc;
+use alloc::collections::BTreeMap;
+use alloc::string::String;
 use cantrip_os_common::camkes::Camkes;
+use cantrip_os_common::logger::binary::{Expanded, BINARY_DATA, BINARY_DEFINE, LEVEL_MASK};
+use cantrip_os_common::logger::ring::{LogRing, LOG_RING_MAX_MSG};
 use core::fmt::Write;
 use core::slice;
+use core::sync::atomic::{AtomicBool, Ordering};
 use cpio::CpioNewcReader;
 use cstr_core::CStr;
 use log::LevelFilter;
@@ -53,6 +60,7 @@ pub unsafe extern "C" fn pre_init() {
     const HEAP_SIZE: usize = 16 * 1024;
     static mut HEAP_MEMORY: [u8; HEAP_SIZE] = [0; HEAP_SIZE];
     CAMKES.pre_init(INIT_LOG_LEVEL, &mut HEAP_MEMORY);
+    publish_log_level(INIT_LOG_LEVEL);
 }
 
 // Returns a trait-compatible Tx based on the selected features.
@@ -65,25 +73,184 @@ fn get_tx() -> impl cantrip_io::Write {
     return default_uart_client::Tx::new();
 }
 
-/// Console logging interface.
-#[no_mangle]
-pub unsafe extern "C" fn logger_log(level: u8, msg: *const cstr_core::c_char) {
+// Maps a log::Level sent by a client (which may be bogus) to a Level.
+fn to_level(level: u8) -> log::Level {
     use log::Level;
-    let l = match level {
+    match level {
         x if x == Level::Error as u8 => Level::Error,
         x if x == Level::Warn as u8 => Level::Warn,
         x if x == Level::Info as u8 => Level::Info,
         x if x == Level::Debug as u8 => Level::Debug,
         _ => Level::Trace,
-    };
-    if l <= log::max_level() {
+    }
+}
+
+// Writes a client's log |msg| to the console if |level| is enabled.
+fn console_log(level: u8, msg: &[u8]) {
+    if to_level(level) <= log::max_level() {
         // TODO(sleffler): is the uart driver ok w/ multiple writers?
         // TODO(sleffler): fallback to seL4_DebugPutChar?
         let output: &mut dyn cantrip_io::Write = &mut get_tx();
-        let _ = writeln!(output, "{}", CStr::from_ptr(msg).to_str().unwrap());
+        let _ = writeln!(output, "{}", core::str::from_utf8(msg).unwrap_or("<invalid utf8>"));
+    }
+}
+
+/// Console logging interface.
+#[no_mangle]
+pub unsafe extern "C" fn logger_log(level: u8, msg: *const cstr_core::c_char) {
+    console_log(level, CStr::from_ptr(msg).to_bytes());
+}
+
+// Asynchronous logging. Each client appends to a log ring shared with us
+// and rings log_doorbell; records are written out here, on the doorbell's
+// thread, so clients never wait on the UART. See logger::ring.
+//
+// NB: the rings & doorbell are optional (the platform may not connect some
+//   or all of them) so everything is weak.
+extern "C" {
+    #[linkage = "extern_weak"]
+    static log_ring_process_manager: *const *mut u8;
+    #[linkage = "extern_weak"]
+    static log_ring_ml_coordinator: *const *mut u8;
+    #[linkage = "extern_weak"]
+    static log_ring_memory_manager: *const *mut u8;
+    #[linkage = "extern_weak"]
+    static log_ring_security_coordinator: *const *mut u8;
+    #[linkage = "extern_weak"]
+    static log_ring_timer_service: *const *mut u8;
+    #[linkage = "extern_weak"]
+    static log_ring_mailbox_driver: *const *mut u8;
+    #[linkage = "extern_weak"]
+    static log_ring_sdk_runtime: *const *mut u8;
+
+    #[linkage = "extern_weak"]
+    static log_doorbell_reg_callback: *const ();
+}
+
+const NUM_LOG_RINGS: usize = 7;
+
+// Returns the connected log rings with the index and name of the client
+// that writes each.
+fn log_rings() -> impl Iterator<Item = (usize, &'static str, LogRing)> {
+    unsafe {
+        [
+            ("ProcessManager", log_ring_process_manager),
+            ("MlCoordinator", log_ring_ml_coordinator),
+            ("MemoryManager", log_ring_memory_manager),
+            ("SecurityCoordinator", log_ring_security_coordinator),
+            ("TimerService", log_ring_timer_service),
+            ("MailboxDriver", log_ring_mailbox_driver),
+            ("SDKRuntime", log_ring_sdk_runtime),
+        ]
+    }
+    .into_iter()
+    .enumerate()
+    .filter(|(_, (_, dataport))| !dataport.is_null() && unsafe { !(**dataport).is_null() })
+    .map(|(index, (name, dataport))| (index, name, unsafe { LogRing::new(*dataport) }))
+}
+
+// Tells clients the console log level so they discard messages that
+// would not be written before formatting them.
+fn publish_log_level(level: LevelFilter) {
+    for (_, _, ring) in log_rings() {
+        ring.set_max_level(level as u32);
+    }
+}
+
+/// Sets the console log level; used by the shell in place of
+/// log::set_max_level so clients filter at the same level.
+#[no_mangle]
+pub extern "C" fn console_set_log_level(level: usize) {
+    let level = match level {
+        0 => LevelFilter::Off,
+        1 => LevelFilter::Error,
+        2 => LevelFilter::Warn,
+        3 => LevelFilter::Info,
+        4 => LevelFilter::Debug,
+        _ => LevelFilter::Trace,
+    };
+    log::set_max_level(level);
+    publish_log_level(level);
+}
+
+// Writes a record popped from a log ring. Deferred-format records (see
+// logger::binary) are expanded using the format strings the client has
+// defined; |formats| holds those for the record's ring.
+fn log_record(formats: &mut BTreeMap<u16, String>, level: u8, record: &[u8]) {
+    if level & (BINARY_DEFINE | BINARY_DATA) == 0 {
+        return console_log(level, record);
+    }
+    if record.len() < 2 {
+        return;
+    }
+    let id = u16::from_le_bytes([record[0], record[1]]);
+    let rest = &record[2..];
+    if level & BINARY_DEFINE != 0 {
+        if let Ok(fmt) = core::str::from_utf8(rest) {
+            formats.insert(id, String::from(fmt));
+        }
+    } else if to_level(level & LEVEL_MASK) <= log::max_level() {
+        let output: &mut dyn cantrip_io::Write = &mut get_tx();
+        let _ = match formats.get(&id) {
+            Some(fmt) => writeln!(output, "{}", Expanded { fmt, args: rest }),
+            None => writeln!(output, "<unknown log format {}>", id),
+        };
     }
 }
 
+// Set by each drain request; whoever holds LOG_DRAINING keeps draining
+// until it finds this clear.
+static LOG_DRAIN_PENDING: AtomicBool = AtomicBool::new(false);
+// Held by the one thread allowed to consume the log rings (they are SPSC).
+static LOG_DRAINING: AtomicBool = AtomicBool::new(false);
+
+// Writes out everything queued in the log rings. Safe to call from any
+// thread: if another thread is already draining it is left to pick up
+// this request instead of two threads consuming the rings at once.
+fn drain_log_rings() {
+    static mut MSG: [u8; LOG_RING_MAX_MSG] = [0; LOG_RING_MAX_MSG];
+    const NO_FORMATS: BTreeMap<u16, String> = BTreeMap::new();
+    static mut FORMATS: [BTreeMap<u16, String>; NUM_LOG_RINGS] = [NO_FORMATS; NUM_LOG_RINGS];
+
+    LOG_DRAIN_PENDING.store(true, Ordering::Release);
+    // NB: re-check after releasing LOG_DRAINING in case a request was
+    //   handed off to us just as we finished.
+    while LOG_DRAIN_PENDING.load(Ordering::Acquire) {
+        if LOG_DRAINING.swap(true, Ordering::Acquire) {
+            return; // The draining thread will see LOG_DRAIN_PENDING
+        }
+        while LOG_DRAIN_PENDING.swap(false, Ordering::AcqRel) {
+            // NB: MSG & FORMATS are only touched while holding LOG_DRAINING
+            for (index, name, ring) in log_rings() {
+                while let Some((level, len)) = ring.pop(unsafe { &mut MSG }) {
+                    log_record(unsafe { &mut FORMATS[index] }, level, unsafe { &MSG[..len] });
+                }
+                let dropped = ring.take_dropped();
+                if dropped != 0 {
+                    let output: &mut dyn cantrip_io::Write = &mut get_tx();
+                    let _ = writeln!(output, "{}: {} log message(s) dropped", name, dropped);
+                }
+            }
+        }
+        LOG_DRAINING.store(false, Ordering::Release);
+    }
+}
+
+// Drains the log rings each time log_doorbell is rung.
+unsafe extern "C" fn log_doorbell_callback(_arg: *mut cty::c_void) {
+    let reg_callback: Option<
+        unsafe extern "C" fn(
+            callback: unsafe extern "C" fn(*mut cty::c_void),
+            arg: *mut cty::c_void,
+        ) -> cty::c_int,
+    > = core::mem::transmute(log_doorbell_reg_callback);
+    // NB: re-arm first so a doorbell rung while draining is not missed.
+    if let Some(reg_callback) = reg_callback {
+        let _ = reg_callback(log_doorbell_callback, core::ptr::null_mut());
+    }
+    drain_log_rings();
+}
+
 // If the builtins archive includes an "autostart.repl" file it is run
 // through the shell with output sent either to the console or /dev/null
 // depending on the feature selection.
@@ -123,6 +290,12 @@ fn run_sparrow_shell(cpio_archive_ref: &[u8]) -> ! {
 /// after which it runs an interactive shell with UART IO.
 #[no_mangle]
 pub extern "C" fn run() {
+    // Drain anything logged before we started and wait for more.
+    // NB: the callback arms the doorbell; a doorbell rung during this drain
+    //   runs it on the notification thread but drain_log_rings serializes
+    //   the two.
+    unsafe { log_doorbell_callback(core::ptr::null_mut()) };
+
     let cpio_archive_ref = unsafe {
         // XXX want begin-end or begin+size instead of a fixed-size block
         slice::from_raw_parts(cpio_archive, 16777216)
@@ -130,6 +130,12 @@ impl Read for &[u8] {
     }
 }
 
+impl BufRead for &[u8] {
+    fn fill_buf(&mut self) -> Result<&[u8]> { Ok(*self) }
+
+    fn consume(&mut self, amt: usize) { *self = &self[amt..]; }
+}
+
 pub struct BufReader<R> {
     inner: R,
     buf: Box<[u8]>,
@@ -215,6 +221,15 @@ where
     fn consume(&mut self, amt: usize) { (**self).consume(amt) }
 }
 
+impl Write for Vec<u8> {
+    fn write(&mut self, buf: &[u8]) -> Result<usize> {
+        self.extend_from_slice(buf);
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> Result<()> { Ok(()) }
+}
+
 /// Forwarding implementation of Write for &mut
 impl<'a, T: ?Sized> Write for &'a mut T
 where
@@ -12,13 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#![no_std]
+#![cfg_attr(not(test), no_std)]
 
 use core::fmt;
 
 use cantrip_io as io;
 
-const LINE_MAX: usize = 128;
+/// Default maximum line length (in bytes).
+pub const LINE_MAX: usize = 256;
 
 pub enum LineReadError {
     IO(io::Error),
@@ -44,54 +45,174 @@ impl fmt::Display for LineReadError {
     }
 }
 
-pub struct LineReader {
+/// Reads (and echos) lines of at most N bytes.
+///
+/// Input is taken a buffer at a time from a BufRead so pasted or scripted
+/// input costs one read per buffer-full rather than one per byte, and is
+/// echoed a run of characters at a time. Bytes after the end of a line
+/// are left in the BufRead for the next read_line (or whoever reads next).
+pub struct LineReader<const N: usize = LINE_MAX> {
     // Owned by LineReader to facilitate static allocation.
-    buf: [u8; LINE_MAX],
+    buf: [u8; N],
 }
-impl Default for LineReader {
+impl<const N: usize> Default for LineReader<N> {
     fn default() -> Self { Self::new() }
 }
 
-fn get_u8(reader: &mut dyn io::Read) -> io::Result<u8> {
-    let mut buf: [u8; 1] = [0u8];
-    reader.read_exact(&mut buf)?;
-    Ok(buf[0])
-}
-
-impl LineReader {
-    pub fn new() -> LineReader {
-        LineReader {
-            buf: [0u8; LINE_MAX],
-        }
-    }
+impl<const N: usize> LineReader<N> {
+    pub fn new() -> Self { LineReader { buf: [0u8; N] } }
 
+    /// Returns the next line without its terminator (CR or LF). DEL and
+    /// BACKSPACE erase the previous character. A line longer than N bytes
+    /// is discarded through its terminator and Overflow is returned. At
+    /// EOF an unterminated line is returned, otherwise an IO error.
     pub fn read_line(
         &mut self,
         output: &mut dyn io::Write,
-        input: &mut dyn io::Read,
+        input: &mut dyn io::BufRead,
     ) -> Result<&str, LineReadError> {
         const DEL: u8 = 127u8;
         const BACKSPACE: u8 = 8u8;
         let mut len = 0;
-        while len < self.buf.len() {
-            let mut c = get_u8(input)?;
-            while c == DEL || c == BACKSPACE {
-                if len > 0 {
-                    output.write(&[BACKSPACE, b' ', BACKSPACE])?;
-                    len -= 1;
+        let mut overflow = false;
+        loop {
+            let available = input.fill_buf()?;
+            if available.is_empty() {
+                // EOF
+                if len == 0 || overflow {
+                    return Err(LineReadError::IO(io::Error));
+                }
+                output.write_all(b"\n")?;
+                return Ok(core::str::from_utf8(&self.buf[0..len])?);
+            }
+            let mut used = 0;
+            let mut echo_start = len; // Start of chars not yet echoed
+            let mut done = false;
+            for &c in available {
+                used += 1;
+                match c {
+                    b'\r' | b'\n' => {
+                        done = true;
+                        break;
+                    }
+                    _ if overflow => {}
+                    DEL | BACKSPACE => {
+                        output.write_all(&self.buf[echo_start..len])?;
+                        if len > 0 {
+                            output.write_all(&[BACKSPACE, b' ', BACKSPACE])?;
+                            len -= 1;
+                        }
+                        echo_start = len;
+                    }
+                    _ if len == N => overflow = true,
+                    _ => {
+                        self.buf[len] = c;
+                        len += 1;
+                    }
                 }
-                c = get_u8(input)?;
             }
-            if c == b'\r' || c == b'\n' {
+            output.write_all(&self.buf[echo_start..len])?;
+            input.consume(used);
+            if done {
+                if overflow {
+                    return Err(LineReadError::Overflow);
+                }
                 if len > 0 {
-                    output.write(&[b'\n'])?;
+                    output.write_all(b"\n")?;
                 }
                 return Ok(core::str::from_utf8(&self.buf[0..len])?);
             }
-            self.buf[len] = c;
-            len += 1;
-            output.write(&[c])?;
         }
-        Err(LineReadError::Overflow)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::cell::Cell;
+
+    // Captures output and counts the writes.
+    #[derive(Default)]
+    struct Output {
+        data: Vec<u8>,
+        writes: usize,
+    }
+    impl io::Write for Output {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            self.data.extend_from_slice(buf);
+            self.writes += 1;
+            Ok(buf.len())
+        }
+        fn flush(&mut self) -> io::Result<()> { Ok(()) }
+    }
+
+    // Returns the input in chunks of at most |chunk| bytes and counts reads.
+    struct Input<'a> {
+        data: &'a [u8],
+        chunk: usize,
+        reads: &'a Cell<usize>,
+    }
+    impl io::Read for Input<'_> {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            self.reads.set(self.reads.get() + 1);
+            let n = core::cmp::min(core::cmp::min(buf.len(), self.chunk), self.data.len());
+            buf[..n].copy_from_slice(&self.data[..n]);
+            self.data = &self.data[n..];
+            Ok(n)
+        }
+    }
+
+    fn read_all<const N: usize>(data: &[u8], chunk: usize) -> (Vec<String>, Output, usize) {
+        let reads = Cell::new(0);
+        let mut input = io::BufReader::new(Input {
+            data,
+            chunk,
+            reads: &reads,
+        });
+        let mut output = Output::default();
+        let mut reader = LineReader::<N>::new();
+        let mut lines = Vec::new();
+        loop {
+            match reader.read_line(&mut output, &mut input) {
+                Ok(line) => lines.push(line.to_string()),
+                Err(LineReadError::Overflow) => lines.push("<overflow>".to_string()),
+                Err(_) => break,
+            }
+        }
+        (lines, output, reads.get())
+    }
+
+    #[test]
+    fn test_lines() {
+        let (lines, output, _) = read_all::<LINE_MAX>(b"one\ntwo\r\nthree", 1);
+        assert_eq!(lines, ["one", "two", "", "three"]);
+        assert_eq!(output.data, b"one\ntwo\nthree\n");
+    }
+
+    #[test]
+    fn test_bulk() {
+        let script = "echo hello\n".repeat(50);
+        let (lines, output, reads) = read_all::<LINE_MAX>(script.as_bytes(), 4096);
+        assert_eq!(lines.len(), 50);
+        assert!(lines.iter().all(|l| l == "echo hello"));
+        assert_eq!(output.data, script.as_bytes());
+        // One read per BufReader fill (plus the EOF) and two echo
+        // writes per line.
+        assert!(reads <= 1 + script.len() / 1024 + 1, "{} reads", reads);
+        assert_eq!(output.writes, 2 * 50);
+    }
+
+    #[test]
+    fn test_backspace() {
+        let (lines, output, _) = read_all::<LINE_MAX>(b"\x08ab\x7fc\x08\x08d\n", 64);
+        assert_eq!(lines, ["d"]);
+        assert_eq!(output.data, b"ab\x08 \x08c\x08 \x08\x08 \x08d\n");
+    }
+
+    #[test]
+    fn test_overflow() {
+        // The rest of an over-long line is discarded, not read as a new line.
+        let (lines, _, _) = read_all::<4>(b"abcd\nabcdef\nxy\n", 3);
+        assert_eq!(lines, ["abcd", "<overflow>", "xy"]);
     }
 }
@@ -74,14 +74,19 @@ fn echo_command(
     Ok(writeln!(output, "{}", &value)?)
 }
 
-/// Implements a command to receive a blob using ZMODEM.
+/// Implements a command to receive a blob using ZMODEM, optionally switching
+/// the UART to the baud rate given as the argument for the transfer.
 fn rz_command(
-    _args: &mut dyn Iterator<Item = &str>,
+    args: &mut dyn Iterator<Item = &str>,
     input: &mut dyn io::BufRead,
     mut output: &mut dyn io::Write,
     _builtin_cpio: &[u8],
 ) -> Result<(), CommandError> {
-    let upload = rz::rz(input, &mut output)?;
+    let baud = args.next().map(|arg| arg.parse::<u32>()).transpose()?;
+    if let Some(rate) = baud {
+        writeln!(output, "Switching to {} baud for the transfer", rate)?;
+    }
+    let upload = rz::rz(input, &mut output, baud)?;
     writeln!(
         output,
         "size: {}, crc32: {}",
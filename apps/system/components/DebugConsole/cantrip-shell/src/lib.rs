@@ -32,7 +32,9 @@ use cantrip_os_common::slot_allocator;
 use cantrip_proc_interface::cantrip_pkg_mgmt_install;
 use cantrip_proc_interface::cantrip_pkg_mgmt_install_app;
 use cantrip_proc_interface::cantrip_pkg_mgmt_uninstall;
+use cantrip_proc_interface::cantrip_proc_ctrl_get_domain_stats;
 use cantrip_proc_interface::cantrip_proc_ctrl_get_running_bundles;
+use cantrip_proc_interface::cantrip_proc_ctrl_reset_domain_stats;
 use cantrip_proc_interface::cantrip_proc_ctrl_start;
 use cantrip_proc_interface::cantrip_proc_ctrl_stop;
 use cantrip_proc_interface::ProcessManagerError;
@@ -43,6 +45,7 @@ use cantrip_security_interface::cantrip_security_write_key;
 
 use sel4_sys::seL4_CNode_Delete;
 use sel4_sys::seL4_CPtr;
+use sel4_sys::seL4_PageBits;
 use sel4_sys::seL4_WordBits;
 
 use slot_allocator::CANTRIP_CSPACE_SLOTS;
@@ -124,6 +127,7 @@ fn get_cmds() -> HashMap<&'static str, CmdFn> {
         ("builtins", builtins_command as CmdFn),
         ("bundles", bundles_command as CmdFn),
         ("capscan", capscan_command as CmdFn),
+        ("domstats", domstats_command as CmdFn),
         ("kvdelete", kvdelete_command as CmdFn),
         ("kvread", kvread_command as CmdFn),
         ("kvwrite", kvwrite_command as CmdFn),
@@ -139,8 +143,13 @@ fn get_cmds() -> HashMap<&'static str, CmdFn> {
         ("stop", stop_command as CmdFn),
         ("uninstall", uninstall_command as CmdFn),
     ]);
+    #[cfg(feature = "uart_control")]
+    cmds.extend([("ustats", ustats_command as CmdFn)]);
     #[cfg(feature = "ml_support")]
-    cmds.extend([("state_mlcoord", state_mlcoord_command as CmdFn)]);
+    cmds.extend([
+        ("mlstats", mlstats_command as CmdFn),
+        ("state_mlcoord", state_mlcoord_command as CmdFn),
+    ]);
     #[cfg(feature = "FRINGE_CMDS")]
     fringe_cmds::add_cmds(&mut cmds);
     #[cfg(feature = "TEST_GLOBAL_ALLOCATOR")]
@@ -195,7 +204,7 @@ pub fn eval<T: io::BufRead>(
 /// Read-eval-print loop for the DebugConsole command line interface.
 pub fn repl<T: io::BufRead>(output: &mut dyn io::Write, input: &mut T, builtin_cpio: &[u8]) -> ! {
     let cmds = get_cmds();
-    let mut line_reader = LineReader::new();
+    let mut line_reader: LineReader = LineReader::new();
     loop {
         const PROMPT: &str = "CANTRIP> ";
         let _ = output.write_str(PROMPT);
@@ -212,7 +221,7 @@ pub fn repl<T: io::BufRead>(output: &mut dyn io::Write, input: &mut T, builtin_c
 /// each cmd line and stops at EOF/error.
 pub fn repl_eof<T: io::BufRead>(output: &mut dyn io::Write, input: &mut T, builtin_cpio: &[u8]) {
     let cmds = get_cmds();
-    let mut line_reader = LineReader::new();
+    let mut line_reader: LineReader = LineReader::new();
     loop {
         // NB: LineReader echo's input
         let _ = write!(output, "CANTRIP> ");
@@ -295,6 +304,15 @@ fn builtins_command(
     Ok(())
 }
 
+/// Sets the max log level for the DebugConsole. This also tells clients
+/// with a log ring to discard messages at more verbose levels.
+pub(crate) fn set_log_level(level: log::LevelFilter) {
+    extern "C" {
+        fn console_set_log_level(level: usize);
+    }
+    unsafe { console_set_log_level(level as usize) }
+}
+
 /// Implements a command to configure the max log level for the DebugConsole.
 fn loglevel_command(
     args: &mut dyn Iterator<Item = &str>,
@@ -305,12 +323,12 @@ fn loglevel_command(
     if let Some(level) = args.next() {
         use log::LevelFilter;
         match level {
-            "off" => log::set_max_level(LevelFilter::Off),
-            "debug" => log::set_max_level(LevelFilter::Debug),
-            "info" => log::set_max_level(LevelFilter::Info),
-            "error" => log::set_max_level(LevelFilter::Error),
-            "trace" => log::set_max_level(LevelFilter::Trace),
-            "warn" => log::set_max_level(LevelFilter::Warn),
+            "off" => set_log_level(LevelFilter::Off),
+            "debug" => set_log_level(LevelFilter::Debug),
+            "info" => set_log_level(LevelFilter::Info),
+            "error" => set_log_level(LevelFilter::Error),
+            "trace" => set_log_level(LevelFilter::Trace),
+            "warn" => set_log_level(LevelFilter::Warn),
             _ => writeln!(output, "Unknown log level {}", level)?,
         }
     }
@@ -357,6 +375,61 @@ fn bundles_command(
     Ok(())
 }
 
+/// Implements a "domstats" command that reports CPU time per scheduling
+/// domain. "domstats reset" starts a measurement period and "domstats"
+/// ends it and reports busy & idle time for the period.
+fn domstats_command(
+    args: &mut dyn Iterator<Item = &str>,
+    _input: &mut dyn io::BufRead,
+    output: &mut dyn io::Write,
+    _builtin_cpio: &[u8],
+) -> Result<(), CommandError> {
+    fn percent(ticks: u64, total: u64) -> u64 {
+        if total == 0 {
+            0
+        } else {
+            ticks.saturating_mul(100) / total
+        }
+    }
+    let result = match args.next() {
+        Some("reset") => cantrip_proc_ctrl_reset_domain_stats(),
+        Some(_) => return Err(CommandError::BadArgs),
+        None => match cantrip_proc_ctrl_get_domain_stats() {
+            Ok(stats) => {
+                writeln!(
+                    output,
+                    "{} ticks, {} idle ({}%)",
+                    stats.total,
+                    stats.idle,
+                    percent(stats.idle, stats.total)
+                )?;
+                for (domain, ticks) in stats.domains.iter().enumerate() {
+                    writeln!(
+                        output,
+                        "domain {}: busy {} ({}%) idle {} ({}%)",
+                        domain,
+                        ticks.busy,
+                        percent(ticks.busy, stats.total),
+                        ticks.idle,
+                        percent(ticks.idle, stats.total)
+                    )?;
+                }
+                Ok(())
+            }
+            Err(status) => Err(status),
+        },
+    };
+    match result {
+        Ok(_) => {}
+        Err(ProcessManagerError::NotSupported) => writeln!(
+            output,
+            "Kernel support not configured with CONFIG_BENCHMARK_TRACK_UTILISATION!"
+        )?,
+        Err(status) => writeln!(output, "domstats failed: {:?}", status)?,
+    }
+    Ok(())
+}
+
 /// Implements a "capscan" command that dumps seL4 capabilities to the console.
 #[allow(unused_variables)]
 fn capscan_command(
@@ -453,7 +526,7 @@ fn collect_from_zmodem(
     mut output: &mut dyn io::Write,
 ) -> Option<ObjDescBundle> {
     writeln!(output, "Starting zmodem upload...").ok()?;
-    let mut upload = rz::rz(input, &mut output).ok()?;
+    let mut upload = rz::rz(input, &mut output, None).ok()?;
     upload.finish();
     writeln!(
         output,
@@ -749,6 +822,42 @@ fn mstats(output: &mut dyn io::Write, stats: &MemoryManagerStats) -> Result<(),
         "{} objs in-use, {} objs requested",
         stats.allocated_objs, stats.total_requested_objs
     )?;
+    writeln!(
+        output,
+        "{} objs cached, {} cache hits, {} cache misses",
+        stats.cached_objs, stats.cache_hits, stats.cache_misses
+    )?;
+    writeln!(output, "{} bytes largest free", stats.largest_free_bytes)?;
+    write!(output, "free slabs by largest object:")?;
+    for (i, count) in stats.free_histogram.iter().enumerate() {
+        if *count != 0 {
+            let plus = if i == FREE_HISTOGRAM_BUCKETS - 1 {
+                "+"
+            } else {
+                ""
+            };
+            write!(output, " {}K{}:{}", (1 << (seL4_PageBits + i)) / 1024, plus, count)?;
+        }
+    }
+    writeln!(output)?;
+    write!(output, "alloc latency (ticks):")?;
+    for (i, count) in stats.alloc_latency.iter().enumerate() {
+        if *count != 0 {
+            if i == ALLOC_LATENCY_BUCKETS - 1 {
+                write!(output, " >={}:{}", 1 << (ALLOC_LATENCY_BASE_BITS + i - 1), count)?;
+            } else {
+                write!(output, " <{}:{}", 1 << (ALLOC_LATENCY_BASE_BITS + i), count)?;
+            }
+        }
+    }
+    writeln!(output)?;
+    write!(output, "peak bytes by client:")?;
+    for (i, peak) in stats.client_peak_bytes.iter().enumerate() {
+        if *peak != 0 {
+            write!(output, " [{}]:{}", i + 1, peak)?;
+        }
+    }
+    writeln!(output)?;
     Ok(())
 }
 
@@ -769,6 +878,136 @@ fn mstats_command(
     Ok(())
 }
 
+/// Implements a "ustats" command that dumps the UART driver performance
+/// counters; "ustats reset" zeroes them afterwards.
+#[cfg(feature = "uart_control")]
+fn ustats_command(
+    args: &mut dyn Iterator<Item = &str>,
+    _input: &mut dyn io::BufRead,
+    output: &mut dyn io::Write,
+    _builtin_cpio: &[u8],
+) -> Result<(), CommandError> {
+    let stats = cantrip_uart_client::get_stats()?;
+    let handlers = [
+        ("tx_watermark", &stats.tx_watermark),
+        ("tx_empty", &stats.tx_empty),
+        ("rx_watermark", &stats.rx_watermark),
+        ("rx_timeout", &stats.rx_timeout),
+    ];
+    for (name, isr) in handlers {
+        writeln!(
+            output,
+            "{}: {} irqs, {} bytes, avg {} max {} ticks",
+            name,
+            isr.count,
+            isr.bytes,
+            isr.avg_ticks(),
+            isr.max_ticks
+        )?;
+    }
+    writeln!(
+        output,
+        "{} rx stalls, {} short writes, high water tx {} rx {} bytes",
+        stats.rx_stalls, stats.short_writes, stats.tx_buf_high_water, stats.rx_buf_high_water
+    )?;
+    match args.next() {
+        Some("reset") => cantrip_uart_client::reset_stats()?,
+        Some(_) => return Err(CommandError::BadArgs),
+        None => {}
+    }
+    Ok(())
+}
+
+/// Implements an "mlstats" command that reports where ML inference time
+/// goes: per-model queue wait, image load, execution & period jitter,
+/// and how busy the vector core is.
+#[cfg(feature = "ml_support")]
+fn mlstats_command(
+    _args: &mut dyn Iterator<Item = &str>,
+    _input: &mut dyn io::BufRead,
+    output: &mut dyn io::Write,
+    _builtin_cpio: &[u8],
+) -> Result<(), CommandError> {
+    let stats = match cantrip_mlcoord_stats() {
+        Ok(stats) => stats,
+        Err(status) => {
+            writeln!(output, "mlstats failed: {:?}", status)?;
+            return Ok(());
+        }
+    };
+    // Converts ticks to microseconds; ticks are shown if the rate is unknown.
+    let us = |ticks: u64| -> u64 {
+        if stats.clock_hz == 0 {
+            ticks
+        } else {
+            ticks.saturating_mul(1_000_000) / stats.clock_hz
+        }
+    };
+    let units = if stats.clock_hz == 0 { "ticks" } else { "us" };
+    let busy_pct = if stats.elapsed_ticks == 0 {
+        0
+    } else {
+        stats.busy_ticks.saturating_mul(100) / stats.elapsed_ticks
+    };
+    writeln!(
+        output,
+        "vector core busy {} of {} {} ({}%)",
+        us(stats.busy_ticks),
+        us(stats.elapsed_ticks),
+        units,
+        busy_pct
+    )?;
+    writeln!(
+        output,
+        "{} load failures, {} dropped periodic runs, {} static data reuses, {} prefetched ({} no space)",
+        stats.load_failures,
+        stats.already_queued,
+        stats.static_data_reuse,
+        stats.prefetched,
+        stats.prefetch_no_space
+    )?;
+    // NB: only query job ids that have a model (one RPC each)
+    let live_jobs = (0..ML_JOB_MASK_PAGES * ML_JOB_MASK_BITS).filter(|idx| {
+        stats.live_jobs[idx / ML_JOB_MASK_BITS] & (1 << (idx % ML_JOB_MASK_BITS)) != 0
+    });
+    for job_id in live_jobs.map(|idx| idx as MlJobId) {
+        let model = match cantrip_mlcoord_model_stats(job_id) {
+            Ok(model) => model,
+            Err(MlCoordError::NoSuchModel) => continue,
+            Err(status) => {
+                writeln!(output, "[{}]: stats failed: {:?}", job_id, status)?;
+                continue;
+            }
+        };
+        if model.period_ms == 0 {
+            writeln!(output, "[{}] {}:{} oneshot", job_id, model.bundle_id, model.model_id)?;
+        } else {
+            writeln!(
+                output,
+                "[{}] {}:{} every {} ms",
+                job_id, model.bundle_id, model.model_id, model.period_ms
+            )?;
+        }
+        for (name, timing) in [
+            ("queue wait", &model.queue_wait),
+            ("load", &model.load),
+            ("exec", &model.exec),
+            ("jitter", &model.jitter),
+        ] {
+            writeln!(
+                output,
+                "  {}: {} runs, avg {} max {} {}",
+                name,
+                timing.count,
+                us(timing.avg_ticks()),
+                us(timing.max_ticks),
+                units
+            )?;
+        }
+    }
+    Ok(())
+}
+
 #[cfg(feature = "ml_support")]
 fn state_mlcoord_command(
     _args: &mut dyn Iterator<Item = &str>,
@@ -13,17 +13,24 @@
 // limitations under the License.
 
 //! Wrapper types for fully-buffered ZMODEM receives.
+//!
+//! Received data is written straight into page frames mapped one at a time
+//! at the UPLOAD copyregion; there is no intermediate buffer. Upload is a
+//! zmodem Sink: a subpacket that fails its CRC check is rewound, which may
+//! mean freeing frames and re-mapping the one holding the rewind point.
 
 // TODO(sleffler): maybe extract the page-at-a-time support to it's own crate
 
 use alloc::vec;
 use cantrip_memory_interface::cantrip_frame_alloc;
+use cantrip_memory_interface::cantrip_object_free_toplevel;
+use cantrip_memory_interface::ObjDesc;
 use cantrip_memory_interface::ObjDescBundle;
 use cantrip_os_common::sel4_sys;
 use core::cmp;
 use core::ptr;
-use crc::crc32;
-use crc::Hasher32;
+use zmodem::crc::Crc32;
+use zmodem::recv::Sink;
 
 use sel4_sys::seL4_CPtr;
 use sel4_sys::seL4_CapRights;
@@ -40,6 +47,7 @@ enum UploadError {
     PageMap,
     PageUnmap,
     Malloc,
+    Free,
 }
 impl From<UploadError> for io::Error {
     fn from(_err: UploadError) -> io::Error { io::Error }
@@ -55,17 +63,19 @@ extern "C" {
 }
 
 pub struct Upload {
-    digest: crc32::Digest,
+    digest: Crc32,
     frames: ObjDescBundle, // Page frames
     mapped_page: *mut u8,  // Currently mapped page frame
     mapped_bytes: usize,   // Bytes in mapped_frame, 0 =>'s no frame mapped
     next_free: usize,      // Next available byte in mapped frame
+    committed_len: usize,  // Sink::rewind point
+    committed_digest: Crc32,
 }
 
 impl Upload {
     pub fn new() -> Self {
         Upload {
-            digest: crc32::Digest::new(crc32::IEEE),
+            digest: Crc32::new(),
             frames: ObjDescBundle::new(
                 // Collect frames in the top-level CNode for now
                 unsafe { SELF_CNODE },
@@ -75,6 +85,8 @@ impl Upload {
             mapped_page: unsafe { ptr::addr_of_mut!(UPLOAD[0]) },
             mapped_bytes: 0, // NB: nothing mapped
             next_free: 0,
+            committed_len: 0,
+            committed_digest: Crc32::new(),
         }
     }
     pub fn crc32(&self) -> u32 { self.digest.sum32() }
@@ -105,7 +117,13 @@ impl Upload {
         assert_eq!(new_page.cnode, self.frames.cnode);
         assert_eq!(new_page.depth, self.frames.depth);
         self.frames.objs.push(new_page.objs[0]);
+        self.map_last_frame()?;
+        self.next_free = 0;
+        Ok(())
+    }
 
+    // Maps the last (singleton) frame for write.
+    fn map_last_frame(&mut self) -> Result<(), UploadError> {
         let frame = &self.frames.objs.last().unwrap();
         unsafe {
             seL4_Page_Map(
@@ -122,7 +140,49 @@ impl Upload {
         }
         .map_err(|_| UploadError::PageMap)?;
         self.mapped_bytes = PAGE_SIZE;
-        self.next_free = 0;
+        Ok(())
+    }
+
+    // Removes the last frame from |frames| (splitting it off a combined
+    // ObjDesc as needed) and returns it.
+    fn pop_frame(&mut self) -> Option<ObjDesc> {
+        let last = self.frames.objs.pop()?;
+        let count = last.retype_count();
+        if count > 1 {
+            self.frames
+                .objs
+                .push(ObjDesc::new(last.type_, count - 1, last.cptr));
+        }
+        Some(last.new_at(count - 1))
+    }
+
+    // Discards the data past |len|: frames no longer needed are freed and
+    // the frame holding |len| (if it is mid-frame) is re-mapped so writing
+    // resumes there.
+    fn truncate(&mut self, len: usize) -> Result<(), UploadError> {
+        if len >= self.len() {
+            return Ok(());
+        }
+        if self.mapped_bytes > 0 {
+            self.unmap_current_frame()?;
+        }
+        let keep = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+        while self.frames.count() > keep {
+            let frame = self.pop_frame().unwrap();
+            cantrip_object_free_toplevel(&ObjDescBundle::new(
+                self.frames.cnode,
+                self.frames.depth,
+                vec![frame],
+            ))
+            .map_err(|_| UploadError::Free)?;
+        }
+        let offset = len % PAGE_SIZE;
+        if offset != 0 {
+            let frame = self.pop_frame().unwrap();
+            self.frames.objs.push(frame);
+            self.map_last_frame()?;
+            self.next_free = offset;
+        }
         Ok(())
     }
 }
@@ -163,24 +223,61 @@ impl io::Write for Upload {
             // Allocate another frame and map it for write.
             self.expand_and_map()?;
         }
-        self.digest.write(buf); // Update crc32 calculation
+        self.digest.update(buf); // Update crc32 calculation
         Ok(buf.len())
     }
 
     fn flush(&mut self) -> io::Result<()> { Ok(()) }
 }
 
-/// Receives using ZMODEM and wraps the result as an Upload.
-pub fn rz<R: io::BufRead, W: io::Write>(r: R, w: W) -> Result<Upload, io::Error> {
+impl Sink for Upload {
+    fn commit(&mut self) -> io::Result<()> {
+        self.committed_len = self.len();
+        self.committed_digest = self.digest;
+        Ok(())
+    }
+
+    fn rewind(&mut self) -> io::Result<()> {
+        self.truncate(self.committed_len)?;
+        self.digest = self.committed_digest;
+        Ok(())
+    }
+}
+
+/// Receives using ZMODEM and wraps the result as an Upload. If |baud| is
+/// given the UART runs at that rate for the transfer (the sender must
+/// switch too) and is restored afterwards.
+pub fn rz<R: io::BufRead, W: io::Write>(
+    r: R,
+    w: W,
+    baud: Option<u32>,
+) -> Result<Upload, io::Error> {
+    #[cfg(feature = "uart_control")]
+    let _baud = match baud {
+        Some(rate) => Some(cantrip_uart_client::BaudRateOverride::new(rate)?),
+        None => None,
+    };
+    #[cfg(not(feature = "uart_control"))]
+    if baud.is_some() {
+        return Err(io::Error);
+    }
+
     let mut upload = Upload::new();
 
     // Turn off logging, since it goes to the UART and will cause the sender to
     // abort.
     let prior_log_level = log::max_level();
-    log::set_max_level(log::LevelFilter::Off);
+    crate::set_log_level(log::LevelFilter::Off);
+
+    // Take one interrupt per burst rather than per byte for the transfer
+    // (best effort; the transfer works either way).
+    #[cfg(feature = "uart_bulk_rx")]
+    let _rx_mode = cantrip_uart_client::BulkRxMode::new().ok();
 
-    zmodem::recv::recv(r, w, &mut upload)?;
+    let result = zmodem::recv::recv(r, w, &mut upload);
 
-    log::set_max_level(prior_log_level);
+    // NB: restore logging before reporting any transfer error
+    crate::set_log_level(prior_log_level);
+    result?;
     Ok(upload)
 }
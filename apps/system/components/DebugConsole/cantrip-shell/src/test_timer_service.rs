@@ -14,20 +14,30 @@
 
 //! TimerService shell test commands
 
+extern crate alloc;
 use crate::CmdFn;
 use crate::CommandError;
 use crate::HashMap;
+use alloc::vec::Vec;
 use core::fmt::Write;
 
 use cantrip_io as io;
+use cantrip_os_common::sel4_sys::seL4_Wait;
 
+use cantrip_timer_interface::cantrip_timer_batch;
 use cantrip_timer_interface::cantrip_timer_completed_timers;
+use cantrip_timer_interface::cantrip_timer_completed_timers_page;
+use cantrip_timer_interface::cantrip_timer_notification;
 use cantrip_timer_interface::cantrip_timer_oneshot;
 use cantrip_timer_interface::cantrip_timer_wait;
+use cantrip_timer_interface::TimerOp;
+use cantrip_timer_interface::TIMERS_PER_CLIENT;
+use cantrip_timer_interface::TIMER_MASK_PAGES;
 
 pub fn add_cmds(cmds: &mut HashMap<&str, CmdFn>) {
     cmds.extend([
         ("test_timer_async", timer_async_command as CmdFn),
+        ("test_timer_batch", timer_batch_command as CmdFn),
         ("test_timer_blocking", timer_blocking_command as CmdFn),
         ("test_timer_completed", timer_completed_command as CmdFn),
     ]);
@@ -80,6 +90,48 @@ fn timer_blocking_command(
     return Ok(writeln!(output, "Timer completed.")?);
 }
 
+/// Implements a command that arms |count| one-shot timers spread over
+/// |time_ms| with one batch request and waits for them all to complete.
+fn timer_batch_command(
+    args: &mut dyn Iterator<Item = &str>,
+    _input: &mut dyn io::BufRead,
+    output: &mut dyn io::Write,
+    _builtin_cpio: &[u8],
+) -> Result<(), CommandError> {
+    let count_str = args.next().ok_or(CommandError::BadArgs)?;
+    let count = count_str.parse::<usize>()?;
+    let time_str = args.next().ok_or(CommandError::BadArgs)?;
+    let time_ms = time_str.parse::<u32>()?;
+    if count == 0 || count > TIMERS_PER_CLIENT {
+        return Err(CommandError::BadArgs);
+    }
+
+    let ops = (0..count)
+        .map(|i| {
+            let duration_ms = time_ms as u64 * (i as u64 + 1) / count as u64;
+            TimerOp::Oneshot(i as u32, 1 + duration_ms as u32)
+        })
+        .collect::<Vec<_>>();
+    writeln!(output, "Starting {} timers over {} ms.", count, time_ms)?;
+    if let Err((applied, e)) = cantrip_timer_batch(&ops) {
+        writeln!(output, "cantrip_timer_batch failed after {} ops: {:?}", applied, e)?;
+        return Err(CommandError::BadArgs);
+    }
+
+    let mut remaining = count;
+    while remaining > 0 {
+        unsafe {
+            seL4_Wait(cantrip_timer_notification(), core::ptr::null_mut());
+        }
+        for page in 0..TIMER_MASK_PAGES {
+            let mask = cantrip_timer_completed_timers_page(page).unwrap_or(0);
+            remaining = remaining.saturating_sub(mask.count_ones() as usize);
+        }
+    }
+
+    Ok(writeln!(output, "{} timers completed.", count)?)
+}
+
 /// Implements a command that checks the completed timers.
 fn timer_completed_command(
     _args: &mut dyn Iterator<Item = &str>,
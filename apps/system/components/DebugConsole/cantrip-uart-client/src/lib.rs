@@ -14,84 +14,186 @@
 
 #![no_std]
 
-use cantrip_io as io;
+use sel4_sys::seL4_CPtr;
+use sel4_sys::seL4_Wait;
 
 const DATAPORT_SIZE: usize = 4096;
 
-pub struct Rx {
-    dataport: &'static [u8],
-}
-impl Default for Rx {
-    fn default() -> Self { Self::new() }
-}
-
-impl Rx {
-    pub fn new() -> Rx {
+// Serializes the threads writing to the UART (e.g. the DebugConsole logger,
+// log doorbell and shell). They share tx_dataport and the driver holds a
+// single write notification per client, so a second thread arming it while
+// another waits would swallow the first one's wakeup. Writers hold this from
+// their first submit until the data is queued, including across
+// wait_writable.
+struct TxLock;
+impl TxLock {
+    fn acquire() -> Self {
         extern "C" {
-            static rx_dataport: *mut cty::c_uchar;
-        }
-        Rx {
-            dataport: unsafe { core::slice::from_raw_parts(rx_dataport, DATAPORT_SIZE) },
+            fn uart_tx_mutex_lock() -> u32;
         }
+        unsafe { uart_tx_mutex_lock() };
+        TxLock
     }
 }
-
-impl io::Read for Rx {
-    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+impl Drop for TxLock {
+    fn drop(&mut self) {
         extern "C" {
-            fn uart_read_read(limit: cty::size_t) -> cty::c_int;
-        }
-        let n = unsafe { uart_read_read(buf.len()) };
-        if n >= 0 {
-            let s = n as usize;
-            buf[..s].copy_from_slice(&self.dataport[..s]);
-            Ok(s)
-        } else {
-            Err(io::Error)
+            fn uart_tx_mutex_unlock() -> u32;
         }
+        unsafe { uart_tx_mutex_unlock() };
     }
 }
 
-pub struct Tx {
-    dataport: &'static mut [u8],
+// Blocks until the UART driver signals that a short submit has room again.
+// Signals may be spurious so callers should re-check with another submit.
+// NB: must be called with the TxLock held.
+fn wait_writable() {
+    extern "C" {
+        fn uart_write_notification() -> seL4_CPtr;
+    }
+    unsafe {
+        seL4_Wait(uart_write_notification(), core::ptr::null_mut());
+    }
 }
-impl Default for Tx {
-    fn default() -> Self { Self::new() }
+
+// Queues |available| bytes already placed in (or, in zero-copy mode, still
+// waiting for) tx_dataport without blocking; see RustIO.idl4.
+fn uart_submit(available: usize) -> cantrip_io::Result<usize> {
+    extern "C" {
+        fn uart_write_submit(available: cty::size_t) -> cty::c_int;
+    }
+    let n = unsafe { uart_write_submit(available) };
+    if n >= 0 {
+        Ok(n as usize)
+    } else {
+        Err(cantrip_io::Error)
+    }
 }
 
-impl Tx {
-    pub fn new() -> Tx {
-        extern "C" {
-            static tx_dataport: *mut cty::c_uchar;
-        }
-        Tx {
-            dataport: unsafe { core::slice::from_raw_parts_mut(tx_dataport, DATAPORT_SIZE) },
-        }
+/// Sets the driver's receive interrupt coalescing: an interrupt is taken
+/// once |watermark| bytes are pending or the line has been idle for
+/// |timeout| bit times. (0, 0) restores the driver's build-time defaults.
+/// See UARTControlInterface.camkes for the accepted values.
+pub fn set_rx_mode(watermark: u32, timeout: u32) -> cantrip_io::Result<()> {
+    extern "C" {
+        fn uart_control_set_rx_mode(watermark: u32, timeout: u32) -> cty::c_int;
+    }
+    match unsafe { uart_control_set_rx_mode(watermark, timeout) } {
+        0 => Ok(()),
+        _ => Err(cantrip_io::Error),
     }
 }
 
-impl io::Write for Tx {
-    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
-        extern "C" {
-            fn uart_write_write(available: cty::size_t) -> cty::c_int;
-        }
-        self.dataport[..buf.len()].copy_from_slice(buf);
-        let n = unsafe { uart_write_write(buf.len()) };
-        if n >= 0 {
-            Ok(n as usize)
-        } else {
-            Err(io::Error)
-        }
+/// Coalesces receive interrupts for a bulk transfer (e.g. a zmodem upload)
+/// until dropped, when the driver defaults are restored.
+///
+/// NB: requires rx_timeout support, which Renode lacks; without it the tail
+///   of each burst is not delivered until more data arrives.
+pub struct BulkRxMode;
+impl BulkRxMode {
+    // Half the FIFO, leaving the other half to absorb interrupt latency.
+    const WATERMARK: u32 = 16;
+    // ~4 characters of idle line (10 bit times each).
+    const TIMEOUT: u32 = 40;
+
+    pub fn new() -> cantrip_io::Result<Self> {
+        set_rx_mode(Self::WATERMARK, Self::TIMEOUT)?;
+        Ok(BulkRxMode)
+    }
+}
+impl Drop for BulkRxMode {
+    fn drop(&mut self) { let _ = set_rx_mode(0, 0); }
+}
+
+/// Sets the line rate in bits per second; 0 restores the driver's default.
+/// Output already queued is sent at the old rate first.
+pub fn set_baud(baud: u32) -> cantrip_io::Result<()> {
+    extern "C" {
+        fn uart_control_set_baud(baud: u32) -> cty::c_int;
+    }
+    match unsafe { uart_control_set_baud(baud) } {
+        0 => Ok(()),
+        _ => Err(cantrip_io::Error),
     }
+}
 
-    fn flush(&mut self) -> io::Result<()> {
-        extern "C" {
-            fn uart_write_flush() -> cty::c_int;
-        }
-        if unsafe { uart_write_flush() } == 0 {
-            Ok(())
+/// Runs the line at a different rate (e.g. for a bulk transfer) until
+/// dropped, when the driver default is restored. The peer must switch too.
+pub struct BaudRateOverride;
+impl BaudRateOverride {
+    pub fn new(baud: u32) -> cantrip_io::Result<Self> {
+        set_baud(baud)?;
+        Ok(BaudRateOverride)
+    }
+}
+impl Drop for BaudRateOverride {
+    fn drop(&mut self) { let _ = set_baud(0); }
+}
+
+/// Per interrupt handler counters (mirrors uart_isr_stats_t in the driver's
+/// uart_stats.h). Times are in rdtime ticks.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct UartIsrStats {
+    pub total_ticks: u64,
+    pub count: u32,
+    pub bytes: u32,
+    pub max_ticks: u32,
+}
+impl UartIsrStats {
+    /// Mean handler duration in rdtime ticks.
+    pub fn avg_ticks(&self) -> u64 {
+        if self.count == 0 {
+            0
         } else {
-            Err(io::Error)
+            self.total_ticks / self.count as u64
         }
     }
 }
+
+/// UART driver performance counters (mirrors uart_driver_stats_t).
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct UartStats {
+    pub tx_watermark: UartIsrStats,
+    pub tx_empty: UartIsrStats,
+    pub rx_watermark: UartIsrStats,
+    pub rx_timeout: UartIsrStats,
+    pub rx_stalls: u32,
+    pub short_writes: u32,
+    pub tx_buf_high_water: u32,
+    pub rx_buf_high_water: u32,
+}
+
+/// Returns a snapshot of the driver's performance counters.
+pub fn get_stats() -> cantrip_io::Result<UartStats> {
+    extern "C" {
+        fn uart_control_get_stats(stats: *mut UartStats) -> cty::c_int;
+    }
+    let mut stats = UartStats::default();
+    match unsafe { uart_control_get_stats(&mut stats as *mut _) } {
+        0 => Ok(stats),
+        _ => Err(cantrip_io::Error),
+    }
+}
+
+/// Zeroes the driver's performance counters.
+pub fn reset_stats() -> cantrip_io::Result<()> {
+    extern "C" {
+        fn uart_control_reset_stats() -> cty::c_int;
+    }
+    match unsafe { uart_control_reset_stats() } {
+        0 => Ok(()),
+        _ => Err(cantrip_io::Error),
+    }
+}
+
+#[cfg(not(feature = "zero_copy"))]
+mod copy;
+#[cfg(not(feature = "zero_copy"))]
+pub use copy::{Rx, Tx};
+
+#[cfg(feature = "zero_copy")]
+mod zero_copy;
+#[cfg(feature = "zero_copy")]
+pub use zero_copy::{Rx, Tx};
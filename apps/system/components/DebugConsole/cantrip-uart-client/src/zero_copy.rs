@@ -0,0 +1,191 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! UART client that shares tx_dataport/rx_dataport with the driver as
+//! single-producer/single-consumer rings. The ring indices live in the
+//! uart_ring_header dataport; the layout and the doorbell protocol are
+//! described in OpenTitanUARTDriver/include/uart_ring.h and must match.
+//!
+//! Data is copied once, between the caller's buffer and the ring; the
+//! driver's interrupt handlers move it between the ring and the UART FIFOs.
+//! The read/write RPCs are only used to wake the driver.
+//!
+//! The DebugConsole has several writing threads; they are the TX ring's
+//! single producer only because they are serialized by the TxLock.
+
+use super::{uart_submit, wait_writable, TxLock, DATAPORT_SIZE};
+use cantrip_io as io;
+use core::cmp;
+use core::sync::atomic::{fence, AtomicU32, AtomicUsize, Ordering};
+
+const RING_MASK: usize = DATAPORT_SIZE - 1;
+
+#[repr(C)]
+struct RingIndices {
+    head: AtomicUsize, // next slot to read, written only by the consumer
+    tail: AtomicUsize, // next slot to write, written only by the producer
+}
+
+// Mirrors uart_ring_header.
+#[repr(C)]
+struct RingHeader {
+    tx: RingIndices,
+    rx: RingIndices,
+    tx_busy: AtomicU32,
+}
+
+fn ring_header() -> &'static RingHeader {
+    extern "C" {
+        static uart_ring_header: *mut cty::c_void;
+    }
+    unsafe { &*(uart_ring_header as *const RingHeader) }
+}
+
+pub struct Rx {
+    dataport: &'static [u8],
+}
+impl Default for Rx {
+    fn default() -> Self { Self::new() }
+}
+
+impl Rx {
+    pub fn new() -> Rx {
+        extern "C" {
+            static rx_dataport: *mut cty::c_uchar;
+        }
+        Rx {
+            dataport: unsafe { core::slice::from_raw_parts(rx_dataport, DATAPORT_SIZE) },
+        }
+    }
+}
+
+impl io::Read for Rx {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        extern "C" {
+            fn uart_read_read(limit: cty::size_t) -> cty::c_int;
+        }
+        if buf.is_empty() {
+            return Ok(0);
+        }
+        let rx = &ring_header().rx;
+        let head = rx.head.load(Ordering::Relaxed);
+        let mut tail = rx.tail.load(Ordering::Acquire);
+        if tail == head {
+            // Blocks in the driver until something arrives.
+            if unsafe { uart_read_read(cmp::min(buf.len(), DATAPORT_SIZE)) } < 0 {
+                return Err(io::Error);
+            }
+            tail = rx.tail.load(Ordering::Acquire);
+        }
+        let available = tail.wrapping_sub(head);
+        let n = cmp::min(available, buf.len());
+        let offset = head & RING_MASK;
+        let first = cmp::min(n, DATAPORT_SIZE - offset);
+        buf[..first].copy_from_slice(&self.dataport[offset..offset + first]);
+        buf[first..n].copy_from_slice(&self.dataport[..n - first]);
+        rx.head.store(head.wrapping_add(n), Ordering::Release);
+        if available == DATAPORT_SIZE {
+            // The ring was full so the driver may be blocked waiting for room.
+            if unsafe { uart_read_read(0) } < 0 {
+                return Err(io::Error);
+            }
+        }
+        Ok(n)
+    }
+}
+
+pub struct Tx {
+    dataport: &'static mut [u8],
+}
+impl Default for Tx {
+    fn default() -> Self { Self::new() }
+}
+
+impl Tx {
+    pub fn new() -> Tx {
+        extern "C" {
+            static tx_dataport: *mut cty::c_uchar;
+        }
+        Tx {
+            dataport: unsafe { core::slice::from_raw_parts_mut(tx_dataport, DATAPORT_SIZE) },
+        }
+    }
+}
+
+impl Tx {
+    /// Queues as much of |buf| as fits in the ring without blocking.
+    /// Returns the number of bytes queued, possibly 0; use write to block
+    /// until there is room.
+    pub fn submit(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let _lock = TxLock::acquire();
+        self.submit_locked(buf)
+    }
+
+    // NB: must be called with the TxLock held.
+    fn submit_locked(&mut self, buf: &[u8]) -> io::Result<usize> {
+        extern "C" {
+            fn uart_write_write(available: cty::size_t) -> cty::c_int;
+        }
+        if buf.is_empty() {
+            return Ok(0);
+        }
+        let header = ring_header();
+        let tx = &header.tx;
+        let tail = tx.tail.load(Ordering::Relaxed);
+        let head = tx.head.load(Ordering::Acquire);
+        let free = DATAPORT_SIZE - tail.wrapping_sub(head);
+        if free == 0 {
+            // Asks to be signalled when the driver has drained some.
+            uart_submit(cmp::min(buf.len(), DATAPORT_SIZE))?;
+            return Ok(0);
+        }
+        let n = cmp::min(free, buf.len());
+        let offset = tail & RING_MASK;
+        let first = cmp::min(n, DATAPORT_SIZE - offset);
+        self.dataport[offset..offset + first].copy_from_slice(&buf[..first]);
+        self.dataport[..n - first].copy_from_slice(&buf[first..n]);
+        tx.tail.store(tail.wrapping_add(n), Ordering::Release);
+
+        // Pairs with the driver's fence after clearing tx_busy: either the
+        // driver sees the new tail or we see tx_busy clear and ring.
+        fence(Ordering::SeqCst);
+        if header.tx_busy.load(Ordering::Relaxed) == 0 && unsafe { uart_write_write(n) } < 0 {
+            return Err(io::Error);
+        }
+        Ok(n)
+    }
+}
+
+impl io::Write for Tx {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let _lock = TxLock::acquire();
+        loop {
+            match self.submit_locked(buf)? {
+                0 if !buf.is_empty() => wait_writable(),
+                n => return Ok(n),
+            }
+        }
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        extern "C" {
+            fn uart_write_flush() -> cty::c_int;
+        }
+        if unsafe { uart_write_flush() } == 0 {
+            Ok(())
+        } else {
+            Err(io::Error)
+        }
+    }
+}
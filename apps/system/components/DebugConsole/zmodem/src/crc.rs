@@ -12,12 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-use crc32::crc32;
-use crc32::crc32::update;
-use crc32::crc32::IEEE_TABLE;
+//! ZMODEM CRCs: CRC-16/XMODEM for ZBIN frames and CRC-32/IEEE for ZBIN32.
+//!
+//! Both use slicing-by-8: eight 256-entry tables so the inner loop folds
+//! 8 bytes into the CRC per iteration with independent table lookups
+//! instead of one dependent lookup per byte. The tables are built at
+//! compile time (12KB of rodata).
 
 /* crctab calculated by Mark G. Mendel, Network Systems Corporation */
-static CRCTAB: [u16; 256] = [
+const CRCTAB: [u16; 256] = [
     0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7, 0x8108, 0x9129, 0xa14a, 0xb16b,
     0xc18c, 0xd1ad, 0xe1ce, 0xf1ef, 0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
     0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de, 0x2462, 0x3443, 0x0420, 0x1401,
@@ -54,36 +57,253 @@ static CRCTAB: [u16; 256] = [
  * Omen Technology.
  */
 
+// The classic one-byte-at-a-time update; used for the tail of a buffer.
 fn updcrc(cp: u8, crc: u16) -> u16 {
-    let idx = ((crc >> 8) & 255) as usize;
-    CRCTAB[idx] ^ (crc << 8) ^ (cp as u16)
+    let idx = ((crc >> 8) as u8 ^ cp) as usize;
+    CRCTAB[idx] ^ (crc << 8)
 }
 
-pub fn get_crc16(buf: &[u8], zcrc: Option<u8>) -> [u8; 2] {
-    let mut crc = 0;
-    for x in buf {
-        crc = updcrc(*x, crc);
+// CRC16_TABLES[k][b] is the CRC of byte b followed by k zero bytes.
+static CRC16_TABLES: [[u16; 256]; 8] = {
+    let mut t = [[0u16; 256]; 8];
+    t[0] = CRCTAB;
+    let mut k = 1;
+    while k < 8 {
+        let mut i = 0;
+        while i < 256 {
+            let prev = t[k - 1][i];
+            t[k][i] = (prev << 8) ^ CRCTAB[(prev >> 8) as usize];
+            i += 1;
+        }
+        k += 1;
     }
+    t
+};
 
-    if let Some(x) = zcrc {
-        crc = updcrc(x, crc);
+/// Incremental CRC-16/XMODEM (poly 0x1021, MSB first, no reflection).
+#[derive(Clone, Copy, Default)]
+pub struct Crc16(u16);
+impl Crc16 {
+    pub fn new() -> Self { Crc16(0) }
+
+    pub fn update(&mut self, buf: &[u8]) {
+        let t = &CRC16_TABLES;
+        let mut crc = self.0;
+        let mut chunks = buf.chunks_exact(8);
+        for b in &mut chunks {
+            let b0 = b[0] ^ (crc >> 8) as u8;
+            let b1 = b[1] ^ crc as u8;
+            crc = t[7][b0 as usize]
+                ^ t[6][b1 as usize]
+                ^ t[5][b[2] as usize]
+                ^ t[4][b[3] as usize]
+                ^ t[3][b[4] as usize]
+                ^ t[2][b[5] as usize]
+                ^ t[1][b[6] as usize]
+                ^ t[0][b[7] as usize];
+        }
+        for &b in chunks.remainder() {
+            crc = updcrc(b, crc);
+        }
+        self.0 = crc;
+    }
+
+    /// Returns the CRC in wire (big-endian) order.
+    pub fn finish(&self) -> [u8; 2] { self.0.to_be_bytes() }
+}
+
+const IEEE_POLY: u32 = 0xedb8_8320; // reflected 0x04c11db7
+
+// CRC32_TABLES[k][b] is the CRC of byte b followed by k zero bytes.
+static CRC32_TABLES: [[u32; 256]; 8] = {
+    let mut t = [[0u32; 256]; 8];
+    let mut i = 0;
+    while i < 256 {
+        let mut crc = i as u32;
+        let mut bit = 0;
+        while bit < 8 {
+            crc = if crc & 1 != 0 {
+                (crc >> 1) ^ IEEE_POLY
+            } else {
+                crc >> 1
+            };
+            bit += 1;
+        }
+        t[0][i] = crc;
+        i += 1;
+    }
+    let mut k = 1;
+    while k < 8 {
+        let mut i = 0;
+        while i < 256 {
+            let prev = t[k - 1][i];
+            t[k][i] = (prev >> 8) ^ t[0][(prev & 0xff) as usize];
+            i += 1;
+        }
+        k += 1;
+    }
+    t
+};
+
+/// Incremental CRC-32/IEEE (as used by zlib, Ethernet, etc).
+#[derive(Clone, Copy)]
+pub struct Crc32(u32);
+impl Default for Crc32 {
+    fn default() -> Self { Self::new() }
+}
+impl Crc32 {
+    pub fn new() -> Self { Crc32(!0) }
+
+    pub fn update(&mut self, buf: &[u8]) {
+        let t = &CRC32_TABLES;
+        let mut crc = self.0;
+        let mut chunks = buf.chunks_exact(8);
+        for b in &mut chunks {
+            let lo = crc ^ u32::from_le_bytes([b[0], b[1], b[2], b[3]]);
+            crc = t[7][(lo & 0xff) as usize]
+                ^ t[6][((lo >> 8) & 0xff) as usize]
+                ^ t[5][((lo >> 16) & 0xff) as usize]
+                ^ t[4][(lo >> 24) as usize]
+                ^ t[3][b[4] as usize]
+                ^ t[2][b[5] as usize]
+                ^ t[1][b[6] as usize]
+                ^ t[0][b[7] as usize];
+        }
+        for &b in chunks.remainder() {
+            crc = (crc >> 8) ^ t[0][((crc ^ b as u32) & 0xff) as usize];
+        }
+        self.0 = crc;
     }
 
-    crc = updcrc(0, updcrc(0, crc));
+    pub fn sum32(&self) -> u32 { !self.0 }
+
+    /// Returns the CRC in wire (little-endian) order.
+    pub fn finish(&self) -> [u8; 4] { self.sum32().to_le_bytes() }
+}
 
-    [(crc >> 8) as u8, (crc & 0xff) as u8]
+/// The CRC of a data subpacket or header, selected by the frame encoding.
+#[derive(Clone, Copy)]
+pub enum FrameCrc {
+    Crc16(Crc16),
+    Crc32(Crc32),
+}
+impl FrameCrc {
+    /// Returns the CRC used by frames with |header| (ZBIN32 => CRC-32).
+    pub fn for_header(header: u8) -> Self {
+        if header == crate::consts::ZBIN32 {
+            FrameCrc::Crc32(Crc32::new())
+        } else {
+            FrameCrc::Crc16(Crc16::new())
+        }
+    }
+
+    pub fn update(&mut self, buf: &[u8]) {
+        match self {
+            FrameCrc::Crc16(crc) => crc.update(buf),
+            FrameCrc::Crc32(crc) => crc.update(buf),
+        }
+    }
+
+    /// Returns true if |wire| (the CRC bytes that followed the data)
+    /// matches.
+    pub fn check(&self, wire: &[u8]) -> bool {
+        match self {
+            FrameCrc::Crc16(crc) => wire == crc.finish(),
+            FrameCrc::Crc32(crc) => wire == crc.finish(),
+        }
+    }
+
+    /// Length of the CRC on the wire.
+    pub fn wire_len(&self) -> usize {
+        match self {
+            FrameCrc::Crc16(_) => 2,
+            FrameCrc::Crc32(_) => 4,
+        }
+    }
+}
+
+pub fn get_crc16(buf: &[u8], zcrc: Option<u8>) -> [u8; 2] {
+    let mut crc = Crc16::new();
+    crc.update(buf);
+    if let Some(x) = zcrc {
+        crc.update(&[x]);
+    }
+    crc.finish()
 }
 
 pub fn get_crc32(buf: &[u8], zcrc: Option<u8>) -> [u8; 4] {
-    let mut crc = crc32::checksum_ieee(buf);
+    let mut crc = Crc32::new();
+    crc.update(buf);
     if let Some(x) = zcrc {
-        crc = update(crc, &IEEE_TABLE, &[x]);
+        crc.update(&[x]);
     }
+    crc.finish()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use alloc::vec::Vec;
 
-    [
-        (crc & 0xff) as u8,
-        (crc >> 8) as u8,
-        (crc >> 16) as u8,
-        (crc >> 24) as u8,
-    ]
+    // The original augmented updcrc loop the sliced version replaces.
+    fn reference_crc16(buf: &[u8]) -> [u8; 2] {
+        fn updcrc(cp: u8, crc: u16) -> u16 {
+            CRCTAB[((crc >> 8) & 255) as usize] ^ (crc << 8) ^ (cp as u16)
+        }
+        let mut crc = 0;
+        for &x in buf {
+            crc = updcrc(x, crc);
+        }
+        crc = updcrc(0, updcrc(0, crc));
+        [(crc >> 8) as u8, (crc & 0xff) as u8]
+    }
+
+    fn reference_crc32(buf: &[u8]) -> u32 {
+        let mut crc = !0u32;
+        for &b in buf {
+            crc ^= b as u32;
+            for _ in 0..8 {
+                crc = if crc & 1 != 0 {
+                    (crc >> 1) ^ IEEE_POLY
+                } else {
+                    crc >> 1
+                };
+            }
+        }
+        !crc
+    }
+
+    #[test]
+    fn test_check_values() {
+        assert_eq!(get_crc16(b"123456789", None), [0x31, 0xc3]);
+        assert_eq!(get_crc32(b"123456789", None), 0xcbf4_3926u32.to_le_bytes());
+    }
+
+    #[test]
+    fn test_matches_bytewise() {
+        let data: Vec<u8> = (0..1031u32).map(|i| (i * 7 + i / 5) as u8).collect();
+        for len in [0, 1, 7, 8, 9, 63, 64, 1031] {
+            let buf = &data[..len];
+            assert_eq!(get_crc16(buf, None), reference_crc16(buf), "len {}", len);
+            assert_eq!(
+                get_crc32(buf, None),
+                reference_crc32(buf).to_le_bytes(),
+                "len {}",
+                len
+            );
+        }
+    }
+
+    #[test]
+    fn test_incremental() {
+        let data: Vec<u8> = (0..500u32).map(|i| (i * 31) as u8).collect();
+        let mut crc16 = Crc16::new();
+        let mut crc32 = Crc32::new();
+        for chunk in data.chunks(13) {
+            crc16.update(chunk);
+            crc32.update(chunk);
+        }
+        assert_eq!(crc16.finish(), get_crc16(&data, None));
+        assert_eq!(crc32.finish(), get_crc32(&data, None));
+    }
 }
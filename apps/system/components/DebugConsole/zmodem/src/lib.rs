@@ -16,13 +16,13 @@
 
 extern crate alloc;
 extern crate cantrip_io;
-extern crate crc as crc32;
 extern crate hex;
 #[macro_use]
 extern crate log;
+extern crate memchr;
 
 mod consts;
-mod crc;
+pub mod crc;
 mod frame;
 mod proto;
 
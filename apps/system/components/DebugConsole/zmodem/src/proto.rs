@@ -22,6 +22,7 @@ use log::Level::Debug;
 use consts::*;
 use crc::*;
 use frame::*;
+use recv::Sink;
 
 /// Looking for sequence: ZPAD [ZPAD] ZLDE
 /// Returns true if found otherwise false
@@ -158,6 +159,59 @@ where
     Ok(buf.pop()) // pop ZCRC* byte
 }
 
+/// Streams a data subpacket (<escaped data> ZLDE ZCRC* <CRC bytes>) from
+/// |r| to |data_out| as it arrives: runs of unescaped bytes are taken
+/// directly from the BufRead's buffer and checksummed & written without
+/// staging the subpacket. Returns the ZCRC* byte and the data length if
+/// the CRC matches; otherwise None and the caller must rewind |data_out|.
+pub fn recv_zlde_stream<R, DO>(
+    header: u8,
+    r: &mut R,
+    data_out: &mut DO,
+) -> io::Result<Option<(u8, usize)>>
+where
+    R: io::BufRead,
+    DO: io::Write,
+{
+    let mut crc = FrameCrc::for_header(header);
+    let mut len = 0;
+    let zcrc = loop {
+        let available = r.fill_buf()?;
+        if available.is_empty() {
+            return Err(io::Error); // EOF
+        }
+        let (run, used) = match memchr::memchr(ZLDE, available) {
+            Some(i) => (&available[..i], i + 1),
+            None => (available, available.len()),
+        };
+        crc.update(run);
+        data_out.write_all(run)?;
+        len += run.len();
+        let escape = used > run.len();
+        r.consume(used);
+        if escape {
+            let b = read_byte(r)?;
+            if !is_escaped(b) {
+                crc.update(&[b]);
+                break b;
+            }
+            let b = unescape(b);
+            crc.update(&[b]);
+            data_out.write_all(&[b])?;
+            len += 1;
+        }
+    };
+
+    let mut crc1 = [0u8; 4];
+    let crc1 = &mut crc1[..crc.wire_len()];
+    read_exact_unescaped(&mut *r, crc1)?;
+    if !crc.check(crc1) {
+        error!("crc mismatch on {} byte subpacket", len);
+        return Ok(None);
+    }
+    Ok(Some((zcrc, len)))
+}
+
 pub fn recv_data<CI, CO, DO>(
     header: u8,
     count: &mut u32,
@@ -168,20 +222,18 @@ pub fn recv_data<CI, CO, DO>(
 where
     CI: io::BufRead,
     CO: io::Write,
-    DO: io::Write,
+    DO: Sink,
 {
-    let mut buf = Vec::new();
-
     loop {
-        buf.clear();
-
-        let zcrc = match recv_zlde_frame(header, channel_in, &mut buf)? {
+        let (zcrc, len) = match recv_zlde_stream(header, channel_in, data_out)? {
             Some(x) => x,
-            None => return Ok(false),
+            None => {
+                data_out.rewind()?;
+                return Ok(false);
+            }
         };
-
-        data_out.write_all(&buf)?;
-        *count += buf.len() as u32;
+        data_out.commit()?;
+        *count += len as u32;
 
         match zcrc {
             ZCRCW => {
@@ -484,4 +536,55 @@ mod tests {
         );
         assert_eq!(&v[..], [0, 1, 2, 3, 4, 0x20, 0x20]);
     }
+
+    #[test]
+    fn test_recv_zlde_stream() {
+        use recv::Staged;
+
+        // Same subpackets as test_recv_zlde_frame.
+        let i = vec![ZLDE, 0x00, ZLDE, ZCRCW, 221, 205];
+        let mut v = vec![];
+        assert_eq!(
+            recv_zlde_stream(ZBIN, &mut i.as_slice(), &mut v).unwrap(),
+            Some((ZCRCW, 1))
+        );
+        assert_eq!(&v[..], [0x00]);
+
+        let i = vec![
+            0, 1, 2, 3, 4, ZLDE, 0x60, ZLDE, 0x60, ZLDE, ZCRCQ, 85, 114, 241, 70,
+        ];
+        let mut v = vec![];
+        assert_eq!(
+            recv_zlde_stream(ZBIN32, &mut i.as_slice(), &mut v).unwrap(),
+            Some((ZCRCQ, 7))
+        );
+        assert_eq!(&v[..], [0, 1, 2, 3, 4, 0x20, 0x20]);
+
+        // A bad CRC is reported and the data is not committed.
+        let i = vec![0, 1, 2, ZLDE, ZCRCE, 0, 0, 0, 0];
+        let mut out = Staged::new(vec![]);
+        assert_eq!(recv_zlde_stream(ZBIN32, &mut i.as_slice(), &mut out).unwrap(), None);
+        out.rewind().unwrap();
+        assert!(out.into_inner().is_empty());
+
+        // Escapes split across reads of at most 3 bytes.
+        struct Trickle<'a>(&'a [u8]);
+        impl cantrip_io::Read for Trickle<'_> {
+            fn read(&mut self, buf: &mut [u8]) -> cantrip_io::Result<usize> {
+                let n = core::cmp::min(core::cmp::min(3, buf.len()), self.0.len());
+                buf[..n].copy_from_slice(&self.0[..n]);
+                self.0 = &self.0[n..];
+                Ok(n)
+            }
+        }
+        let data: Vec<u8> = (0..=255u8).collect();
+        let mut wire = vec![];
+        escape_buf(&data, &mut wire);
+        wire.extend_from_slice(&[ZLDE, ZCRCG]);
+        escape_buf(&get_crc32(&data, Some(ZCRCG)), &mut wire);
+        let mut r = cantrip_io::BufReader::new(Trickle(&wire));
+        let mut v = vec![];
+        assert_eq!(recv_zlde_stream(ZBIN32, &mut r, &mut v).unwrap(), Some((ZCRCG, 256)));
+        assert_eq!(v, data);
+    }
 }
@@ -21,6 +21,56 @@ use consts::*;
 use frame::*;
 use proto::*;
 
+/// Destination for received file data. Each subpacket is written as it
+/// arrives, before its CRC has been checked; the receiver then commits it
+/// or, if the CRC does not match, rewinds to the last commit so the
+/// sender can resend (ZRPOS). This lets data be written straight to its
+/// final location (e.g. the pages of an upload).
+pub trait Sink: io::Write {
+    /// Accepts everything written since the last commit.
+    fn commit(&mut self) -> io::Result<()>;
+    /// Discards everything written since the last commit.
+    fn rewind(&mut self) -> io::Result<()>;
+}
+
+/// Sink for a plain io::Write: uncommitted data is held in a Vec and
+/// passed on when committed.
+pub struct Staged<W> {
+    inner: W,
+    pending: Vec<u8>,
+}
+impl<W: io::Write> Staged<W> {
+    pub fn new(inner: W) -> Self {
+        Staged {
+            inner,
+            pending: Vec::new(),
+        }
+    }
+    pub fn into_inner(self) -> W { self.inner }
+}
+impl<W: io::Write> io::Write for Staged<W> {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        self.pending.extend_from_slice(buf);
+        Ok(buf.len())
+    }
+    fn flush(&mut self) -> io::Result<()> { self.inner.flush() }
+}
+impl<W: io::Write> Sink for Staged<W> {
+    fn commit(&mut self) -> io::Result<()> {
+        let result = self.inner.write_all(&self.pending);
+        self.pending.clear();
+        result
+    }
+    fn rewind(&mut self) -> io::Result<()> {
+        self.pending.clear();
+        Ok(())
+    }
+}
+impl<T: Sink + ?Sized> Sink for &mut T {
+    fn commit(&mut self) -> io::Result<()> { (**self).commit() }
+    fn rewind(&mut self) -> io::Result<()> { (**self).rewind() }
+}
+
 #[derive(Debug, PartialEq)]
 enum State {
     /// Sending ZRINIT
@@ -73,7 +123,7 @@ pub fn recv<CI, CO, DO>(
 where
     CI: io::BufRead,
     CO: io::Write,
-    DO: io::Write,
+    DO: Sink,
 {
     let mut count = 0;
 
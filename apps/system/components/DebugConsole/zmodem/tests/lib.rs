@@ -102,13 +102,13 @@ fn recv_from_sz() {
     let mut c = Cursor::new(Vec::new());
 
     zmodem::recv::recv(
-        ReadWrapper {
+        cantrip_io::BufReader::new(ReadWrapper {
             r: sz.stdout.unwrap(),
-        },
+        }),
         WriteWrapper {
             w: sz.stdin.unwrap(),
         },
-        WriteWrapper { w: &mut c },
+        zmodem::recv::Staged::new(WriteWrapper { w: &mut c }),
     )
     .unwrap();
 
@@ -201,13 +201,13 @@ fn lib_send_recv() {
     let mut c = Cursor::new(Vec::new());
 
     zmodem::recv::recv(
-        ReadWrapper {
+        cantrip_io::BufReader::new(ReadWrapper {
             r: File::open("test-fifo1").unwrap(),
-        },
+        }),
         WriteWrapper {
             w: OpenOptions::new().write(true).open("test-fifo2").unwrap(),
         },
-        WriteWrapper { w: &mut c },
+        zmodem::recv::Staged::new(WriteWrapper { w: &mut c }),
     )
     .unwrap();
 
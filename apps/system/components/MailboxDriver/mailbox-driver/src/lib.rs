@@ -137,6 +137,10 @@ fn dequeue_u32() -> u32 {
     }
 }
 
+fn outbox_full() -> bool { unsafe { (get_STATUS() & STATUS_BIT_FULL) == STATUS_BIT_FULL } }
+
+fn inbox_empty() -> bool { unsafe { (get_STATUS() & STATUS_BIT_EMPTY) == STATUS_BIT_EMPTY } }
+
 fn drain_read_fifo() {
     unsafe {
         while (get_STATUS() & STATUS_BIT_EMPTY) == 0 {
@@ -147,15 +151,211 @@ fn drain_read_fifo() {
 
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// Queued transfers. Requests are held here until the outbox has room so
+// several may be in flight at once. The security core replies with the
+// paddr of the request page so each response is matched to its transfer
+// by paddr and marked done for whoever waits on the transfer's tag. Not
+// thread-safe, should only be used while holding the api_mutex lock.
+
+// Max transfers in flight (queued, sent, or done but not yet collected).
+const MAX_TRANSFERS: usize = 8;
+
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum TransferState {
+    Free,
+    Queued,    // Waiting for room in the outbox
+    Sent,      // Waiting for the response
+    Done,      // Response waiting to be collected
+    Abandoned, // Sent but not wanted; freed when the response arrives
+}
+
+#[derive(Clone, Copy)]
+struct Transfer {
+    state: TransferState,
+    tag: u32,
+    seq: u32,       // Post order; queued transfers are sent oldest first
+    untagged: bool, // From api_send, collected by api_receive
+    request_paddr: u32,
+    request_size: u32,
+    response_paddr: u32,
+    response_size: u32,
+}
+impl Transfer {
+    const fn empty() -> Self {
+        Transfer {
+            state: TransferState::Free,
+            tag: 0,
+            seq: 0,
+            untagged: false,
+            request_paddr: 0,
+            request_size: 0,
+            response_paddr: 0,
+            response_size: 0,
+        }
+    }
+}
+
+struct Transfers {
+    slots: [Transfer; MAX_TRANSFERS],
+    next_tag: u32,
+    next_seq: u32,
+}
+impl Transfers {
+    const fn new() -> Self {
+        Transfers {
+            slots: [Transfer::empty(); MAX_TRANSFERS],
+            next_tag: 1,
+            next_seq: 0,
+        }
+    }
+
+    // Queues a request; returns its tag or None if no slot is free or the
+    // page is already in flight (its response could not be matched).
+    fn post(&mut self, request_paddr: u32, request_size: u32, untagged: bool) -> Option<u32> {
+        if self
+            .slots
+            .iter()
+            .any(|t| t.state != TransferState::Free && t.request_paddr == request_paddr)
+        {
+            return None;
+        }
+        let tag = self.next_tag;
+        let seq = self.next_seq;
+        let slot = self
+            .slots
+            .iter_mut()
+            .find(|t| t.state == TransferState::Free)?;
+        *slot = Transfer {
+            state: TransferState::Queued,
+            tag,
+            seq,
+            untagged,
+            request_paddr,
+            request_size,
+            ..Transfer::empty()
+        };
+        self.next_tag = self.next_tag.wrapping_add(1).max(1); // NB: 0 is never a tag
+        self.next_seq = self.next_seq.wrapping_add(1);
+        Some(tag)
+    }
+
+    // Writes queued requests to the outbox, oldest first, while it has room.
+    fn send_queued(&mut self) {
+        loop {
+            let next_seq = self.next_seq;
+            let oldest = self
+                .slots
+                .iter_mut()
+                .filter(|t| t.state == TransferState::Queued)
+                .min_by_key(|t| t.seq.wrapping_sub(next_seq));
+            let transfer = match oldest {
+                Some(transfer) if !outbox_full() => transfer,
+                _ => break,
+            };
+            // NB: the paddr may briefly wait for the second slot.
+            enqueue_u32(transfer.request_size | HEADER_FLAG_LONG_MESSAGE);
+            enqueue_u32(transfer.request_paddr);
+            transfer.state = TransferState::Sent;
+        }
+    }
+
+    // Moves every response in the inbox to its transfer.
+    fn receive_responses(&mut self) {
+        while !inbox_empty() {
+            let message_header = unsafe { get_MBOXR() };
+            let message_paddr = dequeue_u32();
+            match self.slots.iter_mut().find(|t| {
+                (t.state == TransferState::Sent || t.state == TransferState::Abandoned)
+                    && t.request_paddr == message_paddr
+            }) {
+                Some(transfer) if transfer.state == TransferState::Abandoned => {
+                    transfer.state = TransferState::Free;
+                }
+                Some(transfer) => {
+                    transfer.state = TransferState::Done;
+                    transfer.response_paddr = message_paddr;
+                    transfer.response_size = message_header & !HEADER_FLAG_LONG_MESSAGE;
+                }
+                None => error!("Unexpected response for paddr 0x{:X}", message_paddr),
+            }
+        }
+    }
+
+    fn find_tagged(&mut self, tag: u32) -> Option<&mut Transfer> {
+        self.slots.iter_mut().find(|t| {
+            t.state != TransferState::Free
+                && t.state != TransferState::Abandoned
+                && !t.untagged
+                && t.tag == tag
+        })
+    }
+
+    // Collects the response for |tag|. Returns None if |tag| is not in
+    // flight, Some(None) if the response has not arrived.
+    fn collect(&mut self, tag: u32) -> Option<Option<(u32, u32)>> {
+        Some(Self::take(self.find_tagged(tag)?))
+    }
+
+    // Drops the transfer for |tag| without collecting its response.
+    // A request still in the outbox queue is discarded. A request the
+    // security core already has keeps its slot (and page) until the
+    // response arrives so the response is not matched to a later
+    // request for the same page. Returns false if |tag| is not in flight.
+    fn abandon(&mut self, tag: u32) -> bool {
+        match self.find_tagged(tag) {
+            Some(transfer) => {
+                transfer.state = match transfer.state {
+                    TransferState::Sent => TransferState::Abandoned,
+                    _ => TransferState::Free,
+                };
+                true
+            }
+            None => false,
+        }
+    }
+
+    // Returns whether an api_send request is waiting to be collected.
+    fn has_untagged(&self) -> bool {
+        self.slots.iter().any(|t| {
+            t.state != TransferState::Free && t.state != TransferState::Abandoned && t.untagged
+        })
+    }
+
+    // Collects the oldest response for an api_send request.
+    fn collect_untagged(&mut self) -> Option<(u32, u32)> {
+        let next_seq = self.next_seq;
+        let transfer = self
+            .slots
+            .iter_mut()
+            .filter(|t| t.state == TransferState::Done && t.untagged)
+            .min_by_key(|t| t.seq.wrapping_sub(next_seq))?;
+        Self::take(transfer)
+    }
+
+    fn take(transfer: &mut Transfer) -> Option<(u32, u32)> {
+        if transfer.state != TransferState::Done {
+            return None;
+        }
+        transfer.state = TransferState::Free;
+        Some((transfer.response_paddr, transfer.response_size))
+    }
+}
+
+static mut TRANSFERS: Transfers = Transfers::new();
+
+//------------------------------------------------------------------------------
+
 #[no_mangle]
 pub unsafe extern "C" fn pre_init() {
     static CANTRIP_LOGGER: CantripLogger = CantripLogger;
     log::set_logger(&CANTRIP_LOGGER).unwrap();
     log::set_max_level(log::LevelFilter::Trace);
 
-    // We always want our receive interrupt to fire as soon as anything appears
-    // in the mailbox, so set the threshold to 0.
-    set_RIRQT(0);
+    // Every message is two words (header + paddr) so set the threshold to
+    // have our receive interrupt fire once a whole message is in the
+    // mailbox; rtirq_handle then never waits on the second word.
+    set_RIRQT(1);
     set_INTR_STATE(INTR_STATE_BIT_RTIRQ);
     set_INTR_ENABLE(INTR_ENABLE_BIT_RTIRQ);
 }
@@ -177,8 +377,19 @@ pub unsafe extern "C" fn wtirq_handle() {
 pub unsafe extern "C" fn rtirq_handle() {
     trace!("rtirq_handle()");
 
-    // Unblock anyone waiting for a message. api_receive() below will clear
-    // the interrupt once the message has been deliverd to the client.
+    api_mutex_lock();
+
+    // Move the responses to their transfers. Each response means the
+    // security core has taken a request from the outbox so refill it.
+    TRANSFERS.receive_responses();
+    TRANSFERS.send_queued();
+
+    set_INTR_STATE(INTR_STATE_BIT_RTIRQ);
+    rtirq_acknowledge();
+
+    api_mutex_unlock();
+
+    // Unblock anyone waiting for a response.
     rx_semaphore_post();
 }
 
@@ -196,37 +407,129 @@ pub unsafe extern "C" fn eirq_handle() {
 
 // Send a message to the security core. The message must be at a _physical_
 // address, as the security core knows nothing about seL4's virtual memory.
+// The response is collected with api_receive. Returns false if the
+// message could not be queued (see api_post).
 #[no_mangle]
-pub unsafe extern "C" fn api_send(request_paddr: u32, request_size: u32) {
+pub unsafe extern "C" fn api_send(request_paddr: u32, request_size: u32) -> bool {
     api_mutex_lock();
 
-    let request_header = request_size | HEADER_FLAG_LONG_MESSAGE;
-    enqueue_u32(request_header);
-    enqueue_u32(request_paddr);
+    let posted = TRANSFERS.post(request_paddr, request_size, true).is_some();
+    if posted {
+        TRANSFERS.send_queued();
+    }
 
     api_mutex_unlock();
+
+    posted
+}
+
+// Receive the response to the oldest api_send request. Blocks the calling
+// thread until it arrives; returns false if no api_send request is in
+// flight.
+#[no_mangle]
+pub unsafe extern "C" fn api_receive(response_paddr: *mut u32, response_size: *mut u32) -> bool {
+    loop {
+        api_mutex_lock();
+        let response = TRANSFERS.collect_untagged();
+        let pending = TRANSFERS.has_untagged();
+        api_mutex_unlock();
+
+        if let Some((paddr, size)) = response {
+            response_paddr.write(paddr);
+            response_size.write(size);
+            return true;
+        }
+        if !pending {
+            return false;
+        }
+        // When a response arrives, the interrupt handler will raise the
+        // semaphore.
+        rx_semaphore_wait();
+    }
 }
 
-// Receive a message from the security core. Blocks the calling thread until a
-// message arrives.
+// Queue a message for the security core (see api_send) and return its tag
+// without waiting for the response.
 #[no_mangle]
-pub unsafe extern "C" fn api_receive(response_paddr: *mut u32, response_size: *mut u32) {
+pub unsafe extern "C" fn api_post(request_paddr: u32, request_size: u32, tag: *mut u32) -> bool {
     api_mutex_lock();
 
-    // When a message arrives, the interrupt handler will raise the semaphore.
-    rx_semaphore_wait();
+    let posted = TRANSFERS.post(request_paddr, request_size, false);
+    if posted.is_some() {
+        TRANSFERS.send_queued();
+    }
 
-    // Message arrived, dequeue it.
-    let message_header = dequeue_u32();
-    let message_paddr = dequeue_u32();
-    response_paddr.write(message_paddr);
-    response_size.write(message_header & !HEADER_FLAG_LONG_MESSAGE);
+    api_mutex_unlock();
 
-    // The interrupt that raised the semaphore has been handled, clear it.
-    set_INTR_STATE(INTR_STATE_BIT_RTIRQ);
-    rtirq_acknowledge();
+    match posted {
+        Some(posted) => {
+            tag.write(posted);
+            true
+        }
+        None => false,
+    }
+}
+
+// Receive the response for |tag|. Blocks the calling thread until it
+// arrives; returns false if |tag| is not in flight.
+#[no_mangle]
+pub unsafe extern "C" fn api_wait(
+    tag: u32,
+    response_paddr: *mut u32,
+    response_size: *mut u32,
+) -> bool {
+    loop {
+        api_mutex_lock();
+        let response = TRANSFERS.collect(tag);
+        api_mutex_unlock();
+
+        match response {
+            Some(Some((paddr, size))) => {
+                response_paddr.write(paddr);
+                response_size.write(size);
+                return true;
+            }
+            Some(None) => {
+                rx_semaphore_wait(); // NB: may be for another tag
+            }
+            None => return false,
+        }
+    }
+}
+
+// Receive the response for |tag| if it has arrived; returns false if not
+// (or if |tag| is not in flight).
+#[no_mangle]
+pub unsafe extern "C" fn api_poll(
+    tag: u32,
+    response_paddr: *mut u32,
+    response_size: *mut u32,
+) -> bool {
+    api_mutex_lock();
+    let response = TRANSFERS.collect(tag);
+    api_mutex_unlock();
+
+    match response {
+        Some(Some((paddr, size))) => {
+            response_paddr.write(paddr);
+            response_size.write(size);
+            true
+        }
+        _ => false,
+    }
+}
 
+// Drop the transfer for |tag| without collecting its response (e.g. when
+// the caller gives up on it); returns false if |tag| is not in flight.
+// NB: the security core may still write the request page if it has
+// already taken the request.
+#[no_mangle]
+pub unsafe extern "C" fn api_abandon(tag: u32) -> bool {
+    api_mutex_lock();
+    let abandoned = TRANSFERS.abandon(tag);
     api_mutex_unlock();
+
+    abandoned
 }
 
 //------------------------------------------------------------------------------
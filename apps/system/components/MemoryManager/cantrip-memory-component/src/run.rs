@@ -32,6 +32,7 @@ use log::info;
 use sel4_sys::seL4_BootInfo;
 use sel4_sys::seL4_CNode_Delete;
 use sel4_sys::seL4_CPtr;
+use sel4_sys::seL4_Word;
 
 static mut CAMKES: Camkes = Camkes::new("MemoryManager");
 
@@ -42,6 +43,9 @@ extern "C" {
     // Each CAmkES-component has a CNode setup at a well-known top-level slot.
     // We re-use that slot to receive CNode caps passed with alloc & free requests.
     static MEMORY_RECV_CNODE: seL4_CPtr;
+
+    // Badge of the client making the current request (1-indexed).
+    fn memory_get_sender_id() -> seL4_Word;
 }
 
 #[no_mangle]
@@ -115,7 +119,35 @@ pub unsafe extern "C" fn memory_alloc(
 
             bundle.cnode = recv_path.1;
             // NB: bundle.depth should reflect the received cnode
-            CANTRIP_MEMORY.alloc(&bundle).into()
+            CANTRIP_MEMORY.alloc(memory_get_sender_id(), &bundle).into()
+        }
+        Err(_) => MemoryManagerError::MmeDeserializeFailed,
+    };
+    // NB: must clear ReceivePath for next request
+    CAMKES.clear_recv_path();
+    ret_status
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn memory_alloc_in_cnode(
+    c_raw_data_len: u32,
+    c_raw_data: *const u8,
+) -> MemoryManagerError {
+    let recv_path = CAMKES.get_current_recv_path();
+    // NB: make sure noone clobbers the setup done in memory__init
+    CAMKES.assert_recv_path();
+
+    let raw_slice = slice::from_raw_parts(c_raw_data, c_raw_data_len as usize);
+    let ret_status = match postcard::from_bytes::<ObjDescBundle>(raw_slice) {
+        Ok(mut bundle) => {
+            // We must have a CNode for returning the allocated CNode.
+            Camkes::debug_assert_slot_cnode("memory_alloc_in_cnode", &recv_path);
+
+            bundle.cnode = recv_path.1;
+            // NB: bundle.depth should reflect the received cnode
+            CANTRIP_MEMORY
+                .alloc_in_cnode(memory_get_sender_id(), &bundle)
+                .into()
         }
         Err(_) => MemoryManagerError::MmeDeserializeFailed,
     };
@@ -141,7 +173,7 @@ pub unsafe extern "C" fn memory_free(
 
             bundle.cnode = recv_path.1;
             // NB: bundle.depth should reflect the received cnode
-            CANTRIP_MEMORY.free(&bundle).into()
+            CANTRIP_MEMORY.free(memory_get_sender_id(), &bundle).into()
         }
         Err(_) => MemoryManagerError::MmeDeserializeFailed,
     };
@@ -300,7 +300,9 @@ pub enum MemoryError {
     FreeFailed,
 }
 
-pub const RAW_MEMORY_STATS_DATA_SIZE: usize = 100;
+// NB: sized for the worst-case postcard encoding of MemoryManagerStats
+//   (5 bytes per usize on a 32-bit target).
+pub const RAW_MEMORY_STATS_DATA_SIZE: usize = 256;
 pub type RawMemoryStatsData = [u8; RAW_MEMORY_STATS_DATA_SIZE];
 
 #[repr(C)]
@@ -329,13 +331,65 @@ pub struct MemoryManagerStats {
 
     // Alloc requests failed due to lack of untyped memory.
     pub out_of_memory: usize,
+
+    // Objects served from the pools of pre-retyped objects.
+    pub cache_hits: usize,
+
+    // Objects of a pooled type that had to be retyped on demand.
+    pub cache_misses: usize,
+
+    // Objects currently held in the pools.
+    pub cached_objs: usize,
+
+    // Largest object (in bytes) that can be retyped from any slab.
+    pub largest_free_bytes: usize,
+
+    // Untyped slabs by the largest object they can still supply:
+    // [i] counts slabs where that is 2^(seL4_PageBits + i) bytes; the last
+    // bucket also counts anything larger. Slabs with less than a page
+    // free are not counted.
+    pub free_histogram: [usize; FREE_HISTOGRAM_BUCKETS],
+
+    // Alloc requests by service time in rdtime ticks: [i] counts requests
+    // that took less than 2^(ALLOC_LATENCY_BASE_BITS + i) ticks; the last
+    // bucket also counts anything slower.
+    pub alloc_latency: [usize; ALLOC_LATENCY_BUCKETS],
+
+    // High-water mark of bytes concurrently allocated by each client,
+    // indexed by RPC badge - 1 (so [0] is the first client in the memory
+    // connection). Allocs are charged to and frees credited to the badge
+    // making the request. NB: objects allocated by one client and freed by
+    // another (e.g. the SecurityCoordinator's application frames, freed by
+    // the ProcessManager) stay charged to the allocator, so its mark may
+    // over-report; the freeing client is never credited below zero.
+    pub client_peak_bytes: [usize; MAX_MEMORY_CLIENTS],
 }
 
+// Number of size classes in MemoryManagerStats::free_histogram.
+pub const FREE_HISTOGRAM_BUCKETS: usize = 12; // 4KiB .. >= 8MiB
+
+// Number of buckets in MemoryManagerStats::alloc_latency.
+pub const ALLOC_LATENCY_BUCKETS: usize = 10;
+pub const ALLOC_LATENCY_BASE_BITS: usize = 8; // First bucket is < 256 ticks
+
+// Max clients tracked in MemoryManagerStats::client_peak_bytes; clients
+// with larger badges are not tracked.
+pub const MAX_MEMORY_CLIENTS: usize = 8;
+
 // Objects are potentially batched with caps to allocated objects returned
 // in the container slots specified by the |bundle] objects.
+// |client_id| is the RPC badge of the requester and is used only for
+// accounting.
 pub trait MemoryManagerInterface {
-    fn alloc(&mut self, bundle: &ObjDescBundle) -> Result<(), MemoryError>;
-    fn free(&mut self, bundle: &ObjDescBundle) -> Result<(), MemoryError>;
+    fn alloc(&mut self, client_id: usize, bundle: &ObjDescBundle) -> Result<(), MemoryError>;
+    // Like alloc but the first descriptor is a CNode that is created in
+    // |bundle|.cnode and the remaining descriptors are allocated into it.
+    fn alloc_in_cnode(
+        &mut self,
+        client_id: usize,
+        bundle: &ObjDescBundle,
+    ) -> Result<(), MemoryError>;
+    fn free(&mut self, client_id: usize, bundle: &ObjDescBundle) -> Result<(), MemoryError>;
     fn stats(&self) -> Result<MemoryManagerStats, MemoryError>;
     fn debug(&self) -> Result<(), MemoryError>;
 }
@@ -436,10 +490,18 @@ pub fn cantrip_object_alloc_in_toplevel(
 // in a new CNode allocated with sufficient capacity.
 // Note the objects' cptr's are assumed to be consecutive and start at zero.
 // Note the returned |ObjDescBundle| has the new CNode marked as the container.
+// NB: the CNode and its contents are allocated with one request.
 #[inline]
 pub fn cantrip_object_alloc_in_cnode(
     objs: Vec<ObjDesc>,
 ) -> Result<ObjDescBundle, MemoryManagerError> {
+    extern "C" {
+        // NB: this assumes the MemoryManager component is named "memory".
+        fn memory_alloc_in_cnode(
+            c_request_len: u32,
+            c_request_data: *const u8,
+        ) -> MemoryManagerError;
+    }
     fn next_log2(value: usize) -> usize {
         // NB: BITS & leading_zeros return u32
         (1 + usize::BITS - usize::leading_zeros(value)) as usize
@@ -447,18 +509,35 @@ pub fn cantrip_object_alloc_in_cnode(
     // NB: CNode size depends on how many objects are requested.
     let cnode_depth = next_log2(objs.iter().map(|od| od.count).sum());
 
-    // Request a top-level CNode.
-    let cnode = cantrip_cnode_alloc(cnode_depth)?;
-
-    // Now construct the request for |objs| with |cnode| as the container.
-    let request = ObjDescBundle::new(cnode.objs[0].cptr, cnode_depth as u8, objs);
-    match cantrip_object_alloc(&request) {
-        Err(e) => {
-            cantrip_object_free_toplevel(&cnode).expect("cnode free");
-            Err(e)
-        }
-        Ok(_) => Ok(request),
+    // The request is the CNode (returned in the dedicated MemoryManager
+    // container) followed by the contents.
+    let mut descs = Vec::with_capacity(1 + objs.len());
+    descs.push(ObjDesc::new(seL4_CapTableObject, cnode_depth, /*cptr=*/ 0));
+    descs.extend_from_slice(&objs);
+    let request = ObjDescBundle::new(
+        unsafe { MEMORY_RECV_CNODE },
+        unsafe { MEMORY_RECV_CNODE_DEPTH },
+        descs,
+    );
+    trace!("cantrip_object_alloc_in_cnode {}", request);
+    let raw_data = &mut [0u8; RAW_OBJ_DESC_DATA_SIZE];
+    postcard::to_slice(&request, &mut raw_data[..])
+        .map_err(|_| MemoryManagerError::MmeSerializeFailed)?;
+    let status: Result<(), MemoryManagerError> = unsafe {
+        // NB: see cantrip_object_alloc
+        let _cleanup = Camkes::set_request_cap(request.cnode);
+        memory_alloc_in_cnode(raw_data.len() as u32, raw_data.as_ptr()).into()
+    };
+    status?;
+
+    // Move the CNode to the top-level like cantrip_cnode_alloc.
+    let mut cnode = ObjDescBundle::new(request.cnode, request.depth, vec![request.objs[0]]);
+    if cnode.move_objects_to_toplevel().is_err() {
+        // NB: deleting the CNode deletes the contents
+        cantrip_object_free(&cnode).expect("cantrip_object_alloc_in_cnode");
+        return Err(MemoryManagerError::MmeObjCapInvalid); // TODO(sleffler): e.into
     }
+    Ok(ObjDescBundle::new(cnode.objs[0].cptr, cnode_depth as u8, objs))
 }
 
 // TODO(sleffler): remove unused convience wrappers?
@@ -38,11 +38,22 @@ impl CantripMemoryManager {
 }
 // These just lock accesses and handle the necessary indirection.
 impl MemoryManagerInterface for CantripMemoryManager {
-    fn alloc(&mut self, objs: &ObjDescBundle) -> Result<(), MemoryError> {
-        self.manager.lock().as_mut().unwrap().alloc(objs)
+    fn alloc(&mut self, client_id: usize, objs: &ObjDescBundle) -> Result<(), MemoryError> {
+        self.manager.lock().as_mut().unwrap().alloc(client_id, objs)
     }
-    fn free(&mut self, objs: &ObjDescBundle) -> Result<(), MemoryError> {
-        self.manager.lock().as_mut().unwrap().free(objs)
+    fn alloc_in_cnode(
+        &mut self,
+        client_id: usize,
+        objs: &ObjDescBundle,
+    ) -> Result<(), MemoryError> {
+        self.manager
+            .lock()
+            .as_mut()
+            .unwrap()
+            .alloc_in_cnode(client_id, objs)
+    }
+    fn free(&mut self, client_id: usize, objs: &ObjDescBundle) -> Result<(), MemoryError> {
+        self.manager.lock().as_mut().unwrap().free(client_id, objs)
     }
     fn stats(&self) -> Result<MemoryManagerStats, MemoryError> {
         self.manager.lock().as_ref().unwrap().stats()
@@ -1,26 +1,43 @@
 //! Cantrip OS global memory management support
 
 extern crate alloc;
+use alloc::vec;
 use cantrip_memory_interface::MemoryError;
 use cantrip_memory_interface::MemoryManagerInterface;
 use cantrip_memory_interface::MemoryManagerStats;
 use cantrip_memory_interface::ObjDesc;
 use cantrip_memory_interface::ObjDescBundle;
+use cantrip_memory_interface::ALLOC_LATENCY_BASE_BITS;
+use cantrip_memory_interface::ALLOC_LATENCY_BUCKETS;
+use cantrip_memory_interface::FREE_HISTOGRAM_BUCKETS;
+use cantrip_memory_interface::MAX_MEMORY_CLIENTS;
 use cantrip_os_common::camkes::{seL4_CPath, Camkes};
+use cantrip_os_common::clock::clock_ticks;
+use cantrip_os_common::clock::Ticks;
+use cantrip_os_common::logger::bin_debug;
 use cantrip_os_common::sel4_sys;
+use cantrip_os_common::slot_allocator::CANTRIP_CSPACE_SLOTS;
 use core::ops::Range;
 use log::{debug, error, info, trace, warn};
 use smallvec::SmallVec;
 
 use sel4_sys::seL4_CNode_Delete;
+use sel4_sys::seL4_CNode_Move;
 use sel4_sys::seL4_CNode_Revoke;
 use sel4_sys::seL4_CPtr;
+use sel4_sys::seL4_CapTableObject;
 use sel4_sys::seL4_Error;
+use sel4_sys::seL4_PageBits;
 use sel4_sys::seL4_Result;
 use sel4_sys::seL4_UntypedDesc;
 use sel4_sys::seL4_Untyped_Describe;
 use sel4_sys::seL4_Untyped_Retype;
 use sel4_sys::seL4_Word;
+use sel4_sys::seL4_WordBits;
+
+mod object_cache;
+use object_cache::ObjectCache;
+use object_cache::NUM_OBJECT_CACHES;
 
 fn delete_path(path: &seL4_CPath) -> seL4_Result {
     unsafe { seL4_CNode_Delete(path.0, path.1, path.2 as u8) }
@@ -67,12 +84,20 @@ impl UntypedSlab {
         }
     }
 }
+#[derive(Clone, Copy, Default)]
+struct ClientUsage {
+    allocated_bytes: usize, // Bytes currently held
+    peak_bytes: usize,      // High-water mark of allocated_bytes
+}
 pub struct MemoryManager {
     untypeds: SmallVec<[UntypedSlab; UNTYPED_SLAB_CAPACITY]>,
     _device_untypeds: SmallVec<[UntypedSlab; UNTYPED_SLAB_CAPACITY]>,
     cur_untyped: usize,
     _cur_device_untyped: usize,
 
+    // Pools of freshly retyped objects by type.
+    caches: [ObjectCache; NUM_OBJECT_CACHES],
+
     total_bytes: usize,     // Total available space
     allocated_bytes: usize, // Amount of space currently allocated
     requested_bytes: usize, // Amount of space allocated over all time
@@ -87,6 +112,12 @@ pub struct MemoryManager {
     // Alloc requests failed due to lack of untyped memory (NB: may be
     // due to fragmentation of untyped slabs).
     out_of_memory: usize,
+
+    // Histogram of alloc service times (see MemoryManagerStats).
+    alloc_latency: [usize; ALLOC_LATENCY_BUCKETS],
+
+    // Per-client usage indexed by RPC badge - 1.
+    clients: [ClientUsage; MAX_MEMORY_CLIENTS],
 }
 
 fn _howmany(value: usize, unit: usize) -> usize { value + (unit - 1) / unit }
@@ -107,6 +138,8 @@ impl MemoryManager {
             cur_untyped: 0,
             _cur_device_untyped: 0,
 
+            caches: ObjectCache::caches(),
+
             total_bytes: 0,
             allocated_bytes: 0,
             requested_bytes: 0,
@@ -117,6 +150,9 @@ impl MemoryManager {
 
             untyped_slab_too_small: 0,
             out_of_memory: 0,
+
+            alloc_latency: [0; ALLOC_LATENCY_BUCKETS],
+            clients: [ClientUsage::default(); MAX_MEMORY_CLIENTS],
         };
         for (ut_index, ut) in untypeds.iter().enumerate() {
             #[cfg(feature = "CONFIG_NOISY_UNTYPEDS")]
@@ -183,6 +219,87 @@ impl MemoryManager {
         }
     }
 
+    // Returns the index in |caches| of the pool holding |od|'s objects, if any.
+    fn cache_index(&self, od: &ObjDesc) -> Option<usize> {
+        self.caches.iter().position(|cache| cache.matches(od))
+    }
+
+    // Retypes a batch of objects into the pool |index| from the current
+    // slab. Failure is not an error; the alloc just retypes on demand.
+    fn refill_cache(&mut self, index: usize) {
+        let (first, count) = match self.caches[index].reserve() {
+            Some(slots) => slots,
+            None => return,
+        };
+        let cache = &self.caches[index];
+        let root = Camkes::top_level_path(first).0;
+        // NB: not retype_untyped; an ObjDesc cannot describe more than
+        //   one CNode but a single retype can create them
+        let result = unsafe {
+            seL4_Untyped_Retype(
+                self.untypeds[self.cur_untyped].cptr,
+                /*type=*/ cache.type_().into(),
+                /*size_bits=*/ cache.retype_size_bits(),
+                /*root=*/ root,
+                /*node_index=*/ 0, // Ignored 'cuz depth is zero
+                /*node_depth=*/ 0, // NB: store in cnode
+                /*node_offset=*/ first,
+                /*num_objects=*/ count,
+            )
+        };
+        match result {
+            Ok(_) => self.caches[index].fill(first, count),
+            Err(_) => self.caches[index].unreserve(first, count),
+        }
+    }
+
+    // Deletes all pooled objects; returns the number deleted.
+    fn drain_caches(&mut self) -> usize { self.caches.iter_mut().map(|cache| cache.drain()).sum() }
+
+    // Retypes |od| from the untyped slabs into |root|, starting with the
+    // slab last used.
+    fn retype(&mut self, root: seL4_CPtr, od: &ObjDesc) -> Result<(), MemoryError> {
+        let first_ut = self.cur_untyped;
+        let mut ut_index = first_ut;
+        let mut drained = false;
+
+        // NB: we don't check slots are available (the kernel will tell us).
+        // TODO(sleffler): maybe check size_bytes() against untyped slab?
+        //    (we depend on the kernel for now)
+        while let Err(e) =
+            // NB: we don't allocate ASIDPool objects but if we did it
+            //   would fail because it needs to map to an UntypedObject
+            MemoryManager::retype_untyped(self.untypeds[ut_index].cptr, root, od)
+        {
+            if e != seL4_Error::seL4_NotEnoughMemory {
+                // Should not happen.
+                // TODO(sleffler): reclaim allocations
+                error!("Allocation request failed (retype returned {:?})", e);
+                return Err(MemoryError::UnknownMemoryError);
+            }
+            // This untyped does not have enough available space, try
+            // the next slab until we exhaust all slabs. This is the best
+            // we can do without per-slab bookkeeping.
+            self.untyped_slab_too_small += 1;
+            ut_index = (ut_index + 1) % self.untypeds.len();
+            bin_debug!("Advance to untyped slab {}", ut_index);
+            if ut_index == first_ut {
+                // Pooled objects pin their slabs; release them and make
+                // one more pass in case that freed a slab.
+                if !drained && self.drain_caches() > 0 {
+                    drained = true;
+                    continue;
+                }
+                // TODO(sleffler): reclaim allocations
+                self.out_of_memory += 1;
+                bin_debug!("Allocation request failed (out of space)");
+                return Err(MemoryError::AllocFailed);
+            }
+        }
+        self.cur_untyped = ut_index;
+        Ok(())
+    }
+
     fn delete_caps(root: seL4_CPtr, depth: u8, od: &ObjDesc) -> seL4_Result {
         for offset in 0..od.retype_count() {
             let path = (root, od.cptr + offset, depth as usize);
@@ -194,53 +311,31 @@ impl MemoryManager {
     }
 }
 
-impl MemoryManagerInterface for MemoryManager {
-    fn alloc(&mut self, bundle: &ObjDescBundle) -> Result<(), MemoryError> {
+// Request handlers; these return the number of bytes allocated/freed
+// for charging to the client.
+impl MemoryManager {
+    fn alloc_bundle(&mut self, bundle: &ObjDescBundle) -> Result<usize, MemoryError> {
         trace!("alloc {:?}", bundle);
 
         // TODO(sleffler): split by device vs no-device (or allow mixing)
-        let first_ut = self.cur_untyped;
-        let mut ut_index = first_ut;
-
         let mut allocated_bytes: usize = 0;
         let mut allocated_objs: usize = 0;
 
         for od in &bundle.objs {
-            // NB: we don't check slots are available (the kernel will tell us).
-            // TODO(sleffler): maybe check size_bytes() against untyped slab?
-            //    (we depend on the kernel for now)
-            while let Err(e) =
-                // NB: we don't allocate ASIDPool objects but if we did it
-                //   would fail because it needs to map to an UntypedObject
-                MemoryManager::retype_untyped(
-                    self.untypeds[ut_index].cptr,
-                    bundle.cnode,
-                    od,
-                )
-            {
-                if e != seL4_Error::seL4_NotEnoughMemory {
-                    // Should not happen.
-                    // TODO(sleffler): reclaim allocations
-                    error!("Allocation request failed (retype returned {:?})", e);
-                    return Err(MemoryError::UnknownMemoryError);
-                }
-                // This untyped does not have enough available space, try
-                // the next slab until we exhaust all slabs. This is the best
-                // we can do without per-slab bookkeeping.
-                self.untyped_slab_too_small += 1;
-                ut_index = (ut_index + 1) % self.untypeds.len();
-                debug!("Advance to untyped slab {}", ut_index);
-                if ut_index == first_ut {
-                    // TODO(sleffler): reclaim allocations
-                    self.out_of_memory += 1;
-                    debug!("Allocation request failed (out of space)");
-                    return Err(MemoryError::AllocFailed);
+            let mut retype_od = Some(*od);
+            if let Some(index) = self.cache_index(od) {
+                // Serve what we can from the pool, retype the rest.
+                if self.caches[index].wants_refill(od) {
+                    self.refill_cache(index);
                 }
+                retype_od = self.caches[index].serve(bundle.cnode, bundle.depth, od);
+            }
+            if let Some(retype_od) = retype_od {
+                self.retype(bundle.cnode, &retype_od)?;
             }
             allocated_objs += od.retype_count();
             allocated_bytes += od.size_bytes().unwrap();
         }
-        self.cur_untyped = ut_index;
 
         self.allocated_bytes += allocated_bytes;
         self.allocated_objs += allocated_objs;
@@ -249,12 +344,70 @@ impl MemoryManagerInterface for MemoryManager {
         self.requested_objs += allocated_objs;
         self.requested_bytes += allocated_bytes;
 
-        Ok(())
+        Ok(allocated_bytes)
     }
-    fn free(&mut self, bundle: &ObjDescBundle) -> Result<(), MemoryError> {
+    fn alloc_in_cnode_bundle(&mut self, bundle: &ObjDescBundle) -> Result<usize, MemoryError> {
+        trace!("alloc_in_cnode {:?}", bundle);
+
+        let (container, contents) = bundle
+            .objs
+            .split_first()
+            .ok_or(MemoryError::ObjCountInvalid)?;
+        if container.type_ != seL4_CapTableObject {
+            return Err(MemoryError::ObjTypeInvalid);
+        }
+        // Construct the CNode in our top-level CNode so the contents
+        // can be addressed, fill it, then hand it back in |bundle|.cnode.
+        let slot = unsafe { CANTRIP_CSPACE_SLOTS.alloc(1) }.ok_or(MemoryError::CapAllocFailed)?;
+        let cnode = ObjDescBundle::new(
+            Camkes::top_level_path(slot).0,
+            seL4_WordBits as u8,
+            vec![ObjDesc::new(
+                seL4_CapTableObject,
+                container.retype_size_bits().unwrap(),
+                slot,
+            )],
+        );
+        let result = self.alloc_bundle(&cnode).and_then(|cnode_bytes| {
+            let objs = ObjDescBundle::new(
+                slot,
+                container.retype_size_bits().unwrap() as u8,
+                contents.to_vec(),
+            );
+            let objs_bytes = match self.alloc_bundle(&objs) {
+                Ok(bytes) => bytes,
+                Err(e) => {
+                    // NB: deleting the CNode deletes any contents
+                    let _ = self.free_bundle(&cnode);
+                    return Err(e);
+                }
+            };
+            let src = Camkes::top_level_path(slot);
+            unsafe {
+                seL4_CNode_Move(
+                    bundle.cnode,
+                    container.cptr,
+                    bundle.depth,
+                    src.0,
+                    src.1,
+                    src.2 as u8,
+                )
+            }
+            .map(|_| cnode_bytes + objs_bytes)
+            .map_err(|_| {
+                let _ = self.free_bundle(&cnode);
+                MemoryError::ObjCapInvalid
+            })
+        });
+        unsafe { CANTRIP_CSPACE_SLOTS.free(slot, 1) };
+        result
+    }
+    fn free_bundle(&mut self, bundle: &ObjDescBundle) -> Result<usize, MemoryError> {
         trace!("free {:?}", bundle);
 
+        let mut freed_bytes: usize = 0;
         for od in &bundle.objs {
+            // NB: freed objects are never pooled (see object_cache.rs)
             // TODO(sleffler): support leaving objects so client can do bulk
             //   reclaim on exit (maybe require cptr != 0)
             if MemoryManager::delete_caps(bundle.cnode, bundle.depth, od).is_ok() {
@@ -265,14 +418,91 @@ impl MemoryManagerInterface for MemoryManager {
                 if size_bytes <= self.allocated_bytes {
                     self.allocated_bytes -= size_bytes;
                     self.allocated_objs -= od.retype_count();
+                    freed_bytes += size_bytes;
                 } else {
                     debug!("Underflow on free of {:?}", od);
                 }
             }
         }
+        Ok(freed_bytes)
+    }
+
+    // Free untyped space that can actually be retyped: the largest object
+    // available and a histogram of slabs by the largest object each has.
+    // NB: a slab is a bump allocator so its free space is contiguous and
+    //   ends on a slab-aligned boundary; the largest object that fits is
+    //   the largest power of two <= the remaining bytes.
+    fn free_histogram(&self) -> (usize, [usize; FREE_HISTOGRAM_BUCKETS]) {
+        let mut largest = 0;
+        let mut histogram = [0; FREE_HISTOGRAM_BUCKETS];
+        for ut in &self.untypeds {
+            let remaining = untyped_describe(ut.cptr).remainingBytes;
+            if remaining < l2tob(seL4_PageBits) {
+                continue;
+            }
+            let bits = (usize::BITS - 1 - remaining.leading_zeros()) as usize;
+            largest = largest.max(l2tob(bits));
+            histogram[(bits - seL4_PageBits).min(FREE_HISTOGRAM_BUCKETS - 1)] += 1;
+        }
+        (largest, histogram)
+    }
+
+    // Records the service time of an alloc request that started at |start|.
+    fn record_alloc_latency(&mut self, start: Ticks) {
+        let ticks = clock_ticks().saturating_sub(start);
+        let bucket = (u64::BITS - ticks.leading_zeros()) as usize;
+        self.alloc_latency[bucket
+            .saturating_sub(ALLOC_LATENCY_BASE_BITS)
+            .min(ALLOC_LATENCY_BUCKETS - 1)] += 1;
+    }
+
+    // Returns the usage record for the client with RPC badge |client_id|.
+    fn client_usage(&mut self, client_id: usize) -> Option<&mut ClientUsage> {
+        self.clients.get_mut(client_id.checked_sub(1)?)
+    }
+    fn charge(&mut self, client_id: usize, bytes: usize) {
+        if let Some(usage) = self.client_usage(client_id) {
+            usage.allocated_bytes += bytes;
+            usage.peak_bytes = usage.peak_bytes.max(usage.allocated_bytes);
+        }
+    }
+    fn uncharge(&mut self, client_id: usize, bytes: usize) {
+        if let Some(usage) = self.client_usage(client_id) {
+            // NB: objects may be freed by a client other than the one
+            //   that allocated them (e.g. on process teardown); the
+            //   allocator stays charged since objects are not tracked
+            //   individually (see MemoryManagerStats::client_peak_bytes).
+            usage.allocated_bytes = usage.allocated_bytes.saturating_sub(bytes);
+        }
+    }
+}
+
+impl MemoryManagerInterface for MemoryManager {
+    fn alloc(&mut self, client_id: usize, bundle: &ObjDescBundle) -> Result<(), MemoryError> {
+        let start = clock_ticks();
+        let result = self.alloc_bundle(bundle);
+        self.record_alloc_latency(start);
+        self.charge(client_id, result?);
+        Ok(())
+    }
+    fn alloc_in_cnode(
+        &mut self,
+        client_id: usize,
+        bundle: &ObjDescBundle,
+    ) -> Result<(), MemoryError> {
+        let start = clock_ticks();
+        let result = self.alloc_in_cnode_bundle(bundle);
+        self.record_alloc_latency(start);
+        self.charge(client_id, result?);
+        Ok(())
+    }
+    fn free(&mut self, client_id: usize, bundle: &ObjDescBundle) -> Result<(), MemoryError> {
+        let freed_bytes = self.free_bundle(bundle)?;
+        self.uncharge(client_id, freed_bytes);
         Ok(())
     }
     fn stats(&self) -> Result<MemoryManagerStats, MemoryError> {
+        let (largest_free_bytes, free_histogram) = self.free_histogram();
         Ok(MemoryManagerStats {
             allocated_bytes: self.allocated_space(),
             free_bytes: self.free_space(),
@@ -284,6 +514,15 @@ impl MemoryManagerInterface for MemoryManager {
 
             untyped_slab_too_small: self.untyped_slab_too_small(),
             out_of_memory: self.out_of_memory(),
+
+            cache_hits: self.caches.iter().map(|cache| cache.hits()).sum(),
+            cache_misses: self.caches.iter().map(|cache| cache.misses()).sum(),
+            cached_objs: self.caches.iter().map(|cache| cache.len()).sum(),
+
+            largest_free_bytes,
+            free_histogram,
+            alloc_latency: self.alloc_latency,
+            client_peak_bytes: self.clients.map(|usage| usage.peak_bytes),
         })
     }
     fn debug(&self) -> Result<(), MemoryError> {
@@ -298,6 +537,15 @@ impl MemoryManagerInterface for MemoryManager {
                 info.remainingBytes,
             );
         }
+        for cache in &self.caches {
+            info!(
+                "{:?} cache: {} held, {} hits, {} misses",
+                cache.type_(),
+                cache.len(),
+                cache.hits(),
+                cache.misses(),
+            );
+        }
         Ok(())
     }
 }
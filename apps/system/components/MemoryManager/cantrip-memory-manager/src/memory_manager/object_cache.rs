@@ -0,0 +1,363 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Pools of freshly retyped seL4 objects.
+//!
+//! Small allocs of a pooled type are served from objects the MemoryManager
+//! retyped ahead of time and holds (in our top-level CNode). A hit is a
+//! single CNode_Move instead of an untyped search + retype, and a refill
+//! retypes a batch of objects with one call. Frames, notifications and
+//! CNodes of one size (POOLED_CNODE_SIZE_BITS) are pooled.
+//!
+//! Only objects that have never been handed to a client are pooled; freed
+//! objects are deleted. The MemoryManager cannot tell whether a cap passed
+//! to free is the only one (a client may free a copy and keep the
+//! original) so recycling freed objects could give another client a frame
+//! that is still mapped elsewhere, or a notification another thread still
+//! signals.
+
+use cantrip_memory_interface::ObjDesc;
+use cantrip_os_common::sel4_sys;
+use log::warn;
+use smallvec::SmallVec;
+
+use sel4_sys::seL4_CPtr;
+use sel4_sys::seL4_CapTableObject;
+use sel4_sys::seL4_NotificationObject;
+use sel4_sys::seL4_ObjectType;
+use sel4_sys::seL4_SmallPageObject;
+
+// Max objects held per pool; sized so the pools land in .bss. Each pooled
+// object holds one slot in our top-level CNode.
+pub const OBJECT_CACHE_CAPACITY: usize = 32;
+
+// Objects retyped per refill; allocs of more than this bypass the pool.
+pub const OBJECT_CACHE_REFILL: usize = 8;
+
+// CNodes are pooled only at this size (log2 slots); their size must match
+// the request exactly. 32 slots holds the small bundles the shell and
+// alloc_in_cnode build. CNodes are larger than the other pooled objects
+// so fewer are retyped at a time.
+pub const POOLED_CNODE_SIZE_BITS: usize = 5;
+const CNODE_CACHE_REFILL: usize = 2;
+
+// Number of pooled object types (see ObjectCache::caches).
+pub const NUM_OBJECT_CACHES: usize = 3;
+
+// Kernel operations on pooled objects, faked for unit tests.
+#[cfg(not(test))]
+mod kernel {
+    use cantrip_os_common::camkes::Camkes;
+    use cantrip_os_common::sel4_sys;
+    use cantrip_os_common::slot_allocator::CANTRIP_CSPACE_SLOTS;
+    use sel4_sys::seL4_CNode_Delete;
+    use sel4_sys::seL4_CNode_Move;
+    use sel4_sys::seL4_CPtr;
+    use sel4_sys::seL4_Result;
+
+    pub fn alloc_slots(count: usize) -> Option<seL4_CPtr> {
+        unsafe { CANTRIP_CSPACE_SLOTS.alloc(count) }
+    }
+    pub fn free_slots(first: seL4_CPtr, count: usize) {
+        unsafe { CANTRIP_CSPACE_SLOTS.free(first, count) }
+    }
+    // Moves the object in top-level |slot| to |index| in |root|.
+    pub fn move_to(root: seL4_CPtr, index: seL4_CPtr, depth: u8, slot: seL4_CPtr) -> seL4_Result {
+        let src = Camkes::top_level_path(slot);
+        unsafe { seL4_CNode_Move(root, index, depth, src.0, src.1, src.2 as u8) }
+    }
+    pub fn delete(slot: seL4_CPtr) -> seL4_Result {
+        let path = Camkes::top_level_path(slot);
+        unsafe { seL4_CNode_Delete(path.0, path.1, path.2 as u8) }
+    }
+}
+#[cfg(test)]
+mod kernel {
+    use cantrip_os_common::sel4_sys;
+    use core::sync::atomic::{AtomicUsize, Ordering};
+    use sel4_sys::seL4_CPtr;
+    use sel4_sys::seL4_Error;
+    use sel4_sys::seL4_Result;
+
+    // Destination CNode that fails every move.
+    pub const BAD_ROOT: seL4_CPtr = 0xbad;
+
+    static NEXT_SLOT: AtomicUsize = AtomicUsize::new(100);
+
+    pub fn alloc_slots(count: usize) -> Option<seL4_CPtr> {
+        Some(NEXT_SLOT.fetch_add(count, Ordering::Relaxed))
+    }
+    pub fn free_slots(_first: seL4_CPtr, _count: usize) {}
+    pub fn move_to(
+        root: seL4_CPtr,
+        _index: seL4_CPtr,
+        _depth: u8,
+        _slot: seL4_CPtr,
+    ) -> seL4_Result {
+        if root == BAD_ROOT {
+            Err(seL4_Error::seL4_FailedLookup)
+        } else {
+            Ok(())
+        }
+    }
+    pub fn delete(_slot: seL4_CPtr) -> seL4_Result { Ok(()) }
+}
+
+pub struct ObjectCache {
+    proto: ObjDesc, // Type and size of pooled objects (count/cptr unused)
+    refill: usize,  // Objects retyped per refill
+    objs: SmallVec<[seL4_CPtr; OBJECT_CACHE_CAPACITY]>, // NB: top-level slots
+    hits: usize,
+    misses: usize,
+}
+impl ObjectCache {
+    // |count| is the ObjDesc count for |type_|: the log2 size for sized
+    // objects like CNodes, otherwise ignored.
+    fn new(type_: seL4_ObjectType, count: usize, refill: usize) -> Self {
+        ObjectCache {
+            proto: ObjDesc::new(type_, count, 0),
+            refill,
+            objs: SmallVec::new(),
+            hits: 0,
+            misses: 0,
+        }
+    }
+
+    // Returns the pools for all pooled object types.
+    pub fn caches() -> [ObjectCache; NUM_OBJECT_CACHES] {
+        [
+            ObjectCache::new(seL4_SmallPageObject, 1, OBJECT_CACHE_REFILL),
+            ObjectCache::new(seL4_NotificationObject, 1, OBJECT_CACHE_REFILL),
+            ObjectCache::new(seL4_CapTableObject, POOLED_CNODE_SIZE_BITS, CNODE_CACHE_REFILL),
+        ]
+    }
+
+    pub fn type_(&self) -> seL4_ObjectType { self.proto.type_ }
+    // Parameter for seL4_Untyped_Retype when refilling.
+    pub fn retype_size_bits(&self) -> usize { self.proto.retype_size_bits().unwrap() }
+    pub fn len(&self) -> usize { self.objs.len() }
+    pub fn hits(&self) -> usize { self.hits }
+    pub fn misses(&self) -> usize { self.misses }
+
+    // Returns whether |od| describes objects this pool holds.
+    pub fn matches(&self, od: &ObjDesc) -> bool {
+        od.type_ == self.proto.type_ && od.retype_size_bits() == self.proto.retype_size_bits()
+    }
+
+    // Returns whether an alloc of |od| should refill the pool first:
+    // the pool is short and the request is small enough to be served.
+    pub fn wants_refill(&self, od: &ObjDesc) -> bool {
+        let count = od.retype_count();
+        count <= self.refill && self.objs.len() < count
+    }
+
+    // Reserves top-level slots for a refill. Returns the first slot and
+    // the number of objects to retype into them (then call fill or
+    // unreserve), or None if the pool is full or no slots are available.
+    pub fn reserve(&mut self) -> Option<(seL4_CPtr, usize)> {
+        let count = self.refill.min(OBJECT_CACHE_CAPACITY - self.objs.len());
+        if count == 0 {
+            return None;
+        }
+        let first = kernel::alloc_slots(count)?;
+        Some((first, count))
+    }
+
+    // Adds the objects retyped into the slots of a reserve.
+    pub fn fill(&mut self, first: seL4_CPtr, count: usize) {
+        // NB: push in reverse so take hands out the lowest slot first
+        for index in (0..count).rev() {
+            self.objs.push(first + index);
+        }
+    }
+
+    // Releases the slots of a reserve whose retype failed.
+    pub fn unreserve(&mut self, first: seL4_CPtr, count: usize) {
+        kernel::free_slots(first, count);
+    }
+
+    // Serves what it can of |od| (which must match) by moving pooled
+    // objects to its slots in the CNode |root| (addressed with |depth|).
+    // Returns the objects that are still to be retyped, if any.
+    pub fn serve(&mut self, root: seL4_CPtr, depth: u8, od: &ObjDesc) -> Option<ObjDesc> {
+        let count = od.retype_count();
+        let mut hits = 0;
+        while hits < count && self.take(root, od.cptr + hits, depth) {
+            hits += 1;
+        }
+        self.hits += hits;
+        self.misses += count - hits;
+        match hits {
+            0 => Some(*od),
+            _ if hits == count => None,
+            // NB: only counted types get here; sized types have count 1
+            _ => Some(ObjDesc::new(od.type_, count - hits, od.cptr + hits)),
+        }
+    }
+
+    // Moves a pooled object to |index| in the CNode |root| (addressed
+    // with |depth|). Returns false if the pool is empty.
+    fn take(&mut self, root: seL4_CPtr, index: seL4_CPtr, depth: u8) -> bool {
+        if let Some(slot) = self.objs.pop() {
+            match kernel::move_to(root, index, depth, slot) {
+                Ok(_) => {
+                    kernel::free_slots(slot, 1);
+                    return true;
+                }
+                Err(e) => {
+                    // NB: the destination is bad; put the object back
+                    warn!("cache move to {}:{} failed: {:?}", root, index, e);
+                    self.objs.push(slot);
+                }
+            }
+        }
+        false
+    }
+
+    // Deletes all pooled objects. This is used when untyped memory runs
+    // out; objects that are deleted may let the kernel reclaim a slab.
+    pub fn drain(&mut self) -> usize {
+        let count = self.objs.len();
+        for slot in self.objs.drain(..) {
+            if let Err(e) = kernel::delete(slot) {
+                warn!("DELETE slot {} failed: {:?}", slot, e);
+            }
+            kernel::free_slots(slot, 1);
+        }
+        count
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const ROOT: seL4_CPtr = 1;
+    const DEPTH: u8 = 32;
+
+    fn frames(count: usize, cptr: seL4_CPtr) -> ObjDesc {
+        ObjDesc::new(seL4_SmallPageObject, count, cptr)
+    }
+
+    // Returns a frame pool after one refill.
+    fn filled_frame_cache() -> ObjectCache {
+        let mut cache = ObjectCache::new(seL4_SmallPageObject, 1, OBJECT_CACHE_REFILL);
+        let (first, count) = cache.reserve().unwrap();
+        cache.fill(first, count);
+        cache
+    }
+
+    #[test]
+    fn test_matches() {
+        let caches = ObjectCache::caches();
+        assert!(caches[0].matches(&frames(3, 0)));
+        assert!(!caches[0].matches(&ObjDesc::new(seL4_NotificationObject, 1, 0)));
+        assert!(caches[1].matches(&ObjDesc::new(seL4_NotificationObject, 2, 0)));
+        assert!(caches[2].matches(&ObjDesc::new(seL4_CapTableObject, POOLED_CNODE_SIZE_BITS, 0)));
+        assert!(!caches[2].matches(&ObjDesc::new(
+            seL4_CapTableObject,
+            POOLED_CNODE_SIZE_BITS + 1,
+            0
+        )));
+    }
+
+    #[test]
+    fn test_refill() {
+        let mut cache = ObjectCache::new(seL4_SmallPageObject, 1, OBJECT_CACHE_REFILL);
+        assert!(cache.wants_refill(&frames(1, 0)));
+        // Requests larger than a refill bypass the pool.
+        assert!(!cache.wants_refill(&frames(OBJECT_CACHE_REFILL + 1, 0)));
+
+        let (first, count) = cache.reserve().unwrap();
+        assert_eq!(count, OBJECT_CACHE_REFILL);
+        cache.fill(first, count);
+        assert_eq!(cache.len(), OBJECT_CACHE_REFILL);
+        assert!(!cache.wants_refill(&frames(OBJECT_CACHE_REFILL, 0)));
+
+        // A failed retype leaves the pool unchanged.
+        let (first, count) = cache.reserve().unwrap();
+        cache.unreserve(first, count);
+        assert_eq!(cache.len(), OBJECT_CACHE_REFILL);
+
+        // Refills stop at the capacity.
+        while let Some((first, count)) = cache.reserve() {
+            cache.fill(first, count);
+        }
+        assert_eq!(cache.len(), OBJECT_CACHE_CAPACITY);
+    }
+
+    #[test]
+    fn test_serve_hit() {
+        let mut cache = filled_frame_cache();
+        assert!(cache.serve(ROOT, DEPTH, &frames(3, 10)).is_none());
+        assert_eq!(cache.len(), OBJECT_CACHE_REFILL - 3);
+        assert_eq!((cache.hits(), cache.misses()), (3, 0));
+    }
+
+    #[test]
+    fn test_serve_partial() {
+        let mut cache = filled_frame_cache();
+        let rest = cache
+            .serve(ROOT, DEPTH, &frames(OBJECT_CACHE_REFILL + 2, 10))
+            .unwrap();
+        // The remainder follows the slots that were served.
+        assert_eq!(rest.retype_count(), 2);
+        assert_eq!(rest.cptr, 10 + OBJECT_CACHE_REFILL);
+        assert_eq!(cache.len(), 0);
+        assert_eq!((cache.hits(), cache.misses()), (OBJECT_CACHE_REFILL, 2));
+    }
+
+    #[test]
+    fn test_serve_miss() {
+        let mut cache = ObjectCache::new(seL4_SmallPageObject, 1, OBJECT_CACHE_REFILL);
+        let od = frames(2, 10);
+        let rest = cache.serve(ROOT, DEPTH, &od).unwrap();
+        assert_eq!(rest.type_, od.type_);
+        assert_eq!((rest.retype_count(), rest.cptr), (od.retype_count(), od.cptr));
+        assert_eq!((cache.hits(), cache.misses()), (0, 2));
+    }
+
+    #[test]
+    fn test_serve_bad_dest() {
+        let mut cache = filled_frame_cache();
+        // The object is put back and the request falls through to retype.
+        assert!(cache
+            .serve(kernel::BAD_ROOT, DEPTH, &frames(1, 10))
+            .is_some());
+        assert_eq!(cache.len(), OBJECT_CACHE_REFILL);
+        assert_eq!((cache.hits(), cache.misses()), (0, 1));
+    }
+
+    #[test]
+    fn test_serve_cnode() {
+        let caches = ObjectCache::caches();
+        let mut cache = caches.into_iter().nth(2).unwrap();
+        let od = ObjDesc::new(seL4_CapTableObject, POOLED_CNODE_SIZE_BITS, 10);
+        assert!(cache.wants_refill(&od));
+        let (first, count) = cache.reserve().unwrap();
+        assert_eq!(count, CNODE_CACHE_REFILL);
+        cache.fill(first, count);
+        assert!(cache.serve(ROOT, DEPTH, &od).is_none());
+        assert_eq!(cache.len(), CNODE_CACHE_REFILL - 1);
+        assert_eq!((cache.hits(), cache.misses()), (1, 0));
+    }
+
+    #[test]
+    fn test_drain() {
+        let mut cache = filled_frame_cache();
+        assert_eq!(cache.drain(), OBJECT_CACHE_REFILL);
+        assert_eq!(cache.len(), 0);
+        assert_eq!(cache.drain(), 0);
+    }
+}
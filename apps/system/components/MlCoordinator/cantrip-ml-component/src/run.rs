@@ -21,7 +21,10 @@ use alloc::string::String;
 use cantrip_ml_coordinator::MLCoordinator;
 use cantrip_ml_coordinator::ModelIdx;
 use cantrip_ml_interface::MlCoordError;
+use cantrip_ml_interface::RawMlResultsData;
+use cantrip_ml_interface::RawMlStatsData;
 use cantrip_ml_shared::ImageId;
+use cantrip_ml_shared::MAX_MODELS;
 use cantrip_os_common::camkes::Camkes;
 use cantrip_timer_interface::*;
 use cstr_core::CStr;
@@ -40,21 +43,42 @@ pub unsafe extern "C" fn pre_init() {
 #[no_mangle]
 pub unsafe extern "C" fn mlcoord__init() { ML_COORD.lock().init(); }
 
+// Loads the next queued model's image while another model runs. The
+// SecurityCoordinator fetch and TCM copy are done without holding ML_COORD
+// so requests and interrupts are not held off by them.
+unsafe fn prefetch_next_model() {
+    loop {
+        let claim = match ML_COORD.lock().claim_prefetch() {
+            Some(claim) => claim,
+            None => return,
+        };
+        let result = claim.load();
+        if !ML_COORD.lock().publish_prefetch(claim, result) {
+            return;
+        }
+    }
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn run() {
+    // NB: timer id's are model indices; models may span several pages.
+    let timer_pages = (MAX_MODELS + TIMER_MASK_BITS - 1) / TIMER_MASK_BITS;
     loop {
-        let mut completed = cantrip_timer_wait().unwrap();
-        assert!(completed != 0);
-        for i in 0..31 {
-            let mask: TimerMask = 1 << i;
-            if (completed & mask) != 0 {
-                if let Err(e) = ML_COORD.lock().timer_completed(i as ModelIdx) {
+        let first_page = cantrip_timer_wait().unwrap();
+        for page in 0..timer_pages {
+            let mut completed = if page == 0 {
+                first_page
+            } else {
+                cantrip_timer_completed_timers_page(page).unwrap_or(0)
+            };
+            while completed != 0 {
+                let i = completed.trailing_zeros() as usize;
+                let model_idx = page * TIMER_MASK_BITS + i;
+                if let Err(e) = ML_COORD.lock().timer_completed(model_idx as ModelIdx) {
                     error!("Error when trying to run periodic model: {:?}", e);
                 }
-                completed &= !mask;
-                if completed == 0 {
-                    break;
-                }
+                prefetch_next_model();
+                completed &= !((1 as TimerMask) << i);
             }
         }
     }
@@ -89,6 +113,7 @@ pub unsafe extern "C" fn mlcoord_oneshot(
     if let Err(e) = ML_COORD.lock().oneshot(id) {
         return e;
     }
+    prefetch_next_model();
 
     MlCoordError::MlCoordOk
 }
@@ -106,6 +131,7 @@ pub unsafe extern "C" fn mlcoord_periodic(
     if let Err(e) = ML_COORD.lock().periodic(id, rate_in_ms) {
         return e;
     }
+    prefetch_next_model();
 
     MlCoordError::MlCoordOk
 }
@@ -130,11 +156,64 @@ pub unsafe extern "C" fn mlcoord_cancel(
 #[no_mangle]
 pub unsafe extern "C" fn mlcoord_completed_jobs() -> u32 { ML_COORD.lock().completed_jobs() }
 
+#[no_mangle]
+pub unsafe extern "C" fn mlcoord_completed_jobs_page(page: u32) -> u32 {
+    ML_COORD.lock().completed_jobs_page(page as usize)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn mlcoord_results(
+    c_bundle_id: *const cstr_core::c_char,
+    c_model_id: *const cstr_core::c_char,
+    c_raw_data: *mut RawMlResultsData,
+) -> MlCoordError {
+    let id = match validate_ids(c_bundle_id, c_model_id) {
+        Ok(id) => id,
+        Err(e) => return e,
+    };
+    match ML_COORD.lock().results(&id) {
+        Ok(results) => match postcard::to_slice(&results, &mut (*c_raw_data)[..]) {
+            Ok(_) => MlCoordError::MlCoordOk,
+            Err(_) => MlCoordError::SerializeFailed,
+        },
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn mlcoord_stats(c_raw_data: *mut RawMlStatsData) -> MlCoordError {
+    let stats = ML_COORD.lock().stats();
+    match postcard::to_slice(&stats, &mut (*c_raw_data)[..]) {
+        Ok(_) => MlCoordError::MlCoordOk,
+        Err(_) => MlCoordError::SerializeFailed,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn mlcoord_model_stats(
+    job_id: u32,
+    c_raw_data: *mut RawMlStatsData,
+) -> MlCoordError {
+    match ML_COORD.lock().model_stats(job_id as ModelIdx) {
+        Ok(stats) => match postcard::to_slice(&stats, &mut (*c_raw_data)[..]) {
+            Ok(_) => MlCoordError::MlCoordOk,
+            Err(_) => MlCoordError::SerializeFailed,
+        },
+        Err(e) => e,
+    }
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn host_req_handle() { ML_COORD.lock().handle_host_req_interrupt(); }
 
 #[no_mangle]
-pub unsafe extern "C" fn finish_handle() { ML_COORD.lock().handle_return_interrupt(); }
+pub unsafe extern "C" fn finish_handle() {
+    // NB: timestamp before (possibly) waiting for the lock so the run's
+    //   exec time does not include whatever holds it.
+    let finished_at = cantrip_clock_ticks();
+    ML_COORD.lock().handle_return_interrupt(finished_at);
+    prefetch_next_model();
+}
 
 #[no_mangle]
 pub unsafe extern "C" fn instruction_fault_handle() {
@@ -21,18 +21,34 @@ extern crate alloc;
 use alloc::vec::Vec;
 use cantrip_memory_interface::cantrip_object_free_in_cnode;
 use cantrip_ml_interface::MlCoordError;
+use cantrip_ml_interface::MlJobMask;
+use cantrip_ml_interface::MlJobMasks;
+use cantrip_ml_interface::MlModelResult;
+use cantrip_ml_interface::MlModelResults;
+use cantrip_ml_interface::MlModelStats;
+use cantrip_ml_interface::MlStats;
+use cantrip_ml_interface::MlTimingStats;
+use cantrip_ml_interface::ML_JOB_MASK_BITS;
+use cantrip_ml_interface::ML_JOB_MASK_PAGES;
+use cantrip_ml_interface::ML_RESULTS_MAX;
 use cantrip_ml_shared::*;
 use cantrip_ml_support::image_manager::ImageManager;
 use cantrip_os_common::cspace_slot::CSpaceSlot;
+use cantrip_os_common::logger::bin_trace;
 use cantrip_os_common::sel4_sys;
 use cantrip_proc_interface::BundleImage;
 use cantrip_security_interface::*;
 use cantrip_timer_interface::*;
 use cantrip_vec_core as MlCore;
-use log::{error, info, trace, warn};
+use log::{error, info, warn};
+use spin::Mutex;
 
 use sel4_sys::seL4_Word;
 
+// Serializes use of the BUNDLE_IMAGE copyregion (see BundleImage); a
+// prefetch reads an image without holding the MLCoordinator lock.
+static BUNDLE_IMAGE_LOCK: Mutex<()> = Mutex::new(());
+
 /// Represents a single loadable model.
 #[derive(Debug)]
 struct LoadableModel {
@@ -41,6 +57,54 @@ struct LoadableModel {
     in_memory_sizes: ImageSizes,
     rate_in_ms: Option<u32>,
     client_id: seL4_Word,
+    results: ResultRing,
+    timing: ModelTiming,
+}
+
+/// Where a model's time goes (see MlModelStats).
+#[derive(Debug, Default)]
+struct ModelTiming {
+    queue_wait: MlTimingStats,
+    load: MlTimingStats,
+    exec: MlTimingStats,
+    jitter: MlTimingStats,
+    queued_at: Option<Ticks>, // When last put on the execution queue
+    period_ticks: Ticks,      // Periodic timer rate; 0 if oneshot
+    next_deadline: Ticks,     // Expected time of the next timer expiry
+}
+
+/// Results of a model's runs not yet collected by the client. A periodic
+/// model may complete several runs per client wakeup; the newest
+/// ML_RESULTS_MAX are held (|completed| counts them all).
+#[derive(Debug, Default)]
+struct ResultRing {
+    completed: u32,
+    next: usize, // Slot for the next result
+    count: usize,
+    buf: [MlModelResult; ML_RESULTS_MAX],
+}
+impl ResultRing {
+    fn push(&mut self, result: MlModelResult) {
+        self.buf[self.next] = result;
+        self.next = (self.next + 1) % ML_RESULTS_MAX;
+        self.count = core::cmp::min(self.count + 1, ML_RESULTS_MAX);
+        self.completed = self.completed.wrapping_add(1);
+    }
+
+    // Returns the held results, oldest first, and empties the ring.
+    fn take(&mut self) -> MlModelResults {
+        let mut results = MlModelResults {
+            completed: self.completed,
+            count: self.count as u32,
+            ..Default::default()
+        };
+        let first = (self.next + ML_RESULTS_MAX - self.count) % ML_RESULTS_MAX;
+        for i in 0..self.count {
+            results.results[i] = self.buf[(first + i) % ML_RESULTS_MAX];
+        }
+        *self = ResultRing::default();
+        results
+    }
 }
 
 /// Statistics on non-happy-path events.
@@ -48,6 +112,10 @@ struct LoadableModel {
 struct Statistics {
     load_failures: u32,
     already_queued: u32,
+    static_data_reuse: u32, // Runs that skipped reload_static_data
+    prefetched: u32,        // Images loaded while another model ran
+    prefetch_no_space: u32, // Prefetches skipped for lack of free TCM
+    busy_ticks: Ticks,      // Vector core running a model
 }
 
 pub struct MLCoordinator {
@@ -59,13 +127,127 @@ pub struct MLCoordinator {
     /// A queue of models that are ready for immediate execution on the vector
     /// core, once the currently running model has finished.
     execution_queue: Vec<ModelIdx>,
-    /// Bitmask of completed model runs.
+    /// Bitmask of completed model runs, ML_JOB_MASK_BITS models per page.
     // XXX needs to be per-client
-    completed_job_mask: usize,
+    completed_job_mask: [MlJobMask; ML_JOB_MASK_PAGES],
     /// The image manager is responsible for tracking, loading, and unloading
     /// images.
     image_manager: ImageManager,
     statistics: Statistics,
+    /// Profiling state; times are cantrip_clock_ticks.
+    started_at: Ticks,
+    run_started_at: Ticks,
+    clock_hz: u64, // NB: fetched from the TimerService on first use
+    /// The model whose image is being prefetched, if any (see
+    /// claim_prefetch).
+    prefetching: Option<ModelIdx>,
+}
+
+/// A prefetch handed out by MLCoordinator::claim_prefetch. The image is
+/// written to free TCM with load, which does not need the MLCoordinator
+/// (so its lock need not be held), and the result is handed back with
+/// MLCoordinator::publish_prefetch.
+pub struct PrefetchClaim {
+    idx: ModelIdx,
+    id: ImageId,
+    on_flash_sizes: ImageSizes,
+    in_memory_sizes: ImageSizes,
+    data_top_addr: usize,
+}
+impl PrefetchClaim {
+    /// Writes the claimed image to the TCM; returns the time taken.
+    pub fn load(&self) -> Result<Ticks, MlCoordError> {
+        let start = cantrip_clock_ticks();
+        write_image(
+            &self.id,
+            &self.on_flash_sizes,
+            &self.in_memory_sizes,
+            self.data_top_addr,
+        )?;
+        Ok(cantrip_clock_ticks() - start)
+    }
+}
+
+// Loads the image |id| from the SecurityCoordinator into the TCM at
+// |data_top_addr|. This does not touch the MLCoordinator so it can run
+// without holding its lock (see PrefetchClaim); the caller commits the
+// image to the ImageManager.
+fn write_image(
+    id: &ImageId,
+    on_flash_sizes: &ImageSizes,
+    in_memory_sizes: &ImageSizes,
+    data_top_addr: usize,
+) -> Result<(), MlCoordError> {
+    let _image_lock = BUNDLE_IMAGE_LOCK.lock();
+
+    // Loads |model_id| associated with |bundle_id| from the
+    // SecurityCoordinator. The data are returned as unmapped
+    // page frames in a CNode container left in |container_slot|.
+    // To load the model into the vector core the pages must be
+    // mapped into the MlCoordinator's VSpace before being copied
+    // to their destination.
+    let mut container_slot = CSpaceSlot::new();
+    match cantrip_security_load_model(&id.bundle_id, &id.model_id, &container_slot) {
+        Ok(model_frames) => {
+            container_slot.release(); // NB: take ownership
+            let mut image = BundleImage::new(&model_frames);
+
+            let mut temp_top = data_top_addr;
+            bin_trace!(
+                "first load {}:{} temp_top {:#x}",
+                id.bundle_id.as_str(),
+                id.model_id.as_str(),
+                temp_top
+            );
+
+            while let Some(section) = image.next_section() {
+                // TODO(jesionowski): Ensure these are in order.
+                if section.vaddr == TEXT_VADDR {
+                    MlCore::write_image_part(
+                        &mut image,
+                        temp_top,
+                        on_flash_sizes.text,
+                        in_memory_sizes.text,
+                    )
+                    .ok_or(MlCoordError::LoadModelFailed)?;
+
+                    temp_top += in_memory_sizes.text;
+                } else if section.vaddr == CONST_DATA_VADDR {
+                    MlCore::write_image_part(
+                        &mut image,
+                        temp_top,
+                        on_flash_sizes.constant_data,
+                        in_memory_sizes.constant_data,
+                    )
+                    .ok_or(MlCoordError::LoadModelFailed)?;
+
+                    temp_top += in_memory_sizes.constant_data;
+                } else if section.vaddr == MODEL_OUTPUT_VADDR {
+                    // Don't load, but do skip.
+                    temp_top += in_memory_sizes.model_output;
+                } else if section.vaddr == STATIC_DATA_VADDR {
+                    MlCore::write_image_part(
+                        &mut image,
+                        temp_top,
+                        on_flash_sizes.static_data,
+                        in_memory_sizes.static_data,
+                    )
+                    .ok_or(MlCoordError::LoadModelFailed)?;
+
+                    temp_top += in_memory_sizes.static_data;
+                }
+            }
+            info!("Load successful.");
+
+            drop(image);
+            let _ = cantrip_object_free_in_cnode(&model_frames);
+            Ok(())
+        }
+        Err(e) => {
+            error!("{}: LoadModel failed: {:?}", id, e);
+            Err(MlCoordError::LoadModelFailed)
+        }
+    }
 }
 
 // The index of a model in MLCoordinator.models
@@ -80,12 +262,20 @@ impl MLCoordinator {
             running_model: None,
             models: [INIT_NONE; MAX_MODELS],
             execution_queue: Vec::new(),
-            completed_job_mask: 0,
+            completed_job_mask: [0; ML_JOB_MASK_PAGES],
             image_manager: ImageManager::new(),
             statistics: Statistics {
                 load_failures: 0,
                 already_queued: 0,
+                static_data_reuse: 0,
+                prefetched: 0,
+                prefetch_no_space: 0,
+                busy_ticks: 0,
             },
+            started_at: 0,
+            run_started_at: 0,
+            clock_hz: 0,
+            prefetching: None,
         }
     }
 
@@ -93,13 +283,27 @@ impl MLCoordinator {
     pub fn init(&mut self) {
         MlCore::enable_interrupts(true);
         self.execution_queue.reserve(MAX_MODELS);
-        self.image_manager.init();
+        self.started_at = cantrip_clock_ticks();
+    }
+
+    fn clock_hz(&mut self) -> u64 {
+        if self.clock_hz == 0 {
+            self.clock_hz = cantrip_timer_clock_hz().unwrap_or(0);
+        }
+        self.clock_hz
+    }
+
+    // Appends the model at |idx| to the execution queue.
+    fn enqueue(&mut self, idx: ModelIdx) {
+        self.models[idx].as_mut().unwrap().timing.queued_at = Some(cantrip_clock_ticks());
+        self.execution_queue.push(idx);
     }
 
     // Validates the image by ensuring it has all the required loadable
     // sections and that it fits into the TCM. Returns a tuple of
     // |(on_flash_sizes, in_memory_sizes)|.
     fn validate_image(&self, id: &ImageId) -> Option<(ImageSizes, ImageSizes)> {
+        let _image_lock = BUNDLE_IMAGE_LOCK.lock();
         let mut container_slot = CSpaceSlot::new();
         match cantrip_security_load_model(&id.bundle_id, &id.model_id, &container_slot) {
             Ok(model_frames) => {
@@ -160,6 +364,7 @@ impl MLCoordinator {
     }
 
     fn reload_static_data(&self, model: &LoadableModel) -> Result<(), MlCoordError> {
+        let _image_lock = BUNDLE_IMAGE_LOCK.lock();
         let mut container_slot = CSpaceSlot::new();
         let model_frames =
             cantrip_security_load_model(&model.id.bundle_id, &model.id.model_id, &container_slot)
@@ -170,7 +375,12 @@ impl MLCoordinator {
 
         // Find top address for loading the data segment.
         let mut temp_top = self.image_manager.get_top_addr(&model.id).unwrap();
-        trace!("reload {} temp_top {:#x}", &model.id, temp_top);
+        bin_trace!(
+            "reload {}:{} temp_top {:#x}",
+            model.id.bundle_id.as_str(),
+            model.id.model_id.as_str(),
+            temp_top
+        );
 
         while let Some(section) = image.next_section() {
             if section.vaddr == TEXT_VADDR {
@@ -196,95 +406,149 @@ impl MLCoordinator {
         Ok(())
     }
 
+    // Loads the image for the model at |idx| from the SecurityCoordinator
+    // into the TCM at |data_top_addr| (as returned by the ImageManager) and
+    // commits it to the ImageManager.
+    fn load_image(&mut self, idx: ModelIdx, data_top_addr: usize) -> Result<(), MlCoordError> {
+        let start = cantrip_clock_ticks();
+        let model = self.models[idx].as_ref().expect("Model get fail");
+        let result = write_image(
+            &model.id,
+            &model.on_flash_sizes,
+            &model.in_memory_sizes,
+            data_top_addr,
+        );
+        match result {
+            Ok(_) => self.image_manager.commit_image(
+                model.id.clone(),
+                data_top_addr,
+                model.in_memory_sizes,
+            ),
+            Err(_) => self.statistics.load_failures += 1,
+        }
+        let model = self.models[idx].as_mut().unwrap();
+        model.timing.load.record(cantrip_clock_ticks() - start);
+        result
+    }
+
+    /// Claims the loading of the image of the model at the head of the
+    /// execution queue while another model runs so it can start as soon as
+    /// the vector core is free. The image is only claimed if it fits in
+    /// free TCM; nothing is evicted and the running model's windows are not
+    /// touched. Until the claim is published no model is started (so the
+    /// TCM is only written by the claim holder).
+    #[cfg(feature = "pipelined_loads")]
+    pub fn claim_prefetch(&mut self) -> Option<PrefetchClaim> {
+        if self.running_model.is_none() || self.prefetching.is_some() {
+            return None;
+        }
+        let next_idx = *self.execution_queue.first()?;
+        let model = self.models[next_idx].as_ref().expect("Model get fail");
+        if self.image_manager.is_loaded(&model.id) {
+            return None;
+        }
+        let sizes = model.in_memory_sizes;
+        match self
+            .image_manager
+            .find_free_space(sizes.data_top_size(), sizes.temporary_data)
+        {
+            Some(data_top_addr) => {
+                self.prefetching = Some(next_idx);
+                Some(PrefetchClaim {
+                    idx: next_idx,
+                    id: model.id.clone(),
+                    on_flash_sizes: model.on_flash_sizes,
+                    in_memory_sizes: sizes,
+                    data_top_addr,
+                })
+            }
+            None => {
+                self.statistics.prefetch_no_space += 1;
+                None
+            }
+        }
+    }
+    #[cfg(not(feature = "pipelined_loads"))]
+    pub fn claim_prefetch(&mut self) -> Option<PrefetchClaim> { None }
+
+    /// Commits the image loaded for |claim| (unless the model was canceled
+    /// meanwhile) and starts the next model if the vector core went idle
+    /// during the load. Returns true if a model was started, in which case
+    /// the caller may claim the next prefetch.
+    pub fn publish_prefetch(
+        &mut self,
+        claim: PrefetchClaim,
+        result: Result<Ticks, MlCoordError>,
+    ) -> bool {
+        self.prefetching = None;
+        match result {
+            Ok(ticks) => {
+                // NB: the slot may have been freed or reused while loading.
+                if let Some(model) = self.models[claim.idx]
+                    .as_mut()
+                    .filter(|model| model.id == claim.id)
+                {
+                    model.timing.load.record(ticks);
+                    self.image_manager.commit_image(
+                        claim.id,
+                        claim.data_top_addr,
+                        claim.in_memory_sizes,
+                    );
+                    self.statistics.prefetched += 1;
+                }
+            }
+            Err(e) => {
+                warn!("Prefetch failed with {:?}", e);
+                self.statistics.load_failures += 1;
+            }
+        }
+        if self.running_model.is_some() {
+            return false;
+        }
+        if let Err(e) = self.schedule_next_model() {
+            error!("Running next model failed with {:?}", e)
+        }
+        self.running_model.is_some()
+    }
+
     // If there is a next model in the queue, load it onto the vector core and
-    // start running. If there's already a running model, don't do anything.
+    // start running. Loading the next model's image while this one runs is
+    // left to the caller (see claim_prefetch) so it can be done without
+    // holding the MLCoordinator lock.
     fn schedule_next_model(&mut self) -> Result<(), MlCoordError> {
-        if self.running_model.is_some() || self.execution_queue.is_empty() {
+        if self.running_model.is_some() {
+            return Ok(());
+        }
+        if self.prefetching.is_some() {
+            // NB: the prefetch may be writing the TCM; publish_prefetch
+            //   starts the next model.
+            return Ok(());
+        }
+        if self.execution_queue.is_empty() {
             return Ok(());
         }
 
         let next_idx = self.execution_queue.remove(0);
-        let model = self.models[next_idx].as_ref().expect("Model get fail");
+        let model = self.models[next_idx].as_mut().expect("Model get fail");
+        if let Some(queued_at) = model.timing.queued_at.take() {
+            model
+                .timing
+                .queue_wait
+                .record(cantrip_clock_ticks() - queued_at);
+        }
+        let model = self.models[next_idx].as_ref().unwrap();
 
         let image_is_loaded = self.image_manager.is_loaded(&model.id);
         if !image_is_loaded {
-            // Loads |model_id| associated with |bundle_id| from the
-            // SecurityCoordinator. The data are returned as unmapped
-            // page frames in a CNode container left in |container_slot|.
-            // To load the model into the vector core the pages must be
-            // mapped into the MlCoordinator's VSpace before being copied
-            // to their destination.
-            let mut container_slot = CSpaceSlot::new();
-            match cantrip_security_load_model(
-                &model.id.bundle_id,
-                &model.id.model_id,
-                &container_slot,
-            ) {
-                Ok(model_frames) => {
-                    container_slot.release(); // NB: take ownership
-                    let mut image = BundleImage::new(&model_frames);
-
-                    // Ask the image manager to make enough room and get
-                    // the address to write to.
-                    let mut temp_top = self.image_manager.make_space(
-                        model.in_memory_sizes.data_top_size(),
-                        model.in_memory_sizes.temporary_data,
-                    );
-                    trace!("first load {} temp_top {:#x}", &model.id, temp_top);
-
-                    while let Some(section) = image.next_section() {
-                        // TODO(jesionowski): Ensure these are in order.
-                        if section.vaddr == TEXT_VADDR {
-                            MlCore::write_image_part(
-                                &mut image,
-                                temp_top,
-                                model.on_flash_sizes.text,
-                                model.in_memory_sizes.text,
-                            )
-                            .ok_or(MlCoordError::LoadModelFailed)?;
-
-                            temp_top += model.in_memory_sizes.text;
-                        } else if section.vaddr == CONST_DATA_VADDR {
-                            MlCore::write_image_part(
-                                &mut image,
-                                temp_top,
-                                model.on_flash_sizes.constant_data,
-                                model.in_memory_sizes.constant_data,
-                            )
-                            .ok_or(MlCoordError::LoadModelFailed)?;
-
-                            temp_top += model.in_memory_sizes.constant_data;
-                        } else if section.vaddr == MODEL_OUTPUT_VADDR {
-                            // Don't load, but do skip.
-                            temp_top += model.in_memory_sizes.model_output;
-                        } else if section.vaddr == STATIC_DATA_VADDR {
-                            MlCore::write_image_part(
-                                &mut image,
-                                temp_top,
-                                model.on_flash_sizes.static_data,
-                                model.in_memory_sizes.static_data,
-                            )
-                            .ok_or(MlCoordError::LoadModelFailed)?;
-
-                            temp_top += model.in_memory_sizes.static_data;
-                        }
-                    }
-                    info!("Load successful.");
-
-                    // Inform the image manager the image has been written.
-                    self.image_manager
-                        .commit_image(model.id.clone(), model.in_memory_sizes);
-
-                    drop(image);
-                    let _ = cantrip_object_free_in_cnode(&model_frames);
-                }
-                Err(e) => {
-                    error!("{}: LoadModel failed: {:?}", &model.id, e);
-                    self.statistics.load_failures += 1;
-                    return Err(MlCoordError::LoadModelFailed);
-                }
-            }
+            // Ask the image manager to make enough room and get
+            // the address to write to.
+            let data_top_addr = self.image_manager.make_space(
+                model.in_memory_sizes.data_top_size(),
+                model.in_memory_sizes.temporary_data,
+            );
+            self.load_image(next_idx, data_top_addr)?;
         }
+        let model = self.models[next_idx].as_ref().unwrap();
 
         // TODO(jesionowski): Investigate if we need to clear the entire
         // temporary data section or just certain parts.
@@ -293,44 +557,80 @@ impl MLCoordinator {
         self.image_manager.clear_temp_data();
 
         if image_is_loaded {
+            self.image_manager.touch(&model.id);
             // TODO(b/258304148): reload .data section to workaround corruption
-            self.reload_static_data(&model)?;
+            if self.image_manager.static_data_unchanged(&model.id) {
+                self.statistics.static_data_reuse += 1;
+            } else {
+                let start = cantrip_clock_ticks();
+                self.reload_static_data(model)?;
+                let ticks = cantrip_clock_ticks() - start;
+                self.models[next_idx]
+                    .as_mut()
+                    .unwrap()
+                    .timing
+                    .load
+                    .record(ticks);
+            }
         }
+        let model = self.models[next_idx].as_ref().unwrap();
 
         self.image_manager.set_wmmu(&model.id);
 
         self.running_model = Some(model.id.clone());
+        self.run_started_at = cantrip_clock_ticks();
         MlCore::run(); // Start core at default PC.
 
         Ok(())
     }
 
-    pub fn handle_return_interrupt(&mut self) {
+    /// Handles the vector core finishing the running model; |finished_at|
+    /// is when the interrupt was taken.
+    pub fn handle_return_interrupt(&mut self, finished_at: Ticks) {
         extern "C" {
             fn finish_acknowledge() -> u32;
             fn mlcoord_emit(badge: seL4_Word);
         }
 
         if let Some(image_id) = self.running_model.as_ref() {
+            let idx = self.get_model_index(image_id).unwrap();
+            let exec_ticks = finished_at.saturating_sub(self.run_started_at);
+            self.statistics.busy_ticks += exec_ticks;
+            self.models[idx]
+                .as_mut()
+                .unwrap()
+                .timing
+                .exec
+                .record(exec_ticks);
             if let Some(output_header) = self.image_manager.output_header(image_id) {
                 // TODO(jesionowski): Move the result from TCM to SRAM,
                 // update the input/model.
 
                 if output_header.return_code != 0 {
-                    // TODO(jesionowski): Signal the application that there was a failure.
                     error!(
                         "vctop execution failed with code {}, fault pc: {:#010X}",
                         output_header.return_code, output_header.epc
                     );
                 }
+                // Hold the result until the client collects it (see results).
+                self.models[idx]
+                    .as_mut()
+                    .unwrap()
+                    .results
+                    .push(MlModelResult {
+                        return_code: output_header.return_code,
+                        epc: output_header.epc,
+                        output_length: output_header.output_length,
+                    });
             } else {
                 // This can happen during normal execution if mlcancel happens
                 // during an execution.
                 warn!("Executable finished running but image is not loaded.");
             }
 
-            let idx = self.get_model_index(image_id).unwrap();
-            self.completed_job_mask |= 1 << idx;
+            self.mark_completed(idx);
+            // The run consumed its sensor frame.
+            self.image_manager.next_sensor_frame();
             unsafe {
                 mlcoord_emit(self.models[idx].as_ref().unwrap().client_id);
             }
@@ -376,6 +676,8 @@ impl MLCoordinator {
             in_memory_sizes,
             rate_in_ms,
             client_id: unsafe { mlcoord_get_sender_id() },
+            results: ResultRing::default(),
+            timing: ModelTiming::default(),
         });
 
         Ok(index)
@@ -400,7 +702,7 @@ impl MLCoordinator {
             None => self.ready_model(id, None)?,
         };
 
-        self.execution_queue.push(idx);
+        self.enqueue(idx);
         self.schedule_next_model()?;
 
         Ok(())
@@ -415,7 +717,13 @@ impl MLCoordinator {
             None => self.ready_model(id, Some(rate_in_ms))?,
         };
 
-        self.execution_queue.push(idx);
+        // The timer's first expiry is expected one period from now.
+        let period_ticks = self.clock_hz() * rate_in_ms as u64 / 1000;
+        let timing = &mut self.models[idx].as_mut().unwrap().timing;
+        timing.period_ticks = period_ticks;
+        timing.next_deadline = cantrip_clock_ticks() + period_ticks;
+
+        self.enqueue(idx);
         self.schedule_next_model()?;
 
         cantrip_timer_periodic(idx as TimerId, rate_in_ms).map_err(|_| MlCoordError::InvalidTimer)
@@ -446,7 +754,7 @@ impl MLCoordinator {
         }
 
         self.image_manager.unload_image(id);
-        self.completed_job_mask |= 1 << model_idx;
+        self.mark_completed(model_idx);
 
         self.models[model_idx] = None;
         Ok(())
@@ -456,7 +764,19 @@ impl MLCoordinator {
     pub fn timer_completed(&mut self, model_idx: ModelIdx) -> Result<(), MlCoordError> {
         // There's a small chance the model was removed at the same time the
         // timer interrupt fires, in which case we just ignore it.
-        if self.models[model_idx].is_some() {
+        if let Some(model) = self.models[model_idx].as_mut() {
+            // Measure the expiry against the timer's deadline; expiries
+            // that were missed entirely just advance the deadline.
+            let timing = &mut model.timing;
+            if timing.period_ticks != 0 {
+                let now = cantrip_clock_ticks();
+                while timing.next_deadline + timing.period_ticks / 2 < now {
+                    timing.next_deadline += timing.period_ticks;
+                }
+                timing.jitter.record(now.abs_diff(timing.next_deadline));
+                timing.next_deadline += timing.period_ticks;
+            }
+
             // We don't want the queue to grow unbounded, so don't requeue
             // an execution if there's one scheduled already.
             if self.execution_queue.iter().any(|idx| *idx == model_idx) {
@@ -469,18 +789,70 @@ impl MLCoordinator {
                 return Ok(());
             }
 
-            self.execution_queue.push(model_idx);
+            self.enqueue(model_idx);
             self.schedule_next_model()?;
         }
 
         Ok(())
     }
 
-    pub fn completed_jobs(&mut self) -> u32 {
+    fn mark_completed(&mut self, model_idx: ModelIdx) {
+        self.completed_job_mask[model_idx / ML_JOB_MASK_BITS] |=
+            1 << (model_idx % ML_JOB_MASK_BITS);
+    }
+
+    pub fn completed_jobs(&mut self) -> u32 { self.completed_jobs_page(0) }
+
+    /// Returns & clears the completed jobs in mask |page|.
+    pub fn completed_jobs_page(&mut self, page: usize) -> u32 {
         // XXX restrict mask to client jobs
-        let mask = self.completed_job_mask;
-        self.completed_job_mask = 0;
-        mask as u32
+        match self.completed_job_mask.get_mut(page) {
+            Some(mask) => core::mem::take(mask),
+            None => 0,
+        }
+    }
+
+    /// Returns the MlCoordinator-wide statistics.
+    pub fn stats(&mut self) -> MlStats {
+        let mut live_jobs: MlJobMasks = [0; ML_JOB_MASK_PAGES];
+        for (model_idx, _) in self.models.iter().enumerate().filter(|(_, m)| m.is_some()) {
+            live_jobs[model_idx / ML_JOB_MASK_BITS] |= 1 << (model_idx % ML_JOB_MASK_BITS);
+        }
+        MlStats {
+            clock_hz: self.clock_hz(),
+            elapsed_ticks: cantrip_clock_ticks() - self.started_at,
+            busy_ticks: self.statistics.busy_ticks,
+            load_failures: self.statistics.load_failures,
+            already_queued: self.statistics.already_queued,
+            static_data_reuse: self.statistics.static_data_reuse,
+            prefetched: self.statistics.prefetched,
+            prefetch_no_space: self.statistics.prefetch_no_space,
+            live_jobs,
+        }
+    }
+
+    /// Returns the statistics for the model at |model_idx| (its job id).
+    pub fn model_stats(&self, model_idx: ModelIdx) -> Result<MlModelStats, MlCoordError> {
+        let model = self
+            .models
+            .get(model_idx)
+            .and_then(|m| m.as_ref())
+            .ok_or(MlCoordError::NoSuchModel)?;
+        Ok(MlModelStats {
+            bundle_id: model.id.bundle_id.clone(),
+            model_id: model.id.model_id.clone(),
+            period_ms: model.rate_in_ms.unwrap_or(0),
+            queue_wait: model.timing.queue_wait,
+            load: model.timing.load,
+            exec: model.timing.exec,
+            jitter: model.timing.jitter,
+        })
+    }
+
+    /// Returns & clears the results of model |id|'s runs since the last call.
+    pub fn results(&mut self, id: &ImageId) -> Result<MlModelResults, MlCoordError> {
+        let model_idx = self.get_model_index(id).ok_or(MlCoordError::NoSuchModel)?;
+        Ok(self.models[model_idx].as_mut().unwrap().results.take())
     }
 
     pub fn handle_host_req_interrupt(&self) {
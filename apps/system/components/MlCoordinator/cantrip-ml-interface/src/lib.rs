@@ -13,8 +13,13 @@
 // limitations under the License.
 
 #![no_std]
+
+extern crate alloc;
+
+use alloc::string::String;
 use cantrip_os_common::sel4_sys;
 use cstr_core::CString;
+use serde::{Deserialize, Serialize};
 
 use sel4_sys::seL4_CPtr;
 use sel4_sys::seL4_NBWait;
@@ -23,6 +28,93 @@ use sel4_sys::seL4_Wait;
 pub type MlJobId = u32;
 pub type MlJobMask = u32;
 
+/// Job completions are reported one MlJobMask "page" at a time; page N
+/// holds jobs [N * ML_JOB_MASK_BITS, (N + 1) * ML_JOB_MASK_BITS).
+pub const ML_JOB_MASK_BITS: usize = 32;
+pub const ML_JOB_MASK_PAGES: usize = 2;
+
+/// The completed job masks for every page of the job id space.
+pub type MlJobMasks = [MlJobMask; ML_JOB_MASK_PAGES];
+
+/// Outcome of one model run (from the OutputHeader the model writes).
+#[derive(Clone, Copy, Debug, Default, Serialize, Deserialize)]
+pub struct MlModelResult {
+    pub return_code: u32,
+    pub epc: u32, // Fault pc if return_code is non-zero
+    pub output_length: u32,
+}
+
+/// Max results held per model; older results are dropped.
+pub const ML_RESULTS_MAX: usize = 8;
+
+/// Results of the runs of a model since the last request.
+#[derive(Debug, Default, Serialize, Deserialize)]
+pub struct MlModelResults {
+    pub completed: u32, // Runs completed (may be more than |count|)
+    pub count: u32,     // Valid entries in |results|, oldest first
+    pub results: [MlModelResult; ML_RESULTS_MAX],
+}
+
+// NB: sized for the worst-case postcard encoding of MlModelResults.
+pub const RAW_ML_RESULTS_DATA_SIZE: usize = 160;
+pub type RawMlResultsData = [u8; RAW_ML_RESULTS_DATA_SIZE];
+
+/// Timing of one phase of model execution. Times are in cpu clock
+/// ticks (see MlStats::clock_hz).
+#[derive(Clone, Copy, Debug, Default, Serialize, Deserialize)]
+pub struct MlTimingStats {
+    pub total_ticks: u64,
+    pub count: u32,
+    pub max_ticks: u64,
+}
+impl MlTimingStats {
+    pub fn record(&mut self, ticks: u64) {
+        self.total_ticks = self.total_ticks.saturating_add(ticks);
+        self.count += 1;
+        self.max_ticks = core::cmp::max(self.max_ticks, ticks);
+    }
+
+    /// Mean duration in ticks.
+    pub fn avg_ticks(&self) -> u64 {
+        if self.count == 0 {
+            0
+        } else {
+            self.total_ticks / self.count as u64
+        }
+    }
+}
+
+/// MlCoordinator-wide statistics.
+#[derive(Debug, Default, Serialize, Deserialize)]
+pub struct MlStats {
+    pub clock_hz: u64,      // Rate of the tick counts (0 if unknown)
+    pub elapsed_ticks: u64, // Since the MlCoordinator started
+    pub busy_ticks: u64,    // Vector core running a model
+    pub load_failures: u32,
+    pub already_queued: u32,    // Periodic runs dropped
+    pub static_data_reuse: u32, // Runs that skipped reloading static data
+    pub prefetched: u32,        // Images loaded while another model ran
+    pub prefetch_no_space: u32, // Prefetches skipped for lack of free TCM
+    pub live_jobs: MlJobMasks,  // Job ids with a model (see cantrip_mlcoord_model_stats)
+}
+
+/// Per-model statistics; a model's stats reset when it is cancelled.
+#[derive(Debug, Default, Serialize, Deserialize)]
+pub struct MlModelStats {
+    pub bundle_id: String,
+    pub model_id: String,
+    pub period_ms: u32,            // 0 for a oneshot model
+    pub queue_wait: MlTimingStats, // Queued until loaded or started
+    pub load: MlTimingStats,       // Image fetch + TCM copy
+    pub exec: MlTimingStats,       // Vector core start to return interrupt
+    pub jitter: MlTimingStats,     // Periodic run start vs its deadline
+}
+
+// NB: stats travel in the IPC buffer; model names longer than ~90 bytes
+//   fail to serialize.
+pub const RAW_ML_STATS_DATA_SIZE: usize = 256;
+pub type RawMlStatsData = [u8; RAW_ML_STATS_DATA_SIZE];
+
 /// Errors that can occur when interacting with the MlCoordinator.
 #[repr(C)]
 #[derive(Debug, Eq, PartialEq)]
@@ -35,6 +127,9 @@ pub enum MlCoordError {
     LoadModelFailed,
     NoModelSlotsLeft,
     NoSuchModel,
+    InvalidJobMaskPage,
+    SerializeFailed,
+    DeserializeFailed,
 }
 
 impl From<MlCoordError> for Result<(), MlCoordError> {
@@ -114,24 +209,106 @@ pub fn cantrip_mlcoord_completed_jobs() -> Result<MlJobMask, MlCoordError> {
     Ok(unsafe { mlcoord_completed_jobs() } as MlJobMask)
 }
 
+/// Returns the bitmask of completed jobs in |page| of the job id space
+/// (see ML_JOB_MASK_PAGES); cantrip_mlcoord_completed_jobs returns page 0.
+#[inline]
+pub fn cantrip_mlcoord_completed_jobs_page(page: usize) -> Result<MlJobMask, MlCoordError> {
+    extern "C" {
+        fn mlcoord_completed_jobs_page(page: u32) -> u32;
+    }
+    if page >= ML_JOB_MASK_PAGES {
+        return Err(MlCoordError::InvalidJobMaskPage);
+    }
+    Ok(unsafe { mlcoord_completed_jobs_page(page as u32) } as MlJobMask)
+}
+
+/// Returns the bitmasks of completed jobs for all pages of the job id space.
+#[inline]
+pub fn cantrip_mlcoord_completed_job_masks() -> Result<MlJobMasks, MlCoordError> {
+    let mut masks: MlJobMasks = [0; ML_JOB_MASK_PAGES];
+    for (page, mask) in masks.iter_mut().enumerate() {
+        *mask = cantrip_mlcoord_completed_jobs_page(page)?;
+    }
+    Ok(masks)
+}
+
+/// Returns (and clears) the results of the runs of |model_id| since the
+/// last call. A client running a model periodically can collect all the
+/// runs that completed since it last woke with one request.
+#[inline]
+pub fn cantrip_mlcoord_results(
+    bundle_id: &str,
+    model_id: &str,
+) -> Result<MlModelResults, MlCoordError> {
+    extern "C" {
+        fn mlcoord_results(
+            c_bundle_id: *const cstr_core::c_char,
+            c_model_id: *const cstr_core::c_char,
+            c_raw_data: *mut RawMlResultsData,
+        ) -> MlCoordError;
+    }
+    let bundle_id_cstr = CString::new(bundle_id).map_err(|_| MlCoordError::InvalidBundleId)?;
+    let model_id_cstr = CString::new(model_id).map_err(|_| MlCoordError::InvalidModelId)?;
+    let raw_data = &mut [0u8; RAW_ML_RESULTS_DATA_SIZE];
+    match unsafe {
+        mlcoord_results(bundle_id_cstr.as_ptr(), model_id_cstr.as_ptr(), raw_data as *mut _)
+    } {
+        MlCoordError::MlCoordOk => postcard::from_bytes::<MlModelResults>(raw_data)
+            .map_err(|_| MlCoordError::DeserializeFailed),
+        status => Err(status),
+    }
+}
+
+/// Returns the MlCoordinator-wide statistics.
+#[inline]
+pub fn cantrip_mlcoord_stats() -> Result<MlStats, MlCoordError> {
+    extern "C" {
+        fn mlcoord_stats(c_raw_data: *mut RawMlStatsData) -> MlCoordError;
+    }
+    let raw_data = &mut [0u8; RAW_ML_STATS_DATA_SIZE];
+    match unsafe { mlcoord_stats(raw_data as *mut _) } {
+        MlCoordError::MlCoordOk => {
+            postcard::from_bytes::<MlStats>(raw_data).map_err(|_| MlCoordError::DeserializeFailed)
+        }
+        status => Err(status),
+    }
+}
+
+/// Returns the statistics for the model with job id |job_id| (a bit in
+/// the completed jobs masks). Returns NoSuchModel if there is none; the
+/// job ids that have a model are in MlStats::live_jobs.
+#[inline]
+pub fn cantrip_mlcoord_model_stats(job_id: MlJobId) -> Result<MlModelStats, MlCoordError> {
+    extern "C" {
+        fn mlcoord_model_stats(job_id: u32, c_raw_data: *mut RawMlStatsData) -> MlCoordError;
+    }
+    let raw_data = &mut [0u8; RAW_ML_STATS_DATA_SIZE];
+    match unsafe { mlcoord_model_stats(job_id, raw_data as *mut _) } {
+        MlCoordError::MlCoordOk => postcard::from_bytes::<MlModelStats>(raw_data)
+            .map_err(|_| MlCoordError::DeserializeFailed),
+        status => Err(status),
+    }
+}
+
 /// Waits for the next pending job for the client. If a job completes
-/// the associated job id is returned.
+/// the associated job id is set in the returned masks (one per page).
 #[inline]
-pub fn cantrip_mlcoord_wait() -> Result<MlJobMask, MlCoordError> {
+pub fn cantrip_mlcoord_wait() -> Result<MlJobMasks, MlCoordError> {
     unsafe {
         seL4_Wait(cantrip_mlcoord_notification(), core::ptr::null_mut());
     }
-    cantrip_mlcoord_completed_jobs()
+    cantrip_mlcoord_completed_job_masks()
 }
 
-/// Returns a bitmask of completed jobs. Note this is non-blocking; to
-/// wait for one or more jobs to complete use cantrip_mlcoord_wait.
+/// Returns the bitmasks of completed jobs (one per page). Note this is
+/// non-blocking; to wait for one or more jobs to complete use
+/// cantrip_mlcoord_wait.
 #[inline]
-pub fn cantrip_mlcoord_poll() -> Result<MlJobMask, MlCoordError> {
+pub fn cantrip_mlcoord_poll() -> Result<MlJobMasks, MlCoordError> {
     unsafe {
         seL4_NBWait(cantrip_mlcoord_notification(), core::ptr::null_mut());
     }
-    cantrip_mlcoord_completed_jobs()
+    cantrip_mlcoord_completed_job_masks()
 }
 
 #[inline]
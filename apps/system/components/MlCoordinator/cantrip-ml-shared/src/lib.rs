@@ -70,6 +70,8 @@ impl ImageSizes {
     }
 
     pub fn model_output_offset(&self) -> usize { self.text + self.constant_data }
+
+    pub fn static_data_offset(&self) -> usize { self.model_output_offset() + self.model_output }
 }
 
 /// After execution our ML executable populates the top of .model_output with
@@ -87,9 +89,9 @@ pub struct OutputHeader {
 pub const WMMU_PAGE_SIZE: usize = 0x1000;
 
 /// The maximum number of models that the MLCoordinator can handle. This is
-/// bounded by timer slots. It's unlikely we'll be anywhere near this due to
-/// memory contstraints.
-pub const MAX_MODELS: usize = 32;
+/// bounded by timer slots and the MlCoordinator's job masks. It's unlikely
+/// we'll be anywhere near this due to memory contstraints.
+pub const MAX_MODELS: usize = 64;
 
 /// The size of the Vector Core's Tightly Coupled Memory (TCM).
 pub const TCM_SIZE: usize = 0x1000000;
@@ -26,18 +26,22 @@
  * models from different applications.)
  * The top region contains the sensor frames and the segments of each
  * image. On system initialization the Sensor Manager requests an allocation,
- * meaning the top of the memory will always contain those frames. Applications
- * then request models to be loaded. These are allocated downward in a linear
- * fashion. Images contain 6 different sections, of which 4 are loaded
- * contiguously together (text, constant_data, model_output, static_data).
- * All sections are described in go/sparrow-vc-memory.
+ * meaning the top of the memory will always contain those frames. The frames
+ * form a ring of equal-sized slots so the producer can fill the next frames
+ * while a model runs on the current one; each run consumes one slot. Applications
+ * then request models to be loaded. Each image is placed in the smallest
+ * free hole in the top region that fits it (best-fit) so unloading an image
+ * never moves the others. Images contain 6 different sections, of which 4
+ * are loaded contiguously together (text, constant_data, model_output,
+ * static_data). All sections are described in go/sparrow-vc-memory.
  *
  * The expected most common usage patterns are:
  *   There is only one model resident in memory.
  *   There are two models resident in memory.
- *   There are two models and each are too large to fit into memory together,
- *   so they're unloaded and loaded on demand.
- * Based on these expectations eviction is done on a FILO basis.
+ *   There are several models run periodically that do not all fit into
+ *   memory together, so they're unloaded and loaded on demand.
+ * Eviction is least-recently-used so on a periodic schedule the models that
+ * run most often stay resident.
  */
 
 extern crate alloc;
@@ -45,6 +49,7 @@ extern crate alloc;
 use alloc::vec::Vec;
 use cantrip_ml_shared::*;
 use core::cmp;
+use core::iter;
 use log::{info, trace};
 
 #[cfg(not(test))]
@@ -77,6 +82,12 @@ struct Image {
     id: ImageId,
     data_top_addr: usize,
     sizes: ImageSizes,
+    last_used: u64,     // ImageManager::use_count at last load or run
+    static_digest: u64, // Digest of static_data as loaded
+}
+impl Image {
+    fn data_top_end(&self) -> usize { self.data_top_addr + self.sizes.data_top_size() }
+    fn static_data_addr(&self) -> usize { self.data_top_addr + self.sizes.static_data_offset() }
 }
 
 pub type ImageIdx = usize;
@@ -95,6 +106,10 @@ const INIT_NONE: Option<Image> = None;
 //                   |               |
 //                   +---------------+
 //                   |               |
+//                   |  (free hole)  |
+//                   |               |
+//                   +---------------+
+//                   |               |
 //                   | model 2 data  |
 //                   |               |
 // tcm_top    -----> +---------------+
@@ -108,11 +123,15 @@ const INIT_NONE: Option<Image> = None;
 //                   +---------------+
 pub struct ImageManager {
     images: [Option<Image>; MAX_MODELS],
-    image_queue: Vec<ImageIdx>,
+    use_count: u64, // Monotonic clock for LRU eviction
 
     sensor_top: usize,
     tcm_top: usize,
     tcm_bottom: usize,
+
+    sensor_frame_size: usize, // Page-rounded size of a sensor frame slot
+    sensor_slots: usize,      // Slots in the sensor ring (0 if none)
+    sensor_slot: usize,       // Slot the next run reads
 }
 
 // Returns the bytes needed above current_size to fit requested_size.
@@ -124,28 +143,55 @@ impl ImageManager {
     pub const fn new() -> Self {
         ImageManager {
             images: [INIT_NONE; MAX_MODELS],
-            image_queue: Vec::new(),
+            use_count: 0,
             sensor_top: TCM_PADDR,
             tcm_top: TCM_PADDR,
             tcm_bottom: TCM_PADDR + TCM_SIZE,
+            sensor_frame_size: 0,
+            sensor_slots: 0,
+            sensor_slot: 0,
         }
     }
 
-    // Optional initilization step to reserve space for the queue.
-    pub fn init(&mut self) { self.image_queue.reserve(MAX_MODELS); }
-
     // Allocate a block of memory for the SensorManager to use. Returns the
     // address of the block. This function should only be called once during
     // SensorManager initialization, before any images are loaded.
     pub fn allocate_sensor_input(&mut self, size: usize) -> usize {
+        self.allocate_sensor_ring(size, 1)
+    }
+
+    // Allocate a ring of |slots| sensor frames of |frame_size| bytes each.
+    // Returns the address of the first slot; slot N follows at N times the
+    // page-rounded frame size. Like allocate_sensor_input this must be
+    // called once, before any images are loaded.
+    pub fn allocate_sensor_ring(&mut self, frame_size: usize, slots: usize) -> usize {
         // Check no images have been loaded.
         assert_eq!(self.sensor_top, TCM_PADDR);
         let ret = self.sensor_top;
-        self.sensor_top += round_up(size, WMMU_PAGE_SIZE);
+        self.sensor_frame_size = round_up(frame_size, WMMU_PAGE_SIZE);
+        self.sensor_slots = slots;
+        self.sensor_slot = 0;
+        self.sensor_top += self.sensor_frame_size * slots;
         self.tcm_top = self.sensor_top;
         ret
     }
 
+    /// Returns the address of the sensor frame the next run reads.
+    pub fn sensor_frame_addr(&self) -> Option<usize> {
+        if self.sensor_slots == 0 {
+            return None;
+        }
+        Some(TCM_PADDR + self.sensor_slot * self.sensor_frame_size)
+    }
+
+    /// Moves to the next sensor frame; called when a run has consumed
+    /// the current one.
+    pub fn next_sensor_frame(&mut self) {
+        if self.sensor_slots > 0 {
+            self.sensor_slot = (self.sensor_slot + 1) % self.sensor_slots;
+        }
+    }
+
     fn tcm_top_size(&self) -> usize { self.tcm_top - TCM_PADDR }
 
     fn tcm_bottom_size(&self) -> usize { TCM_PADDR + TCM_SIZE - self.tcm_bottom }
@@ -161,73 +207,118 @@ impl ImageManager {
             .map_or(0, |m| m)
     }
 
-    // After images have been unloaded via unload_image we'll be left with
-    // discontiguous spaces on the vector core. This function compacts the
-    // images loaded in TCM to be contiguous.
-    fn compact_tcm_top(&mut self) {
-        let mut tcm_addr = self.sensor_top;
-
-        for idx in &self.image_queue {
-            if let Some(image) = self.images[*idx].as_mut() {
-                let size = image.sizes.data_top_size();
+    // Returns the next value of the LRU clock.
+    fn next_use(&mut self) -> u64 {
+        self.use_count += 1;
+        self.use_count
+    }
 
-                // Only move data if the addresses are different.
-                if tcm_addr != image.data_top_addr {
-                    MlCore::tcm_move(image.data_top_addr, tcm_addr, size);
-                    image.data_top_addr = tcm_addr;
-                }
+    // Recalculates tcm_top after an image is added or removed.
+    fn set_tcm_top(&mut self) {
+        self.tcm_top = self
+            .images
+            .iter()
+            .flatten()
+            .map(|image| image.data_top_end())
+            .fold(self.sensor_top, cmp::max);
+    }
 
-                tcm_addr += size;
+    // Returns the address of the smallest hole between sensor_top and
+    // |limit| that holds |size| bytes.
+    fn find_space(&self, size: usize, limit: usize) -> Option<usize> {
+        let mut resident: Vec<(usize, usize)> = self
+            .images
+            .iter()
+            .flatten()
+            .map(|image| (image.data_top_addr, image.data_top_end()))
+            .collect();
+        resident.sort_unstable();
+
+        let mut best: Option<(usize, usize)> = None; // (hole size, hole addr)
+        let mut cursor = self.sensor_top;
+        for (start, end) in resident.into_iter().chain(iter::once((limit, limit))) {
+            let hole = start.saturating_sub(cursor);
+            if hole >= size && best.map_or(true, |(best_size, _)| hole < best_size) {
+                best = Some((hole, cursor));
             }
+            cursor = cmp::max(cursor, end);
         }
-        self.tcm_top = tcm_addr;
+        best.map(|(_, addr)| addr)
     }
 
-    // Removes the latest image loaded and return the size of the freed space.
-    fn unload_latest(&mut self) -> ImageSizes {
-        // We can assume there's an image in the queue and unwrap safely, as
-        // otherwise we wouldn't need to unload images to fit new ones.
-        let idx = self.image_queue.pop().unwrap();
-
+    // Removes the image at |idx| and returns its sizes. The space is
+    // left as a hole for the next image to be loaded.
+    fn unload_at(&mut self, idx: ImageIdx) -> ImageSizes {
         let (bundle, model) = self.ids_at(idx);
         info!("Unloading image {}:{}", bundle, model);
 
-        self.images[idx].take().unwrap().sizes
+        let sizes = self.images[idx].take().unwrap().sizes;
+        self.set_tcm_top();
+        sizes
+    }
+
+    // Returns the index of the least recently used image.
+    fn lru_index(&self) -> Option<ImageIdx> {
+        self.images
+            .iter()
+            .enumerate()
+            .filter_map(|(idx, opt)| opt.as_ref().map(|image| (idx, image.last_used)))
+            .min_by_key(|&(_, last_used)| last_used)
+            .map(|(idx, _)| idx)
     }
 
-    /// Removes images in FILO order until the top TCM and temp TCM
-    /// constraints are satisfied. Returns the address of the freed space.
+    /// Removes images in LRU order until the top TCM and temp TCM
+    /// constraints are satisfied. Returns the address at which to load
+    /// the new image's top sections.
     pub fn make_space(&mut self, top_tcm_needed: usize, temp_tcm_needed: usize) -> usize {
         assert!(top_tcm_needed + temp_tcm_needed <= TCM_SIZE);
-        let mut available_tcm = self.tcm_free_space();
-        let mut space_needed_for_temp =
-            space_needed(self.required_temporary_data(), temp_tcm_needed);
-
-        while available_tcm < top_tcm_needed + space_needed_for_temp {
-            let freed_sizes = self.unload_latest();
-
-            available_tcm += freed_sizes.data_top_size();
-
-            self.tcm_top -= freed_sizes.data_top_size();
+        loop {
+            let temp_size = cmp::max(self.required_temporary_data(), temp_tcm_needed);
+            let limit = TCM_PADDR + TCM_SIZE - temp_size;
+
+            // Images that overlap a grown temporary data section must go
+            // regardless of when they were last used.
+            let overlap = self.images.iter().position(|opt| {
+                opt.as_ref()
+                    .map_or(false, |image| image.data_top_end() > limit)
+            });
+            if let Some(idx) = overlap {
+                self.unload_at(idx);
+                continue;
+            }
 
-            // If we removed an image that had a temporary data size above the
-            // current temp data size, we add that new memory to the pool.
-            let remaining_temp = self.required_temporary_data();
-            if freed_sizes.temporary_data > remaining_temp {
-                available_tcm += freed_sizes.temporary_data - remaining_temp;
+            if let Some(addr) = self.find_space(top_tcm_needed, limit) {
+                return addr;
             }
 
-            // Re-calculate space needed for temporary data given the new size.
-            space_needed_for_temp = space_needed(remaining_temp, temp_tcm_needed);
+            // We can assume there's an image to unload, as otherwise all
+            // of the TCM (less the sensor frames) would be free.
+            let idx = self.lru_index().unwrap();
+            self.unload_at(idx);
         }
+    }
 
-        self.tcm_top
+    /// Returns the address at which an image with the top TCM and temp TCM
+    /// requirements fits without unloading anything or growing the
+    /// temporary data section, or None if it does not fit. This is used to
+    /// load an image while another runs.
+    pub fn find_free_space(&self, top_tcm_needed: usize, temp_tcm_needed: usize) -> Option<usize> {
+        if temp_tcm_needed > self.tcm_bottom_size() {
+            return None;
+        }
+        self.find_space(top_tcm_needed, self.tcm_bottom)
     }
 
     // Sets the size of the temporary section based on the remaining images.
+    // NB: the WMMU is only touched if the size changes so an image can be
+    //   committed while another is running.
     fn set_tcm_bottom(&mut self) {
         let temp_data_size = self.required_temporary_data();
-        self.tcm_bottom = TCM_PADDR + TCM_SIZE - temp_data_size;
+        let tcm_bottom = TCM_PADDR + TCM_SIZE - temp_data_size;
+        if tcm_bottom == self.tcm_bottom {
+            return;
+        }
+        self.tcm_bottom = tcm_bottom;
         MlCore::set_wmmu_window(
             WindowId::TempData,
             self.tcm_bottom,
@@ -262,12 +353,18 @@ impl ImageManager {
 
     /// Appends an (already written) image to internal book-keeping. This class
     /// does not handle the write as it requires seL4 references. The
-    /// MlCoordinator must call this function after the write.
-    pub fn commit_image(&mut self, id: ImageId, sizes: ImageSizes) {
+    /// MlCoordinator must call this function after writing the image at
+    /// |data_top_addr| (as returned by make_space).
+    pub fn commit_image(&mut self, id: ImageId, data_top_addr: usize, sizes: ImageSizes) {
+        let last_used = self.next_use();
+        let static_digest =
+            MlCore::tcm_digest(data_top_addr + sizes.static_data_offset(), sizes.static_data);
         let image = Image {
             id,
             sizes,
-            data_top_addr: self.tcm_top,
+            data_top_addr,
+            last_used,
+            static_digest,
         };
 
         // We expect to always have <32 models due to memory constraints,
@@ -276,11 +373,9 @@ impl ImageManager {
 
         trace!("Adding image: {:x?}", image);
 
-        self.image_queue.push(index);
-        self.tcm_top += image.sizes.data_top_size();
-
         self.images[index] = Some(image);
 
+        self.set_tcm_top();
         self.set_tcm_bottom();
 
         // If these pointers cross the memory is in an inconsistent state.
@@ -291,10 +386,7 @@ impl ImageManager {
     // Unloads image |id| if loaded. Returns true if an image was unloaded.
     pub fn unload_image(&mut self, id: &ImageId) -> bool {
         if let Some(idx) = self.get_image_index(id) {
-            self.image_queue.remove(idx);
-            self.images[idx] = None;
-
-            self.compact_tcm_top();
+            self.unload_at(idx);
             self.set_tcm_bottom();
             return true;
         }
@@ -302,6 +394,29 @@ impl ImageManager {
         false
     }
 
+    /// Marks the loaded image |id| as used (e.g. because it is about to
+    /// run) so it is the last to be evicted.
+    pub fn touch(&mut self, id: &ImageId) {
+        if let Some(idx) = self.get_image_index(id) {
+            let last_used = self.next_use();
+            self.images[idx].as_mut().unwrap().last_used = last_used;
+        }
+    }
+
+    /// Returns true if the static_data section of the loaded image |id|
+    /// still holds what was loaded (so it need not be reloaded before the
+    /// next run).
+    pub fn static_data_unchanged(&self, id: &ImageId) -> bool {
+        match self.get_image_index(id) {
+            Some(idx) => {
+                let image = self.images[idx].as_ref().unwrap();
+                MlCore::tcm_digest(image.static_data_addr(), image.sizes.static_data)
+                    == image.static_digest
+            }
+            None => false,
+        }
+    }
+
     /// Sets the WMMU to match the loaded image |id|. Returns true if that
     /// image exists and the WMMU was set.
     pub fn set_wmmu(&self, id: &ImageId) -> bool {
@@ -341,8 +456,14 @@ impl ImageManager {
                 Permission::READ_WRITE,
             );
 
-            // TODO(jesionowski): Set model_input window when sensor manager
-            // is integrated.
+            if let Some(frame_addr) = self.sensor_frame_addr() {
+                MlCore::set_wmmu_window(
+                    WindowId::ModelInput,
+                    frame_addr,
+                    self.sensor_frame_size,
+                    Permission::READ,
+                );
+            }
 
             // NB: TEMP_DATA_WINDOW is set in set_tcm_bottom.
 
@@ -381,13 +502,11 @@ impl ImageManager {
             info!("  {:x?}", image);
         }
 
-        info!("Image Queue:");
-        for idx in &self.image_queue {
-            let (bundle, model) = self.ids_at(*idx);
-            info!("  {}:{}", bundle, model);
-        }
-
         info!("Sensor Top: 0x{:x}", self.sensor_top);
+        info!(
+            "Sensor Ring: {} x 0x{:x} next {}",
+            self.sensor_slots, self.sensor_frame_size, self.sensor_slot
+        );
         info!("TCM Top: 0x{:x}", self.tcm_top);
         info!("TCM Bottom: 0x{:x}", self.tcm_bottom);
     }
@@ -409,6 +528,24 @@ mod test {
         assert_eq_hex!(image_manager.tcm_top_size(), 0x1000);
     }
 
+    #[test]
+    fn allocate_sensor_ring() {
+        let mut image_manager = ImageManager::new();
+        assert_eq!(image_manager.sensor_frame_addr(), None);
+
+        // Frames are rounded up to a page.
+        assert_eq_hex!(image_manager.allocate_sensor_ring(0x1800, 3), TCM_PADDR);
+        assert_eq_hex!(image_manager.tcm_top_size(), 0x6000);
+
+        assert_eq!(image_manager.sensor_frame_addr(), Some(TCM_PADDR));
+        image_manager.next_sensor_frame();
+        assert_eq!(image_manager.sensor_frame_addr(), Some(TCM_PADDR + 0x2000));
+        image_manager.next_sensor_frame();
+        assert_eq!(image_manager.sensor_frame_addr(), Some(TCM_PADDR + 0x4000));
+        image_manager.next_sensor_frame();
+        assert_eq!(image_manager.sensor_frame_addr(), Some(TCM_PADDR));
+    }
+
     fn constant_image_size(size: usize) -> ImageSizes {
         ImageSizes {
             text: size,
@@ -430,9 +567,10 @@ mod test {
     fn default_id() -> ImageId { make_id(1) }
 
     fn load_image(image_manager: &mut ImageManager, id: ImageId, in_memory_sizes: ImageSizes) {
-        image_manager.make_space(in_memory_sizes.data_top_size(), in_memory_sizes.temporary_data);
+        let addr = image_manager
+            .make_space(in_memory_sizes.data_top_size(), in_memory_sizes.temporary_data);
 
-        image_manager.commit_image(id, in_memory_sizes);
+        image_manager.commit_image(id, addr, in_memory_sizes);
     }
 
     // Load a model and see that is_loaded returns true. Unload and see false.
@@ -513,15 +651,56 @@ mod test {
         assert!(image_manager.is_loaded(&id4));
     }
 
+    // Image with top sections filling a quarter of the TCM.
+    fn quarter_image() -> ImageSizes {
+        ImageSizes {
+            text: TCM_SIZE / 16,
+            model_input: 0,
+            model_output: TCM_SIZE / 16,
+            constant_data: TCM_SIZE / 16,
+            static_data: TCM_SIZE / 16,
+            temporary_data: 0,
+        }
+    }
+
+    // Fill the TCM then load another image; the least recently used image
+    // is evicted, not the most recently loaded.
+    #[test]
+    fn evicts_lru() {
+        let mut image_manager = ImageManager::new();
+
+        let ids: Vec<ImageId> = (1..=5).map(make_id).collect();
+        for id in &ids[..4] {
+            load_image(&mut image_manager, id.clone(), quarter_image());
+        }
+        // Image 1 (the oldest) runs again so image 2 is now the LRU.
+        image_manager.touch(&ids[0]);
+
+        load_image(&mut image_manager, ids[4].clone(), quarter_image());
+
+        assert!(image_manager.is_loaded(&ids[0]));
+        assert!(!image_manager.is_loaded(&ids[1]));
+        assert!(image_manager.is_loaded(&ids[2]));
+        assert!(image_manager.is_loaded(&ids[3]));
+        assert!(image_manager.is_loaded(&ids[4]));
+
+        // The new image re-uses image 2's space.
+        assert_eq_hex!(
+            image_manager.get_top_addr(&ids[4]).unwrap(),
+            TCM_PADDR + quarter_image().data_top_size()
+        );
+    }
+
     // Load three models onto the TCM. Unload the second, and check that the
-    // others have been compacted.
+    // others have not moved and the hole is re-used.
     #[test]
-    fn unloads_compact_tcm() {
+    fn unload_leaves_hole() {
         let mut image_manager = ImageManager::new();
 
         let id1 = make_id(1);
         let id2 = make_id(2);
         let id3 = make_id(3);
+        let id4 = make_id(4);
 
         // Set different temporary data values.
         let sizes1 = ImageSizes {
@@ -555,25 +734,76 @@ mod test {
         load_image(&mut image_manager, id2.clone(), sizes2.clone());
         load_image(&mut image_manager, id3.clone(), sizes3.clone());
 
-        // The third image will be available at images[2]. Before unloading we
-        // validate that it's past the first two models.
-        assert_eq_hex!(
-            image_manager.images[2].as_ref().unwrap().data_top_addr,
-            TCM_PADDR + sizes1.data_top_size() + sizes2.data_top_size()
-        );
+        let id3_addr = TCM_PADDR + sizes1.data_top_size() + sizes2.data_top_size();
+        assert_eq_hex!(image_manager.get_top_addr(&id3).unwrap(), id3_addr);
 
         assert!(image_manager.unload_image(&id2));
 
-        // After compacting it should be past just the first model.
+        // Nothing is moved; the second image's space is left as a hole.
+        assert_eq_hex!(image_manager.get_top_addr(&id3).unwrap(), id3_addr);
+        assert_eq_hex!(
+            image_manager.tcm_top_size(),
+            sizes1.data_top_size() + sizes2.data_top_size() + sizes3.data_top_size()
+        );
+        assert_eq_hex!(image_manager.tcm_bottom_size(), 0x3000);
+
+        // An image that fits in the hole is placed there.
+        load_image(&mut image_manager, id4.clone(), sizes1.clone());
         assert_eq_hex!(
-            image_manager.images[2].as_ref().unwrap().data_top_addr,
+            image_manager.get_top_addr(&id4).unwrap(),
             TCM_PADDR + sizes1.data_top_size()
         );
+        assert!(image_manager.is_loaded(&id1));
+        assert!(image_manager.is_loaded(&id3));
+    }
 
+    // Space for an image is only found without eviction if it fits in a
+    // hole and within the current temporary data section.
+    #[test]
+    fn finds_free_space() {
+        let mut image_manager = ImageManager::new();
+        let sizes1 = constant_image_size(0x1000);
+        load_image(&mut image_manager, make_id(1), sizes1.clone());
+
+        let sizes2 = ImageSizes {
+            temporary_data: 0x800,
+            ..constant_image_size(0x1000)
+        };
         assert_eq_hex!(
-            image_manager.tcm_top_size(),
-            sizes1.data_top_size() + sizes3.data_top_size()
+            image_manager
+                .find_free_space(sizes2.data_top_size(), sizes2.temporary_data)
+                .unwrap(),
+            TCM_PADDR + sizes1.data_top_size()
         );
-        assert_eq_hex!(image_manager.tcm_bottom_size(), 0x3000);
+
+        // A larger temporary data section would move the running image's.
+        assert!(image_manager
+            .find_free_space(sizes2.data_top_size(), 0x2000)
+            .is_none());
+
+        // Nothing fits once the top region is full.
+        assert!(image_manager
+            .find_free_space(TCM_SIZE - sizes1.data_top_size(), 0)
+            .is_none());
+        assert!(image_manager.is_loaded(&make_id(1)));
+    }
+
+    #[test]
+    fn static_data_unchanged() {
+        let mut image_manager = ImageManager::new();
+        load_image(&mut image_manager, default_id(), constant_image_size(0x1000));
+
+        assert!(image_manager.static_data_unchanged(&default_id()));
+        assert!(!image_manager.static_data_unchanged(&make_id(2)));
+
+        // Clearing the temporary data leaves the static data alone.
+        image_manager.clear_temp_data();
+        assert!(image_manager.static_data_unchanged(&default_id()));
+
+        // A write over the static data is noticed.
+        let static_data_addr = image_manager.get_top_addr(&default_id()).unwrap()
+            + constant_image_size(0x1000).static_data_offset();
+        MlCore::clear_tcm(static_data_addr, 0x100);
+        assert!(!image_manager.static_data_unchanged(&default_id()));
     }
 }
@@ -172,6 +172,23 @@ pub fn clear_tcm(addr: usize, byte_length: usize) {
     tcm_slice[start..start + count].fill(0x00);
 }
 
+/// Returns a digest (64-bit FNV-1a over words) of |byte_length| bytes at
+/// |addr|; used to detect whether a section has been written.
+pub fn tcm_digest(addr: usize, byte_length: usize) -> u64 {
+    assert!(addr >= TCM_PADDR);
+    assert!(addr + byte_length <= TCM_PADDR + TCM_SIZE);
+
+    let start = (addr - TCM_PADDR) / size_of::<u32>();
+    let count: usize = byte_length / size_of::<u32>();
+
+    let tcm_slice = get_tcm_slice();
+    tcm_slice[start..start + count]
+        .iter()
+        .fold(0xcbf29ce484222325, |hash, word| {
+            (hash ^ *word as u64).wrapping_mul(0x100000001b3)
+        })
+}
+
 // TODO(jesionowski): Use when TCM_SIZE fits into INIT_END.
 // We'll want to kick off the hardware clear after the execution is complete,
 // holding off the busy-wait until we're ready to start another execution.
@@ -18,8 +18,21 @@
 extern crate alloc;
 
 use alloc::boxed::Box;
+use alloc::vec::Vec;
 use cantrip_io::Read;
 use cantrip_ml_shared::{OutputHeader, Permission, WindowId};
+use spin::Mutex;
+
+// There is no TCM to hash so writes are logged as (addr, byte_length)
+// instead; tcm_digest hashes the writes that overlap its range, which
+// changes whenever that range is written.
+static TCM_WRITES: Mutex<Vec<(usize, usize)>> = Mutex::new(Vec::new());
+
+fn log_write(addr: usize, byte_length: usize) {
+    if byte_length > 0 {
+        TCM_WRITES.lock().push((addr, byte_length));
+    }
+}
 
 pub fn enable_interrupts(_enable: bool) {}
 
@@ -35,14 +48,15 @@ pub fn run() {}
 
 pub fn write_image_part(
     _image: &mut Box<dyn Read>,
-    _start_address: usize,
+    start_address: usize,
     _on_flash_size: usize,
-    _unpacked_size: usize,
+    unpacked_size: usize,
 ) -> Result<(), &'static str> {
+    log_write(start_address, unpacked_size);
     Ok(())
 }
 
-pub fn tcm_move(_src_offset: usize, _dest_offset: usize, _byte_length: usize) {}
+pub fn tcm_move(_src: usize, dest: usize, byte_length: usize) { log_write(dest, byte_length); }
 
 pub fn clear_host_req() {}
 
@@ -52,7 +66,18 @@ pub fn clear_instruction_fault() {}
 
 pub fn clear_data_fault() {}
 
-pub fn clear_tcm(_addr: usize, _len: usize) {}
+pub fn clear_tcm(addr: usize, len: usize) { log_write(addr, len); }
+
+pub fn tcm_digest(addr: usize, len: usize) -> u64 {
+    TCM_WRITES
+        .lock()
+        .iter()
+        .enumerate()
+        .filter(|(_, &(start, length))| start < addr + len && addr < start + length)
+        .fold(0xcbf29ce484222325, |hash, (seq, _)| {
+            (hash ^ seq as u64).wrapping_mul(0x100000001b3)
+        })
+}
 
 pub fn wait_for_clear_to_finish() {}
 
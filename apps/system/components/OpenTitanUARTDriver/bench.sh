@@ -0,0 +1,31 @@
+#!/bin/sh
+
+# Microbenchmarks for the buffers the UART driver depends on, built with the
+# development machine gcc. (On target, build apps/c/uartbench instead.)
+#
+# With a file argument the results are compared against a previous run (saved
+# from this script's output) and the script fails if any benchmark got more
+# than BENCH_TOLERANCE percent (default 10) slower in ticks per op.
+
+BENCH_BINARY=bench_buffers
+BASELINE=$1
+
+cc -O2 -o $BENCH_BINARY -Iinclude src/circular_buffer.c src/spsc_buffer.c \
+  test/buffer_bench.c || exit 1
+./$BENCH_BINARY > $BENCH_BINARY.out
+rm -f ./$BENCH_BINARY
+cat $BENCH_BINARY.out
+
+STATUS=0
+if [ -n "$BASELINE" ]; then
+  awk -v tolerance="${BENCH_TOLERANCE:-10}" '
+    NR == FNR { if (FNR > 1) base[$1] = $2; next }
+    FNR > 1 && ($1 in base) && $2 * 100 > base[$1] * (100 + tolerance) {
+      printf("REGRESSION %s: %d -> %d ticks/kop\n", $1, base[$1], $2)
+      failed = 1
+    }
+    END { exit failed }
+  ' "$BASELINE" $BENCH_BINARY.out || STATUS=1
+fi
+rm -f $BENCH_BINARY.out
+exit $STATUS
@@ -5,7 +5,9 @@
  *
  * (thread-compatible but not thread-safe)
  *
- * It acts as a first-in-first-out queue of characters.
+ * It acts as a first-in-first-out queue of characters. Storage is supplied by
+ * the caller at init, so each instance can have its own capacity; capacities
+ * must be a power of two so that wrapping is a mask rather than a compare.
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -15,24 +17,30 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-#define CIRCULAR_BUFFER_CAPACITY 512
-
-#ifndef WARN_UNUSED_RESELT
+#ifndef WARN_UNUSED_RESULT
 #define WARN_UNUSED_RESULT __attribute__((warn_unused_result))
 #endif
 
 typedef struct {
-  char data[CIRCULAR_BUFFER_CAPACITY + 1];
-  char *begin;
-  char *end;
+  char *data;
+  size_t mask;   // capacity - 1
+  size_t begin;  // free-running index of the next char to pop
+  size_t end;    // free-running index of the next char to push
 } circular_buffer;
 
 // Call this exactly once before first use of a new circular_buffer.
-void circular_buffer_init(circular_buffer *buf);
+//
+// storage must hold capacity chars and outlive the buffer. Returns false if
+// capacity is not a non-zero power of two.
+bool circular_buffer_init(circular_buffer *buf, char *storage,
+                          size_t capacity) WARN_UNUSED_RESULT;
 
 // Empties the buffer, discarding current data.
 void circular_buffer_clear(circular_buffer *buf);
 
+// Returns the total number of chars the buffer can hold.
+size_t circular_buffer_capacity(const circular_buffer *buf) WARN_UNUSED_RESULT;
+
 // Returns whether the buffer is empty.
 bool circular_buffer_empty(const circular_buffer *buf) WARN_UNUSED_RESULT;
 
@@ -54,3 +62,45 @@ bool circular_buffer_pop_front(circular_buffer *buf,
 // If the buffer is already full, returns false and leaves the buffer
 // unmodified.
 bool circular_buffer_push_back(circular_buffer *buf, char c) WARN_UNUSED_RESULT;
+
+// Copies up to n characters from src onto the back of the buffer.
+//
+// The copy is done with at most two memcpy calls. Returns the number of
+// characters actually queued, which is less than n if the buffer fills up.
+size_t circular_buffer_push_many(circular_buffer *buf, const char *src,
+                                 size_t n) WARN_UNUSED_RESULT;
+
+// Removes up to n of the least recently queued characters and copies them
+// into dst.
+//
+// The copy is done with at most two memcpy calls. Returns the number of
+// characters actually removed, which is less than n if the buffer empties.
+size_t circular_buffer_pop_many(circular_buffer *buf, char *dst,
+                                size_t n) WARN_UNUSED_RESULT;
+
+// Sets *region to the oldest queued character and returns the number of
+// characters that can be read from there without wrapping.
+//
+// Returns 0 (and leaves *region unmodified) if the buffer is empty. Consume
+// what was read with circular_buffer_commit_read.
+size_t circular_buffer_peek_readable(const circular_buffer *buf,
+                                     const char **region) WARN_UNUSED_RESULT;
+
+// Removes n characters previously exposed by circular_buffer_peek_readable.
+//
+// n must not exceed the value returned by the last peek.
+void circular_buffer_commit_read(circular_buffer *buf, size_t n);
+
+// Sets *region to the first free slot and returns the number of characters
+// that can be written there without wrapping.
+//
+// Returns 0 (and leaves *region unmodified) if the buffer is full. Publish
+// what was written with circular_buffer_commit_write.
+size_t circular_buffer_peek_writable(circular_buffer *buf,
+                                     char **region) WARN_UNUSED_RESULT;
+
+// Queues n characters previously written into the region exposed by
+// circular_buffer_peek_writable.
+//
+// n must not exceed the value returned by the last peek.
+void circular_buffer_commit_write(circular_buffer *buf, size_t n);
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2021, Google LLC
+ *
+ * A lock-free single-producer/single-consumer circular character buffer for
+ * use in CAmkES components.
+ *
+ * (thread-safe for exactly one producer thread and one consumer thread)
+ *
+ * It acts as a first-in-first-out queue of characters, like circular_buffer,
+ * but the producer (push_*, peek_writable, commit_write) and consumer (pop_*,
+ * peek_readable, commit_read) may run concurrently without a lock. Each side
+ * owns one free-running index and publishes it with release semantics; the
+ * other side reads it with acquire semantics. The capacity must be a power of
+ * two so that indices map to slots with a mask.
+ *
+ * The indices may live outside the buffer (spsc_buffer_attach), which lets the
+ * producer and consumer sit in different components that share the storage
+ * and the indices through dataports.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef WARN_UNUSED_RESULT
+#define WARN_UNUSED_RESULT __attribute__((warn_unused_result))
+#endif
+
+// The free-running indices; this is the state the two sides share.
+typedef struct {
+  atomic_size_t head;  // next slot to read, written only by the consumer
+  atomic_size_t tail;  // next slot to write, written only by the producer
+} spsc_buffer_indices;
+
+typedef struct {
+  char *data;
+  size_t mask;  // capacity - 1
+  spsc_buffer_indices *idx;
+  spsc_buffer_indices local_idx;  // used unless attached to external indices
+} spsc_buffer;
+
+// Call this exactly once before first use of a new spsc_buffer.
+//
+// storage must hold capacity chars and outlive the buffer. Returns false if
+// capacity is not a non-zero power of two.
+bool spsc_buffer_init(spsc_buffer *buf, char *storage,
+                      size_t capacity) WARN_UNUSED_RESULT;
+
+// Like spsc_buffer_init but uses indices stored outside the buffer, e.g. in
+// shared memory, and leaves their current values alone.
+//
+// Zero-filled indices describe an empty buffer, so freshly mapped shared
+// memory needs no further setup.
+bool spsc_buffer_attach(spsc_buffer *buf, char *storage, size_t capacity,
+                        spsc_buffer_indices *indices) WARN_UNUSED_RESULT;
+
+// Empties the buffer, discarding current data.
+//
+// Unlike the other calls this is not safe to run concurrently with either the
+// producer or the consumer.
+void spsc_buffer_clear(spsc_buffer *buf);
+
+// Returns the total number of chars the buffer can hold.
+size_t spsc_buffer_capacity(const spsc_buffer *buf) WARN_UNUSED_RESULT;
+
+// Returns whether the buffer is empty.
+//
+// When called concurrently with the other side this is only a snapshot.
+bool spsc_buffer_empty(const spsc_buffer *buf) WARN_UNUSED_RESULT;
+
+// Returns the number of chars currently in the buffer.
+//
+// When called concurrently with the other side this is only a snapshot.
+size_t spsc_buffer_size(const spsc_buffer *buf) WARN_UNUSED_RESULT;
+
+// Returns the number of chars that can be written to the buffer before it will
+// become full.
+//
+// When called concurrently with the other side this is only a snapshot.
+size_t spsc_buffer_remaining(const spsc_buffer *buf) WARN_UNUSED_RESULT;
+
+// Consumer: removes the character least recently queued and returns it.
+//
+// If the buffer is empty, returns false and leaves *c unmodified.
+bool spsc_buffer_pop_front(spsc_buffer *buf, char *c) WARN_UNUSED_RESULT;
+
+// Producer: adds a character to the buffer.
+//
+// If the buffer is already full, returns false and leaves the buffer
+// unmodified.
+bool spsc_buffer_push_back(spsc_buffer *buf, char c) WARN_UNUSED_RESULT;
+
+// Producer: copies up to n characters from src onto the back of the buffer.
+//
+// Returns the number of characters actually queued.
+size_t spsc_buffer_push_many(spsc_buffer *buf, const char *src,
+                             size_t n) WARN_UNUSED_RESULT;
+
+// Consumer: removes up to n of the least recently queued characters and copies
+// them into dst.
+//
+// Returns the number of characters actually removed.
+size_t spsc_buffer_pop_many(spsc_buffer *buf, char *dst,
+                            size_t n) WARN_UNUSED_RESULT;
+
+// Consumer: sets *region to the oldest queued character and returns the number
+// of characters that can be read from there without wrapping.
+//
+// Returns 0 (and leaves *region unmodified) if the buffer is empty.
+size_t spsc_buffer_peek_readable(spsc_buffer *buf,
+                                 const char **region) WARN_UNUSED_RESULT;
+
+// Consumer: removes n characters previously exposed by
+// spsc_buffer_peek_readable.
+void spsc_buffer_commit_read(spsc_buffer *buf, size_t n);
+
+// Producer: sets *region to the first free slot and returns the number of
+// characters that can be written there without wrapping.
+//
+// Returns 0 (and leaves *region unmodified) if the buffer is full.
+size_t spsc_buffer_peek_writable(spsc_buffer *buf,
+                                 char **region) WARN_UNUSED_RESULT;
+
+// Producer: queues n characters previously written into the region exposed by
+// spsc_buffer_peek_writable.
+void spsc_buffer_commit_write(spsc_buffer *buf, size_t n);
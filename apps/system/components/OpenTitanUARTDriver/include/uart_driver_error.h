@@ -12,8 +12,10 @@
 //
 // Normally these functions return the number of bytes actually read or written,
 // with 0 indicating the end of the stream. If something goes wrong, the
-// functions will return one of these negative values.
+// functions will return one of these negative values. The control interface
+// returns 0 on success and these values otherwise.
 typedef enum UARTDriverError {
   UARTDriver_AssertionFailed = -1,
   UARTDriver_OutOfDataportBounds = -2,
+  UARTDriver_InvalidArgument = -3,
 } uart_driver_error_t;
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2021, Google LLC
+ *
+ * Layout of the ring_header dataport used when the OpenTitanUARTDriver is
+ * built with UART_ZERO_COPY.
+ *
+ * In that mode tx_dataport and rx_dataport are not staging areas for each
+ * read/write RPC but are themselves the storage of two single-producer/
+ * single-consumer rings (see spsc_buffer.h), and this header holds their
+ * indices. The client writes transmit data straight into tx_dataport and reads
+ * received data straight out of rx_dataport; the driver's interrupt handlers
+ * drain and fill those rings directly. The read/write RPCs only serve as
+ * doorbells:
+ *
+ *   write(n)  client published TX data and saw tx_busy clear; the driver
+ *             restarts draining. Returns the number of bytes still queued.
+ *   submit(n) the TX ring is full and the client still has n bytes to write;
+ *             the driver signals the client's write notification once the
+ *             ring drains to its low-water mark.
+ *   flush()   blocks until the TX ring is empty.
+ *   read(n)   n > 0: blocks until the RX ring is not empty and returns the
+ *             number of bytes queued. n == 0: the client consumed from a full
+ *             RX ring and the driver may be waiting for room.
+ *
+ * The Rust client in cantrip-uart-client (feature "zero_copy") mirrors this
+ * layout; keep the two in sync.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+
+#include "spsc_buffer.h"
+
+typedef struct {
+  spsc_buffer_indices tx;  // client produces, driver consumes
+  spsc_buffer_indices rx;  // driver produces, client consumes
+
+  // Non-zero while the driver will keep draining the TX ring without a
+  // doorbell. The client checks it after publishing new data, with a full
+  // fence between the two, and rings the write doorbell when it is clear.
+  atomic_uint tx_busy;
+} uart_ring_header;
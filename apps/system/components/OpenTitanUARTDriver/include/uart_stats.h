@@ -0,0 +1,43 @@
+/*
+ * Copyright 2021, Google LLC
+ *
+ * Performance counters of the OpenTitanUARTDriver, returned by
+ * UARTControlInterface.get_stats.
+ *
+ * The counters are updated without locks from the threads that own them and
+ * are read by the control thread, so a snapshot may be slightly inconsistent;
+ * they are meant for tuning watermarks and buffer sizes, not accounting. Times
+ * are in rdtime ticks (0 on targets without rdtime).
+ *
+ * The Rust client in cantrip-uart-client mirrors this layout; keep the two in
+ * sync.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Per interrupt handler counters.
+typedef struct {
+  uint64_t total_ticks;  // summed over all invocations
+  uint32_t count;        // invocations
+  uint32_t bytes;        // bytes moved between the FIFO and the buffer
+  uint32_t max_ticks;    // longest invocation
+} uart_isr_stats_t;
+
+typedef struct {
+  uart_isr_stats_t tx_watermark;
+  uart_isr_stats_t tx_empty;
+  uart_isr_stats_t rx_watermark;
+  uart_isr_stats_t rx_timeout;
+  // Times the RX handlers blocked on rx_empty_semaphore because rx_buf was
+  // full (the RX FIFO may then overflow).
+  uint32_t rx_stalls;
+  // write/submit calls that could not queue every available byte.
+  uint32_t short_writes;
+  // Highest observed fill levels of tx_buf and rx_buf.
+  uint32_t tx_buf_high_water;
+  uint32_t rx_buf_high_water;
+} uart_driver_stats_t;
@@ -7,22 +7,38 @@
  */
 #include "circular_buffer.h"
 
-// Advances one of the begin/end pointers, wrapping around the end of the
-// data array when necessary.
-static void *circular_buffer_advance(circular_buffer *buf, char **p) {
-  *p += 1;
-  if (*p > buf->data + CIRCULAR_BUFFER_CAPACITY) {
-    *p = buf->data;
-  }
+#include <string.h>
+
+// Maps a free-running begin/end index to its slot in the data array.
+static char *circular_buffer_slot(const circular_buffer *buf, size_t index) {
+  return buf->data + (index & buf->mask);
+}
+
+// Returns the number of chars from the slot for index to the end of the data
+// array.
+static size_t circular_buffer_until_wrap(const circular_buffer *buf,
+                                         size_t index) {
+  return circular_buffer_capacity(buf) - (index & buf->mask);
 }
 
-void circular_buffer_init(circular_buffer *buf) {
+bool circular_buffer_init(circular_buffer *buf, char *storage,
+                          size_t capacity) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    return false;
+  }
+  buf->data = storage;
+  buf->mask = capacity - 1;
   circular_buffer_clear(buf);
+  return true;
 }
 
 void circular_buffer_clear(circular_buffer *buf) {
-  buf->begin = buf->data;
-  buf->end = buf->data;
+  buf->begin = 0;
+  buf->end = 0;
+}
+
+size_t circular_buffer_capacity(const circular_buffer *buf) {
+  return buf->mask + 1;
 }
 
 bool circular_buffer_empty(const circular_buffer *buf) {
@@ -30,34 +46,98 @@ bool circular_buffer_empty(const circular_buffer *buf) {
 }
 
 size_t circular_buffer_size(const circular_buffer *buf) {
-  if (buf->end >= buf->begin) {
-    // empty when end == begin
-    return buf->end - buf->begin;
-  } else {
-    // full when begin == (end + 1)
-    // cannot be empty in this branch
-    return CIRCULAR_BUFFER_CAPACITY - (buf->begin - buf->end - 1);
-  }
+  // Indices are free-running, so unsigned wraparound yields the distance.
+  return buf->end - buf->begin;
 }
 
 size_t circular_buffer_remaining(const circular_buffer *buf) {
-  return CIRCULAR_BUFFER_CAPACITY - circular_buffer_size(buf);
+  return circular_buffer_capacity(buf) - circular_buffer_size(buf);
 }
 
 bool circular_buffer_pop_front(circular_buffer *buf, char *c) {
-  if(circular_buffer_empty(buf)) {
+  if (circular_buffer_empty(buf)) {
     return false;
   }
-  *c = *buf->begin;
-  circular_buffer_advance(buf, &buf->begin);
+  *c = *circular_buffer_slot(buf, buf->begin);
+  buf->begin += 1;
   return true;
 }
 
 bool circular_buffer_push_back(circular_buffer *buf, char c) {
-  if(circular_buffer_remaining(buf) == 0) {
+  if (circular_buffer_remaining(buf) == 0) {
     return false;
   }
-  *buf->end = c;
-  circular_buffer_advance(buf, &buf->end);
+  *circular_buffer_slot(buf, buf->end) = c;
+  buf->end += 1;
   return true;
 }
+
+size_t circular_buffer_push_many(circular_buffer *buf, const char *src,
+                                 size_t n) {
+  size_t pushed = 0;
+  // At most two passes: up to the end of the data array, then from its start.
+  while (pushed < n) {
+    char *region;
+    size_t len = circular_buffer_peek_writable(buf, &region);
+    if (len == 0) {
+      // The buffer is full.
+      break;
+    }
+    if (len > n - pushed) {
+      len = n - pushed;
+    }
+    memcpy(region, src + pushed, len);
+    circular_buffer_commit_write(buf, len);
+    pushed += len;
+  }
+  return pushed;
+}
+
+size_t circular_buffer_pop_many(circular_buffer *buf, char *dst, size_t n) {
+  size_t popped = 0;
+  // At most two passes: up to the end of the data array, then from its start.
+  while (popped < n) {
+    const char *region;
+    size_t len = circular_buffer_peek_readable(buf, &region);
+    if (len == 0) {
+      // The buffer is empty.
+      break;
+    }
+    if (len > n - popped) {
+      len = n - popped;
+    }
+    memcpy(dst + popped, region, len);
+    circular_buffer_commit_read(buf, len);
+    popped += len;
+  }
+  return popped;
+}
+
+size_t circular_buffer_peek_readable(const circular_buffer *buf,
+                                     const char **region) {
+  size_t len = circular_buffer_size(buf);
+  if (len == 0) {
+    return 0;
+  }
+  size_t contiguous = circular_buffer_until_wrap(buf, buf->begin);
+  *region = circular_buffer_slot(buf, buf->begin);
+  return len < contiguous ? len : contiguous;
+}
+
+void circular_buffer_commit_read(circular_buffer *buf, size_t n) {
+  buf->begin += n;
+}
+
+size_t circular_buffer_peek_writable(circular_buffer *buf, char **region) {
+  size_t len = circular_buffer_remaining(buf);
+  if (len == 0) {
+    return 0;
+  }
+  size_t contiguous = circular_buffer_until_wrap(buf, buf->end);
+  *region = circular_buffer_slot(buf, buf->end);
+  return len < contiguous ? len : contiguous;
+}
+
+void circular_buffer_commit_write(circular_buffer *buf, size_t n) {
+  buf->end += n;
+}
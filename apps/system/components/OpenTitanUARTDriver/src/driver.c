@@ -10,13 +10,17 @@
 #include <assert.h>
 #include <camkes.h>
 #include <sel4/syscalls.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <utils/arith.h>
 
-#include "circular_buffer.h"
 #include "opentitan/uart.h"
+#include "spsc_buffer.h"
 #include "uart_driver_error.h"
+#include "uart_ring.h"
+#include "uart_stats.h"
 
 // NB: CANTRIP_ASSERTs preserve expr when not checking
 #ifdef CONFIG_DEBUG_BUILD
@@ -34,13 +38,39 @@
 // This is the default in CAmkES 2 and the configurable default in CAmkES 3.
 #define TX_RX_DATAPORT_CAPACITY PAGE_SIZE
 
-// Frequency of the primary clock clk_i.
+// Capacities of the driver-owned rx_buf and tx_buf. Both must be powers of
+// two. The build normally sets these from the OpenTitanUARTRxBufferSize and
+// OpenTitanUARTTxBufferSize CMake cache variables.
 //
-// TODO(mattharvey): OpenTitan actually specifies 24Mhz, but using that results
-// in Renode reporting double the expected BaudRate.
+// Matching the dataport size lets a single read_read/write_write move a full
+// dataport's worth of data.
 //
-// https://docs.opentitan.org/hw/ip/clkmgr/doc/
-#define CLK_FIXED_FREQ_HZ (48ull * 1000 * 1000)
+// With UART_ZERO_COPY the rings are the dataports themselves (see uart_ring.h)
+// and these are ignored.
+#ifndef UART_RX_BUFFER_CAPACITY
+#define UART_RX_BUFFER_CAPACITY TX_RX_DATAPORT_CAPACITY
+#endif
+#ifndef UART_TX_BUFFER_CAPACITY
+#define UART_TX_BUFFER_CAPACITY TX_RX_DATAPORT_CAPACITY
+#endif
+
+// Default receive interrupt coalescing, normally set from the
+// OpenTitanUARTRxWatermark and OpenTitanUARTRxTimeout CMake cache variables and
+// changed at runtime with control_set_rx_mode.
+//
+// UART_RX_WATERMARK is the RX FIFO level that raises rx_watermark and
+// UART_RX_TIMEOUT the number of idle bit times after which rx_timeout delivers
+// whatever is left below that level (0 disables it). A watermark of 1 makes
+// calls that block on a single byte at a time, like the one the shell does when
+// reading a line of input, return as soon as that byte is received. Higher
+// watermarks take far fewer interrupts for bulk transfers but need the
+// timeout; Renode does not yet support rx_timeout, hence the defaults.
+#ifndef UART_RX_WATERMARK
+#define UART_RX_WATERMARK 1
+#endif
+#ifndef UART_RX_TIMEOUT
+#define UART_RX_TIMEOUT 0
+#endif
 
 // Read/write access to a 32-bit register of UART0, using substrings of the
 // #define names in opentitan/uart.h. (The literal 0 is the value of ##id##
@@ -56,20 +86,113 @@
   ((value & UART_##regname##_##subfield##_MASK)     \
    << UART_##regname##_##subfield##_OFFSET)
 
-#define LOCK(lockname) CANTRIP_ASSERT(lockname##_lock() == 0)
-#define UNLOCK(lockname) CANTRIP_ASSERT(lockname##_unlock() == 0)
 #define ASSERT_OR_RETURN(x)            \
   if (!(bool)(x)) {                    \
     return UARTDriver_AssertionFailed; \
   }
 
-// Driver-owned buffer to receive more than the FIFO size before the received
-// data is consumed by rx_update.
-static circular_buffer rx_buf;  // guarded by rx_mutex
+// Buffer to receive more than the FIFO size before the received data is
+// consumed by read_read (or, with UART_ZERO_COPY, by the client directly).
+//
+// drain_rx_fifo is the only producer but runs on both RX interrupt threads;
+// rx_drain_requests makes one of them the producer at a time without a lock
+// (see claim_pass). The single consumer takes no part in that.
+static spsc_buffer rx_buf;
+static atomic_uint rx_drain_requests;
+
+// Buffer to buffer more transmitted bytes than can fit in the transmit FIFO.
+//
+// write_write (or, with UART_ZERO_COPY, the client, which serializes its
+// writing threads) is the only producer.
+// fill_tx_fifo is the consumer but runs on the write thread and both TX
+// interrupt threads; tx_fill_requests makes one of them the consumer at a
+// time without a lock (see claim_pass). The producer takes no part in that.
+static spsc_buffer tx_buf;
+static atomic_uint tx_fill_requests;
+
+// Asynchronous TX state (see write_submit).
+//
+// tx_low_water is the tx_buf level at or below which a submitter that ran out
+// of room is signalled on its write notification. tx_notify_armed is set by
+// write_submit and consumed by whichever TX path signals. There is a single
+// waiter so a client with several writing threads must serialize them
+// between submit and the wait (cantrip-uart-client does).
+static size_t tx_low_water;
+static seL4_Word tx_notify_badge;
+static atomic_bool tx_notify_armed;
+
+// Set while write_flush waits on tx_drained_semaphore.
+static atomic_bool tx_flush_waiting;
+
+// Performance counters; see uart_stats.h.
+static uart_driver_stats_t stats;
+
+#ifdef UART_ZERO_COPY
+#define RING_HEADER ((uart_ring_header *)ring_header)
+
+// Marks whether the TX interrupts will keep draining tx_buf; see
+// uart_ring.h. When clearing, the fence orders the store before the caller's
+// following check of tx_buf, pairing with the client's fence between
+// publishing data and checking tx_busy, so that one side always notices the
+// other.
+static void set_tx_busy(bool busy) {
+  atomic_store_explicit(&RING_HEADER->tx_busy, busy, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+}
+#else
+static char rx_storage[UART_RX_BUFFER_CAPACITY];
+static char tx_storage[UART_TX_BUFFER_CAPACITY];
+#endif
 
-// Driver-owned buffer to buffer more transmitted bytes than can fit in the
-// transmit FIFO.
-static circular_buffer tx_buf;  // guarded by tx_mutex
+// Reads the low word of the RISC-V time CSR for timing interrupt handlers;
+// handlers are short enough that the difference of two reads never wraps.
+static uint32_t rdtime(void) {
+#ifdef __riscv
+  unsigned long t;
+  asm volatile("rdtime %0" : "=r"(t));
+  return t;
+#else
+  return 0;
+#endif
+}
+
+// Accounts one interrupt handler invocation that began at |start| and moved
+// |bytes| through the FIFO.
+static void isr_done(uart_isr_stats_t *isr, uint32_t start, size_t bytes) {
+  uint32_t ticks = rdtime() - start;
+  isr->count++;
+  isr->bytes += bytes;
+  isr->total_ticks += ticks;
+  if (ticks > isr->max_ticks) {
+    isr->max_ticks = ticks;
+  }
+}
+
+// Records |level| in a buffer high-water mark.
+static void note_high_water(uint32_t *high_water, size_t level) {
+  if (level > *high_water) {
+    *high_water = level;
+  }
+}
+
+// Serializes the threads that share one side of an spsc_buffer without a
+// lock. Each caller counts itself in |*requests|; the one that finds it zero
+// claims the side and makes passes until next_pass reports that nobody
+// arrived meanwhile, and the others return at once, leaving their pass to it.
+// Nobody waits on another thread, so a claimant may block (drain_rx_fifo does
+// when rx_buf is full) without stalling the other interrupt threads. The
+// seq_cst read-modify-writes hand the side's own index from one claimant to
+// the next.
+static bool claim_pass(atomic_uint *requests) {
+  return atomic_fetch_add(requests, 1) == 0;
+}
+
+// Retires the |*passes| requests the claimant has served; returns true (with
+// the count of newer requests in |*passes|) if it must go round again.
+static bool next_pass(atomic_uint *requests, unsigned *passes) {
+  *passes = atomic_fetch_sub(requests, *passes) - *passes;
+  return *passes != 0;
+}
 
 // Gets the number of unsent bytes in the TX FIFO from hardware MMIO.
 static uint32_t tx_fifo_level() {
@@ -102,79 +225,192 @@ static void uart_putchar(char c) {
   REG(WDATA) = MASK_AND_SHIFT_UP(c, WDATA, WDATA);
 }
 
+// Maps an RX watermark in bytes to its FIFO_CTRL.RXILVL encoding. Returns -1
+// for levels the hardware does not support.
+static int rx_watermark_to_rxilvl(uint32_t watermark) {
+  switch (watermark) {
+    case 1:
+      return UART_FIFO_CTRL_RXILVL_VALUE_RXLVL1;
+    case 4:
+      return UART_FIFO_CTRL_RXILVL_VALUE_RXLVL4;
+    case 8:
+      return UART_FIFO_CTRL_RXILVL_VALUE_RXLVL8;
+    case 16:
+      return UART_FIFO_CTRL_RXILVL_VALUE_RXLVL16;
+    case 30:
+      return UART_FIFO_CTRL_RXILVL_VALUE_RXLVL30;
+    default:
+      return -1;
+  }
+}
+
+// Programs the RX watermark and timeout; see UART_RX_WATERMARK.
+//
+// Note that the watermark is only a threshold for when to be informed that
+// bytes have been received. The FIFO can still fill to its full capacity (32)
+// independent of how this is set.
+static int set_rx_mode(uint32_t watermark, uint32_t timeout) {
+  int rxilvl = rx_watermark_to_rxilvl(watermark);
+  if (rxilvl < 0 || timeout > UART_TIMEOUT_CTRL_VAL_MASK ||
+      (watermark > 1 && timeout == 0)) {
+    return UARTDriver_InvalidArgument;
+  }
+
+  // Disables the timeout while the watermark changes.
+  uint32_t intr_enable = REG(INTR_ENABLE);
+  REG(INTR_ENABLE) = intr_enable & ~BIT(UART_INTR_COMMON_RX_TIMEOUT_BIT);
+  REG(TIMEOUT_CTRL) = 0;
+
+  // NB: the RXRST/TXRST bits read back as zero so this does not reset the
+  // FIFOs.
+  uint32_t fifo_ctrl = REG(FIFO_CTRL);
+  fifo_ctrl &= ~(UART_FIFO_CTRL_RXILVL_MASK << UART_FIFO_CTRL_RXILVL_OFFSET);
+  REG(FIFO_CTRL) = fifo_ctrl | MASK_AND_SHIFT_UP(rxilvl, FIFO_CTRL, RXILVL);
+
+  if (timeout > 0) {
+    REG(TIMEOUT_CTRL) = MASK_AND_SHIFT_UP(timeout, TIMEOUT_CTRL, VAL) |
+                        BIT(UART_TIMEOUT_CTRL_EN_BIT);
+    intr_enable |= BIT(UART_INTR_COMMON_RX_TIMEOUT_BIT);
+  } else {
+    intr_enable &= ~BIT(UART_INTR_COMMON_RX_TIMEOUT_BIT);
+  }
+  REG(INTR_ENABLE) = intr_enable;
+
+  // Bytes already waiting below a lowered watermark raise no new interrupt,
+  // so fakes one to have rx_watermark_handle deliver them.
+  if (!rx_empty()) {
+    REG(INTR_TEST) = BIT(UART_INTR_TEST_RX_WATERMARK_BIT);
+  }
+  return 0;
+}
+
+// Computes the NCO value for a baud rate given the frequency of the primary
+// clock clk_i (the clock_frequency attribute). Returns 0 if the rate is not
+// representable.
+static uint32_t baud_to_nco(uint32_t baud) {
+  // nco = 2^20 * baud / fclk  (assuming NCO width is 16-bit)
+  compile_time_assert(NCO, UART_CTRL_NCO_MASK == 0xffff);
+  uint64_t ctrl_nco = ((uint64_t)baud << 20) / (uint32_t)clock_frequency;
+  return ctrl_nco <= UART_CTRL_NCO_MASK ? ctrl_nco : 0;
+}
+
+// Sets the baud rate and enables TX and RX.
+static void set_ctrl(uint32_t ctrl_nco) {
+  REG(CTRL) = MASK_AND_SHIFT_UP(ctrl_nco, CTRL, NCO) | BIT(UART_CTRL_TX_BIT) |
+              BIT(UART_CTRL_RX_BIT);
+}
+
 // Copies from tx_buf into the transmit FIFO.
 //
 // This stops when the transmit FIFO is full or when tx_buf is empty, whichever
 // comes first.
-static void fill_tx_fifo() {
-  LOCK(tx_mutex);
-  while (tx_fifo_level() < UART_FIFO_CAPACITY) {
-    char c;
-    if (!circular_buffer_pop_front(&tx_buf, &c)) {
-      // The buffer is empty.
-      break;
+//
+// The FIFO level is read only once since MMIO reads are far more expensive
+// than writes; the FIFO only drains meanwhile, so the free slots computed up
+// front never overfill it. The bytes are written straight out of tx_buf's
+// contiguous spans (at most two because of wrap-around). Returns the number of
+// bytes copied, 0 if another thread was already filling (it makes this
+// caller's pass too).
+static size_t fill_tx_fifo() {
+  if (!claim_pass(&tx_fill_requests)) {
+    return 0;
+  }
+  size_t num_filled = 0;
+  unsigned passes = 1;
+  do {
+    size_t free_slots = UART_FIFO_CAPACITY - tx_fifo_level();
+    while (free_slots > 0) {
+      const char *data;
+      size_t n = MIN(spsc_buffer_peek_readable(&tx_buf, &data), free_slots);
+      if (n == 0) {
+        // The buffer is empty.
+        break;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        uart_putchar(data[i]);
+      }
+      spsc_buffer_commit_read(&tx_buf, n);
+      free_slots -= n;
+      num_filled += n;
     }
-    uart_putchar(c);
+  } while (next_pass(&tx_fill_requests, &passes));
+  return num_filled;
+}
+
+// Signals the client armed by write_submit once tx_buf has drained to the
+// low-water mark.
+static void notify_tx_ready() {
+  if (spsc_buffer_size(&tx_buf) <= tx_low_water &&
+      atomic_exchange(&tx_notify_armed, false)) {
+    write_emit(tx_notify_badge);
+  }
+}
+
+// Wakes write_flush once tx_buf is empty.
+static void notify_tx_drained() {
+  if (spsc_buffer_empty(&tx_buf) && atomic_exchange(&tx_flush_waiting, false)) {
+    CANTRIP_ASSERT(tx_drained_semaphore_post() == 0);
   }
-  UNLOCK(tx_mutex);
 }
 
 // CAmkES initialization hook.
 //
 // Performs initial programming of the OpenTitan UART at mmio_region.
 //
-// In short, sets 115200bps, TX and RX on, and TX watermark to 1.
+// In short, sets the baud_rate attribute (115200bps by default), TX and RX on,
+// TX watermark to 16 and the build-time RX watermark and timeout.
 void pre_init() {
+#ifdef UART_ZERO_COPY
+  // Attaches the rings to the shared dataports. Their indices start out
+  // zero-filled (empty) and the client may already have queued output, so
+  // they are not cleared here.
+  compile_time_assert(RING_HEADER_FITS,
+                      sizeof(uart_ring_header) <= TX_RX_DATAPORT_CAPACITY);
+  bool tx_ok = spsc_buffer_attach(&tx_buf, (char *)tx_dataport,
+                                  TX_RX_DATAPORT_CAPACITY, &RING_HEADER->tx);
+  bool rx_ok = spsc_buffer_attach(&rx_buf, (char *)rx_dataport,
+                                  TX_RX_DATAPORT_CAPACITY, &RING_HEADER->rx);
+#else
   // Clears the driver-owned buffers.
-  circular_buffer_init(&tx_buf);
-  circular_buffer_init(&rx_buf);
-
-  // Computes NCO value corresponding to baud rate.
-  // nco = 2^20 * baud / fclk  (assuming NCO width is 16-bit)
-  compile_time_assert(NCO, UART_CTRL_NCO_MASK == 0xffff);
-  uint64_t baud = 115200ull;
-  uint64_t ctrl_nco = ((uint64_t)baud << 20) / CLK_FIXED_FREQ_HZ;
-  assert(ctrl_nco < 0xffff);
+  compile_time_assert(
+      RX_BUFFER_POW2,
+      (UART_RX_BUFFER_CAPACITY & (UART_RX_BUFFER_CAPACITY - 1)) == 0);
+  compile_time_assert(
+      TX_BUFFER_POW2,
+      (UART_TX_BUFFER_CAPACITY & (UART_TX_BUFFER_CAPACITY - 1)) == 0);
+  bool tx_ok = spsc_buffer_init(&tx_buf, tx_storage, sizeof(tx_storage));
+  bool rx_ok = spsc_buffer_init(&rx_buf, rx_storage, sizeof(rx_storage));
+#endif
+  // NB: the results are checked outside CANTRIP_ASSERT so the calls'
+  //   WARN_UNUSED_RESULT is satisfied in non-debug builds too.
+  CANTRIP_ASSERT(tx_ok && rx_ok);
+  tx_low_water = spsc_buffer_capacity(&tx_buf) / 4;
 
-  // Sets baud rate and enables TX and RX.
-  REG(CTRL) = MASK_AND_SHIFT_UP(ctrl_nco, CTRL, NCO) | BIT(UART_CTRL_TX_BIT) |
-              BIT(UART_CTRL_RX_BIT);
+  // Sets the baud_rate attribute and enables TX and RX.
+  uint32_t ctrl_nco = baud_to_nco(baud_rate);
+  assert(ctrl_nco != 0);
+  set_ctrl(ctrl_nco);
 
   // Resets TX and RX FIFOs.
   uint32_t fifo_ctrl = REG(FIFO_CTRL);
   REG(FIFO_CTRL) =
       fifo_ctrl | BIT(UART_FIFO_CTRL_RXRST_BIT) | BIT(UART_FIFO_CTRL_TXRST_BIT);
 
-  // Sets FIFO watermarks.
+  // Sets the TX watermark to 16 (half full).
   fifo_ctrl = REG(FIFO_CTRL);
-  // Clears old values of both watermarks.
   fifo_ctrl = fifo_ctrl &
-              (~(UART_FIFO_CTRL_RXILVL_MASK << UART_FIFO_CTRL_RXILVL_OFFSET)) &
               (~(UART_FIFO_CTRL_TXILVL_MASK << UART_FIFO_CTRL_TXILVL_OFFSET));
-  // RX watermark to 1.
-  //
-  // This enables calls that block on a single byte at a time, like the one the
-  // shell does when reading a line of input, to return immediately when that
-  // byte is received.
-  //
-  // Note that this high watermark is only a threshold for when to be informed
-  // that bytes have been received. The FIFO can still fill to its full capacity
-  // (32) independent of how this is set.
-  //
-  // Although a higher watermark in combination with rx_timeout might be
-  // preferable, Renode simulation does not yet support the rx_timeout
-  // interrupt.
-  fifo_ctrl = fifo_ctrl | MASK_AND_SHIFT_UP(UART_FIFO_CTRL_RXILVL_VALUE_RXLVL1,
-                                            FIFO_CTRL, RXILVL);
-  // TX watermark to 16 (half full).
   fifo_ctrl = fifo_ctrl | MASK_AND_SHIFT_UP(UART_FIFO_CTRL_TXILVL_VALUE_TXLVL16,
                                             FIFO_CTRL, TXILVL);
   REG(FIFO_CTRL) = fifo_ctrl;
 
-  // Enables interrupts.
+  // Enables interrupts. set_rx_mode adds rx_timeout when configured.
   REG(INTR_ENABLE) =
       (BIT(UART_INTR_COMMON_TX_WATERMARK_BIT) | BIT(UART_INTR_COMMON_RX_WATERMARK_BIT) |
        BIT(UART_INTR_COMMON_TX_EMPTY_BIT));
+
+  // Sets the RX watermark and timeout.
+  CANTRIP_ASSERT(set_rx_mode(UART_RX_WATERMARK, UART_RX_TIMEOUT) == 0);
 }
 
 // Implements Rust Read::read().
@@ -185,29 +421,29 @@ int read_read(size_t limit) {
   if (limit > TX_RX_DATAPORT_CAPACITY) {
     return UARTDriver_OutOfDataportBounds;
   }
-  char *cursor = (char *)rx_dataport;
-  char *const cursor_begin = cursor;
-  char *const cursor_limit = cursor_begin + limit;
-
-  LOCK(rx_mutex);
-  while (circular_buffer_empty(&rx_buf)) {
-    UNLOCK(rx_mutex);
+#ifdef UART_ZERO_COPY
+  // Doorbell only: the client reads rx_dataport in place (see uart_ring.h).
+  if (limit == 0) {
+    // The client made room in a full ring; unblocks rx_watermark_handle.
+    CANTRIP_ASSERT(rx_empty_semaphore_post() == 0);
+    return 0;
+  }
+  while (spsc_buffer_empty(&rx_buf)) {
     CANTRIP_ASSERT(rx_nonempty_semaphore_wait() == 0);
-    LOCK(rx_mutex);
   }
-  while (cursor < cursor_limit) {
-    if (!circular_buffer_pop_front(&rx_buf, cursor)) {
-      // The buffer is empty.
-      CANTRIP_ASSERT(rx_empty_semaphore_post() == 0);
-      break;
-    }
-    ++cursor;
+  return spsc_buffer_size(&rx_buf);
+#else
+  while (spsc_buffer_empty(&rx_buf)) {
+    CANTRIP_ASSERT(rx_nonempty_semaphore_wait() == 0);
+  }
+  int num_read = spsc_buffer_pop_many(&rx_buf, (char *)rx_dataport, limit);
+  if (spsc_buffer_empty(&rx_buf)) {
+    CANTRIP_ASSERT(rx_empty_semaphore_post() == 0);
   }
-  UNLOCK(rx_mutex);
 
-  int num_read = cursor - cursor_begin;
   ASSERT_OR_RETURN(num_read > 0);
   return num_read;
+#endif
 }
 
 // Implements Rust Write::write().
@@ -219,41 +455,80 @@ int write_write(size_t available) {
   if (available > TX_RX_DATAPORT_CAPACITY) {
     return UARTDriver_OutOfDataportBounds;
   }
-  const char *cursor = (const char *)tx_dataport;
-  const char *const cursor_begin = cursor;
-  const char *const cursor_limit = cursor_begin + available;
-
-  while (cursor < cursor_limit) {
-    LOCK(tx_mutex);
-    if (circular_buffer_remaining(&tx_buf) == 0) {
-      UNLOCK(tx_mutex);
-      break;
-    }
-    for (; cursor < cursor_limit; ++cursor) {
-      if (!circular_buffer_push_back(&tx_buf, *cursor)) {
-        // The buffer is full.
-        break;
-      }
-    }
-    UNLOCK(tx_mutex);
+#ifdef UART_ZERO_COPY
+  // Doorbell only: the client already queued the data in tx_dataport (see
+  // uart_ring.h). The TX interrupts keep draining until tx_buf empties.
+  note_high_water(&stats.tx_buf_high_water, spsc_buffer_size(&tx_buf));
+  set_tx_busy(true);
+  fill_tx_fifo();
+  return spsc_buffer_size(&tx_buf);
+#else
+  int num_written =
+      spsc_buffer_push_many(&tx_buf, (const char *)tx_dataport, available);
+  note_high_water(&stats.tx_buf_high_water, spsc_buffer_size(&tx_buf));
+  if ((size_t)num_written < available) {
+    stats.short_writes++;
   }
 
   fill_tx_fifo();
 
-  int num_written = cursor - cursor_begin;
   ASSERT_OR_RETURN(num_written > 0);
   return num_written;
+#endif
+}
+
+// Queues data for transmission without blocking.
+//
+// Copies as many of the available bytes from tx_dataport into tx_buf as fit
+// (with UART_ZERO_COPY the data is already in the ring and nothing is copied)
+// and starts transmission. Returns the number of bytes queued by this call,
+// which may be 0, or a negative value if there is any error.
+//
+// If not everything fit (with UART_ZERO_COPY: if available is non-zero, i.e.
+// the client still has data waiting for room), the caller's write notification
+// is signalled once tx_buf drains to a quarter full. Callers must tolerate
+// spurious signals.
+int write_submit(size_t available) {
+  if (available > TX_RX_DATAPORT_CAPACITY) {
+    return UARTDriver_OutOfDataportBounds;
+  }
+#ifdef UART_ZERO_COPY
+  int num_queued = 0;
+  bool want_room = available > 0;
+  set_tx_busy(true);
+#else
+  int num_queued =
+      spsc_buffer_push_many(&tx_buf, (const char *)tx_dataport, available);
+  bool want_room = (size_t)num_queued < available;
+#endif
+  note_high_water(&stats.tx_buf_high_water, spsc_buffer_size(&tx_buf));
+  if (want_room) {
+    stats.short_writes++;
+    // Arms before filling so the TX interrupts cannot miss the crossing.
+    tx_notify_badge = write_get_sender_id();
+    atomic_store(&tx_notify_armed, true);
+  }
+  fill_tx_fifo();
+  if (want_room) {
+    notify_tx_ready();
+  }
+  return num_queued;
 }
 
 // Implements Rust Write::flush().
 //
-// Drains tx_buf and TX_FIFO. Returns a negative value if there is any error.
+// Blocks until tx_buf has been drained into the TX FIFO. Returns a negative
+// value if there is any error.
 int write_flush() {
-  LOCK(tx_mutex);
-  while (circular_buffer_remaining(&tx_buf)) {
+  while (!spsc_buffer_empty(&tx_buf)) {
+    atomic_store(&tx_flush_waiting, true);
     fill_tx_fifo();
+    if (spsc_buffer_empty(&tx_buf)) {
+      break;
+    }
+    // tx_empty_handle posts once the rest has gone out.
+    CANTRIP_ASSERT(tx_drained_semaphore_wait() == 0);
   }
-  UNLOCK(tx_mutex);
   return 0;
 }
 
@@ -261,9 +536,11 @@ int write_flush() {
 //
 // These happen when the transmit FIFO is half-empty. This refills the FIFO to
 // prevent stalling, stopping early if tx_buf becomes empty, and then signals
-// any tx_update that might be waiting for tx_buf to not be full.
+// any write_submit caller waiting for room in tx_buf.
 void tx_watermark_handle(void) {
-  fill_tx_fifo();
+  uint32_t start = rdtime();
+  size_t num_filled = fill_tx_fifo();
+  notify_tx_ready();
 
   // Clears INTR_STATE for tx_watermark. (INTR_STATE is write-1-to-clear.) No
   // similar check to the one in tx_empty_handle is necessary here, since
@@ -271,61 +548,163 @@ void tx_watermark_handle(void) {
   // flushed out.
   REG(INTR_STATE) = BIT(UART_INTR_STATE_TX_WATERMARK_BIT);
 
+  isr_done(&stats.tx_watermark, start, num_filled);
   CANTRIP_ASSERT(tx_watermark_acknowledge() == 0);
 }
 
-// Handles an rx_watermark interrupt.
+// Implements UARTControlInterface::set_rx_mode.
+//
+// Switches the receive interrupt coalescing, e.g. to a high watermark for a
+// bulk upload and back to the interactive default afterwards.
+int control_set_rx_mode(uint32_t watermark, uint32_t timeout) {
+  if (watermark == 0) {
+    return set_rx_mode(UART_RX_WATERMARK, UART_RX_TIMEOUT);
+  }
+  return set_rx_mode(watermark, timeout);
+}
+
+// Implements UARTControlInterface::set_baud.
 //
+// Drains everything queued for transmission at the old rate, then switches to
+// the new one (0 restores the baud_rate attribute).
+int control_set_baud(uint32_t baud) {
+  if (baud == 0) {
+    baud = baud_rate;
+  }
+  // Checks the rate before draining so a bad request changes nothing.
+  uint32_t ctrl_nco = baud_to_nco(baud);
+  if (ctrl_nco == 0) {
+    return UARTDriver_InvalidArgument;
+  }
+
+  // NB: write_flush assumes a single waiter; the only client is also the
+  //   caller here, so it cannot be flushing concurrently.
+  int rc = write_flush();
+  if (rc != 0) {
+    return rc;
+  }
+  // Waits out the few characters still in the TX FIFO and shift register.
+  while (!(REG(STATUS) & BIT(UART_STATUS_TXIDLE_BIT))) {
+    seL4_Yield();
+  }
+  set_ctrl(ctrl_nco);
+  return 0;
+}
+
+// Implements UARTControlInterface::get_stats.
+int control_get_stats(uart_driver_stats_t *out) {
+  *out = stats;
+  return 0;
+}
+
+// Implements UARTControlInterface::reset_stats.
+int control_reset_stats(void) {
+  memset(&stats, 0, sizeof(stats));
+  return 0;
+}
+
 // Reads any bytes currently pending in the receive FIFO into rx_buf, stopping
-// early if rx_buf becomes full and then signals any call to rx_update that may
-// be waiting on the condition that rx_buf not be empty.
-void rx_watermark_handle(void) {
-  LOCK(rx_mutex);
-  while (!rx_empty()) {
-    size_t buffer_remaining = circular_buffer_remaining(&rx_buf);
-    if (buffer_remaining == 0) {
-      // The buffer is full.
-      //
-      // We want to stay in this invocation of the interrupt handler until the
-      // RX FIFO is empty, since the rx_watermark interrupt will not fire again
-      // until the RX FIFO level crosses from 0 to 1. Therefore we unblock any
-      // pending reads and wait for enough reads to consume all of rx_buf.
-      CANTRIP_ASSERT(rx_nonempty_semaphore_post() == 0);
-      UNLOCK(rx_mutex);
-      CANTRIP_ASSERT(rx_empty_semaphore_wait() == 0);
-      LOCK(rx_mutex);
-      continue;
-    }
-    size_t to_read = rx_fifo_level();
-    to_read = to_read > buffer_remaining ? buffer_remaining : to_read;
-    while(to_read--) {
-      CANTRIP_ASSERT(circular_buffer_push_back(&rx_buf, uart_getchar()));
-    }
+// early if rx_buf becomes full, and then signals any read_read that may be
+// waiting on the condition that rx_buf not be empty. Returns the number of
+// bytes read, 0 if the other RX interrupt thread was already draining (it
+// makes this caller's pass too).
+static size_t drain_rx_fifo(void) {
+  if (!claim_pass(&rx_drain_requests)) {
+    return 0;
   }
+  size_t num_drained = 0;
+  unsigned passes = 1;
+  do {
+    while (!rx_empty()) {
+      size_t buffer_remaining = spsc_buffer_remaining(&rx_buf);
+      if (buffer_remaining == 0) {
+        // The buffer is full.
+        //
+        // We want to stay in this invocation of the interrupt handler until
+        // the RX FIFO is empty, since the rx_watermark interrupt will not fire
+        // again until the RX FIFO level crosses from 0 to 1. Therefore we
+        // unblock any pending reads and wait for enough reads to consume all
+        // of rx_buf. No lock is held so the other RX thread is not stalled.
+        stats.rx_stalls++;
+        CANTRIP_ASSERT(rx_nonempty_semaphore_post() == 0);
+        CANTRIP_ASSERT(rx_empty_semaphore_wait() == 0);
+        continue;
+      }
+      // Reads the FIFO level once and copies that many bytes straight into
+      // rx_buf's contiguous free spans (at most two because of wrap-around).
+      size_t to_read = MIN(rx_fifo_level(), buffer_remaining);
+      while (to_read > 0) {
+        char *span;
+        size_t n = MIN(spsc_buffer_peek_writable(&rx_buf, &span), to_read);
+        for (size_t i = 0; i < n; ++i) {
+          span[i] = uart_getchar();
+        }
+        spsc_buffer_commit_write(&rx_buf, n);
+        to_read -= n;
+        num_drained += n;
+      }
+      note_high_water(&stats.rx_buf_high_water, spsc_buffer_size(&rx_buf));
+    }
+  } while (next_pass(&rx_drain_requests, &passes));
   CANTRIP_ASSERT(rx_nonempty_semaphore_post() == 0);
-  UNLOCK(rx_mutex);
+  return num_drained;
+}
+
+// Handles an rx_watermark interrupt.
+//
+// These happen when the receive FIFO reaches the RX watermark.
+void rx_watermark_handle(void) {
+  uint32_t start = rdtime();
+  size_t num_drained = drain_rx_fifo();
 
   // Clears INTR_STATE for rx_watermark. (INTR_STATE is write-1-to-clear.)
   REG(INTR_STATE) = BIT(UART_INTR_STATE_RX_WATERMARK_BIT);
+  isr_done(&stats.rx_watermark, start, num_drained);
   CANTRIP_ASSERT(rx_watermark_acknowledge() == 0);
 }
 
+// Handles an rx_timeout interrupt.
+//
+// These happen when bytes below the RX watermark have sat in the receive FIFO
+// for the configured number of idle bit times, e.g. at the end of a burst.
+void rx_timeout_handle(void) {
+  uint32_t start = rdtime();
+  size_t num_drained = drain_rx_fifo();
+
+  // Clears INTR_STATE for rx_timeout. (INTR_STATE is write-1-to-clear.)
+  REG(INTR_STATE) = BIT(UART_INTR_STATE_RX_TIMEOUT_BIT);
+  isr_done(&stats.rx_timeout, start, num_drained);
+  CANTRIP_ASSERT(rx_timeout_acknowledge() == 0);
+}
+
 // Handles a tx_empty interrupt.
 //
 // This copies tx_buf into the hardware transmit FIFO, stopping early if tx_buf
-// becomes empty, and then signals any tx_update that might be waiting for
-// tx_buf to not be full.
+// becomes empty, and then signals any write_submit caller waiting for room in
+// tx_buf and any write_flush waiting for tx_buf to drain.
 void tx_empty_handle(void) {
-  fill_tx_fifo();
-
-  LOCK(tx_mutex);
-  if (circular_buffer_empty(&tx_buf)) {
+  uint32_t start = rdtime();
+  size_t num_filled = fill_tx_fifo();
+
+#ifdef UART_ZERO_COPY
+  if (spsc_buffer_empty(&tx_buf)) {
+    // Tells the client to ring the doorbell for further output, then checks
+    // again in case it published data before seeing that.
+    set_tx_busy(false);
+    if (!spsc_buffer_empty(&tx_buf)) {
+      set_tx_busy(true);
+    }
+  }
+#endif
+  if (spsc_buffer_empty(&tx_buf)) {
     // Clears INTR_STATE for tx_empty. (INTR_STATE is write-1-to-clear.) We
     // only do this if tx_buf is empty, since the TX FIFO might have become
     // empty in the time from fill_tx_fifo having sent the last character
     // until here. In that case, we want the interrupt to reassert.
     REG(INTR_STATE) = BIT(UART_INTR_STATE_TX_EMPTY_BIT);
   }
-  UNLOCK(tx_mutex);
+  notify_tx_ready();
+  notify_tx_drained();
+  isr_done(&stats.tx_empty, start, num_filled);
   CANTRIP_ASSERT(tx_empty_acknowledge() == 0);
 }
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2021, Google LLC
+ *
+ * Implementation for spsc_buffer.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "spsc_buffer.h"
+
+#include <string.h>
+
+// Each side loads its own index relaxed (only it writes that index) and the
+// other side's index with acquire, pairing with the release store that
+// published it. That orders the data copy against the index update.
+#define LOAD_OWN(idx) atomic_load_explicit(&(idx), memory_order_relaxed)
+#define LOAD_OTHER(idx) atomic_load_explicit(&(idx), memory_order_acquire)
+#define PUBLISH(idx, v) atomic_store_explicit(&(idx), (v), memory_order_release)
+
+bool spsc_buffer_init(spsc_buffer *buf, char *storage, size_t capacity) {
+  atomic_init(&buf->local_idx.head, 0);
+  atomic_init(&buf->local_idx.tail, 0);
+  return spsc_buffer_attach(buf, storage, capacity, &buf->local_idx);
+}
+
+bool spsc_buffer_attach(spsc_buffer *buf, char *storage, size_t capacity,
+                        spsc_buffer_indices *indices) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    return false;
+  }
+  buf->data = storage;
+  buf->mask = capacity - 1;
+  buf->idx = indices;
+  return true;
+}
+
+void spsc_buffer_clear(spsc_buffer *buf) {
+  atomic_store(&buf->idx->head, 0);
+  atomic_store(&buf->idx->tail, 0);
+}
+
+size_t spsc_buffer_capacity(const spsc_buffer *buf) { return buf->mask + 1; }
+
+bool spsc_buffer_empty(const spsc_buffer *buf) {
+  return spsc_buffer_size(buf) == 0;
+}
+
+size_t spsc_buffer_size(const spsc_buffer *buf) {
+  // Indices are free-running, so unsigned wraparound yields the distance. The
+  // caller is one of the two sides, so at least one index is stable.
+  size_t head = LOAD_OTHER(buf->idx->head);
+  size_t tail = LOAD_OTHER(buf->idx->tail);
+  return tail - head;
+}
+
+size_t spsc_buffer_remaining(const spsc_buffer *buf) {
+  return spsc_buffer_capacity(buf) - spsc_buffer_size(buf);
+}
+
+bool spsc_buffer_pop_front(spsc_buffer *buf, char *c) {
+  const char *region;
+  if (spsc_buffer_peek_readable(buf, &region) == 0) {
+    return false;
+  }
+  *c = *region;
+  spsc_buffer_commit_read(buf, 1);
+  return true;
+}
+
+bool spsc_buffer_push_back(spsc_buffer *buf, char c) {
+  char *region;
+  if (spsc_buffer_peek_writable(buf, &region) == 0) {
+    return false;
+  }
+  *region = c;
+  spsc_buffer_commit_write(buf, 1);
+  return true;
+}
+
+size_t spsc_buffer_push_many(spsc_buffer *buf, const char *src, size_t n) {
+  size_t pushed = 0;
+  // At most two passes: up to the end of storage, then from its start.
+  while (pushed < n) {
+    char *region;
+    size_t len = spsc_buffer_peek_writable(buf, &region);
+    if (len == 0) {
+      // The buffer is full.
+      break;
+    }
+    if (len > n - pushed) {
+      len = n - pushed;
+    }
+    memcpy(region, src + pushed, len);
+    spsc_buffer_commit_write(buf, len);
+    pushed += len;
+  }
+  return pushed;
+}
+
+size_t spsc_buffer_pop_many(spsc_buffer *buf, char *dst, size_t n) {
+  size_t popped = 0;
+  // At most two passes: up to the end of storage, then from its start.
+  while (popped < n) {
+    const char *region;
+    size_t len = spsc_buffer_peek_readable(buf, &region);
+    if (len == 0) {
+      // The buffer is empty.
+      break;
+    }
+    if (len > n - popped) {
+      len = n - popped;
+    }
+    memcpy(dst + popped, region, len);
+    spsc_buffer_commit_read(buf, len);
+    popped += len;
+  }
+  return popped;
+}
+
+size_t spsc_buffer_peek_readable(spsc_buffer *buf, const char **region) {
+  size_t head = LOAD_OWN(buf->idx->head);
+  size_t tail = LOAD_OTHER(buf->idx->tail);
+  size_t len = tail - head;
+  if (len == 0) {
+    return 0;
+  }
+  size_t offset = head & buf->mask;
+  size_t contiguous = spsc_buffer_capacity(buf) - offset;
+  *region = buf->data + offset;
+  return len < contiguous ? len : contiguous;
+}
+
+void spsc_buffer_commit_read(spsc_buffer *buf, size_t n) {
+  PUBLISH(buf->idx->head, LOAD_OWN(buf->idx->head) + n);
+}
+
+size_t spsc_buffer_peek_writable(spsc_buffer *buf, char **region) {
+  size_t tail = LOAD_OWN(buf->idx->tail);
+  size_t head = LOAD_OTHER(buf->idx->head);
+  size_t len = spsc_buffer_capacity(buf) - (tail - head);
+  if (len == 0) {
+    return 0;
+  }
+  size_t offset = tail & buf->mask;
+  size_t contiguous = spsc_buffer_capacity(buf) - offset;
+  *region = buf->data + offset;
+  return len < contiguous ? len : contiguous;
+}
+
+void spsc_buffer_commit_write(spsc_buffer *buf, size_t n) {
+  PUBLISH(buf->idx->tail, LOAD_OWN(buf->idx->tail) + n);
+}
@@ -1,10 +1,12 @@
 #!/bin/sh
 
-# Quick and dirty script to test the pure C module the UART driver depends on.
+# Quick and dirty script to test the pure C modules the UART driver depends on.
 # This can be run as needed with the development machine gcc.
 
-TEST_BINARY=test_circular_buffer
+for MODULE in circular_buffer spsc_buffer; do
+  TEST_BINARY=test_$MODULE
 
-cc -o $TEST_BINARY -Iinclude src/circular_buffer.c test/circular_buffer_test.c
-./$TEST_BINARY
-rm -f ./$TEST_BINARY
+  cc -o $TEST_BINARY -Iinclude src/$MODULE.c test/${MODULE}_test.c -lpthread
+  ./$TEST_BINARY
+  rm -f ./$TEST_BINARY
+done
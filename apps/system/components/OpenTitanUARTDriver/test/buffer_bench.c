@@ -0,0 +1,284 @@
+/*
+ * Copyright 2021, Google LLC
+ *
+ * Microbenchmarks for circular_buffer, spsc_buffer and the UART driver's use
+ * of them.
+ *
+ * Run these on the development machine with OpenTitanUARTDriver/bench.sh, or
+ * on target as the apps/c/uartbench application (built with -DCANTRIP_APP).
+ *
+ * Each line of output is
+ *
+ *   <name> <ticks per 1000 ops> <bytes per 1000 ticks> <ns per 1000 ops>
+ *
+ * where ticks come from rdtime on RISC-V, the TSC on x86 and are nanoseconds
+ * elsewhere; on target ns are derived from rdtime with libcantrip's clock
+ * (0 if the TimerService has no calibration).
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "circular_buffer.h"
+#include "spsc_buffer.h"
+
+#ifdef CANTRIP_APP
+#include <cantrip.h>
+#include <clock.h>
+#define BENCH_PRINTF debug_printf
+#else
+#include <stdio.h>
+#include <time.h>
+#define BENCH_PRINTF printf
+#endif
+
+// Sizes matching the driver: the dataport/default buffer capacity, a typical
+// bulk copy, and the hardware FIFO burst.
+#define BENCH_CAPACITY 4096
+#define BENCH_CHUNK 64
+#define FIFO_BURST 32
+
+// Bytes moved by each benchmark; a multiple of BENCH_CAPACITY.
+#define BENCH_BYTES (1u << 20)
+
+static char storage[BENCH_CAPACITY];
+static char chunk[BENCH_CAPACITY];
+
+// Keeps the compiler from discarding popped data and results.
+static volatile char sink;
+static volatile size_t moved;
+
+#ifdef CANTRIP_APP
+// libcantrip has no libc; the buffers' bulk ops need memcpy.
+void *memcpy(void *dst, const void *src, size_t n) {
+  char *d = dst;
+  const char *s = src;
+  while (n--) {
+    *d++ = *s++;
+  }
+  return dst;
+}
+#endif
+
+// Reads the benchmark tick counter.
+static uint64_t bench_ticks(void) {
+#ifdef CANTRIP_APP
+  return clock_ticks();
+#elif defined(__riscv)
+  uint64_t t;
+  asm volatile("rdtime %0" : "=r"(t));
+  return t;
+#elif defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+// Reads wall-clock nanoseconds, or 0 where there is no clock.
+static uint64_t bench_ns(void) {
+#ifdef CANTRIP_APP
+  return clock_ns();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+// A benchmark moves BENCH_BYTES through a buffer and returns the number of
+// operations (calls into the buffer API) it made.
+typedef uint32_t (*bench_fn)(void);
+
+// Repetitions per benchmark; the fastest is reported to filter out
+// interference from the rest of the system.
+#define BENCH_REPS 7
+
+static void run(const char *name, bench_fn fn) {
+  uint64_t best_ticks = UINT64_MAX;
+  uint64_t best_ns = UINT64_MAX;
+  uint32_t ops = fn();  // Warms the caches.
+  for (int rep = 0; rep < BENCH_REPS; ++rep) {
+    uint64_t ns = bench_ns();
+    uint64_t ticks = bench_ticks();
+    ops = fn();
+    ticks = bench_ticks() - ticks;
+    ns = bench_ns() - ns;
+    best_ticks = ticks < best_ticks ? ticks : best_ticks;
+    best_ns = ns < best_ns ? ns : best_ns;
+  }
+  if (best_ticks == 0) {
+    best_ticks = 1;
+  }
+  BENCH_PRINTF("%s %llu %llu %llu\n", name,
+               (unsigned long long)(best_ticks * 1000 / ops),
+               (unsigned long long)((uint64_t)BENCH_BYTES * 1000 / best_ticks),
+               (unsigned long long)(best_ns * 1000 / ops));
+}
+
+static uint32_t circular_bytewise(void) {
+  circular_buffer buf;
+  const bool success = circular_buffer_init(&buf, storage, sizeof(storage));
+  (void)success;
+  uint32_t ops = 0;
+  for (uint32_t n = 0; n < BENCH_BYTES; n += BENCH_CAPACITY) {
+    for (size_t i = 0; i < BENCH_CAPACITY; ++i, ++ops) {
+      moved += circular_buffer_push_back(&buf, (char)i);
+    }
+    char c;
+    while (circular_buffer_pop_front(&buf, &c)) {
+      sink = c;
+      ++ops;
+    }
+  }
+  return ops;
+}
+
+static uint32_t circular_bulk(void) {
+  circular_buffer buf;
+  const bool success = circular_buffer_init(&buf, storage, sizeof(storage));
+  (void)success;
+  uint32_t ops = 0;
+  for (uint32_t n = 0; n < BENCH_BYTES; n += BENCH_CHUNK, ops += 2) {
+    moved += circular_buffer_push_many(&buf, chunk, BENCH_CHUNK);
+    moved += circular_buffer_pop_many(&buf, chunk, BENCH_CHUNK);
+  }
+  return ops;
+}
+
+static uint32_t spsc_bytewise(void) {
+  spsc_buffer buf;
+  const bool success = spsc_buffer_init(&buf, storage, sizeof(storage));
+  (void)success;
+  uint32_t ops = 0;
+  for (uint32_t n = 0; n < BENCH_BYTES; n += BENCH_CAPACITY) {
+    for (size_t i = 0; i < BENCH_CAPACITY; ++i, ++ops) {
+      moved += spsc_buffer_push_back(&buf, (char)i);
+    }
+    char c;
+    while (spsc_buffer_pop_front(&buf, &c)) {
+      sink = c;
+      ++ops;
+    }
+  }
+  return ops;
+}
+
+static uint32_t spsc_bulk(void) {
+  spsc_buffer buf;
+  const bool success = spsc_buffer_init(&buf, storage, sizeof(storage));
+  (void)success;
+  uint32_t ops = 0;
+  // NB: an odd chunk keeps the indices moving across the wrap point.
+  for (uint32_t n = 0; n < BENCH_BYTES; n += BENCH_CHUNK - 1, ops += 2) {
+    moved += spsc_buffer_push_many(&buf, chunk, BENCH_CHUNK - 1);
+    moved += spsc_buffer_pop_many(&buf, chunk, BENCH_CHUNK - 1);
+  }
+  return ops;
+}
+
+static uint32_t spsc_spans(void) {
+  spsc_buffer buf;
+  const bool success = spsc_buffer_init(&buf, storage, sizeof(storage));
+  (void)success;
+  uint32_t ops = 0;
+  for (uint32_t n = 0; n < BENCH_BYTES;) {
+    char *w;
+    size_t len = spsc_buffer_peek_writable(&buf, &w);
+    len = len < BENCH_CHUNK ? len : BENCH_CHUNK;
+    for (size_t i = 0; i < len; ++i) {
+      w[i] = (char)i;
+    }
+    spsc_buffer_commit_write(&buf, len);
+    const char *r;
+    len = spsc_buffer_peek_readable(&buf, &r);
+    for (size_t i = 0; i < len; ++i) {
+      sink = r[i];
+    }
+    spsc_buffer_commit_read(&buf, len);
+    n += len;
+    ops += 4;
+  }
+  return ops;
+}
+
+// Simulates the receive path: the interrupt handler copies FIFO bursts into
+// rx_buf's free spans (as drain_rx_fifo does) and every few bursts read_read
+// pops everything into the dataport.
+static uint32_t rx_ping_pong(void) {
+  spsc_buffer buf;
+  const bool success = spsc_buffer_init(&buf, storage, sizeof(storage));
+  (void)success;
+  uint32_t ops = 0;
+  for (uint32_t n = 0; n < BENCH_BYTES;) {
+    for (int burst = 0; burst < 4; ++burst) {
+      size_t to_read = FIFO_BURST;
+      while (to_read > 0) {
+        char *span;
+        size_t len = spsc_buffer_peek_writable(&buf, &span);
+        len = len < to_read ? len : to_read;
+        for (size_t i = 0; i < len; ++i) {
+          span[i] = (char)i;  // Stands in for the RDATA read.
+        }
+        spsc_buffer_commit_write(&buf, len);
+        to_read -= len;
+        ops += 2;
+      }
+    }
+    n += spsc_buffer_pop_many(&buf, chunk, sizeof(chunk));
+    ops++;
+  }
+  return ops;
+}
+
+// Simulates the transmit path: write_write pushes a dataport's worth and the
+// interrupt handlers drain it in half-FIFO bursts (as fill_tx_fifo does after
+// a tx_watermark).
+static uint32_t tx_ping_pong(void) {
+  spsc_buffer buf;
+  const bool success = spsc_buffer_init(&buf, storage, sizeof(storage));
+  (void)success;
+  uint32_t ops = 0;
+  for (uint32_t n = 0; n < BENCH_BYTES;) {
+    moved += spsc_buffer_push_many(&buf, chunk, BENCH_CAPACITY / 2);
+    ops++;
+    while (!spsc_buffer_empty(&buf)) {
+      size_t free_slots = FIFO_BURST / 2;
+      while (free_slots > 0) {
+        const char *data;
+        size_t len = spsc_buffer_peek_readable(&buf, &data);
+        len = len < free_slots ? len : free_slots;
+        if (len == 0) {
+          break;
+        }
+        for (size_t i = 0; i < len; ++i) {
+          sink = data[i];  // Stands in for the WDATA write.
+        }
+        spsc_buffer_commit_read(&buf, len);
+        free_slots -= len;
+        n += len;
+        ops += 2;
+      }
+    }
+  }
+  return ops;
+}
+
+int main() {
+#ifdef CANTRIP_APP
+  (void)clock_hz();  // Fetch the clock rate before anything is timed.
+#endif
+  BENCH_PRINTF("name ticks/kop bytes/kticks ns/kop\n");
+  run("circular_bytewise", circular_bytewise);
+  run("circular_bulk", circular_bulk);
+  run("spsc_bytewise", spsc_bytewise);
+  run("spsc_bulk", spsc_bulk);
+  run("spsc_spans", spsc_spans);
+  run("rx_ping_pong", rx_ping_pong);
+  run("tx_ping_pong", tx_ping_pong);
+  return 0;
+}
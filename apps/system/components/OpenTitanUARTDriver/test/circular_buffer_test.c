@@ -11,6 +11,7 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 // These are currently quick and dirty tests with a minimal "framework." When
 // adding new tests, be sure to add a TEST(...); declaration to main().
@@ -30,28 +31,49 @@
     return false;                                                       \
   }
 
+#define TEST_CAPACITY 512
+
+static char storage[TEST_CAPACITY];
+
+static void init_test_buffer(circular_buffer* buf) {
+  const bool success = circular_buffer_init(buf, storage, sizeof(storage));
+  (void)success;
+}
+
 static void fill_with_x(circular_buffer* buf) {
-  circular_buffer_init(buf);
+  init_test_buffer(buf);
   const char c = 'x';
-  for (size_t i = 0; i < CIRCULAR_BUFFER_CAPACITY; ++i) {
+  for (size_t i = 0; i < TEST_CAPACITY; ++i) {
     const bool success = circular_buffer_push_back(buf, c);
     (void)success;
   }
 }
 
+bool test_init_rejects_non_power_of_two() {
+  circular_buffer buf;
+
+  ASSERT(!circular_buffer_init(&buf, storage, 0));
+  ASSERT(!circular_buffer_init(&buf, storage, 500));
+  ASSERT(circular_buffer_init(&buf, storage, 128));
+  ASSERT(circular_buffer_capacity(&buf) == 128);
+  ASSERT(circular_buffer_remaining(&buf) == 128);
+
+  return true;
+}
+
 bool test_size_of_empty() {
   circular_buffer buf;
-  circular_buffer_init(&buf);
+  init_test_buffer(&buf);
 
   ASSERT(circular_buffer_empty(&buf));
-  ASSERT(circular_buffer_remaining(&buf) == CIRCULAR_BUFFER_CAPACITY);
+  ASSERT(circular_buffer_remaining(&buf) == TEST_CAPACITY);
 
   return true;
 }
 
 bool test_double_push_double_pop() {
   circular_buffer buf;
-  circular_buffer_init(&buf);
+  init_test_buffer(&buf);
 
   char push = 'a';
   ASSERT(circular_buffer_push_back(&buf, push));
@@ -72,7 +94,7 @@ bool test_size_of_full() {
   fill_with_x(&buf);
 
   ASSERT(circular_buffer_remaining(&buf) == 0);
-  ASSERT(circular_buffer_size(&buf) == CIRCULAR_BUFFER_CAPACITY);
+  ASSERT(circular_buffer_size(&buf) == TEST_CAPACITY);
 
   return true;
 }
@@ -88,7 +110,7 @@ bool test_push_full() {
 
 bool test_pop_empty() {
   circular_buffer buf;
-  circular_buffer_init(&buf);
+  init_test_buffer(&buf);
 
   char pop;
   ASSERT(circular_buffer_pop_front(&buf, &pop) == false);
@@ -103,7 +125,7 @@ bool test_clear_full() {
   circular_buffer_clear(&buf);
 
   ASSERT(circular_buffer_empty(&buf));
-  ASSERT(circular_buffer_remaining(&buf) == CIRCULAR_BUFFER_CAPACITY);
+  ASSERT(circular_buffer_remaining(&buf) == TEST_CAPACITY);
 
   return true;
 }
@@ -113,9 +135,9 @@ bool test_rotating_push_pop() {
   const char push = 'x';
   char pop;
   circular_buffer buf;
-  circular_buffer_init(&buf);
+  init_test_buffer(&buf);
 
-  for (size_t i = 0; i < 10 * CIRCULAR_BUFFER_CAPACITY; ++i) {
+  for (size_t i = 0; i < 10 * TEST_CAPACITY; ++i) {
     pop = 0;
     ASSERT(circular_buffer_push_back(&buf, push));
     ASSERT(circular_buffer_pop_front(&buf, &pop));
@@ -127,7 +149,119 @@ bool test_rotating_push_pop() {
   return true;
 }
 
+bool test_push_many_pop_many() {
+  const char push[] = "abcdefgh";
+  char pop[sizeof(push)] = {0};
+  circular_buffer buf;
+  init_test_buffer(&buf);
+
+  ASSERT(circular_buffer_push_many(&buf, push, sizeof(push)) == sizeof(push));
+  ASSERT(circular_buffer_size(&buf) == sizeof(push));
+  ASSERT(circular_buffer_pop_many(&buf, pop, sizeof(pop)) == sizeof(pop));
+  ASSERT(memcmp(push, pop, sizeof(push)) == 0);
+  ASSERT(circular_buffer_empty(&buf));
+
+  return true;
+}
+
+bool test_push_many_overflow() {
+  char push[TEST_CAPACITY + 10];
+  memset(push, 'x', sizeof(push));
+  circular_buffer buf;
+  init_test_buffer(&buf);
+
+  ASSERT(circular_buffer_push_many(&buf, push, sizeof(push)) ==
+         TEST_CAPACITY);
+  ASSERT(circular_buffer_remaining(&buf) == 0);
+  ASSERT(circular_buffer_push_many(&buf, push, 1) == 0);
+
+  return true;
+}
+
+bool test_pop_many_underflow() {
+  char pop[4];
+  circular_buffer buf;
+  init_test_buffer(&buf);
+
+  ASSERT(circular_buffer_pop_many(&buf, pop, sizeof(pop)) == 0);
+  ASSERT(circular_buffer_push_back(&buf, 'a'));
+  ASSERT(circular_buffer_pop_many(&buf, pop, sizeof(pop)) == 1);
+  ASSERT(pop[0] == 'a');
+
+  return true;
+}
+
+bool test_rotating_push_many_pop_many() {
+  // Uses a chunk size that doesn't divide the capacity so that copies are
+  // split across the wrap at varying offsets.
+  char push[37];
+  char pop[sizeof(push)];
+  circular_buffer buf;
+  init_test_buffer(&buf);
+
+  for (size_t i = 0; i < 10 * TEST_CAPACITY / sizeof(push); ++i) {
+    for (size_t j = 0; j < sizeof(push); ++j) {
+      push[j] = (char)(i + j);
+    }
+    ASSERT(circular_buffer_push_many(&buf, push, sizeof(push)) == sizeof(push));
+    ASSERT(circular_buffer_pop_many(&buf, pop, sizeof(pop)) == sizeof(pop));
+    ASSERT(memcmp(push, pop, sizeof(push)) == 0);
+  }
+
+  ASSERT(circular_buffer_empty(&buf));
+
+  return true;
+}
+
+bool test_peek_commit_across_wrap() {
+  const char* region;
+  char* wregion;
+  circular_buffer buf;
+  fill_with_x(&buf);
+
+  // Moves begin near the end of the data array so the queued data wraps.
+  char pop[TEST_CAPACITY - 4];
+  ASSERT(circular_buffer_pop_many(&buf, pop, sizeof(pop)) == sizeof(pop));
+  ASSERT(circular_buffer_push_many(&buf, "abcdef", 6) == 6);
+
+  // Readable data ends at the end of the data array.
+  ASSERT(circular_buffer_peek_readable(&buf, &region) == 4);
+  ASSERT(memcmp(region, "xxxx", 4) == 0);
+  circular_buffer_commit_read(&buf, 4);
+  ASSERT(circular_buffer_peek_readable(&buf, &region) == 6);
+  ASSERT(memcmp(region, "abcdef", 6) == 0);
+
+  // Writable space runs up to begin since no slot is kept in reserve.
+  ASSERT(circular_buffer_peek_writable(&buf, &wregion) ==
+         circular_buffer_remaining(&buf));
+  ASSERT(wregion == storage + 6);
+  wregion[0] = 'g';
+  circular_buffer_commit_write(&buf, 1);
+  circular_buffer_commit_read(&buf, 6);
+  ASSERT(circular_buffer_pop_front(&buf, pop));
+  ASSERT(pop[0] == 'g');
+  ASSERT(circular_buffer_empty(&buf));
+
+  return true;
+}
+
+bool test_peek_full_and_empty() {
+  const char* region = NULL;
+  char* wregion = NULL;
+  circular_buffer buf;
+  init_test_buffer(&buf);
+
+  ASSERT(circular_buffer_peek_readable(&buf, &region) == 0);
+  ASSERT(region == NULL);
+  fill_with_x(&buf);
+  ASSERT(circular_buffer_peek_writable(&buf, &wregion) == 0);
+  ASSERT(wregion == NULL);
+
+  return true;
+}
+
 int main(int argc, char** argv) {
+  TEST(test_init_rejects_non_power_of_two);
   TEST(test_size_of_empty);
   TEST(test_double_push_double_pop);
   TEST(test_size_of_full);
@@ -135,4 +269,10 @@ int main(int argc, char** argv) {
   TEST(test_pop_empty);
   TEST(test_clear_full);
   TEST(test_rotating_push_pop);
+  TEST(test_push_many_pop_many);
+  TEST(test_push_many_overflow);
+  TEST(test_pop_many_underflow);
+  TEST(test_rotating_push_many_pop_many);
+  TEST(test_peek_commit_across_wrap);
+  TEST(test_peek_full_and_empty);
 }
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2021, Google LLC
+ *
+ * Tests for spsc_buffer.
+ *
+ * Run these with OpenTitanUARTDriver/test.sh.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "spsc_buffer.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// These use the same minimal "framework" as circular_buffer_test.c. When
+// adding new tests, be sure to add a TEST(...); declaration to main().
+
+#define TEST(X)         \
+  printf("%s\n", #X);   \
+  if ((X)()) {          \
+    printf("\tpass\n"); \
+  }
+
+#define ASSERT(X)                                                       \
+  if (!(X)) {                                                           \
+    printf("\tfailed assertion: (%s:%d) %s\n", __FILE__, __LINE__, #X); \
+    return false;                                                       \
+  }
+
+#define TEST_CAPACITY 64
+
+static char storage[TEST_CAPACITY];
+
+static void init_test_buffer(spsc_buffer* buf) {
+  const bool success = spsc_buffer_init(buf, storage, sizeof(storage));
+  (void)success;
+}
+
+static void fill_with_x(spsc_buffer* buf) {
+  init_test_buffer(buf);
+  for (size_t i = 0; i < TEST_CAPACITY; ++i) {
+    const bool success = spsc_buffer_push_back(buf, 'x');
+    (void)success;
+  }
+}
+
+bool test_init_rejects_non_power_of_two() {
+  spsc_buffer buf;
+
+  ASSERT(!spsc_buffer_init(&buf, storage, 0));
+  ASSERT(!spsc_buffer_init(&buf, storage, 48));
+  ASSERT(spsc_buffer_init(&buf, storage, 32));
+  ASSERT(spsc_buffer_capacity(&buf) == 32);
+
+  return true;
+}
+
+bool test_size_of_empty() {
+  spsc_buffer buf;
+  init_test_buffer(&buf);
+
+  ASSERT(spsc_buffer_empty(&buf));
+  ASSERT(spsc_buffer_remaining(&buf) == TEST_CAPACITY);
+
+  return true;
+}
+
+bool test_size_of_full() {
+  spsc_buffer buf;
+  fill_with_x(&buf);
+
+  ASSERT(spsc_buffer_remaining(&buf) == 0);
+  ASSERT(spsc_buffer_size(&buf) == TEST_CAPACITY);
+  ASSERT(spsc_buffer_push_back(&buf, 'x') == false);
+
+  return true;
+}
+
+bool test_pop_empty() {
+  spsc_buffer buf;
+  init_test_buffer(&buf);
+
+  char pop;
+  ASSERT(spsc_buffer_pop_front(&buf, &pop) == false);
+
+  return true;
+}
+
+bool test_clear_full() {
+  spsc_buffer buf;
+  fill_with_x(&buf);
+
+  spsc_buffer_clear(&buf);
+
+  ASSERT(spsc_buffer_empty(&buf));
+  ASSERT(spsc_buffer_remaining(&buf) == TEST_CAPACITY);
+
+  return true;
+}
+
+bool test_rotating_push_many_pop_many() {
+  // Uses a chunk size that doesn't divide the capacity so that copies are
+  // split across the wrap at varying offsets.
+  char push[13];
+  char pop[sizeof(push)];
+  spsc_buffer buf;
+  init_test_buffer(&buf);
+
+  for (size_t i = 0; i < 10 * TEST_CAPACITY / sizeof(push); ++i) {
+    for (size_t j = 0; j < sizeof(push); ++j) {
+      push[j] = (char)(i + j);
+    }
+    ASSERT(spsc_buffer_push_many(&buf, push, sizeof(push)) == sizeof(push));
+    ASSERT(spsc_buffer_pop_many(&buf, pop, sizeof(pop)) == sizeof(pop));
+    ASSERT(memcmp(push, pop, sizeof(push)) == 0);
+  }
+
+  ASSERT(spsc_buffer_empty(&buf));
+
+  return true;
+}
+
+bool test_peek_commit_across_wrap() {
+  const char* region;
+  char* wregion;
+  char pop[TEST_CAPACITY - 4];
+  spsc_buffer buf;
+  fill_with_x(&buf);
+
+  ASSERT(spsc_buffer_pop_many(&buf, pop, sizeof(pop)) == sizeof(pop));
+  ASSERT(spsc_buffer_push_many(&buf, "abcdef", 6) == 6);
+
+  // Readable data ends at the end of storage.
+  ASSERT(spsc_buffer_peek_readable(&buf, &region) == 4);
+  ASSERT(memcmp(region, "xxxx", 4) == 0);
+  spsc_buffer_commit_read(&buf, 4);
+  ASSERT(spsc_buffer_peek_readable(&buf, &region) == 6);
+  ASSERT(memcmp(region, "abcdef", 6) == 0);
+
+  // Writable space runs up to the end of storage.
+  ASSERT(spsc_buffer_peek_writable(&buf, &wregion) == TEST_CAPACITY - 6);
+  ASSERT(wregion == storage + 6);
+
+  return true;
+}
+
+bool test_attach_shares_indices() {
+  // Models a producer and a consumer in different components with their own
+  // spsc_buffer views of shared storage and indices.
+  spsc_buffer_indices shared = {0};
+  spsc_buffer producer;
+  spsc_buffer consumer;
+  ASSERT(spsc_buffer_attach(&producer, storage, sizeof(storage), &shared));
+  ASSERT(spsc_buffer_attach(&consumer, storage, sizeof(storage), &shared));
+  ASSERT(spsc_buffer_empty(&consumer));
+
+  char pop[3];
+  ASSERT(spsc_buffer_push_many(&producer, "abc", 3) == 3);
+  ASSERT(spsc_buffer_size(&consumer) == 3);
+  ASSERT(spsc_buffer_pop_many(&consumer, pop, sizeof(pop)) == 3);
+  ASSERT(memcmp(pop, "abc", 3) == 0);
+  ASSERT(spsc_buffer_empty(&producer));
+
+  // Re-attaching leaves the shared indices alone.
+  ASSERT(spsc_buffer_push_back(&producer, 'd'));
+  ASSERT(spsc_buffer_attach(&consumer, storage, sizeof(storage), &shared));
+  ASSERT(spsc_buffer_size(&consumer) == 1);
+
+  return true;
+}
+
+#define STRESS_BYTES (1u << 18)
+
+static void* stress_producer(void* arg) {
+  spsc_buffer* buf = arg;
+  char chunk[7];
+  uint32_t sent = 0;
+  while (sent < STRESS_BYTES) {
+    size_t n = sizeof(chunk);
+    if (n > STRESS_BYTES - sent) {
+      n = STRESS_BYTES - sent;
+    }
+    for (size_t j = 0; j < n; ++j) {
+      chunk[j] = (char)(sent + j);
+    }
+    size_t pushed = 0;
+    while (pushed < n) {
+      size_t len = spsc_buffer_push_many(buf, chunk + pushed, n - pushed);
+      if (len == 0) {
+        sched_yield();
+      }
+      pushed += len;
+    }
+    sent += n;
+  }
+  return NULL;
+}
+
+bool test_concurrent_producer_consumer() {
+  spsc_buffer buf;
+  init_test_buffer(&buf);
+
+  pthread_t producer;
+  ASSERT(pthread_create(&producer, NULL, stress_producer, &buf) == 0);
+
+  char chunk[11];
+  uint32_t received = 0;
+  bool in_order = true;
+  while (received < STRESS_BYTES) {
+    size_t n = spsc_buffer_pop_many(&buf, chunk, sizeof(chunk));
+    if (n == 0) {
+      sched_yield();
+    }
+    for (size_t j = 0; j < n; ++j) {
+      in_order &= chunk[j] == (char)(received + j);
+    }
+    received += n;
+  }
+  pthread_join(producer, NULL);
+
+  ASSERT(in_order);
+  ASSERT(spsc_buffer_empty(&buf));
+
+  return true;
+}
+
+int main(int argc, char** argv) {
+  TEST(test_init_rejects_non_power_of_two);
+  TEST(test_size_of_empty);
+  TEST(test_size_of_full);
+  TEST(test_pop_empty);
+  TEST(test_clear_full);
+  TEST(test_rotating_push_many_pop_many);
+  TEST(test_peek_commit_across_wrap);
+  TEST(test_attach_shares_indices);
+  TEST(test_concurrent_producer_consumer);
+}
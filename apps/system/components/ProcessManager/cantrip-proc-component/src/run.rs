@@ -184,6 +184,27 @@ pub unsafe extern "C" fn proc_ctrl_get_running_bundles(
     }
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn proc_ctrl_get_domain_stats(
+    c_raw_data: *mut RawDomainStatsData,
+) -> ProcessManagerError {
+    match CANTRIP_PROC.get_domain_stats() {
+        Ok(stats) => match postcard::to_slice(&stats, &mut (*c_raw_data)[..]) {
+            Ok(_) => ProcessManagerError::Success,
+            Err(_) => ProcessManagerError::SerializeError,
+        },
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn proc_ctrl_reset_domain_stats() -> ProcessManagerError {
+    match CANTRIP_PROC.reset_domain_stats() {
+        Ok(_) => ProcessManagerError::Success,
+        Err(e) => e,
+    }
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn proc_ctrl_capscan() { let _ = Camkes::capscan(); }
 
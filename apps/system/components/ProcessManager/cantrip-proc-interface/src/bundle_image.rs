@@ -16,12 +16,13 @@
 
 use cantrip_memory_interface::ObjDescBundle;
 use cantrip_os_common::cspace_slot::CSpaceSlot;
+use cantrip_os_common::logger::bin_trace;
 use cantrip_os_common::sel4_sys;
 use core::cmp;
 use core::mem::size_of;
 use core::ops::Range;
 use core::ptr;
-use log::{error, trace};
+use log::error;
 
 use sel4_sys::seL4_CPtr;
 use sel4_sys::seL4_CapRights;
@@ -296,7 +297,7 @@ impl<'a> io::Seek for BundleImage<'a> {
             io::SeekFrom::Start(p) => p,
         };
         if new_pos != self.cur_pos {
-            trace!("SEEK: cur {} new {}", self.cur_pos, new_pos);
+            bin_trace!("SEEK: cur {} new {}", self.cur_pos, new_pos);
             // TODO(sleffler): handle seek within same page
             self.unmap_current_frame().map_err(|_| io::Error)?;
             self.cur_pos = new_pos;
@@ -306,7 +307,7 @@ impl<'a> io::Seek for BundleImage<'a> {
 }
 impl<'a> io::Read for BundleImage<'a> {
     fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
-        trace!("READ: {} bytes", buf.len());
+        bin_trace!("READ: {} bytes", buf.len());
         let mut cursor = &mut *buf;
         while !cursor.is_empty() {
             let available_bytes = self.mapped_bytes - self.bytes_read;
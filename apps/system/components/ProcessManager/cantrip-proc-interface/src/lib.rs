@@ -23,6 +23,7 @@ use alloc::vec::Vec;
 use cantrip_memory_interface::ObjDescBundle;
 use cantrip_memory_interface::RAW_OBJ_DESC_DATA_SIZE;
 use cantrip_os_common::camkes::Camkes;
+use cantrip_os_common::scheduling::DomainSchedule;
 use cantrip_security_interface::SecurityRequestError;
 use core::str;
 use cstr_core::CString;
@@ -40,6 +41,12 @@ pub type BundleIdArray = Vec<String>;
 pub const RAW_BUNDLE_ID_DATA_SIZE: usize = 100;
 pub type RawBundleIdData = [u8; RAW_BUNDLE_ID_DATA_SIZE];
 
+// Size of the data buffer used to pass a serialized DomainStats between
+// Rust <> C; bounded like RawBundleIdData. Tick counts are varint-encoded
+// so this holds a few domains worth of stats.
+pub const RAW_DOMAIN_STATS_DATA_SIZE: usize = 100;
+pub type RawDomainStatsData = [u8; RAW_DOMAIN_STATS_DATA_SIZE];
+
 // BundleId capacity before spillover to the heap.
 // TODO(sleffler): hide this; it's part of the implementation
 pub const DEFAULT_BUNDLE_ID_CAPACITY: usize = 64;
@@ -64,6 +71,60 @@ impl Bundle {
     }
 }
 
+// CPU time (kernel benchmark timer ticks) used in a scheduling domain.
+#[derive(Clone, Debug, Default, Eq, PartialEq, Serialize, Deserialize)]
+pub struct DomainTicks {
+    pub busy: u64,
+    pub idle: u64,
+}
+
+// Per-domain CPU accounting since the last reset_domain_stats; indexed
+// by domain number.
+#[derive(Clone, Debug, Default, Eq, PartialEq, Serialize, Deserialize)]
+pub struct DomainStats {
+    pub total: u64,
+    pub idle: u64,
+    pub domains: Vec<DomainTicks>,
+}
+impl DomainStats {
+    // Splits |total| & |idle| ticks across the domains in |schedule|.
+    // |app_busy| has the ticks used by applications in each domain.
+    //
+    // The kernel does not account time per domain so this is approximate:
+    // time not used by the idle thread or by applications outside the
+    // System domain is charged to the System domain, and each domain is
+    // idle for whatever is left of its share of the schedule.
+    pub fn new(schedule: &DomainSchedule, total: u64, idle: u64, app_busy: &[u64]) -> Self {
+        let num_domains = schedule.num_domains().max(app_busy.len());
+        let busy = |domain: usize| app_busy.get(domain).copied().unwrap_or(0);
+        let mut domains = Vec::with_capacity(num_domains);
+        for domain in 0..num_domains {
+            let busy = if domain == 0 {
+                let others: u64 = (1..num_domains).map(busy).sum();
+                total.saturating_sub(idle).saturating_sub(others)
+            } else {
+                busy(domain)
+            };
+            let share = match schedule.total_length() {
+                0 => 0,
+                length => {
+                    ((total as u128 * schedule.domain_length(domain) as u128) / length as u128)
+                        as u64
+                }
+            };
+            domains.push(DomainTicks {
+                busy,
+                idle: share.saturating_sub(busy),
+            });
+        }
+        DomainStats {
+            total,
+            idle,
+            domains,
+        }
+    }
+}
+
 // Interface to underlying Bundle implementations. Mainly
 // used to inject fakes for unit tests.
 pub trait BundleImplInterface {
@@ -72,6 +133,11 @@ pub trait BundleImplInterface {
     fn suspend(&self) -> Result<(), ProcessManagerError>;
     fn resume(&self) -> Result<(), ProcessManagerError>;
     fn capscan(&self) -> Result<(), ProcessManagerError>;
+    // Scheduling domain the application runs in.
+    fn domain(&self) -> usize;
+    // CPU time used since the last reset_utilisation.
+    fn utilisation(&self) -> Result<u64, ProcessManagerError>;
+    fn reset_utilisation(&self) -> Result<(), ProcessManagerError>;
 }
 
 // NB: struct's marked repr(C) are processed by cbindgen to get a .h file
@@ -100,6 +166,8 @@ pub enum ProcessManagerError {
     SuspendFailed,
     ResumeFailed,
     CapScanFailed,
+    // Kernel lacks support (e.g. CONFIG_BENCHMARK_TRACK_UTILISATION).
+    NotSupported,
 }
 
 // Interface to underlying facilities (StorageManager, seL4); also
@@ -121,6 +189,9 @@ pub trait ProcessManagerInterface {
         bundle_impl: &mut dyn BundleImplInterface,
     ) -> Result<(), ProcessManagerError>;
     fn capscan(&self, bundle_impl: &dyn BundleImplInterface) -> Result<(), ProcessManagerError>;
+    // Returns the (total, idle) CPU time since the last reset_utilisation.
+    fn utilisation(&self) -> Result<(u64, u64), ProcessManagerError>;
+    fn reset_utilisation(&mut self) -> Result<(), ProcessManagerError>;
 }
 
 // NB: bundle_id comes across the C interface as *const cstr_core::c_char
@@ -141,6 +212,8 @@ pub trait ProcessControlInterface {
     fn stop(&mut self, bundle_id: &str) -> Result<(), ProcessManagerError>;
     fn get_running_bundles(&self) -> Result<BundleIdArray, ProcessManagerError>;
     fn capscan(&self, bundle_id: &str) -> Result<(), ProcessManagerError>;
+    fn get_domain_stats(&self) -> Result<DomainStats, ProcessManagerError>;
+    fn reset_domain_stats(&mut self) -> Result<(), ProcessManagerError>;
 }
 
 impl From<postcard::Error> for ProcessManagerError {
@@ -308,6 +381,31 @@ pub fn cantrip_proc_ctrl_capscan_bundle(bundle_id: &str) -> Result<(), ProcessMa
     unsafe { proc_ctrl_capscan_bundle(cstr.as_ptr()) }.into()
 }
 
+#[inline]
+#[allow(dead_code)]
+pub fn cantrip_proc_ctrl_get_domain_stats() -> Result<DomainStats, ProcessManagerError> {
+    extern "C" {
+        fn proc_ctrl_get_domain_stats(c_raw_data: *mut u8) -> ProcessManagerError;
+    }
+    let raw_data = &mut [0u8; RAW_DOMAIN_STATS_DATA_SIZE];
+    match unsafe { proc_ctrl_get_domain_stats(raw_data as *mut _) } {
+        ProcessManagerError::Success => {
+            let stats = postcard::from_bytes::<DomainStats>(raw_data)?;
+            Ok(stats)
+        }
+        status => Err(status),
+    }
+}
+
+#[inline]
+#[allow(dead_code)]
+pub fn cantrip_proc_ctrl_reset_domain_stats() -> Result<(), ProcessManagerError> {
+    extern "C" {
+        fn proc_ctrl_reset_domain_stats() -> ProcessManagerError;
+    }
+    unsafe { proc_ctrl_reset_domain_stats() }.into()
+}
+
 // TODO(sleffler): move out of interface?
 #[cfg(test)]
 mod tests {
@@ -354,6 +452,29 @@ mod tests {
         assert!(postcard::to_slice(&bid_array, &mut raw_data).is_err());
     }
 
+    #[test]
+    fn test_domain_stats_split() {
+        // 7:1 schedule; the idle thread ran for 20 ticks and an app in
+        // domain 1 for 4 of 100.
+        let schedule = DomainSchedule::new("0:7,1:1");
+        let stats = DomainStats::new(&schedule, 100, 20, &[0, 4]);
+        assert_eq!(stats.domains.len(), 2);
+        assert_eq!(stats.domains[0], DomainTicks { busy: 76, idle: 11 });
+        assert_eq!(stats.domains[1], DomainTicks { busy: 4, idle: 8 });
+
+        // Marshall/unmarshall a typical result.
+        let mut raw_data = [0u8; RAW_DOMAIN_STATS_DATA_SIZE];
+        assert!(postcard::to_slice(&stats, &mut raw_data).is_ok());
+        assert_eq!(postcard::from_bytes::<DomainStats>(raw_data.as_ref()).unwrap(), stats);
+    }
+
+    #[test]
+    fn test_domain_stats_single_domain() {
+        let schedule = DomainSchedule::new("0:1");
+        let stats = DomainStats::new(&schedule, 100, 30, &[]);
+        assert_eq!(stats.domains, [DomainTicks { busy: 70, idle: 30 }]);
+    }
+
     #[test]
     fn test_raw_bundle_id_data_too_long() {
         // Marshall an id with length >255; serialize will fail because
@@ -19,11 +19,14 @@
 extern crate alloc;
 use alloc::boxed::Box;
 use alloc::string::String;
+use alloc::sync::Arc;
+use alloc::vec::Vec;
 use cantrip_memory_interface::ObjDescBundle;
 use cantrip_os_common::cspace_slot::CSpaceSlot;
 use cantrip_proc_interface::Bundle;
 use cantrip_proc_interface::BundleIdArray;
 use cantrip_proc_interface::BundleImplInterface;
+use cantrip_proc_interface::DomainStats;
 use cantrip_proc_interface::PackageManagementInterface;
 use cantrip_proc_interface::ProcessControlInterface;
 use cantrip_proc_interface::ProcessManagerError;
@@ -32,11 +35,14 @@ use cantrip_security_interface::cantrip_security_install;
 use cantrip_security_interface::cantrip_security_install_application;
 use cantrip_security_interface::cantrip_security_load_application;
 use cantrip_security_interface::cantrip_security_uninstall;
-use log::trace;
+use log::{error, trace};
 use spin::Mutex;
 
 mod sel4bundle;
+use sel4bundle::reset_system_utilisation;
 use sel4bundle::seL4BundleImpl;
+use sel4bundle::system_utilisation;
+use sel4bundle::SharedImage;
 
 mod proc_manager;
 pub use proc_manager::ProcessManager;
@@ -61,7 +67,7 @@ impl CantripProcManager {
 
     // Finishes the setup started by empty():
     pub fn init(&self) {
-        *self.manager.lock() = Some(ProcessManager::new(CantripManagerInterface));
+        *self.manager.lock() = Some(ProcessManager::new(CantripManagerInterface::new()));
     }
 
     // Returns the bundle capacity.
@@ -100,9 +106,68 @@ impl ProcessControlInterface for CantripProcManager {
     fn capscan(&self, bundle_id: &str) -> Result<(), ProcessManagerError> {
         self.manager.lock().as_ref().unwrap().capscan(bundle_id)
     }
+    fn get_domain_stats(&self) -> Result<DomainStats, ProcessManagerError> {
+        self.manager.lock().as_ref().unwrap().get_domain_stats()
+    }
+    fn reset_domain_stats(&mut self) -> Result<(), ProcessManagerError> {
+        self.manager.lock().as_mut().unwrap().reset_domain_stats()
+    }
+}
+
+// Max bundles whose images are kept for later starts.
+const SHARED_IMAGE_CACHE_SIZE: usize = 4;
+
+// CantripManagerInterface keeps the image and read-only pages of the most
+// recently started bundles (see SharedImage). A later start of one of these
+// maps the read-only pages and copies only the writable sections from the
+// kept image; the SecurityCoordinator is not asked to load it again. The
+// least recently started image is dropped to make room for another; a
+// running application holds its own reference so its pages stay mapped
+// until it is stopped.
+struct CantripManagerInterface {
+    shared: Vec<(String, Arc<SharedImage>)>, // Least recently started first
 }
+impl CantripManagerInterface {
+    fn new() -> Self {
+        CantripManagerInterface {
+            shared: Vec::with_capacity(SHARED_IMAGE_CACHE_SIZE),
+        }
+    }
 
-struct CantripManagerInterface;
+    // Returns the kept image for |app_id| and marks it most recently started.
+    fn cached_image(&mut self, app_id: &str) -> Option<Arc<SharedImage>> {
+        let index = self.shared.iter().position(|(id, _)| id == app_id)?;
+        let entry = self.shared.remove(index);
+        let image = entry.1.clone();
+        self.shared.push(entry);
+        Some(image)
+    }
+
+    // Loads the read-only pages of |bundle_frames| and keeps the result for
+    // later starts of |app_id|. Returns None if there is nothing to share;
+    // a failure is logged and likewise means every section is copied.
+    fn load_image(
+        &mut self,
+        app_id: &str,
+        bundle_frames: &ObjDescBundle,
+    ) -> Option<Arc<SharedImage>> {
+        match SharedImage::load(bundle_frames) {
+            Ok(Some(image)) => {
+                let image = Arc::new(image);
+                if self.shared.len() == SHARED_IMAGE_CACHE_SIZE {
+                    let _ = self.shared.remove(0);
+                }
+                self.shared.push((String::from(app_id), image.clone()));
+                Some(image)
+            }
+            Ok(None) => None,
+            Err(e) => {
+                error!("{}: cannot share read-only pages: {:?}", app_id, e);
+                None
+            }
+        }
+    }
+}
 impl ProcessManagerInterface for CantripManagerInterface {
     fn install(&mut self, pkg_contents: &ObjDescBundle) -> Result<String, ProcessManagerError> {
         trace!("ProcessManagerInterface::install pkg_contents {}", pkg_contents);
@@ -133,6 +198,7 @@ impl ProcessManagerInterface for CantripManagerInterface {
 
         // NB: the caller has already checked no running application exists
         // NB: the Security Core is assumed to invalidate/remove any kv store
+        self.shared.retain(|(id, _)| id != bundle_id);
 
         // This is handled by the SecurityCoordinator.
         Ok(cantrip_security_uninstall(bundle_id)?)
@@ -159,18 +225,38 @@ impl ProcessManagerInterface for CantripManagerInterface {
         //     - Badge seL4 recv cap w/ bundle_id for (optional) StorageManager
         //       access
         // What we do atm is:
-        // 1. Ask SecurityCoordinator to return the application contents to load.
+        // 1. Unless the image was kept from an earlier start, ask
+        //    SecurityCoordinator to return the application contents to load.
         //    Data are delivered as a read-only ObjDescBundle ready to copy into
         //    the VSpace.
-        // 2. Do 4+6 with BundleImplInterface::start.
+        // 2. Load the read-only sections into frames shared by all starts
+        //    of the bundle (only when the image is loaded).
+        // 3. Do 4+6 with BundleImplInterface::start; only the writable
+        //    sections are copied.
 
         // TODO(sleffler): awkward container_slot ownership
-        let mut container_slot = CSpaceSlot::new();
-        let bundle_frames = cantrip_security_load_application(&bundle.app_id, &container_slot)?;
-        let mut sel4_bundle = seL4BundleImpl::new(bundle, &bundle_frames)?;
+        let mut container_slot = None;
+        let (bundle_frames, shared) = match self.cached_image(&bundle.app_id) {
+            Some(image) => (image.bundle_frames().clone(), Some(image)),
+            None => {
+                let mut slot = CSpaceSlot::new();
+                let bundle_frames = cantrip_security_load_application(&bundle.app_id, &slot)?;
+                let shared = self.load_image(&bundle.app_id, &bundle_frames);
+                if shared.is_some() {
+                    // The SharedImage owns the slot now.
+                    slot.release();
+                } else {
+                    container_slot = Some(slot);
+                }
+                (bundle_frames, shared)
+            }
+        };
+        let mut sel4_bundle = seL4BundleImpl::new(bundle, &bundle_frames, shared)?;
         // sel4_bundle owns container_slot now; release our ref so it's not
         // reclaimed when container_slot goes out of scope.
-        container_slot.release();
+        if let Some(mut slot) = container_slot {
+            slot.release();
+        }
 
         sel4_bundle.start()?;
 
@@ -196,4 +282,14 @@ impl ProcessManagerInterface for CantripManagerInterface {
 
         bundle_impl.capscan()
     }
+    fn utilisation(&self) -> Result<(u64, u64), ProcessManagerError> {
+        trace!("ProcessManagerInterface::utilisation");
+
+        system_utilisation()
+    }
+    fn reset_utilisation(&mut self) -> Result<(), ProcessManagerError> {
+        trace!("ProcessManagerInterface::reset_utilisation");
+
+        reset_system_utilisation()
+    }
 }
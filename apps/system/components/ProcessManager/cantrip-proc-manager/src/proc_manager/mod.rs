@@ -17,10 +17,13 @@
 extern crate alloc;
 use alloc::boxed::Box;
 use alloc::string::String;
+use alloc::vec;
 use cantrip_memory_interface::ObjDescBundle;
+use cantrip_os_common::scheduling::CANTRIP_DOMAIN_SCHEDULE;
 use cantrip_proc_interface::Bundle;
 use cantrip_proc_interface::BundleIdArray;
 use cantrip_proc_interface::BundleImplInterface;
+use cantrip_proc_interface::DomainStats;
 use cantrip_proc_interface::PackageManagementInterface;
 use cantrip_proc_interface::ProcessControlInterface;
 use cantrip_proc_interface::ProcessManagerError;
@@ -80,6 +83,14 @@ impl ProcessManager {
     }
 
     pub fn capacity(&self) -> usize { self.bundles.capacity() }
+
+    // Returns the BundleImplInterface's of running applications.
+    fn running(&self) -> impl Iterator<Item = &dyn BundleImplInterface> {
+        self.bundles
+            .values()
+            .filter(|bundle| bundle.state == BundleState::Running)
+            .filter_map(|bundle| bundle.bundle_impl.as_deref())
+    }
 }
 
 impl PackageManagementInterface for ProcessManager {
@@ -198,6 +209,33 @@ impl ProcessControlInterface for ProcessManager {
         Ok(result)
     }
 
+    // Ends the accounting period started by reset_domain_stats and returns
+    // the results; repeated calls return the same period.
+    // NB: applications started during the period are charged for their
+    //   time since they started.
+    fn get_domain_stats(&self) -> Result<DomainStats, ProcessManagerError> {
+        trace!("get_domain_stats");
+        let (total, idle) = self.manager.utilisation()?;
+        let mut app_busy = vec![0u64; CANTRIP_DOMAIN_SCHEDULE.num_domains()];
+        for bundle_impl in self.running() {
+            let domain = bundle_impl.domain();
+            if domain >= app_busy.len() {
+                app_busy.resize(domain + 1, 0);
+            }
+            app_busy[domain] += bundle_impl.utilisation()?;
+        }
+        Ok(DomainStats::new(&CANTRIP_DOMAIN_SCHEDULE, total, idle, &app_busy))
+    }
+
+    fn reset_domain_stats(&mut self) -> Result<(), ProcessManagerError> {
+        trace!("reset_domain_stats");
+        self.manager.reset_utilisation()?;
+        for bundle_impl in self.running() {
+            bundle_impl.reset_utilisation()?;
+        }
+        Ok(())
+    }
+
     fn capscan(&self, bundle_id: &str) -> Result<(), ProcessManagerError> {
         trace!("capscan bundle_id {}", bundle_id);
         let bid = BundleId::from_str(bundle_id);
@@ -237,6 +275,9 @@ mod tests {
         fn resume(&self) -> Result<(), ProcessManagerError> { Ok(()) }
         fn suspend(&self) -> Result<(), ProcessManagerError> { Ok(()) }
         fn capscan(&self) -> Result<(), ProcessManagerError> { Ok(()) }
+        fn domain(&self) -> usize { 0 }
+        fn utilisation(&self) -> Result<u64, ProcessManagerError> { Ok(0) }
+        fn reset_utilisation(&self) -> Result<(), ProcessManagerError> { Ok(()) }
     }
     impl ProcessManagerInterface for FakeManager {
         fn install(&mut self, pkg_buffer: *const u8, pkg_buffer_size: u32) -> Result<String, pme> {
@@ -261,6 +302,8 @@ mod tests {
         fn capscan(&mut self, bundle_impl: &mut dyn BundleImplInterface) -> Result<(), pme> {
             Ok(())
         }
+        fn utilisation(&self) -> Result<(u64, u64), pme> { Err(pme::NotSupported) }
+        fn reset_utilisation(&mut self) -> Result<(), pme> { Err(pme::NotSupported) }
     }
 
     #[test]
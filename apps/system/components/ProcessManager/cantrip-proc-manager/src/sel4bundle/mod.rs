@@ -20,6 +20,7 @@
 
 extern crate alloc;
 use alloc::string::String;
+use alloc::sync::Arc;
 use cantrip_memory_interface::cantrip_cnode_alloc;
 use cantrip_memory_interface::cantrip_object_alloc_in_toplevel;
 use cantrip_memory_interface::cantrip_object_free;
@@ -28,6 +29,7 @@ use cantrip_memory_interface::ObjDesc;
 use cantrip_memory_interface::ObjDescBundle;
 use cantrip_os_common::copyregion::CopyRegion;
 use cantrip_os_common::cspace_slot::CSpaceSlot;
+use cantrip_os_common::logger::bin_trace;
 use cantrip_os_common::scheduling::Domain;
 use cantrip_os_common::sel4_sys;
 use cantrip_proc_interface::Bundle;
@@ -38,6 +40,7 @@ use cantrip_sdk_manager::cantrip_sdk_manager_get_endpoint;
 use cantrip_sdk_manager::cantrip_sdk_manager_release_endpoint;
 use core::cmp;
 use core::mem::size_of;
+use core::ops::Range;
 use core::ptr;
 use log::{debug, error, info, trace};
 use smallvec::smallvec;
@@ -48,6 +51,7 @@ use io::Read;
 
 use sel4_sys::seL4_ASIDPool_Assign;
 use sel4_sys::seL4_CNode_CapData;
+use sel4_sys::seL4_CNode_Delete;
 use sel4_sys::seL4_CNode_Move;
 use sel4_sys::seL4_CPtr;
 use sel4_sys::seL4_CapRights;
@@ -94,6 +98,13 @@ mod arch;
 
 use arch::PAGE_SIZE;
 
+// Read-only pages shared between starts of a bundle.
+mod shared_image;
+use shared_image::is_shareable;
+pub use shared_image::SharedImage;
+use shared_image::SharedPages;
+use shared_image::SharedRun;
+
 // MCS feature support
 #[cfg_attr(feature = "CONFIG_KERNEL_MCS", path = "feature/mcs.rs")]
 #[cfg_attr(not(feature = "CONFIG_KERNEL_MCS"), path = "feature/no_mcs.rs")]
@@ -127,6 +138,28 @@ fn make_guard(guard_bits: seL4_Word, guard_size: seL4_Word) -> seL4_Word {
 
 fn roundup(a: usize, b: usize) -> usize { ((a + b - 1) / b) * b }
 
+// Fills |frame|, the page holding |vaddr|, with the next bytes of the
+// section data in |image|. The frame is temporarily mapped in |copy_region|.
+// For now we pre-zero each frame to avoid dealing with partial zero-fill
+// logic (both from zero_range and "to the left of" |data_range|).
+fn load_page(
+    image: &mut BundleImage,
+    copy_region: &mut CopyRegion,
+    frame: &ObjDesc,
+    vaddr: usize,
+    data_range: &Range<usize>,
+) -> seL4_Result {
+    copy_region.map(frame.cptr)?;
+    copy_region.as_mut()[..].fill(0);
+    if data_range.contains(&vaddr) {
+        let end = cmp::min(data_range.end - vaddr, copy_region.size());
+        image
+            .read_exact(&mut copy_region.as_mut()[..end])
+            .map_err(|_| seL4_Error::seL4_NoError)?; // XXX
+    }
+    copy_region.unmap()
+}
+
 #[allow(dead_code)]
 fn is_path_empty((root, index, depth): (seL4_CPtr, seL4_CPtr, u8)) -> bool {
     let e = unsafe { seL4_CNode_Move(root, index, depth, root, index, depth) };
@@ -185,9 +218,16 @@ const INDEX_LAST_COMMON: usize = INDEX_FRAME;
 // arch-specific descriptors start at INDEX_LAST_COMMON + 1
 
 pub struct seL4BundleImpl {
-    // Application binary pages ordered by virtual address.
+    // Application binary pages ordered by virtual address. These are
+    // owned by |shared| when it is set.
     bundle_frames: ObjDescBundle,
 
+    // Read-only pages shared with other starts of the bundle. Copies of
+    // the frame caps are mapped into our VSpace and then parked in
+    // cspace_root starting at shared_slot.
+    shared: Option<Arc<SharedImage>>,
+    shared_slot: seL4_CPtr,
+
     // Dynamically allocated CSpace contents; these start out in our
     // top-level CNode but are then moved to cspace_root.
     dynamic_objs: ObjDescBundle,
@@ -225,10 +265,20 @@ pub struct seL4BundleImpl {
     sc_period: u64,
 }
 impl seL4BundleImpl {
+    // Constructs the application from |bundle_frames|. If |shared| is
+    // provided the image is taken from it and the read-only sections are
+    // mapped from it instead of being copied; otherwise the application
+    // takes ownership of |bundle_frames|.
     pub fn new(
         bundle: &Bundle,
         bundle_frames: &ObjDescBundle,
+        shared: Option<Arc<SharedImage>>,
     ) -> Result<Self, ProcessManagerError> {
+        // NB: cloned so |shared| can be moved into the result
+        let bundle_frames = &match shared.as_ref() {
+            Some(image) => image.bundle_frames().clone(),
+            None => bundle_frames.clone(),
+        };
         trace!("seL4BundleImpl::new {:?} bundle_frames {}", bundle, bundle_frames);
 
         sel4_sys::debug_assert_slot_cnode!(bundle_frames.cnode);
@@ -238,7 +288,7 @@ impl seL4BundleImpl {
         // Calculate how many pages are needed and
         // (while we're here) the entry point.
         let (nframes, first_vaddr, entry_point) =
-            seL4BundleImpl::preprocess_bundle_image(bundle_frames);
+            seL4BundleImpl::preprocess_bundle_image(bundle_frames, shared.is_some());
         if entry_point.is_none() {
             info!(
                 "Bundle {} has no entry point, using {:#x}",
@@ -290,7 +340,7 @@ impl seL4BundleImpl {
             ObjDesc::new(seL4_SmallPageObject, 1, SLOT_SDK_FRAME),
             // Stack frames (guard frames are unpopulated PT slots).
             ObjDesc::new(seL4_SmallPageObject, STACK_COUNT, SLOT_STACK),
-            // Page frames for application binary.
+            // Page frames for application binary (less any shared pages).
             ObjDesc::new(seL4_SmallPageObject, nframes, SLOT_FRAME),
         ];
         debug_assert_eq!(INDEX_LAST_COMMON, desc.len() - 1);
@@ -314,8 +364,14 @@ impl seL4BundleImpl {
         let dynamic_objs = cantrip_object_alloc_in_toplevel(desc.into_vec())
             .map_err(|_| ProcessManagerError::StartFailed)?;
 
-        // Allocate the top-level CNode that will hold |dynamic_objs|.
-        let cspace_root_depth = dynamic_objs.count_log2();
+        // Allocate the top-level CNode that will hold |dynamic_objs|, the
+        // SDK endpoint, and the caps for any shared pages.
+        let shared_slot = sdk_ep_slot + 1;
+        let nslots = shared_slot + shared.as_ref().map_or(0, |image| image.pages().count());
+        let cspace_root_depth = cmp::max(
+            dynamic_objs.count_log2(),
+            (usize::BITS - nslots.leading_zeros()) as usize,
+        );
         let cspace_root = match cantrip_cnode_alloc(cspace_root_depth) {
             Err(e) => {
                 error!("seL4BundleImpl::new: cnode alloc failed: {:?}", e);
@@ -333,6 +389,8 @@ impl seL4BundleImpl {
 
         Ok(seL4BundleImpl {
             bundle_frames: bundle_frames.clone(),
+            shared,
+            shared_slot,
             dynamic_objs,
             cspace_root,
             cap_tcb: CSpaceSlot::new(), // Top-level dup for suspend/resume
@@ -367,7 +425,11 @@ impl seL4BundleImpl {
     // Calculate how many pages are needed and and identify the entry point.
     // While we're here also verify segments are ordered by vaddr; this
     // is required by load_application to handle gaps between segments.
-    fn preprocess_bundle_image(bundle_frames: &ObjDescBundle) -> (usize, usize, Option<usize>) {
+    // When |shared| is set read-only sections need no pages of their own.
+    fn preprocess_bundle_image(
+        bundle_frames: &ObjDescBundle,
+        shared: bool,
+    ) -> (usize, usize, Option<usize>) {
         let mut nframes = 0;
         let mut entry_point = None;
         let mut first_vaddr = usize::MAX;
@@ -381,16 +443,19 @@ impl seL4BundleImpl {
             }
             assert!(vaddr >= prev_vaddr); // XXX return error instead
             if let Some(pc) = section.entry {
-                trace!("entry point {:#x}", pc);
+                bin_trace!("entry point {:#x}", pc);
                 // XXX reject multiple entry's
                 entry_point = Some(pc);
             }
+            prev_vaddr = vaddr;
+            if shared && is_shareable(&section) {
+                continue;
+            }
             let first_frame = vaddr / PAGE_SIZE;
             let last_frame = roundup(vaddr + section.msize, PAGE_SIZE) / PAGE_SIZE;
             nframes += last_frame - first_frame;
-            prev_vaddr = vaddr;
         }
-        trace!("nframes {} first_vaddr {:#x}", nframes, first_vaddr);
+        bin_trace!("nframes {} first_vaddr {:#x}", nframes, first_vaddr);
         (nframes, first_vaddr, entry_point)
     }
 
@@ -416,10 +481,22 @@ impl seL4BundleImpl {
         let mut vaddr_top = 0;
         // Track last allocated page that was mapped to handle gaps between
         // segments. Note page_offset is accumulated to handle multiple gaps.
+        // Shared sections have no pages in |page_frames| so they are
+        // accounted as gaps.
         let mut page_adjust = 0;
         let mut prev_last_page = 0;
+        let mut shared_index = 0;
         while let Some(section) = image.next_section() {
             trace!("load {:?}", &section);
+            if let Some(shared) = self.shared.as_ref().filter(|_| is_shareable(&section)) {
+                let shared = shared.pages();
+                // Pre-loaded; just map the shared frames (nothing to copy).
+                let run = shared.run_for(&section).unwrap();
+                self.map_shared(shared, shared_index, run)?;
+                shared_index += run.npages;
+                vaddr_top = cmp::max(vaddr_top, section.vaddr + run.npages * PAGE_SIZE);
+                continue;
+            }
             let rights = &section.get_rights();
             // Section-adjusted ranges; maybe belongs in BundleImage?
             assert!(section.fsize <= section.msize);
@@ -446,23 +523,8 @@ impl seL4BundleImpl {
                 let frame_vaddr = (vaddr / PAGE_SIZE) * PAGE_SIZE;
 
                 // Temporarily map the VSpace frame into the copy region to
-                // load from the bundle image. For now we pre-zero each frame
-                // to avoid dealing with partial zero-fill logic (both from
-                // zero_range and "to the left of" data_range).
-                copy_region.map(frame.cptr)?;
-                copy_region.as_mut()[..].fill(0);
-                if data_range.contains(&vaddr) {
-                    let start = if index > 0 {
-                        0
-                    } else {
-                        vaddr - data_range.start
-                    };
-                    let end = cmp::min(data_range.end - vaddr, copy_region.size());
-                    image
-                        .read_exact(&mut copy_region.as_mut()[start..end])
-                        .map_err(|_| seL4_Error::seL4_NoError)?; // XXX
-                }
-                copy_region.unmap()?;
+                // load from the bundle image.
+                load_page(&mut image, &mut copy_region, frame, vaddr, &data_range)?;
 
                 // Frame is now setup, map it into the VSpace at the
                 // page-aligned virtual address.
@@ -479,6 +541,49 @@ impl seL4BundleImpl {
         Ok(vaddr_top)
     }
 
+    // Maps the |run| pages of |shared| (starting at frame |index|) into
+    // the VSpace. Each page is mapped through a copy of the frame cap
+    // without write rights; the copies are parked in cspace_root so
+    // unmap_shared can delete them (which also removes the mappings).
+    fn map_shared(&self, shared: &SharedPages, index: usize, run: &SharedRun) -> seL4_Result {
+        let vm_attribs = seL4_Default_VMAttributes;
+        let root = &self.dynamic_objs.objs[arch::INDEX_ROOT];
+        let frames = &shared.frames.objs[0];
+        let copy = CSpaceSlot::new();
+        for page in 0..run.npages {
+            let frame = frames.new_at(index + page);
+            let vaddr = run.vaddr + page * PAGE_SIZE;
+            copy.copy_to(shared.frames.cnode, frame.cptr, shared.frames.depth, run.rights)?;
+            trace!("map shared slot {} vaddr {:#x} {:?}", frame.cptr, vaddr, &run.rights);
+            arch::map_page(
+                &ObjDesc::new(frame.type_, 1, copy.slot),
+                root,
+                vaddr,
+                run.rights,
+                vm_attribs,
+            )?;
+            copy.move_from(
+                self.cspace_root.objs[0].cptr,
+                self.shared_slot + index + page,
+                self.cspace_root_depth,
+            )?;
+        }
+        Ok(())
+    }
+
+    // Deletes the shared page caps installed by map_shared.
+    fn unmap_shared(&self) -> seL4_Result {
+        if let Some(shared) = self.shared.as_ref() {
+            for slot in self.shared_slot..(self.shared_slot + shared.pages().count()) {
+                // NB: deleting an empty slot (e.g. start failed) is a noop
+                unsafe {
+                    seL4_CNode_Delete(self.cspace_root.objs[0].cptr, slot, self.cspace_root_depth)
+                }?;
+            }
+        }
+        Ok(())
+    }
+
     // Construct the VSpace for the application. We use a 2-level page
     // table setup with pages from the provided collection mapped according
     // to the BundleImage section headers. Following the application data
@@ -518,7 +623,7 @@ impl seL4BundleImpl {
 
         // NB: no need for actual guard pages, just leave 'em unmapped.
         let mut vaddr = roundup(vaddr_top, PAGE_SIZE);
-        trace!("guard page vaddr {:#x}", vaddr);
+        bin_trace!("guard page vaddr {:#x}", vaddr);
         vaddr += PAGE_SIZE; // Guard page below stack
 
         // Save lowest stack address for get_stack_frame_obj().
@@ -531,7 +636,7 @@ impl seL4BundleImpl {
         }
         // TODO(sleffler): sp points to the guard page, do we need - size_of::<seL4_Word>()?
         self.tcb_sp = vaddr; // NB: stack grows down (maybe arch-dependent?)
-        trace!("guard page vaddr {:#x}", vaddr);
+        bin_trace!("guard page vaddr {:#x}", vaddr);
         vaddr += PAGE_SIZE; // Guard page between stack & ipc buffer
 
         // Map IPC buffer.
@@ -714,8 +819,14 @@ impl BundleImplInterface for seL4BundleImpl {
         self.suspend()?;
         cantrip_sdk_manager_release_endpoint(&self.tcb_name)
             .map_err(|_| ProcessManagerError::StopFailed)?;
-        cantrip_object_free_in_cnode(&self.bundle_frames)
+        self.unmap_shared()
             .map_err(|_| ProcessManagerError::StopFailed)?;
+        // NB: a shared image owns bundle_frames; dropping our reference
+        //   releases it if it is no longer cached
+        if self.shared.take().is_none() {
+            cantrip_object_free_in_cnode(&self.bundle_frames)
+                .map_err(|_| ProcessManagerError::StopFailed)?;
+        }
         cantrip_object_free_in_cnode(&self.dynamic_objs)
             .map_err(|_| ProcessManagerError::StopFailed)?;
         self.cap_tcb = CSpaceSlot::new(); // NB: force drop
@@ -736,4 +847,64 @@ impl BundleImplInterface for seL4BundleImpl {
         }
         Ok(())
     }
+    fn domain(&self) -> usize { self.domain as usize }
+    fn utilisation(&self) -> Result<u64, ProcessManagerError> {
+        thread_utilisation(self.cap_tcb.slot).map(|(tcb, _, _)| tcb)
+    }
+    fn reset_utilisation(&self) -> Result<(), ProcessManagerError> {
+        reset_thread_utilisation(self.cap_tcb.slot)
+    }
+}
+
+// Returns |tcb|'s CPU time together with the (total, idle) time since
+// the last reset_system_utilisation; requires the kernel be built with
+// CONFIG_BENCHMARK_TRACK_UTILISATION (see CantripDomainTracing).
+#[allow(unused_variables)]
+fn thread_utilisation(tcb: seL4_CPtr) -> Result<(u64, u64, u64), ProcessManagerError> {
+    #[cfg(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION")]
+    unsafe {
+        use sel4_sys::seL4_BenchmarkGetUtilisation as get;
+        use sel4_sys::seL4_BenchmarkUtilisation::*;
+        sel4_sys::seL4_BenchmarkGetThreadUtilisation(tcb);
+        Ok((
+            get(TcbUtilisation),
+            get(TotalUtilisation),
+            get(IdleLocalCpuUtilisation),
+        ))
+    }
+    #[cfg(not(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION"))]
+    Err(ProcessManagerError::NotSupported)
+}
+
+#[allow(unused_variables)]
+fn reset_thread_utilisation(tcb: seL4_CPtr) -> Result<(), ProcessManagerError> {
+    #[cfg(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION")]
+    unsafe {
+        sel4_sys::seL4_BenchmarkResetThreadUtilisation(tcb);
+        Ok(())
+    }
+    #[cfg(not(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION"))]
+    Err(ProcessManagerError::NotSupported)
+}
+
+// Returns the (total, idle) CPU time since reset_system_utilisation.
+// NB: the kernel only updates the total when the log is finalized, which
+//   also stops accounting until the next reset_system_utilisation.
+pub fn system_utilisation() -> Result<(u64, u64), ProcessManagerError> {
+    #[cfg(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION")]
+    unsafe {
+        sel4_sys::seL4_BenchmarkFinalizeLog();
+    }
+    thread_utilisation(unsafe { SELF_TCB }).map(|(_, total, idle)| (total, idle))
+}
+
+// Starts a new accounting period for the idle thread & total time.
+pub fn reset_system_utilisation() -> Result<(), ProcessManagerError> {
+    #[cfg(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION")]
+    unsafe {
+        sel4_sys::seL4_BenchmarkResetLog();
+        Ok(())
+    }
+    #[cfg(not(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION"))]
+    Err(ProcessManagerError::NotSupported)
 }
@@ -0,0 +1,164 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Read-only application pages shared between starts of a bundle.
+//!
+//! The read-only sections of an application (text, rodata) never change
+//! once loaded so they are loaded once into frames held here and every
+//! VSpace started from the bundle maps copies of those frame caps (with
+//! the write right removed). The unmodified image returned by the
+//! SecurityCoordinator is kept too so a later start need not fetch it
+//! again: only the writable sections are copied from it into fresh frames.
+
+use super::load_page;
+use super::roundup;
+use super::LOAD_APPLICATION;
+use super::PAGE_SIZE;
+use alloc::vec::Vec;
+use cantrip_memory_interface::cantrip_frame_alloc;
+use cantrip_memory_interface::cantrip_object_free_in_cnode;
+use cantrip_memory_interface::cantrip_object_free_toplevel;
+use cantrip_memory_interface::ObjDescBundle;
+use cantrip_os_common::copyregion::CopyRegion;
+use cantrip_os_common::sel4_sys;
+use cantrip_proc_interface::BundleImage;
+use cantrip_proc_interface::BundleImageSection;
+use core::ptr;
+use log::{error, trace};
+
+use sel4_sys::seL4_CapRights;
+use sel4_sys::seL4_Error;
+
+// A run of shared pages mapped with the same rights.
+#[derive(Clone, Debug)]
+pub struct SharedRun {
+    pub vaddr: usize, // Page-aligned vaddr of the first page
+    pub npages: usize,
+    pub rights: seL4_CapRights,
+}
+
+// Descriptor-only view of a SharedImage; this is what a seL4BundleImpl
+// holds while it has the pages mapped. The pages are ordered by vaddr
+// and |runs| partition them.
+#[derive(Clone, Debug)]
+pub struct SharedPages {
+    pub frames: ObjDescBundle,
+    pub runs: Vec<SharedRun>,
+}
+impl SharedPages {
+    pub fn count(&self) -> usize { self.frames.count() }
+
+    // Returns the run for |section| if the section is shared.
+    pub fn run_for(&self, section: &BundleImageSection) -> Option<&SharedRun> {
+        let vaddr = (section.vaddr / PAGE_SIZE) * PAGE_SIZE;
+        self.runs.iter().find(|run| run.vaddr == vaddr)
+    }
+}
+
+// Returns true if |section| is loaded once and shared.
+pub fn is_shareable(section: &BundleImageSection) -> bool {
+    !section.is_write() && section.msize > 0
+}
+
+// Owner of a bundle's image (|bundle_frames|, as returned by the
+// SecurityCoordinator) and of the frames holding its read-only sections.
+// Both are released on drop; holders share a SharedImage through an Arc
+// so it is dropped only once no VSpace maps the pages.
+pub struct SharedImage {
+    bundle_frames: ObjDescBundle,
+    pages: SharedPages,
+}
+impl SharedImage {
+    // Loads the read-only sections of |bundle_frames|. On success the
+    // SharedImage takes ownership of |bundle_frames|. Returns None (and
+    // leaves |bundle_frames| with the caller) if there is nothing to share.
+    pub fn load(bundle_frames: &ObjDescBundle) -> Result<Option<Self>, seL4_Error> {
+        let mut runs = Vec::new();
+        let mut npages = 0;
+        let mut image = BundleImage::new(bundle_frames);
+        while let Some(section) = image.next_section() {
+            if is_shareable(&section) {
+                let first_page = section.vaddr / PAGE_SIZE;
+                let last_page = roundup(section.vaddr + section.msize, PAGE_SIZE) / PAGE_SIZE;
+                runs.push(SharedRun {
+                    vaddr: first_page * PAGE_SIZE,
+                    npages: last_page - first_page,
+                    rights: section.get_rights(),
+                });
+                npages += last_page - first_page;
+            }
+        }
+        // NB: release the BUNDLE_IMAGE window before fill re-reads the image
+        drop(image);
+        if npages == 0 {
+            return Ok(None);
+        }
+        let frames = cantrip_frame_alloc(npages * PAGE_SIZE)
+            .map_err(|_| seL4_Error::seL4_NotEnoughMemory)?;
+        let pages = SharedPages { frames, runs };
+        if let Err(e) = SharedImage::fill(&pages, bundle_frames) {
+            if let Err(e) = cantrip_object_free_toplevel(&pages.frames) {
+                error!("SharedImage: free failed: {:?}", e);
+            }
+            return Err(e);
+        }
+        trace!("shared {} pages {:?}", npages, &pages.runs);
+        Ok(Some(SharedImage {
+            bundle_frames: bundle_frames.clone(),
+            pages,
+        }))
+    }
+
+    // Copies the read-only sections from |bundle_frames| into |pages|.
+    fn fill(pages: &SharedPages, bundle_frames: &ObjDescBundle) -> Result<(), seL4_Error> {
+        let mut image = BundleImage::new(bundle_frames);
+        let mut copy_region =
+            CopyRegion::new(unsafe { ptr::addr_of_mut!(LOAD_APPLICATION[0]) }, PAGE_SIZE);
+        let frames = &pages.frames.objs[0];
+        let mut index = 0;
+        while let Some(section) = image.next_section() {
+            if !is_shareable(&section) {
+                continue;
+            }
+            let data_range = section.vaddr..(section.vaddr + section.fsize);
+            let run = pages.run_for(&section).unwrap();
+            let mut vaddr = section.vaddr;
+            for _ in 0..run.npages {
+                load_page(
+                    &mut image,
+                    &mut copy_region,
+                    &frames.new_at(index),
+                    vaddr,
+                    &data_range,
+                )?;
+                vaddr += PAGE_SIZE;
+                index += 1;
+            }
+        }
+        Ok(())
+    }
+
+    pub fn bundle_frames(&self) -> &ObjDescBundle { &self.bundle_frames }
+    pub fn pages(&self) -> &SharedPages { &self.pages }
+}
+impl Drop for SharedImage {
+    fn drop(&mut self) {
+        if let Err(e) = cantrip_object_free_toplevel(&self.pages.frames) {
+            error!("SharedImage: free failed: {:?}", e);
+        }
+        if let Err(e) = cantrip_object_free_in_cnode(&self.bundle_frames) {
+            error!("SharedImage: free image failed: {:?}", e);
+        }
+    }
+}
@@ -222,6 +222,19 @@ pub unsafe extern "C" fn run() -> ! {
                 Ok(SDKRuntimeRequest::PollForModels) => {
                     model_poll_request(app_id, request_slice, reply_slice)
                 }
+                Ok(SDKRuntimeRequest::Batch) => batch_request(app_id, request_slice, reply_slice),
+                Ok(SDKRuntimeRequest::ClockHz) => {
+                    clock_hz_request(app_id, request_slice, reply_slice)
+                }
+                Ok(SDKRuntimeRequest::ModelResults) => {
+                    model_results_request(app_id, request_slice, reply_slice)
+                }
+                Ok(SDKRuntimeRequest::ReadKeys) => {
+                    read_keys_request(app_id, request_slice, reply_slice)
+                }
+                Ok(SDKRuntimeRequest::SyncKeys) => {
+                    sync_keys_request(app_id, request_slice, reply_slice)
+                }
                 Err(_) => {
                     // TODO(b/254286176): possible ddos
                     error!("Unknown RPC request {}", info.get_label());
@@ -279,6 +292,9 @@ fn log_request(
 ) -> Result<(), SDKError> {
     let request = postcard::from_bytes::<sdk_interface::LogRequest>(request_slice)
         .map_err(deserialize_failure)?;
+    log(app_id, &request)
+}
+fn log(app_id: SDKAppId, request: &sdk_interface::LogRequest) -> Result<(), SDKError> {
     let msg = core::str::from_utf8(request.msg).map_err(|_| SDKError::InvalidString)?;
     unsafe { CANTRIP_SDK.log(app_id, msg) }
 }
@@ -298,6 +314,49 @@ fn read_key_request(
     Ok(())
 }
 
+fn read_keys_request(
+    app_id: SDKAppId,
+    request_slice: &[u8],
+    reply_slice: &mut [u8],
+) -> Result<(), SDKError> {
+    let (count, mut rest) =
+        postcard::take_from_bytes::<u32>(request_slice).map_err(deserialize_failure)?;
+    let count = count as usize;
+    if count > sdk_interface::MAX_READ_KEYS {
+        return Err(SDKError::ReadKeyFailed);
+    }
+    let mut keys = [""; sdk_interface::MAX_READ_KEYS];
+    for key in keys.iter_mut().take(count) {
+        let (k, next) = postcard::take_from_bytes::<&str>(rest).map_err(deserialize_failure)?;
+        *key = k;
+        rest = next;
+    }
+    let mut keyvals = [[0u8; sdk_interface::KEY_VALUE_DATA_SIZE]; sdk_interface::MAX_READ_KEYS];
+    let found = unsafe { CANTRIP_SDK.read_keys(app_id, &keys[..count], &mut keyvals[..count])? };
+    let mut values: [&[u8]; sdk_interface::MAX_READ_KEYS] = [&[]; sdk_interface::MAX_READ_KEYS];
+    for (i, (value, keyval)) in values
+        .iter_mut()
+        .zip(keyvals.iter())
+        .enumerate()
+        .take(count)
+    {
+        if (found & (1 << i)) != 0 {
+            *value = keyval;
+        }
+    }
+    let _ = postcard::to_slice(&sdk_interface::ReadKeysResponse { found, values }, reply_slice)
+        .map_err(serialize_failure)?;
+    Ok(())
+}
+
+fn sync_keys_request(
+    app_id: SDKAppId,
+    _request_slice: &[u8],
+    _reply_slice: &mut [u8],
+) -> Result<(), SDKError> {
+    unsafe { CANTRIP_SDK.sync_keys(app_id) }
+}
+
 fn write_key_request(
     app_id: SDKAppId,
     request_slice: &[u8],
@@ -305,6 +364,12 @@ fn write_key_request(
 ) -> Result<(), SDKError> {
     let request = postcard::from_bytes::<sdk_interface::WriteKeyRequest>(request_slice)
         .map_err(deserialize_failure)?;
+    write_key(app_id, &request)
+}
+fn write_key(app_id: SDKAppId, request: &sdk_interface::WriteKeyRequest) -> Result<(), SDKError> {
+    if request.value.len() > sdk_interface::KEY_VALUE_DATA_SIZE {
+        return Err(SDKError::WriteKeyFailed);
+    }
     // NB: the serialized data are variable length so copy to convert
     let mut keyval = [0u8; sdk_interface::KEY_VALUE_DATA_SIZE];
     keyval[..request.value.len()].copy_from_slice(request.value);
@@ -373,6 +438,17 @@ fn timer_poll_request(
     Ok(())
 }
 
+fn clock_hz_request(
+    app_id: SDKAppId,
+    _request_slice: &[u8],
+    reply_slice: &mut [u8],
+) -> Result<(), SDKError> {
+    let hz = unsafe { CANTRIP_SDK.clock_hz(app_id)? };
+    let _ = postcard::to_slice(&sdk_interface::ClockHzResponse { hz }, reply_slice)
+        .map_err(serialize_failure)?;
+    Ok(())
+}
+
 fn model_oneshot_request(
     app_id: SDKAppId,
     request_slice: &[u8],
@@ -431,6 +507,54 @@ fn model_poll_request(
     Ok(())
 }
 
+fn model_results_request(
+    app_id: SDKAppId,
+    request_slice: &[u8],
+    reply_slice: &mut [u8],
+) -> Result<(), SDKError> {
+    let request = postcard::from_bytes::<sdk_interface::ModelResultsRequest>(request_slice)
+        .map_err(deserialize_failure)?;
+    let response = unsafe { CANTRIP_SDK.model_results(app_id, request.id)? };
+    let _ = postcard::to_slice(&response, reply_slice).map_err(serialize_failure)?;
+    Ok(())
+}
+
+fn batch_request(
+    app_id: SDKAppId,
+    request_slice: &[u8],
+    reply_slice: &mut [u8],
+) -> Result<(), SDKError> {
+    let (count, mut ops) =
+        postcard::take_from_bytes::<u32>(request_slice).map_err(deserialize_failure)?;
+    let mut completed = 0;
+    let mut result = Ok(());
+    // NB: ops run in order and the first failure ends the batch.
+    while completed < count {
+        let op = match postcard::take_from_bytes::<sdk_interface::BatchOp>(ops) {
+            Ok((op, rest)) => {
+                ops = rest;
+                op
+            }
+            Err(e) => {
+                result = Err(deserialize_failure(e));
+                break;
+            }
+        };
+        result = match op {
+            sdk_interface::BatchOp::Log(request) => log(app_id, &request),
+            sdk_interface::BatchOp::WriteKey(request) => write_key(app_id, &request),
+        };
+        if result.is_err() {
+            break;
+        }
+        completed += 1;
+    }
+    // NB: the client needs the count to know where a failed batch stopped.
+    let _ = postcard::to_slice(&sdk_interface::BatchResponse { completed }, reply_slice)
+        .map_err(serialize_failure)?;
+    result
+}
+
 // SDKManager RPC handling; these arrive via CAmkES so have a C linkage.
 
 #[no_mangle]
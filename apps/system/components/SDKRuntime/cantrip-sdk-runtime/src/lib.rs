@@ -23,6 +23,7 @@ use sdk_interface::error::SDKError;
 use sdk_interface::KeyValueData;
 use sdk_interface::ModelId;
 use sdk_interface::ModelMask;
+use sdk_interface::ModelResultsResponse;
 use sdk_interface::SDKAppId;
 use sdk_interface::SDKRuntimeInterface;
 use sdk_interface::TimerDuration;
@@ -96,6 +97,21 @@ impl SDKRuntimeInterface for CantripSDKRuntime {
             .unwrap()
             .write_key(app_id, key, value)
     }
+    fn read_keys(
+        &self,
+        app_id: SDKAppId,
+        keys: &[&str],
+        keyvals: &mut [KeyValueData],
+    ) -> Result<u32, SDKError> {
+        self.runtime
+            .lock()
+            .as_ref()
+            .unwrap()
+            .read_keys(app_id, keys, keyvals)
+    }
+    fn sync_keys(&self, app_id: SDKAppId) -> Result<(), SDKError> {
+        self.runtime.lock().as_ref().unwrap().sync_keys(app_id)
+    }
     fn delete_key(&self, app_id: SDKAppId, key: &str) -> Result<(), SDKError> {
         self.runtime
             .lock()
@@ -143,6 +159,11 @@ impl SDKRuntimeInterface for CantripSDKRuntime {
         self.runtime.lock().as_mut().unwrap().timer_poll(app_id)
     }
 
+    // Clock interfaces.
+    fn clock_hz(&self, app_id: SDKAppId) -> Result<u64, SDKError> {
+        self.runtime.lock().as_ref().unwrap().clock_hz(app_id)
+    }
+
     // Model interfaces.
     fn model_oneshot(&mut self, app_id: SDKAppId, model_id: &str) -> Result<ModelId, SDKError> {
         self.runtime
@@ -176,4 +197,15 @@ impl SDKRuntimeInterface for CantripSDKRuntime {
     fn model_poll(&mut self, app_id: SDKAppId) -> Result<ModelMask, SDKError> {
         self.runtime.lock().as_mut().unwrap().model_poll(app_id)
     }
+    fn model_results(
+        &mut self,
+        app_id: SDKAppId,
+        id: ModelId,
+    ) -> Result<ModelResultsResponse, SDKError> {
+        self.runtime
+            .lock()
+            .as_mut()
+            .unwrap()
+            .model_results(app_id, id)
+    }
 }
@@ -27,6 +27,8 @@ use cantrip_sdk_manager::SDKManagerError;
 use cantrip_sdk_manager::SDKManagerInterface;
 use cantrip_security_interface::cantrip_security_delete_key;
 use cantrip_security_interface::cantrip_security_read_key;
+use cantrip_security_interface::cantrip_security_read_keys;
+use cantrip_security_interface::cantrip_security_sync_keys;
 use cantrip_security_interface::cantrip_security_write_key;
 use core::hash::BuildHasher;
 use hashbrown::HashMap;
@@ -36,13 +38,16 @@ cfg_if! {
         use cantrip_ml_interface::cantrip_mlcoord_oneshot;
         use cantrip_ml_interface::cantrip_mlcoord_periodic;
         use cantrip_ml_interface::cantrip_mlcoord_poll;
+        use cantrip_ml_interface::cantrip_mlcoord_results;
         use cantrip_ml_interface::cantrip_mlcoord_wait;
         use cantrip_ml_interface::MlCoordError;
+        use cantrip_ml_interface::MlJobMasks;
     }
 }
 cfg_if! {
     if #[cfg(feature = "timer_support")] {
         use cantrip_timer_interface::cantrip_timer_cancel;
+        use cantrip_timer_interface::cantrip_timer_clock_hz;
         use cantrip_timer_interface::cantrip_timer_oneshot;
         use cantrip_timer_interface::cantrip_timer_periodic;
         use cantrip_timer_interface::cantrip_timer_poll;
@@ -55,6 +60,7 @@ use sdk_interface::error::SDKError;
 use sdk_interface::KeyValueData;
 use sdk_interface::ModelId;
 use sdk_interface::ModelMask;
+use sdk_interface::ModelResultsResponse;
 use sdk_interface::SDKAppId;
 use sdk_interface::SDKRuntimeInterface;
 use sdk_interface::TimerDuration;
@@ -183,7 +189,10 @@ impl SDKRuntimeState {
     // Processes a mask of completed ML jobs. This is simple atm because
     // at most one model may be loaded at a time and we fix the model id
     // (and ignore multiple apps running simultaneously)..
-    pub fn process_completed_jobs(&mut self, mask: ModelMask) -> ModelMask {
+    // NB: MODEL_ID is in the first page of job ids; completions in other
+    //   pages are not for SDK apps.
+    pub fn process_completed_jobs(&mut self, masks: &MlJobMasks) -> ModelMask {
+        let mask = masks[0];
         if (mask & (1 << MODEL_ID)) != 0 {
             if let ModelState::Oneshot(_) = self.model_state {
                 self.model_state = ModelState::None;
@@ -411,6 +420,23 @@ impl SDKRuntimeInterface for SDKRuntime {
         Ok(())
     }
 
+    /// Returns the values of |keys| in the app's private key-value store.
+    fn read_keys(
+        &self,
+        app_id: SDKAppId,
+        keys: &[&str],
+        keyvals: &mut [KeyValueData],
+    ) -> Result<u32, SDKError> {
+        let app = self.get_app(app_id)?;
+        cantrip_security_read_keys(&app.app_id, keys, keyvals).map_err(|_| SDKError::ReadKeyFailed)
+    }
+
+    /// Writes back cached writes to the app's private key-value store.
+    fn sync_keys(&self, app_id: SDKAppId) -> Result<(), SDKError> {
+        let app = self.get_app(app_id)?;
+        cantrip_security_sync_keys(&app.app_id).map_err(|_| SDKError::WriteKeyFailed)
+    }
+
     /// Deletes the specified |key| in the app's private key-value store.
     fn delete_key(&self, app_id: SDKAppId, key: &str) -> Result<(), SDKError> {
         let app = self.get_app(app_id)?;
@@ -555,6 +581,23 @@ impl SDKRuntimeInterface for SDKRuntime {
         Err(SDKError::NoPlatformSupport)
     }
 
+    #[allow(unused_variables)]
+    fn clock_hz(&self, app_id: SDKAppId) -> Result<u64, SDKError> {
+        trace!("clock_hz");
+        let _ = self.get_app(app_id)?;
+        #[cfg(feature = "timer_support")]
+        {
+            // NB: 0 means the TimerService has no clock to calibrate
+            match cantrip_timer_clock_hz().map_err(map_timer_err)? {
+                0 => Err(SDKError::NoPlatformSupport),
+                hz => Ok(hz),
+            }
+        }
+
+        #[cfg(not(feature = "timer_support"))]
+        Err(SDKError::NoPlatformSupport)
+    }
+
     #[allow(unused_variables)]
     fn model_oneshot(&mut self, app_id: SDKAppId, model_id: &str) -> Result<ModelId, SDKError> {
         trace!("model_oneshot {}", model_id);
@@ -622,7 +665,7 @@ impl SDKRuntimeInterface for SDKRuntime {
             // XXX blocking
             cantrip_mlcoord_wait()
                 .map_err(map_ml_err)
-                .map(|mask| app.process_completed_jobs(mask))
+                .map(|masks| app.process_completed_jobs(&masks))
         }
 
         #[cfg(not(feature = "ml_support"))]
@@ -639,12 +682,46 @@ impl SDKRuntimeInterface for SDKRuntime {
         {
             cantrip_mlcoord_poll()
                 .map_err(map_ml_err)
-                .map(|mask| app.process_completed_jobs(mask))
+                .map(|masks| app.process_completed_jobs(&masks))
         }
 
         #[cfg(not(feature = "ml_support"))]
         Err(SDKError::NoPlatformSupport)
     }
+
+    fn model_results(
+        &mut self,
+        app_id: SDKAppId,
+        id: ModelId,
+    ) -> Result<ModelResultsResponse, SDKError> {
+        trace!("model_results {}", id);
+        let app = self.get_app(app_id)?;
+        if id != MODEL_ID {
+            return Err(SDKError::NoSuchModel);
+        }
+        let name = app.model_state.get_name().ok_or(SDKError::NoSuchModel)?;
+        #[cfg(feature = "ml_support")]
+        {
+            let results = cantrip_mlcoord_results(&app.app_id, name).map_err(map_ml_err)?;
+            let mut response = ModelResultsResponse {
+                completed: results.completed,
+                count: results.count,
+                ..Default::default()
+            };
+            for (dst, src) in response.results.iter_mut().zip(results.results.iter()) {
+                dst.return_code = src.return_code;
+                dst.epc = src.epc;
+                dst.output_length = src.output_length;
+            }
+            Ok(response)
+        }
+
+        #[cfg(not(feature = "ml_support"))]
+        {
+            let _ = name;
+            Err(SDKError::NoPlatformSupport)
+        }
+    }
 }
 
 #[cfg(feature = "timer_support")]
@@ -18,6 +18,7 @@
 
 pub mod error;
 
+pub use clock::clock_ticks_to_ns;
 pub use error::SDKError;
 pub use error::SDKRuntimeError;
 
@@ -99,6 +100,30 @@ pub struct DeleteKeyRequest<'a> {
     pub key: &'a str,
 }
 
+/// Max keys per SDKRuntimeRequest::ReadKeys.
+pub const MAX_READ_KEYS: usize = 16;
+
+/// SDKRuntimeRequest::ReadKeys
+///
+/// The request is a key count followed by that many keys (the postcard
+/// encoding of a sequence); the server decodes them one at a time so no
+/// allocation is needed. Bit N of |found| is set if keys[N] exists, in
+/// which case values[N] holds its value; other entries are empty.
+#[derive(Serialize)]
+pub struct ReadKeysRequest<'a> {
+    pub keys: &'a [&'a str],
+}
+#[derive(Serialize, Deserialize)]
+pub struct ReadKeysResponse<'a> {
+    pub found: u32,
+    #[serde(borrow)]
+    pub values: [&'a [u8]; MAX_READ_KEYS],
+}
+
+/// SDKRuntimeRequest::SyncKeys
+#[derive(Serialize, Deserialize)]
+pub struct SyncKeysRequest {}
+
 /// TimerService api's
 
 pub type TimerId = u32;
@@ -126,6 +151,16 @@ pub struct TimerWaitResponse {
     pub mask: TimerMask,
 }
 
+/// Clock api's
+
+/// SDKRuntimeRequest::ClockHz
+#[derive(Serialize, Deserialize)]
+pub struct ClockHzRequest {}
+#[derive(Serialize, Deserialize)]
+pub struct ClockHzResponse {
+    pub hz: u64,
+}
+
 /// MlCoordinator api's
 
 pub type ModelId = u32;
@@ -164,6 +199,50 @@ pub struct ModelWaitResponse {
     pub mask: ModelMask,
 }
 
+/// Max results returned by one SDKRuntimeRequest::ModelResults.
+pub const MAX_MODEL_RESULTS: usize = 8;
+
+/// Outcome of one model run.
+#[derive(Clone, Copy, Debug, Default, Serialize, Deserialize)]
+pub struct ModelResult {
+    pub return_code: u32,
+    pub epc: u32, // Fault pc if return_code is non-zero
+    pub output_length: u32,
+}
+
+/// SDKRuntimeRequest::ModelResults
+#[derive(Serialize, Deserialize)]
+pub struct ModelResultsRequest {
+    pub id: ModelId,
+}
+#[derive(Default, Serialize, Deserialize)]
+pub struct ModelResultsResponse {
+    pub completed: u32, // Runs completed since the last request
+    pub count: u32,     // Valid entries in |results|, oldest first
+    pub results: [ModelResult; MAX_MODEL_RESULTS],
+}
+
+/// Batched api's
+
+/// SDKRuntimeRequest::Batch
+///
+/// The request is an op count followed by that many BatchOp's (the postcard
+/// encoding of a sequence); the server decodes and runs the ops one at a
+/// time so no allocation is needed.
+#[derive(Serialize, Deserialize)]
+pub enum BatchOp<'a> {
+    #[serde(borrow)]
+    Log(LogRequest<'a>),
+    #[serde(borrow)]
+    WriteKey(WriteKeyRequest<'a>),
+}
+/// Returned on success and on failure, in which case the reply label is the
+/// status of the op that failed.
+#[derive(Serialize, Deserialize)]
+pub struct BatchResponse {
+    pub completed: u32, // Number of ops that succeeded
+}
+
 /// SDKRequest token sent over the seL4 IPC interface. We need repr(seL4_Word)
 /// but cannot use that so use the implied usize type instead.
 #[repr(usize)]
@@ -187,6 +266,15 @@ pub enum SDKRuntimeRequest {
     CancelModel,   // Cancel running model: [id: ModelId]
     WaitForModel,  // Wait for any running model to complete: [] -> ModelMask
     PollForModels, // Poll for running models to complete: [] -> ModelMask
+
+    Batch, // Run ops in order until one fails: [ops: &[BatchOp]] -> completed: u32
+
+    ClockHz, // Rate of the cpu time counter (sdk_clock_ticks): [] -> hz: u64
+
+    ModelResults, // Collect results of completed runs: [id: ModelId] -> ModelResultsResponse
+
+    ReadKeys, // Read several keys: [keys: &[&str]] -> ReadKeysResponse
+    SyncKeys, // Write back cached key writes: []
 }
 
 /// Rust interface for the SDKRuntime.
@@ -219,6 +307,19 @@ pub trait SDKRuntimeInterface {
     /// Writes |value| for the specified |key| in the app's private key-value store.
     fn write_key(&self, app_id: SDKAppId, key: &str, value: &KeyValueData) -> Result<(), SDKError>;
 
+    /// Reads the values of |keys| into |keyvals| in the app's private
+    /// key-value store. Returns a mask with bit N set if keys[N] exists.
+    fn read_keys(
+        &self,
+        app_id: SDKAppId,
+        keys: &[&str],
+        keyvals: &mut [KeyValueData],
+    ) -> Result<u32, SDKError>;
+
+    /// Forces any cached writes to the app's private key-value store out
+    /// to storage.
+    fn sync_keys(&self, app_id: SDKAppId) -> Result<(), SDKError>;
+
     /// Deletes the specified |key| in the app's private key-value store.
     fn delete_key(&self, app_id: SDKAppId, key: &str) -> Result<(), SDKError>;
 
@@ -243,6 +344,9 @@ pub trait SDKRuntimeInterface {
     /// Poll for any running timer that have completed.
     fn timer_poll(&mut self, app_id: SDKAppId) -> Result<TimerMask, SDKError>;
 
+    /// Returns the rate of the cpu time counter in ticks per second.
+    fn clock_hz(&self, app_id: SDKAppId) -> Result<u64, SDKError>;
+
     /// Create a one-shot run of |model_id|.
     fn model_oneshot(&mut self, app_id: SDKAppId, model_id: &str) -> Result<ModelId, SDKError>;
     /// Create a periodic (repeating) timer named |id| of |duration_ms|.
@@ -258,6 +362,13 @@ pub trait SDKRuntimeInterface {
     fn model_wait(&mut self, app_id: SDKAppId) -> Result<ModelMask, SDKError>;
     /// Poll for any running timer that have completed.
     fn model_poll(&mut self, app_id: SDKAppId) -> Result<ModelMask, SDKError>;
+    /// Returns (and clears) the results of the runs of |id| that completed
+    /// since the last call.
+    fn model_results(
+        &mut self,
+        app_id: SDKAppId,
+        id: ModelId,
+    ) -> Result<ModelResultsResponse, SDKError>;
 }
 
 /// Rust client-side request processing. Note there is no CAmkES stub to
@@ -363,6 +474,39 @@ pub fn sdk_delete_key(key: &str) -> Result<(), SDKRuntimeError> {
     sdk_request::<DeleteKeyRequest, ()>(SDKRuntimeRequest::DeleteKey, &DeleteKeyRequest { key })
 }
 
+/// Rust client-side wrapper for the read keys method. Reads up to
+/// MAX_READ_KEYS values with one request; bit N of the returned mask is
+/// set if keys[N] exists (keyvals[N] is untouched otherwise).
+#[inline]
+#[allow(dead_code)]
+pub fn sdk_read_keys(keys: &[&str], keyvals: &mut [KeyValueData]) -> Result<u32, SDKRuntimeError> {
+    if keys.len() > MAX_READ_KEYS || keyvals.len() < keys.len() {
+        return Err(SDKRuntimeError::SDKReadKeyFailed);
+    }
+    let response = sdk_request::<ReadKeysRequest, ReadKeysResponse>(
+        SDKRuntimeRequest::ReadKeys,
+        &ReadKeysRequest { keys },
+    )?;
+    for (i, keyval) in keyvals.iter_mut().enumerate().take(keys.len()) {
+        if (response.found & (1 << i)) != 0 {
+            let value = response.values[i];
+            if value.len() > KEY_VALUE_DATA_SIZE {
+                return Err(SDKRuntimeError::SDKDeserializeFailed);
+            }
+            keyval[..value.len()].copy_from_slice(value);
+        }
+    }
+    Ok(response.found)
+}
+
+/// Rust client-side wrapper for the sync keys method. Key writes may be
+/// cached by the system; this forces the app's writes out to storage.
+#[inline]
+#[allow(dead_code)]
+pub fn sdk_sync_keys() -> Result<(), SDKRuntimeError> {
+    sdk_request::<SyncKeysRequest, ()>(SDKRuntimeRequest::SyncKeys, &SyncKeysRequest {})
+}
+
 /// Rust client-side wrapper for the timer_oneshot method.
 #[inline]
 #[allow(dead_code)]
@@ -415,6 +559,37 @@ pub fn sdk_timer_poll() -> Result<TimerMask, SDKRuntimeError> {
     Ok(response.mask)
 }
 
+/// Returns the free-running cpu time counter (rdtime on RISC-V). This is
+/// read directly, without a syscall; use sdk_clock_hz or sdk_clock_ns to
+/// convert to time. Returns 0 where there is no such counter.
+#[inline]
+pub fn sdk_clock_ticks() -> u64 { clock::clock_ticks() }
+
+/// Rust client-side wrapper for the clock_hz method. The rate is
+/// calibrated by the TimerService at boot and does not change so callers
+/// should fetch it once (sdk_clock_ns does this).
+#[inline]
+#[allow(dead_code)]
+pub fn sdk_clock_hz() -> Result<u64, SDKRuntimeError> {
+    let response = sdk_request::<ClockHzRequest, ClockHzResponse>(
+        SDKRuntimeRequest::ClockHz,
+        &ClockHzRequest {},
+    )?;
+    Ok(response.hz)
+}
+
+/// Returns monotonic time in nanoseconds since the cpu time counter
+/// started (0 if there is no clock). Only the first call does an RPC
+/// (to fetch the clock rate); after that this is a counter read.
+///
+/// As with the other sdk_* calls the caller is responsible for
+/// synchronizing access (here to the cached rate).
+pub fn sdk_clock_ns() -> u64 {
+    static mut CLOCK_HZ: Option<u64> = None;
+    let hz = unsafe { *CLOCK_HZ.get_or_insert_with(|| sdk_clock_hz().unwrap_or(0)) };
+    clock_ticks_to_ns(sdk_clock_ticks(), hz)
+}
+
 /// Rust client-side wrapper for the model_oneshot method.
 #[inline]
 #[allow(dead_code)]
@@ -474,3 +649,15 @@ pub fn sdk_model_poll() -> Result<ModelMask, SDKRuntimeError> {
     )?;
     Ok(response.mask)
 }
+
+/// Rust client-side wrapper for the model_results method. A periodic
+/// model may complete several runs between wakeups; this collects all of
+/// them (up to MAX_MODEL_RESULTS) with one request.
+#[inline]
+#[allow(dead_code)]
+pub fn sdk_model_results(id: ModelId) -> Result<ModelResultsResponse, SDKRuntimeError> {
+    sdk_request::<ModelResultsRequest, ModelResultsResponse>(
+        SDKRuntimeRequest::ModelResults,
+        &ModelResultsRequest { id },
+    )
+}
@@ -18,6 +18,9 @@
 #![no_std]
 #![allow(clippy::missing_safety_doc)]
 
+extern crate alloc;
+
+use alloc::vec::Vec;
 use cantrip_os_common::camkes::Camkes;
 use cantrip_os_common::cspace_slot::CSpaceSlot;
 use cantrip_os_common::sel4_sys;
@@ -282,6 +285,67 @@ fn delete_key_request(
     unsafe { CANTRIP_SECURITY.delete_key(request.bundle_id, request.key) }
 }
 
+fn read_keys_request(
+    request_buffer: &[u8],
+    reply_buffer: &mut [u8],
+) -> Result<(), SecurityRequestError> {
+    let request =
+        postcard::from_bytes::<ReadKeysRequest>(request_buffer).map_err(deserialize_failure)?;
+
+    trace!("READ KEYS bundle_id {} keys {:?}", request.bundle_id, request.keys);
+    if request.keys.len() > MAX_READ_KEYS {
+        return Err(SreKeyInvalid);
+    }
+    // NB: copy each value out as the cache may evict them.
+    let mut values = Vec::with_capacity(request.keys.len());
+    for key in &request.keys {
+        match unsafe { CANTRIP_SECURITY.read_key(request.bundle_id, key) } {
+            Ok(value) => values.push(Some(*value)),
+            Err(SreKeyNotFound) => values.push(None),
+            Err(e) => return Err(e),
+        }
+    }
+    let response = ReadKeysResponse {
+        values: values.iter().map(|v| v.as_ref().map(|v| &v[..])).collect(),
+    };
+    let _ = postcard::to_slice(&response, reply_buffer).map_err(serialize_failure)?;
+    Ok(())
+}
+
+fn write_keys_request(
+    request_buffer: &[u8],
+    _reply_buffer: &mut [u8],
+) -> Result<(), SecurityRequestError> {
+    let request =
+        postcard::from_bytes::<WriteKeysRequest>(request_buffer).map_err(deserialize_failure)?;
+
+    trace!(
+        "WRITE KEYS bundle_id {} count {}",
+        request.bundle_id,
+        request.keys.len()
+    );
+    for (key, value) in &request.keys {
+        if value.len() > KEY_VALUE_DATA_SIZE {
+            return Err(SreValueInvalid);
+        }
+        let mut keyval = [0u8; KEY_VALUE_DATA_SIZE];
+        keyval[..value.len()].copy_from_slice(value);
+        unsafe { CANTRIP_SECURITY.write_key(request.bundle_id, key, &keyval) }?;
+    }
+    Ok(())
+}
+
+fn sync_keys_request(
+    request_buffer: &[u8],
+    _reply_buffer: &mut [u8],
+) -> Result<(), SecurityRequestError> {
+    let request =
+        postcard::from_bytes::<SyncKeysRequest>(request_buffer).map_err(deserialize_failure)?;
+
+    trace!("SYNC KEYS bundle_id {}", request.bundle_id);
+    unsafe { CANTRIP_SECURITY.sync_keys(request.bundle_id) }
+}
+
 fn test_mailbox_request() -> Result<(), SecurityRequestError> {
     trace!("TEST MAILBOX");
     unsafe { CANTRIP_SECURITY.test_mailbox() }
@@ -318,6 +382,9 @@ pub unsafe extern "C" fn security_request(
         SecurityRequest::SrDeleteKey => delete_key_request(request_buffer, reply_buffer),
         SecurityRequest::SrTestMailbox => test_mailbox_request(),
         SecurityRequest::SrCapScan => capscan_request(),
+        SecurityRequest::SrReadKeys => read_keys_request(request_buffer, reply_buffer),
+        SecurityRequest::SrWriteKeys => write_keys_request(request_buffer, reply_buffer),
+        SecurityRequest::SrSyncKeys => sync_keys_request(request_buffer, reply_buffer),
     }
     .map_or_else(|e| e, |_v| SecurityRequestError::SreSuccess)
 }
@@ -216,7 +216,11 @@ impl SecurityCoordinatorInterface for FakeSecurityCoordinator {
         // return is as though it was newly instantiated from flash.
         deep_copy(&model_data.pkg_contents).map_err(|_| SecurityRequestError::SreLoadModelFailed)
     }
-    fn read_key(&self, bundle_id: &str, key: &str) -> Result<&KeyValueData, SecurityRequestError> {
+    fn read_key(
+        &mut self,
+        bundle_id: &str,
+        key: &str,
+    ) -> Result<&KeyValueData, SecurityRequestError> {
         let bundle = self.get_bundle(bundle_id)?;
         bundle
             .keys
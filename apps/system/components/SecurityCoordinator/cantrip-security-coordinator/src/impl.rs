@@ -16,17 +16,63 @@
 
 use cantrip_memory_interface::cantrip_frame_alloc;
 use cantrip_memory_interface::cantrip_object_free_toplevel;
+use cantrip_memory_interface::ObjDesc;
+use cantrip_memory_interface::ObjDescBundle;
+use cantrip_os_common::copyregion::CopyRegion;
 use cantrip_os_common::sel4_sys;
 use cantrip_security_interface::*;
+use core::mem::size_of;
+use core::ptr;
 use log::trace;
 
 use sel4_sys::seL4_CPtr;
+use sel4_sys::seL4_PageBits;
 use sel4_sys::seL4_Page_GetAddress;
+use sel4_sys::seL4_Word;
+
+const PAGE_SIZE: usize = 1 << seL4_PageBits;
 
 extern "C" {
     static SECURITY_RECV_SLOT: seL4_CPtr;
+
+    // Region for mapping mailbox message buffers (shared with fakeimpl's deep_copy).
+    static mut DEEP_COPY_SRC: [seL4_Word; PAGE_SIZE / size_of::<seL4_Word>()];
+
+    // MailboxDriver queued transfers (see MailboxInterface.camkes).
+    fn mailbox_api_post(request_paddr: u32, request_size: u32, tag: *mut u32) -> bool;
+    fn mailbox_api_wait(tag: u32, response_paddr: *mut u32, response_size: *mut u32) -> bool;
+    fn mailbox_api_abandon(tag: u32) -> bool;
+}
+
+// Queues the message at |paddr| to the security core; returns the tag
+// used to collect the response with mailbox_wait. Several messages may be
+// in flight at once.
+fn mailbox_post(paddr: u32, size: u32) -> Result<u32, SecurityRequestError> {
+    let mut tag: u32 = 0;
+    if unsafe { mailbox_api_post(paddr, size, &mut tag as *mut u32) } {
+        Ok(tag)
+    } else {
+        Err(SecurityRequestError::SreTestFailed) // XXX no mailbox-specific error
+    }
+}
+
+// Waits for the response to the message posted as |tag|; returns the
+// response's (paddr, size).
+fn mailbox_wait(tag: u32) -> Result<(u32, u32), SecurityRequestError> {
+    let mut response_paddr: u32 = 0;
+    let mut response_size: u32 = 0;
+    if unsafe {
+        mailbox_api_wait(tag, &mut response_paddr as *mut u32, &mut response_size as *mut u32)
+    } {
+        Ok((response_paddr, response_size))
+    } else {
+        Err(SecurityRequestError::SreTestFailed)
+    }
 }
 
+// Drops the message posted as |tag| without collecting its response.
+fn mailbox_abandon(tag: u32) { let _ = unsafe { mailbox_api_abandon(tag) }; }
+
 pub struct SeL4SecurityCoordinator {
     // TODO(sleffler): mailbox api state
 }
@@ -59,7 +105,7 @@ impl SecurityCoordinatorInterface for SeL4SecurityCoordinator {
         Err(SreLoadModelFailed)
     }
     fn read_key(
-        &self,
+        &mut self,
         _bundle_id: &str,
         _key: &str,
     ) -> Result<&KeyValueData, SecurityRequestError> {
@@ -80,75 +126,110 @@ impl SecurityCoordinatorInterface for SeL4SecurityCoordinator {
     fn test_mailbox(&mut self) -> Result<(), SecurityRequestError> {
         trace!("test_mailbox_command()");
 
-        const MESSAGE_SIZE_DWORDS: usize = 17; // Just a random message size for testing.
+        // Allocate a 4k page per message to serve as the message buffers.
+        let frame_bundle = cantrip_frame_alloc(TEST_MESSAGE_COUNT * PAGE_SIZE)
+            .map_err(|_| SecurityRequestError::SreTestFailed)?;
+        trace!("test_mailbox: Frame {:?}", frame_bundle);
 
-        extern "C" {
-            fn mailbox_api_send(paddr: u32, size: u32);
-            fn mailbox_api_receive(paddr: *mut u32, size: *mut u32);
-        }
+        // NB: the test collects every message it posts so the frames are
+        // no longer in flight regardless of the outcome.
+        let result = test_mailbox_messages(&frame_bundle.objs[0]);
 
-        // Allocate a 4k page to serve as our message buffer.
-        let frame_bundle =
-            cantrip_frame_alloc(PAGE_SIZE).map_err(|_| SecurityRequestError::SreTestFailed)?;
-        trace!("test_mailbox: Frame {:?}", frame_bundle);
+        // Done, free the message buffers.
+        let freed = cantrip_object_free_toplevel(&frame_bundle)
+            .map_err(|_| SecurityRequestError::SreTestFailed);
+        result.and(freed)?;
 
-        unsafe {
-            // Map the message buffer into our copyregion so we can access it.
-            // NB: re-use one of the deep_copy copyregions.
-            let mut msg_region = CopyRegion::new(ptr::addr_of_mut!(DEEP_COPY_SRC[0]), PAGE_SIZE);
-            msg_region
-                .map(frame_bundle.objs[0].cptr)
-                .map_err(|_| SecurityRequestError::SreTestFailed)?;
+        trace!("test_mailbox_command() done");
+        Ok(())
+    }
+}
 
+const TEST_MESSAGE_SIZE_DWORDS: usize = 17; // Just a random message size for testing.
+const TEST_MESSAGE_COUNT: usize = 4; // Messages in flight at once.
+const TEST_OFFSET_A: usize = 0;
+const TEST_OFFSET_B: usize = TEST_MESSAGE_SIZE_DWORDS - 1;
+
+// Posts one message per page of |frames| and collects the responses.
+// Every message that was posted is collected, even if an earlier step
+// fails, so no transfer (or page) is left in flight in the MailboxDriver.
+fn test_mailbox_messages(frames: &ObjDesc) -> Result<(), SecurityRequestError> {
+    // Map the message buffers into our copyregion so we can access them.
+    // NB: re-use one of the deep_copy copyregions.
+    let mut msg_region = CopyRegion::new(unsafe { ptr::addr_of_mut!(DEEP_COPY_SRC[0]) }, PAGE_SIZE);
+
+    // Write each message buffer and queue its _physical_ address to the
+    // security core; all of them are in flight before any is collected.
+    let mut result = Ok(());
+    let mut tags = [None; TEST_MESSAGE_COUNT];
+    for (i, tag) in tags.iter_mut().enumerate() {
+        let frame = frames.new_at(i);
+        let message = msg_region.map(frame.cptr).and_then(|_| {
             let message_ptr = msg_region.as_word_mut();
+            message_ptr[TEST_OFFSET_A] = 0xDEADBEEF;
+            message_ptr[TEST_OFFSET_B] = 0xF00DCAFE;
+            msg_region.unmap()
+        });
+        if message.is_err() {
+            result = Err(SecurityRequestError::SreTestFailed);
+            break;
+        }
 
-            // Write to the message buffer through the copyregion.
-            let offset_a = 0;
-            let offset_b = MESSAGE_SIZE_DWORDS - 1;
-            message_ptr[offset_a] = 0xDEADBEEF;
-            message_ptr[offset_b] = 0xF00DCAFE;
-            trace!(
-                "test_mailbox: old buf contents  0x{:X} 0x{:X}",
-                message_ptr[offset_a],
-                message_ptr[offset_b]
-            );
-
-            // Send the _physical_ address of the message buffer to the security
-            // core.
-            let paddr = seL4_Page_GetAddress(frame_bundle.objs[0].cptr);
-            mailbox_api_send(paddr.paddr as u32, (MESSAGE_SIZE_DWORDS * size_of::<u32>()) as u32);
-
-            // Wait for the response to arrive.
-            let mut response_paddr: u32 = 0;
-            let mut response_size: u32 = 0;
-            mailbox_api_receive(&mut response_paddr as *mut u32, &mut response_size as *mut u32);
-
-            // The security core should have replaced the first and last dwords
-            // with 0x12345678 and 0x87654321.
-            trace!("test_mailbox: expected contents 0x12345678 0x87654321");
-            trace!(
-                "test_mailbox: new buf contents  0x{:X} 0x{:X}",
-                message_ptr[offset_a],
-                message_ptr[offset_b]
-            );
-
-            let dword_a = message_ptr[offset_a];
-            let dword_b = message_ptr[offset_b];
-
-            msg_region
-                .unmap()
-                .map_err(|_| SecurityRequestError::SreTestFailed)?;
-
-            // Done, free the message buffer.
-            cantrip_object_free_toplevel(&frame_bundle)
-                .map_err(|_| SecurityRequestError::SreTestFailed)?;
-
-            if dword_a != 0x12345678 || dword_b != 0x87654321 {
-                return Err(SecurityRequestError::SreTestFailed);
+        let paddr = unsafe { seL4_Page_GetAddress(frame.cptr) };
+        match mailbox_post(
+            paddr.paddr as u32,
+            (TEST_MESSAGE_SIZE_DWORDS * size_of::<u32>()) as u32,
+        ) {
+            Ok(posted) => *tag = Some(posted),
+            Err(e) => {
+                result = Err(e);
+                break;
             }
         }
+    }
 
-        trace!("test_mailbox_command() done");
-        Ok(())
+    // Collect the responses newest first; each is matched to its
+    // request by the driver regardless of the order they arrive. The
+    // security core should have replaced the first and last dwords
+    // with 0x12345678 and 0x87654321.
+    trace!("test_mailbox: expected contents 0x12345678 0x87654321");
+    for (i, tag) in tags.iter().enumerate().rev() {
+        let tag = match tag {
+            Some(tag) => *tag,
+            None => continue,
+        };
+        let (response_paddr, response_size) = match mailbox_wait(tag) {
+            Ok(response) => response,
+            Err(e) => {
+                // NB: drop the transfer so its slot is not leaked
+                mailbox_abandon(tag);
+                result = Err(e);
+                continue;
+            }
+        };
+        if result.is_err() {
+            continue; // NB: still collect the rest
+        }
+        let passed = match msg_region.map(frames.new_at(i).cptr) {
+            Ok(_) => {
+                let message_ptr = msg_region.as_word_mut();
+                let dword_a = message_ptr[TEST_OFFSET_A];
+                let dword_b = message_ptr[TEST_OFFSET_B];
+                trace!(
+                    "test_mailbox: tag {} paddr 0x{:X} size {} new buf contents  0x{:X} 0x{:X}",
+                    tag,
+                    response_paddr,
+                    response_size,
+                    dword_a,
+                    dword_b
+                );
+                msg_region.unmap().is_ok() && dword_a == 0x12345678 && dword_b == 0x87654321
+            }
+            Err(_) => false,
+        };
+        if !passed {
+            result = Err(SecurityRequestError::SreTestFailed);
+        }
     }
+    result
 }
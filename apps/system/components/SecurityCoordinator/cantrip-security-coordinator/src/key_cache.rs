@@ -0,0 +1,346 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Bounded cache of key-value pairs held in front of the backing store.
+//!
+//! Reads of a cached key are answered without going to the backing store
+//! (for the real implementation a mailbox round-trip to the security
+//! core). Writes of a key that is already cached update the entry and mark
+//! it dirty; repeated writes coalesce into one write-back. Dirty entries
+//! are written back when evicted, when too many are pending, when they
+//! have been dirty for KEY_CACHE_MAX_DIRTY_AGE cache accesses, or when the
+//! owner asks (sync). The SecurityCoordinator has no thread or timer of
+//! its own so a write stays dirty until one of these happens; a client
+//! that needs a write to be durable now should sync. Writes of keys not
+//! in the cache go straight to the backing store so errors like an unknown
+//! bundle are reported to the writer rather than at some later write-back.
+
+use alloc::string::String;
+use alloc::string::ToString;
+use alloc::vec::Vec;
+use cantrip_security_interface::KeyValueData;
+use cantrip_security_interface::SecurityRequestError;
+use log::error;
+
+// Max entries held; each is a bit over KEY_VALUE_DATA_SIZE bytes of heap.
+pub const KEY_CACHE_CAPACITY: usize = 16;
+
+// Dirty entries allowed before all are written back.
+pub const KEY_CACHE_MAX_DIRTY: usize = 8;
+
+// Cache accesses (lookups, fills & updates) an entry may stay dirty
+// before it is written back.
+pub const KEY_CACHE_MAX_DIRTY_AGE: u32 = 32;
+
+struct CacheEntry {
+    bundle_id: String,
+    key: String,
+    value: KeyValueData,
+    dirty: bool,
+    dirty_since: u32, // KeyCache::use_count when it became dirty
+    last_used: u32,   // KeyCache::use_count at last access
+}
+
+pub struct KeyCache {
+    entries: Vec<CacheEntry>,
+    use_count: u32, // Clock for LRU eviction
+    hits: u32,
+    misses: u32,
+    writebacks: u32,
+}
+
+impl KeyCache {
+    pub const fn new() -> Self {
+        KeyCache {
+            entries: Vec::new(),
+            use_count: 0,
+            hits: 0,
+            misses: 0,
+            writebacks: 0,
+        }
+    }
+
+    pub fn len(&self) -> usize { self.entries.len() }
+    pub fn hits(&self) -> u32 { self.hits }
+    pub fn misses(&self) -> u32 { self.misses }
+    pub fn writebacks(&self) -> u32 { self.writebacks }
+    pub fn dirty(&self) -> usize { self.entries.iter().filter(|e| e.dirty).count() }
+
+    fn find(&self, bundle_id: &str, key: &str) -> Option<usize> {
+        self.entries
+            .iter()
+            .position(|e| e.key == key && e.bundle_id == bundle_id)
+    }
+
+    fn touch(&mut self, index: usize) {
+        self.use_count = self.use_count.wrapping_add(1);
+        self.entries[index].last_used = self.use_count;
+    }
+
+    /// Returns the index of the entry for |key|, counting a hit or miss.
+    pub fn lookup(&mut self, bundle_id: &str, key: &str) -> Option<usize> {
+        match self.find(bundle_id, key) {
+            Some(index) => {
+                self.hits += 1;
+                self.touch(index);
+                Some(index)
+            }
+            None => {
+                self.misses += 1;
+                None
+            }
+        }
+    }
+
+    /// Returns the value of the entry at |index| (from lookup or fill).
+    pub fn value(&self, index: usize) -> &KeyValueData { &self.entries[index].value }
+
+    /// Updates |key| if it is cached; the entry becomes dirty. Returns
+    /// false if the key is not cached (the caller must write it through
+    /// and then fill()).
+    pub fn update(&mut self, bundle_id: &str, key: &str, value: &KeyValueData) -> bool {
+        match self.find(bundle_id, key) {
+            Some(index) => {
+                self.touch(index);
+                let use_count = self.use_count;
+                let entry = &mut self.entries[index];
+                entry.value = *value;
+                if !entry.dirty {
+                    entry.dirty = true;
+                    entry.dirty_since = use_count;
+                }
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// Adds a clean entry for |key| (just read from or written to the
+    /// backing store), evicting the least recently used entry if the cache
+    /// is full. An evicted dirty entry is passed to |write| first. Returns
+    /// the index of the entry.
+    pub fn fill<W>(&mut self, bundle_id: &str, key: &str, value: &KeyValueData, write: W) -> usize
+    where
+        W: FnMut(&str, &str, &KeyValueData) -> Result<(), SecurityRequestError>,
+    {
+        if let Some(index) = self.find(bundle_id, key) {
+            self.entries[index].value = *value;
+            self.touch(index);
+            return index;
+        }
+        if self.entries.len() == KEY_CACHE_CAPACITY {
+            self.evict(write);
+        }
+        self.entries.push(CacheEntry {
+            bundle_id: bundle_id.to_string(),
+            key: key.to_string(),
+            value: *value,
+            dirty: false,
+            dirty_since: 0,
+            last_used: 0,
+        });
+        let index = self.entries.len() - 1;
+        self.touch(index);
+        index
+    }
+
+    fn evict<W>(&mut self, mut write: W)
+    where
+        W: FnMut(&str, &str, &KeyValueData) -> Result<(), SecurityRequestError>,
+    {
+        let use_count = self.use_count;
+        if let Some(index) = (0..self.entries.len())
+            .max_by_key(|&i| use_count.wrapping_sub(self.entries[i].last_used))
+        {
+            let entry = self.entries.swap_remove(index);
+            if entry.dirty {
+                self.write_back(&entry, &mut write);
+            }
+        }
+    }
+
+    fn write_back<W>(&mut self, entry: &CacheEntry, write: &mut W)
+    where
+        W: FnMut(&str, &str, &KeyValueData) -> Result<(), SecurityRequestError>,
+    {
+        self.writebacks += 1;
+        if let Err(e) = write(&entry.bundle_id, &entry.key, &entry.value) {
+            // NB: the write was acknowledged long ago; all we can do is log.
+            error!("write-back of {}:{} failed: {:?}", &entry.bundle_id, &entry.key, e);
+        }
+    }
+
+    /// Writes back the dirty entries of |bundle_id| (all bundles if None).
+    pub fn flush<W>(&mut self, bundle_id: Option<&str>, write: W)
+    where
+        W: FnMut(&str, &str, &KeyValueData) -> Result<(), SecurityRequestError>,
+    {
+        self.flush_if(|e| bundle_id.map_or(true, |b| e.bundle_id == b), write);
+    }
+
+    // Writes back the dirty entries selected by |pred|.
+    fn flush_if<P, W>(&mut self, pred: P, mut write: W)
+    where
+        P: Fn(&CacheEntry) -> bool,
+        W: FnMut(&str, &str, &KeyValueData) -> Result<(), SecurityRequestError>,
+    {
+        let mut entries = core::mem::take(&mut self.entries);
+        for entry in entries.iter_mut().filter(|e| e.dirty && pred(e)) {
+            self.write_back(entry, &mut write);
+            entry.dirty = false;
+        }
+        self.entries = entries;
+    }
+
+    /// Writes back all dirty entries if more than KEY_CACHE_MAX_DIRTY are
+    /// pending, otherwise those dirty for over KEY_CACHE_MAX_DIRTY_AGE
+    /// accesses. Called after each access.
+    pub fn maybe_flush<W>(&mut self, write: W)
+    where
+        W: FnMut(&str, &str, &KeyValueData) -> Result<(), SecurityRequestError>,
+    {
+        if self.dirty() > KEY_CACHE_MAX_DIRTY {
+            self.flush(None, write);
+        } else {
+            let use_count = self.use_count;
+            self.flush_if(
+                |e| use_count.wrapping_sub(e.dirty_since) > KEY_CACHE_MAX_DIRTY_AGE,
+                write,
+            );
+        }
+    }
+
+    /// Drops any entry for |key| without writing it back.
+    pub fn invalidate(&mut self, bundle_id: &str, key: &str) {
+        if let Some(index) = self.find(bundle_id, key) {
+            self.entries.swap_remove(index);
+        }
+    }
+
+    /// Drops all entries for |bundle_id| without writing them back.
+    pub fn invalidate_bundle(&mut self, bundle_id: &str) {
+        self.entries.retain(|e| e.bundle_id != bundle_id);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use alloc::vec;
+    use cantrip_security_interface::KEY_VALUE_DATA_SIZE;
+
+    fn value(byte: u8) -> KeyValueData { [byte; KEY_VALUE_DATA_SIZE] }
+
+    fn get(cache: &mut KeyCache, bundle_id: &str, key: &str) -> Option<KeyValueData> {
+        cache
+            .lookup(bundle_id, key)
+            .map(|index| *cache.value(index))
+    }
+
+    #[test]
+    fn hit_and_miss() {
+        let mut cache = KeyCache::new();
+        assert!(get(&mut cache, "b", "k").is_none());
+        cache.fill("b", "k", &value(1), |_, _, _| panic!("no write-back"));
+        assert_eq!(get(&mut cache, "b", "k"), Some(value(1)));
+        assert!(get(&mut cache, "other", "k").is_none());
+        assert_eq!((cache.hits(), cache.misses()), (1, 2));
+    }
+
+    #[test]
+    fn coalesces_writes() {
+        let mut cache = KeyCache::new();
+        cache.fill("b", "k", &value(1), |_, _, _| Ok(()));
+        for i in 2..10 {
+            assert!(cache.update("b", "k", &value(i)));
+        }
+        assert!(!cache.update("b", "missing", &value(0)));
+        assert_eq!(cache.dirty(), 1);
+
+        let mut written = vec![];
+        cache.flush(Some("b"), |b, k, v| {
+            written.push((b.to_string(), k.to_string(), v[0]));
+            Ok(())
+        });
+        assert_eq!(written, vec![("b".to_string(), "k".to_string(), 9)]);
+        assert_eq!(cache.dirty(), 0);
+        assert_eq!(get(&mut cache, "b", "k"), Some(value(9)));
+    }
+
+    #[test]
+    fn evicts_lru_with_write_back() {
+        let mut cache = KeyCache::new();
+        for i in 0..KEY_CACHE_CAPACITY {
+            cache.fill("b", &i.to_string(), &value(i as u8), |_, _, _| Ok(()));
+        }
+        assert!(cache.update("b", "0", &value(0xff)));
+        // Key "1" is now the least recently used.
+        let mut written = vec![];
+        cache.fill("b", "new", &value(0), |_, k, _| {
+            written.push(k.to_string());
+            Ok(())
+        });
+        assert!(written.is_empty());
+        assert!(get(&mut cache, "b", "1").is_none());
+        assert_eq!(cache.len(), KEY_CACHE_CAPACITY);
+
+        // Touch everything but "0" so the dirty entry is evicted next.
+        for i in 2..KEY_CACHE_CAPACITY {
+            assert!(get(&mut cache, "b", &i.to_string()).is_some());
+        }
+        assert!(get(&mut cache, "b", "new").is_some());
+        cache.fill("b", "newer", &value(0), |_, k, v| {
+            written.push(k.to_string());
+            assert_eq!(v[0], 0xff);
+            Ok(())
+        });
+        assert_eq!(written, vec!["0".to_string()]);
+        assert_eq!(cache.writebacks(), 1);
+    }
+
+    #[test]
+    fn writes_back_aged_dirty() {
+        let mut cache = KeyCache::new();
+        cache.fill("b", "k", &value(1), |_, _, _| Ok(()));
+        cache.fill("b", "other", &value(1), |_, _, _| Ok(()));
+        assert!(cache.update("b", "k", &value(2)));
+        // Further writes do not restart the clock.
+        assert!(cache.update("b", "k", &value(3)));
+        for _ in 0..KEY_CACHE_MAX_DIRTY_AGE - 1 {
+            assert!(get(&mut cache, "b", "other").is_some());
+            cache.maybe_flush(|_, _, _| panic!("no write-back"));
+        }
+        assert!(get(&mut cache, "b", "other").is_some());
+        let mut written = vec![];
+        cache.maybe_flush(|_, k, v| {
+            written.push((k.to_string(), v[0]));
+            Ok(())
+        });
+        assert_eq!(written, vec![("k".to_string(), 3)]);
+        assert_eq!(cache.dirty(), 0);
+    }
+
+    #[test]
+    fn invalidate_drops_dirty() {
+        let mut cache = KeyCache::new();
+        cache.fill("a", "k", &value(1), |_, _, _| Ok(()));
+        cache.fill("b", "k", &value(1), |_, _, _| Ok(()));
+        assert!(cache.update("a", "k", &value(2)));
+        assert!(cache.update("b", "k", &value(2)));
+        cache.invalidate_bundle("a");
+        cache.invalidate("b", "k");
+        assert_eq!(cache.len(), 0);
+        cache.flush(None, |_, _, _| panic!("no write-back"));
+    }
+}
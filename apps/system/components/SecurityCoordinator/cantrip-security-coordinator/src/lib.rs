@@ -25,6 +25,7 @@ use cantrip_memory_interface::ObjDescBundle;
 use cantrip_security_interface::KeyValueData;
 use cantrip_security_interface::SecurityCoordinatorInterface;
 use cantrip_security_interface::SecurityRequestError;
+use key_cache::KeyCache;
 
 #[cfg(all(feature = "fake", feature = "sel4"))]
 compile_error!("features \"fake\" and \"sel4\" are mutually exclusive");
@@ -34,24 +35,41 @@ compile_error!("features \"fake\" and \"sel4\" are mutually exclusive");
 mod platform;
 pub use platform::CantripSecurityCoordinatorInterface;
 
+mod key_cache;
+
 #[cfg(not(test))]
 pub static mut CANTRIP_SECURITY: CantripSecurityCoordinator = CantripSecurityCoordinator::empty();
 
 // CantripSecurityCoordinator bundles an instance of the SecurityCoordinator that operates
 // on CantripOS interfaces. There is a two-step dance to setup an instance because we want
 // CANTRIP_SECURITY static.
+// Key-value requests go through a write-back cache (see key_cache.rs).
 // NB: no locking is done; we assume the caller/user is single-threaded
 pub struct CantripSecurityCoordinator {
     manager: Option<Box<dyn SecurityCoordinatorInterface + Sync>>,
+    keys: KeyCache,
 }
 impl CantripSecurityCoordinator {
     // Constructs a partially-initialized instance; to complete call init().
     // This is needed because we need a const fn for static setup.
-    const fn empty() -> CantripSecurityCoordinator { CantripSecurityCoordinator { manager: None } }
+    const fn empty() -> CantripSecurityCoordinator {
+        CantripSecurityCoordinator {
+            manager: None,
+            keys: KeyCache::new(),
+        }
+    }
 
     pub fn init(&mut self) {
         self.manager = Some(Box::new(CantripSecurityCoordinatorInterface::new()));
     }
+
+    // Writes back any cached key writes for |bundle_id|.
+    pub fn sync_keys(&mut self, bundle_id: &str) -> Result<(), SecurityRequestError> {
+        let manager = self.manager.as_mut().unwrap();
+        self.keys
+            .flush(Some(bundle_id), |b, k, v| manager.write_key(b, k, v));
+        Ok(())
+    }
 }
 impl SecurityCoordinatorInterface for CantripSecurityCoordinator {
     fn install(&mut self, pkg_contents: &ObjDescBundle) -> Result<String, SecurityRequestError> {
@@ -79,6 +97,8 @@ impl SecurityCoordinatorInterface for CantripSecurityCoordinator {
             .install_model(app_id, model_id, pkg_contents)
     }
     fn uninstall(&mut self, bundle_id: &str) -> Result<(), SecurityRequestError> {
+        // NB: the bundle's keys go with it so pending writes are dropped.
+        self.keys.invalidate_bundle(bundle_id);
         self.manager.as_mut().unwrap().uninstall(bundle_id)
     }
     fn size_buffer(&self, bundle_id: &str) -> Result<usize, SecurityRequestError> {
@@ -100,8 +120,23 @@ impl SecurityCoordinatorInterface for CantripSecurityCoordinator {
             .unwrap()
             .load_model(bundle_id, model_id)
     }
-    fn read_key(&self, bundle_id: &str, key: &str) -> Result<&KeyValueData, SecurityRequestError> {
-        self.manager.as_ref().unwrap().read_key(bundle_id, key)
+    fn read_key(
+        &mut self,
+        bundle_id: &str,
+        key: &str,
+    ) -> Result<&KeyValueData, SecurityRequestError> {
+        let manager = self.manager.as_mut().unwrap();
+        let index = match self.keys.lookup(bundle_id, key) {
+            Some(index) => index,
+            None => {
+                let value = *manager.read_key(bundle_id, key)?;
+                self.keys
+                    .fill(bundle_id, key, &value, |b, k, v| manager.write_key(b, k, v))
+            }
+        };
+        // NB: reads also age out dirty entries; flushing leaves |index| valid
+        self.keys.maybe_flush(|b, k, v| manager.write_key(b, k, v));
+        Ok(self.keys.value(index))
     }
     fn write_key(
         &mut self,
@@ -109,12 +144,18 @@ impl SecurityCoordinatorInterface for CantripSecurityCoordinator {
         key: &str,
         value: &KeyValueData,
     ) -> Result<(), SecurityRequestError> {
-        self.manager
-            .as_mut()
-            .unwrap()
-            .write_key(bundle_id, key, value)
+        let manager = self.manager.as_mut().unwrap();
+        if !self.keys.update(bundle_id, key, value) {
+            // First write of the key goes through so errors are returned.
+            manager.write_key(bundle_id, key, value)?;
+            self.keys
+                .fill(bundle_id, key, value, |b, k, v| manager.write_key(b, k, v));
+        }
+        self.keys.maybe_flush(|b, k, v| manager.write_key(b, k, v));
+        Ok(())
     }
     fn delete_key(&mut self, bundle_id: &str, key: &str) -> Result<(), SecurityRequestError> {
+        self.keys.invalidate(bundle_id, key);
         self.manager.as_mut().unwrap().delete_key(bundle_id, key)
     }
     fn test_mailbox(&mut self) -> Result<(), SecurityRequestError> {
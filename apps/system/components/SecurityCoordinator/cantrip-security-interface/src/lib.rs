@@ -18,6 +18,7 @@
 
 extern crate alloc;
 use alloc::string::{String, ToString};
+use alloc::vec::Vec;
 use cantrip_memory_interface::ObjDescBundle;
 use cantrip_os_common::camkes::Camkes;
 use cantrip_os_common::cspace_slot::CSpaceSlot;
@@ -217,6 +218,42 @@ pub struct DeleteKeyRequest<'a> {
 }
 impl<'a> SecurityCapability for DeleteKeyRequest<'a> {}
 
+// SecurityRequestReadKeys
+#[derive(Debug, Serialize, Deserialize)]
+pub struct ReadKeysRequest<'a> {
+    pub bundle_id: &'a str,
+    #[serde(borrow)]
+    pub keys: Vec<&'a str>,
+}
+impl<'a> SecurityCapability for ReadKeysRequest<'a> {}
+
+// NB: values are in request order; None for a key that does not exist.
+#[derive(Debug, Serialize, Deserialize)]
+pub struct ReadKeysResponse<'a> {
+    #[serde(borrow)]
+    pub values: Vec<Option<&'a [u8]>>,
+}
+impl<'a> SecurityCapability for ReadKeysResponse<'a> {}
+
+// Max keys per SrReadKeys request; bounded by SECURITY_REPLY_DATA_SIZE.
+pub const MAX_READ_KEYS: usize = 16;
+
+// SecurityRequestWriteKeys
+#[derive(Debug, Serialize, Deserialize)]
+pub struct WriteKeysRequest<'a> {
+    pub bundle_id: &'a str,
+    #[serde(borrow)]
+    pub keys: Vec<(&'a str, &'a [u8])>,
+}
+impl<'a> SecurityCapability for WriteKeysRequest<'a> {}
+
+// SecurityRequestSyncKeys
+#[derive(Debug, Serialize, Deserialize)]
+pub struct SyncKeysRequest<'a> {
+    pub bundle_id: &'a str,
+}
+impl<'a> SecurityCapability for SyncKeysRequest<'a> {}
+
 // SecurityRequestTestMailbox
 #[derive(Debug, Serialize, Deserialize)]
 pub struct TestMailboxRequest {}
@@ -283,6 +320,10 @@ pub enum SecurityRequest {
 
     SrTestMailbox, // Run mailbox tests
     SrCapScan,     // Dump contents CNode to console
+
+    SrReadKeys,  // Read key values [bundle_id, keys] -> values
+    SrWriteKeys, // Write key values [bundle_id, (key, value)*]
+    SrSyncKeys,  // Write back cached key writes [bundle_id]
 }
 
 // Interface to underlying facilities; also used to inject fakes for unit tests.
@@ -308,7 +349,11 @@ pub trait SecurityCoordinatorInterface {
         bundle_id: &str,
         model_id: &str,
     ) -> Result<ObjDescBundle, SecurityRequestError>;
-    fn read_key(&self, bundle_id: &str, key: &str) -> Result<&KeyValueData, SecurityRequestError>;
+    fn read_key(
+        &mut self,
+        bundle_id: &str,
+        key: &str,
+    ) -> Result<&KeyValueData, SecurityRequestError>;
     fn write_key(
         &mut self,
         bundle_id: &str,
@@ -602,6 +647,79 @@ pub fn cantrip_security_delete_key(bundle_id: &str, key: &str) -> Result<(), Sec
     )
 }
 
+/// Reads the values of |keys| into |keyvals| with one request. Returns a
+/// mask with bit N set if keys[N] exists (keyvals[N] is untouched if not).
+#[inline]
+#[allow(dead_code)]
+pub fn cantrip_security_read_keys(
+    bundle_id: &str,
+    keys: &[&str],
+    keyvals: &mut [KeyValueData],
+) -> Result<u32, SecurityRequestError> {
+    if keys.len() > MAX_READ_KEYS || keyvals.len() < keys.len() {
+        return Err(SecurityRequestError::SreKeyInvalid);
+    }
+    let reply = &mut [0u8; SECURITY_REPLY_DATA_SIZE];
+    cantrip_security_request(
+        SecurityRequest::SrReadKeys,
+        &ReadKeysRequest {
+            bundle_id,
+            keys: keys.to_vec(),
+        },
+        reply,
+    )?;
+    let response = postcard::from_bytes::<ReadKeysResponse>(reply)
+        .map_err(|_| SecurityRequestError::SreDeserializeFailed)?;
+    let mut found = 0;
+    for (i, (value, keyval)) in response
+        .values
+        .iter()
+        .zip(keyvals.iter_mut())
+        .take(keys.len())
+        .enumerate()
+    {
+        if let Some(value) = value {
+            // NB: values written outside the SDK (e.g. from the shell) need
+            //   not be a full KeyValueData.
+            if value.len() != keyval.len() {
+                return Err(SecurityRequestError::SreValueInvalid);
+            }
+            keyval.copy_from_slice(value);
+            found |= 1 << i;
+        }
+    }
+    Ok(found)
+}
+
+/// Writes each (key, value) pair in |keys| with one request.
+#[inline]
+#[allow(dead_code)]
+pub fn cantrip_security_write_keys(
+    bundle_id: &str,
+    keys: &[(&str, &[u8])],
+) -> Result<(), SecurityRequestError> {
+    cantrip_security_request(
+        SecurityRequest::SrWriteKeys,
+        &WriteKeysRequest {
+            bundle_id,
+            keys: keys.to_vec(),
+        },
+        &mut [0u8; SECURITY_REPLY_DATA_SIZE],
+    )
+}
+
+/// Writes back any cached key writes for |bundle_id|. Key writes may be
+/// held in the SecurityCoordinator; this forces them to storage.
+#[inline]
+#[allow(dead_code)]
+pub fn cantrip_security_sync_keys(bundle_id: &str) -> Result<(), SecurityRequestError> {
+    cantrip_security_request(
+        SecurityRequest::SrSyncKeys,
+        &SyncKeysRequest { bundle_id },
+        &mut [0u8; SECURITY_REPLY_DATA_SIZE],
+    )
+}
+
 #[inline]
 #[allow(dead_code)]
 pub fn cantrip_security_test_mailbox() -> Result<(), SecurityRequestError> {
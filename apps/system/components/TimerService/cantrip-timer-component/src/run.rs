@@ -20,14 +20,25 @@ use cantrip_os_common::camkes::Camkes;
 use cantrip_os_common::sel4_sys::seL4_Word;
 use cantrip_timer_interface::TimerId;
 use cantrip_timer_interface::TimerInterface;
+use cantrip_timer_interface::TimerOp;
 use cantrip_timer_interface::TimerServiceError;
 use cantrip_timer_service::CantripTimerService;
+use core::slice;
 use core::time::Duration;
 
 extern "C" {
     fn timer_get_sender_id() -> seL4_Word;
+    fn timer_batch_get_sender_id() -> seL4_Word;
 }
 
+// Max clients of the TimerBatch connection.
+const MAX_TIMER_BATCH_CLIENTS: usize = 8;
+// Timer client id of each TimerBatch client, indexed by its badge on the
+// TimerBatch connection; set by timer_batch_bind. NB: the badges of the two
+// connections are assigned independently so they cannot be assumed to match.
+static mut TIMER_BATCH_CLIENTS: [Option<usize>; MAX_TIMER_BATCH_CLIENTS] =
+    [None; MAX_TIMER_BATCH_CLIENTS];
+
 static mut CAMKES: Camkes = Camkes::new("TimerService");
 // NB: CANTRIP_TIMER cannot be used before setup is completed with a call to init()
 static mut CANTRIP_TIMER: CantripTimerService = CantripTimerService::empty();
@@ -49,9 +60,23 @@ pub unsafe extern "C" fn pre_init() {
 pub unsafe extern "C" fn timer_completed_timers() -> u32 {
     let client_id = timer_get_sender_id();
     // XXX no way to pass error w/ current interface
-    CANTRIP_TIMER.completed_timers(client_id).unwrap_or(0)
+    CANTRIP_TIMER.completed_timers(client_id, 0).unwrap_or(0)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn timer_completed_timers_page(page: u32) -> u32 {
+    let client_id = timer_get_sender_id();
+    CANTRIP_TIMER
+        .completed_timers(client_id, page as usize)
+        .unwrap_or(0)
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn timer_clock_hz() -> u64 { CANTRIP_TIMER.clock_hz() }
+
+#[no_mangle]
+pub unsafe extern "C" fn timer_client_id() -> u32 { timer_get_sender_id() as u32 }
+
 #[no_mangle]
 pub unsafe extern "C" fn timer_oneshot(timer_id: TimerId, duration_ms: u32) -> TimerServiceError {
     let duration = Duration::from_millis(duration_ms as u64);
@@ -76,6 +101,71 @@ pub unsafe extern "C" fn timer_cancel(timer_id: TimerId) -> TimerServiceError {
     CANTRIP_TIMER.cancel(client_id, timer_id).into()
 }
 
+// Records |client_id| (from timer_client_id) as the Timer client for the
+// caller's TimerBatch badge. Clients are trusted system components.
+#[no_mangle]
+pub unsafe extern "C" fn timer_batch_bind(client_id: u32) -> TimerServiceError {
+    match TIMER_BATCH_CLIENTS.get_mut(timer_batch_get_sender_id()) {
+        Some(entry) => {
+            *entry = Some(client_id as usize);
+            TimerServiceError::TimerOk
+        }
+        None => TimerServiceError::TimerBatchUnbound,
+    }
+}
+
+// Applies a serialized [TimerOp] in order, stopping at the first failure;
+// |*c_completed| is set to the number of ops applied.
+#[no_mangle]
+pub unsafe extern "C" fn timer_batch_submit(
+    c_request_len: u32,
+    c_request: *const u8,
+    c_completed: *mut u32,
+) -> TimerServiceError {
+    *c_completed = 0;
+    let client_id = match TIMER_BATCH_CLIENTS.get(timer_batch_get_sender_id()) {
+        Some(Some(client_id)) => *client_id,
+        _ => return TimerServiceError::TimerBatchUnbound,
+    };
+    let mut request = slice::from_raw_parts(c_request, c_request_len as usize);
+
+    // NB: decode one op at a time rather than collecting them on the heap
+    let count = match postcard::take_from_bytes::<u32>(request) {
+        Ok((count, rest)) => {
+            request = rest;
+            count
+        }
+        Err(e) => return e.into(),
+    };
+    for _ in 0..count {
+        let op = match postcard::take_from_bytes::<TimerOp>(request) {
+            Ok((op, rest)) => {
+                request = rest;
+                op
+            }
+            Err(e) => return e.into(),
+        };
+        let result = match op {
+            TimerOp::Oneshot(timer_id, duration_ms) => CANTRIP_TIMER.add_oneshot(
+                client_id,
+                timer_id,
+                Duration::from_millis(duration_ms as u64),
+            ),
+            TimerOp::Periodic(timer_id, duration_ms) => CANTRIP_TIMER.add_periodic(
+                client_id,
+                timer_id,
+                Duration::from_millis(duration_ms as u64),
+            ),
+            TimerOp::Cancel(timer_id) => CANTRIP_TIMER.cancel(client_id, timer_id),
+        };
+        if let Err(e) = result {
+            return e;
+        }
+        *c_completed += 1;
+    }
+    TimerServiceError::TimerOk
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn timer_interrupt_handle() {
     extern "C" {
@@ -15,20 +15,42 @@
 #![no_std]
 #![allow(dead_code)]
 
+use cantrip_os_common::clock;
 use cantrip_os_common::sel4_sys;
+use core::sync::atomic::{AtomicBool, Ordering};
 use core::time::Duration;
+use serde::{Deserialize, Serialize};
 
 use sel4_sys::seL4_CPtr;
 use sel4_sys::seL4_NBWait;
 use sel4_sys::seL4_Wait;
 
-pub const TIMERS_PER_CLIENT: usize = 32;
+pub const TIMERS_PER_CLIENT: usize = 128;
 
-pub type Ticks = u64;
+pub type Ticks = clock::Ticks;
 pub type TimerId = u32;
 pub type TimerDuration = u32;
 pub type TimerMask = u32;
 
+// Completed timers are reported a TimerMask (page) at a time; page N
+// covers TimerId's [TIMER_MASK_BITS * N, TIMER_MASK_BITS * (N + 1)).
+pub const TIMER_MASK_BITS: usize = TimerMask::BITS as usize;
+pub const TIMER_MASK_PAGES: usize = TIMERS_PER_CLIENT / TIMER_MASK_BITS;
+
+// Size of the buffer used to pass a serialized batch of TimerOp's; this
+// is bounded by the 4KB region shared with each client (see TimerBatch)
+// and by it being allocated on the client's stack. Ops take at most 11
+// bytes so this holds at least 180.
+pub const RAW_TIMER_BATCH_DATA_SIZE: usize = 2048;
+
+/// An operation in a cantrip_timer_batch request.
+#[derive(Copy, Clone, Debug, Eq, PartialEq, Serialize, Deserialize)]
+pub enum TimerOp {
+    Oneshot(TimerId, TimerDuration),
+    Periodic(TimerId, TimerDuration),
+    Cancel(TimerId),
+}
+
 /// A hardware timer capable of generating interrupts.
 pub trait HardwareTimer {
     fn setup(&self);
@@ -38,8 +60,16 @@ pub trait HardwareTimer {
     // Return the deadline `duration` in the future, in Ticks.
     fn deadline(&self, duration: Duration) -> Ticks;
     fn set_alarm(&self, deadline: Ticks);
+    // The rate at which now() advances, in ticks per second.
+    fn frequency(&self) -> u64;
 }
 
+/// Returns the free-running cpu time counter (rdtime on RISC-V). This is
+/// readable from user space without a syscall; use cantrip_timer_clock_hz
+/// to convert to seconds. Returns 0 where there is no such counter.
+#[inline]
+pub fn cantrip_clock_ticks() -> Ticks { clock::clock_ticks() }
+
 pub trait TimerInterface {
     fn add_oneshot(
         &mut self,
@@ -54,8 +84,15 @@ pub trait TimerInterface {
         duration: Duration,
     ) -> Result<(), TimerServiceError>;
     fn cancel(&mut self, client_id: usize, timer_id: TimerId) -> Result<(), TimerServiceError>;
-    fn completed_timers(&mut self, client_id: usize) -> Result<TimerMask, TimerServiceError>;
+    // Returns & clears the completed timers in mask |page|.
+    fn completed_timers(
+        &mut self,
+        client_id: usize,
+        page: usize,
+    ) -> Result<TimerMask, TimerServiceError>;
     fn service_interrupt(&mut self);
+    // Returns the calibrated rate of cantrip_clock_ticks (0 if unknown).
+    fn clock_hz(&self) -> u64;
 }
 
 /// Return codes from TimerService api's.
@@ -65,6 +102,8 @@ pub enum TimerServiceError {
     TimerOk = 0,
     NoSuchTimer,
     TimerAlreadyExists,
+    TimerBatchInvalid,
+    TimerBatchUnbound,
 }
 impl From<TimerServiceError> for Result<(), TimerServiceError> {
     fn from(err: TimerServiceError) -> Result<(), TimerServiceError> {
@@ -85,8 +124,14 @@ impl<T> From<Result<T, TimerServiceError>> for TimerServiceError {
     }
 }
 
+impl From<postcard::Error> for TimerServiceError {
+    fn from(_err: postcard::Error) -> TimerServiceError { TimerServiceError::TimerBatchInvalid }
+}
+
 /// Returns a TimerId bitmask of timers registered with cantrip_timer_oneshot
-/// and cantrip_timer_periodic that have expired.
+/// and cantrip_timer_periodic that have expired. Only TimerId's below
+/// TIMER_MASK_BITS are reported; use cantrip_timer_completed_timers_page
+/// for larger id's.
 #[inline]
 pub fn cantrip_timer_completed_timers() -> Result<TimerMask, TimerServiceError> {
     extern "C" {
@@ -95,6 +140,19 @@ pub fn cantrip_timer_completed_timers() -> Result<TimerMask, TimerServiceError>
     Ok(unsafe { timer_completed_timers() } as TimerMask)
 }
 
+/// Returns a bitmask of expired timers in mask |page| (bit N is TimerId
+/// TIMER_MASK_BITS * |page| + N).
+#[inline]
+pub fn cantrip_timer_completed_timers_page(page: usize) -> Result<TimerMask, TimerServiceError> {
+    extern "C" {
+        fn timer_completed_timers_page(page: u32) -> u32;
+    }
+    if page >= TIMER_MASK_PAGES {
+        return Err(TimerServiceError::NoSuchTimer);
+    }
+    Ok(unsafe { timer_completed_timers_page(page as u32) } as TimerMask)
+}
+
 /// Registers a one-shot |timer_id| with |duration_in_ms| to start immediately.
 /// |timer_id| is interpreted per client and must not be running already.
 /// When the timer completes a notification will be delivered to the client.
@@ -137,6 +195,57 @@ pub fn cantrip_timer_cancel(timer_id: TimerId) -> Result<(), TimerServiceError>
     unsafe { timer_cancel(timer_id as u32) }.into()
 }
 
+// Binds the TimerBatch connection to the caller's Timer client id the
+// first time it is used; the badges of the two connections need not match.
+fn timer_batch_bind() -> Result<(), TimerServiceError> {
+    extern "C" {
+        fn timer_client_id() -> u32;
+        fn timer_batch_bind(client_id: u32) -> TimerServiceError;
+    }
+    static BOUND: AtomicBool = AtomicBool::new(false);
+    if !BOUND.load(Ordering::Relaxed) {
+        let result: Result<(), TimerServiceError> =
+            unsafe { timer_batch_bind(timer_client_id()) }.into();
+        result?;
+        BOUND.store(true, Ordering::Relaxed);
+    }
+    Ok(())
+}
+
+/// Applies |ops| in order with one request, stopping at the first that
+/// fails. This is the way to arm/cancel many timers at once: one RPC
+/// instead of one per timer. On failure the number of ops that were
+/// applied is returned with the error.
+pub fn cantrip_timer_batch(ops: &[TimerOp]) -> Result<(), (usize, TimerServiceError)> {
+    extern "C" {
+        fn timer_batch_submit(
+            c_request_len: u32,
+            c_request: *const u8,
+            c_completed: *mut u32,
+        ) -> TimerServiceError;
+    }
+    timer_batch_bind().map_err(|e| (0, e))?;
+    // NB: Camkes copies the request into the shared region
+    let raw_request = &mut [0u8; RAW_TIMER_BATCH_DATA_SIZE];
+    let request = postcard::to_slice(ops, raw_request).map_err(|e| (0, e.into()))?;
+    let mut completed: u32 = 0;
+    match unsafe { timer_batch_submit(request.len() as u32, request.as_ptr(), &mut completed) } {
+        TimerServiceError::TimerOk => Ok(()),
+        status => Err((completed as usize, status)),
+    }
+}
+
+/// Returns the rate of cantrip_clock_ticks in ticks per second, as
+/// calibrated by the TimerService against its hardware timer at boot, or
+/// 0 if there is no clock.
+#[inline]
+pub fn cantrip_timer_clock_hz() -> Result<u64, TimerServiceError> {
+    extern "C" {
+        fn timer_clock_hz() -> u64;
+    }
+    Ok(unsafe { timer_clock_hz() })
+}
+
 /// Returns the cptr for the notification object used to signal timer events.
 #[inline]
 pub fn cantrip_timer_notification() -> seL4_CPtr {
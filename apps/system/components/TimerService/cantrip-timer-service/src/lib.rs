@@ -68,12 +68,17 @@ impl TimerInterface for CantripTimerService {
             .unwrap()
             .cancel(client_id, timer_id)
     }
-    fn completed_timers(&mut self, client_id: usize) -> Result<TimerMask, TimerServiceError> {
+    fn completed_timers(
+        &mut self,
+        client_id: usize,
+        page: usize,
+    ) -> Result<TimerMask, TimerServiceError> {
         self.manager
             .lock()
             .as_mut()
             .unwrap()
-            .completed_timers(client_id)
+            .completed_timers(client_id, page)
     }
+    fn clock_hz(&self) -> u64 { self.manager.lock().as_ref().unwrap().clock_hz() }
     fn service_interrupt(&mut self) { self.manager.lock().as_mut().unwrap().service_interrupt() }
 }
@@ -19,13 +19,22 @@ use alloc::collections::BTreeMap;
 use cantrip_os_common::sel4_sys::seL4_Word;
 use cantrip_timer_interface::*;
 use core::time::Duration;
-use log::error;
+use log::{error, info};
 
 // TODO(jesionowski): NUM_CLIENTS should be derived through the static
 // camkes configuration. This may take some template hacking as the number
 // of clients is generated as a C #define.
 const NUM_CLIENTS: usize = 4;
 
+// How long to measure cantrip_clock_ticks against the hardware timer at
+// boot; 1/CLOCK_CALIBRATION_DIVISOR of a second. Longer is more precise
+// but delays TimerService startup.
+const CLOCK_CALIBRATION_DIVISOR: u64 = 100; // 10ms
+
+// Pending timers are ordered by deadline; the client & timer id make the
+// key unique when deadlines coincide.
+type EventKey = (Ticks, usize, TimerId);
+
 // An event represents a future timeout and the associated notification client.
 // If the event is periodic, it includes the period.
 struct Event {
@@ -35,22 +44,52 @@ struct Event {
 }
 
 // We keep track of outstanding timers using a BTreeMap from the deadline to
-// the associated event.
+// the associated event; it serves as a priority queue with O(log n) insert,
+// remove, and lookup of the next deadline. A second map from (client, timer)
+// to deadline finds a client's timer without scanning all events.
 // Each client may have multiple outstanding timers, which we represent through
 // a bit vector in timer_state.
 pub struct TimerManager {
     timer: Box<dyn HardwareTimer + Sync>,
-    events: BTreeMap<Ticks, Event>,
-    timer_state: [u32; NUM_CLIENTS], // XXX: bitvec?
+    events: BTreeMap<EventKey, Event>,
+    deadlines: BTreeMap<(usize, TimerId), Ticks>,
+    timer_state: [[TimerMask; TIMER_MASK_PAGES]; NUM_CLIENTS], // XXX: bitvec?
+    clock_hz: u64, // Calibrated rate of cantrip_clock_ticks
 }
 impl TimerManager {
     pub fn new(timer: impl HardwareTimer + Sync + 'static) -> Self {
         timer.setup();
+        let clock_hz = Self::calibrate_clock(&timer);
+        info!("clock {} Hz", clock_hz);
         Self {
             timer: Box::new(timer),
             events: BTreeMap::new(),
-            timer_state: [0; NUM_CLIENTS],
+            deadlines: BTreeMap::new(),
+            timer_state: [[0; TIMER_MASK_PAGES]; NUM_CLIENTS],
+            clock_hz,
+        }
+    }
+
+    // Measures the rate of cantrip_clock_ticks by spinning on |timer| for
+    // a known number of its ticks. Each end is taken on a timer tick edge
+    // so the error is bounded by the clock reads, not the timer resolution.
+    // Returns 0 if there is no clock.
+    fn calibrate_clock(timer: &impl HardwareTimer) -> u64 {
+        fn next_edge(timer: &impl HardwareTimer, from: Ticks) -> (Ticks, Ticks) {
+            loop {
+                let now = timer.now();
+                if now > from {
+                    return (now, cantrip_clock_ticks());
+                }
+            }
+        }
+        if cantrip_clock_ticks() == 0 {
+            return 0;
         }
+        let span = core::cmp::max(timer.frequency() / CLOCK_CALIBRATION_DIVISOR, 1);
+        let (start, start_clock) = next_edge(timer, timer.now());
+        let (end, end_clock) = next_edge(timer, start + span - 1);
+        (end_clock - start_clock) * timer.frequency() / (end - start)
     }
 
     // Checks |client_id| and |timer_id| are valid and that no timer exists.
@@ -67,16 +106,20 @@ impl TimerManager {
             return Err(TimerServiceError::NoSuchTimer);
         }
 
-        if self
-            .events
-            .iter()
-            .any(|(_, ev)| ev.client_id == client_id && ev.timer_id == timer_id)
-        {
+        if self.deadlines.contains_key(&(client_id, timer_id)) {
             return Err(TimerServiceError::TimerAlreadyExists);
         }
         Ok(())
     }
 
+    // Queues |event| to expire at |deadline|.
+    fn insert(&mut self, deadline: Ticks, event: Event) {
+        self.deadlines
+            .insert((event.client_id, event.timer_id), deadline);
+        self.events
+            .insert((deadline, event.client_id, event.timer_id), event);
+    }
+
     // Helper for add_periodic & add_oneshot.
     fn add(
         &mut self,
@@ -88,8 +131,9 @@ impl TimerManager {
         self.check_timer_params(client_id, timer_id)?;
 
         let recurring = if periodic { Some(duration) } else { None };
-        self.events.insert(
-            self.timer.deadline(duration),
+        let deadline = self.timer.deadline(duration);
+        self.insert(
+            deadline,
             Event {
                 client_id,
                 timer_id,
@@ -97,9 +141,10 @@ impl TimerManager {
             },
         );
 
-        // Next deadline is always on top of the tree.
-        if let Some(event) = self.events.first_entry() {
-            self.timer.set_alarm(*event.key())
+        // Next deadline is always on top of the tree; the alarm only
+        // needs moving when the new timer is it.
+        if self.events.first_key_value().map(|(&(next, _, _), _)| next) == Some(deadline) {
+            self.timer.set_alarm(deadline)
         }
 
         Ok(())
@@ -123,33 +168,37 @@ impl TimerInterface for TimerManager {
         self.add(client_id, timer_id, duration, /*periodic=*/ true)
     }
 
-    fn completed_timers(&mut self, client_id: usize) -> Result<u32, TimerServiceError> {
-        if !(0..NUM_CLIENTS).contains(&client_id) {
+    fn completed_timers(
+        &mut self,
+        client_id: usize,
+        page: usize,
+    ) -> Result<TimerMask, TimerServiceError> {
+        if !(0..NUM_CLIENTS).contains(&client_id) || page >= TIMER_MASK_PAGES {
             // NB: no need for a message, the error return should suffice
             return Err(TimerServiceError::NoSuchTimer);
         }
 
         // client_id is 1-indexed by seL4, timer_state is 0-index.
         let client = client_id - 1;
-        let state = self.timer_state[client];
-        self.timer_state[client] = 0;
+        let state = self.timer_state[client][page];
+        self.timer_state[client][page] = 0;
 
         Ok(state)
     }
 
     fn cancel(&mut self, client_id: usize, timer_id: TimerId) -> Result<(), TimerServiceError> {
         // NB: no need for an explicit client_id check
-        let key = self
-            .events
-            .iter()
-            .find(|(_, ev)| ev.client_id == client_id && ev.timer_id == timer_id)
-            .map(|(&key, _)| key)
+        let deadline = self
+            .deadlines
+            .remove(&(client_id, timer_id))
             .ok_or(TimerServiceError::NoSuchTimer)?;
-        self.events.remove(&key);
+        self.events.remove(&(deadline, client_id, timer_id));
 
         Ok(())
     }
 
+    fn clock_hz(&self) -> u64 { self.clock_hz }
+
     // Service a hardware timer interrupt. For all expired timer requests
     // signal the client and, if periodic, re-queue the timer. If there
     // are still pending timer requests, re-arm the hardware timer.
@@ -159,15 +208,21 @@ impl TimerInterface for TimerManager {
         }
 
         self.timer.ack_interrupt();
+        let now = self.timer.now();
         while let Some(e) = self.events.first_entry() {
-            if *e.key() > self.timer.now() {
+            if e.key().0 > now {
                 // Timer request expires in the future.
                 break;
             }
-            let event = self.events.pop_first().unwrap().1;
+            let event = e.remove();
+            self.deadlines.remove(&(event.client_id, event.timer_id));
 
             // client_id is 1-indexed by seL4, timer_state is 0-index.
-            self.timer_state[event.client_id - 1] |= 1 << event.timer_id;
+            let (page, bit) = (
+                event.timer_id as usize / TIMER_MASK_BITS,
+                event.timer_id as usize % TIMER_MASK_BITS,
+            );
+            self.timer_state[event.client_id - 1][page] |= 1 << bit;
 
             // Signal the client a timer has expired.
             unsafe {
@@ -176,12 +231,13 @@ impl TimerInterface for TimerManager {
 
             if let Some(period) = event.recurring {
                 // Periodic timer, re-queue.
-                self.events.insert(self.timer.deadline(period), event);
+                let deadline = self.timer.deadline(period);
+                self.insert(deadline, event);
             }
         }
-        if let Some(event) = self.events.first_entry() {
+        if let Some((&(deadline, _, _), _)) = self.events.first_key_value() {
             // There are pending timer requests, arm the hardware timer.
-            self.timer.set_alarm(*event.key())
+            self.timer.set_alarm(deadline)
         }
     }
 }
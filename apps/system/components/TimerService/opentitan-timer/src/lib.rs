@@ -68,4 +68,6 @@ impl HardwareTimer for OtTimer {
 
         opentitan_timer::set_intr_enable(Intr::new().with_timer0(true));
     }
+
+    fn frequency(&self) -> u64 { TIMER_FREQ as u64 }
 }
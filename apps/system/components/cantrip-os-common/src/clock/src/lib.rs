@@ -0,0 +1,71 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Cantrip OS free-running cpu time counter
+//!
+//! This is the one implementation of the counter read; the TimerService
+//! (cantrip_clock_ticks) and the SDK (sdk_clock_ticks) use it and the C
+//! runtime (libcantrip clock.h) mirrors it.
+
+#![cfg_attr(not(test), no_std)]
+
+pub type Ticks = u64;
+
+/// Returns the free-running cpu time counter (rdtime on RISC-V). This is
+/// readable from user space without a syscall. Returns 0 where there is
+/// no such counter.
+#[cfg(target_arch = "riscv32")]
+#[inline]
+pub fn clock_ticks() -> Ticks {
+    loop {
+        let (upper, lower, upper_reread): (u32, u32, u32);
+        unsafe {
+            core::arch::asm!(
+                "rdtimeh {0}",
+                "rdtime {1}",
+                "rdtimeh {2}",
+                out(reg) upper,
+                out(reg) lower,
+                out(reg) upper_reread,
+                options(nomem, nostack),
+            );
+        }
+        // NB: retry if the low word wrapped between the reads.
+        if upper == upper_reread {
+            return ((upper as u64) << 32) | lower as u64;
+        }
+    }
+}
+#[cfg(target_arch = "riscv64")]
+#[inline]
+pub fn clock_ticks() -> Ticks {
+    let ticks: u64;
+    unsafe {
+        core::arch::asm!("rdtime {0}", out(reg) ticks, options(nomem, nostack));
+    }
+    ticks
+}
+#[cfg(not(any(target_arch = "riscv32", target_arch = "riscv64")))]
+#[inline]
+pub fn clock_ticks() -> Ticks { 0 }
+
+/// Converts |ticks| of a |hz| clock to nanoseconds without overflowing
+/// for any clock rate below 18GHz. Returns 0 if |hz| is 0.
+#[inline]
+pub fn clock_ticks_to_ns(ticks: Ticks, hz: u64) -> u64 {
+    if hz == 0 {
+        return 0;
+    }
+    (ticks / hz) * 1_000_000_000 + (ticks % hz) * 1_000_000_000 / hz
+}
@@ -19,6 +19,7 @@ pub extern crate allocator;
 pub extern crate camkes;
 #[cfg(feature = "capdl_support")]
 pub extern crate capdl;
+pub extern crate clock;
 #[cfg(feature = "camkes_support")]
 pub extern crate copyregion;
 #[cfg(feature = "camkes_support")]
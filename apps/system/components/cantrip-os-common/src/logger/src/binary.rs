@@ -0,0 +1,601 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Deferred-format (binary) logging.
+//!
+//! The bin_* macros (bin_trace!, bin_debug!, etc) take the same arguments
+//! as the log crate macros but do not format the message in the caller.
+//! Instead each call site is given a small id the first time it logs and
+//! the component sends the DebugConsole a definition record with the id
+//! and the format string; after that only the id and the raw argument
+//! values are sent:
+//!
+//!   define: level | BINARY_DEFINE, [id: u16 LE]['<target>::<fmt>']
+//!   data:   level | BINARY_DATA,   [id: u16 LE][arg]*
+//!
+//! where each arg is a tag byte followed by its value:
+//!
+//!   ARG_UINT  varint (LEB128)
+//!   ARG_INT   zig-zag varint
+//!   ARG_BOOL  u8
+//!   ARG_CHAR  varint
+//!   ARG_STR   varint length + utf8 bytes
+//!
+//! Ids are per-component, the DebugConsole keeps a table for each log ring
+//! and expands the records when it drains them (a host tool that captures
+//! a ring can do the same with expand). Without a log ring, or when the
+//! ring is busy, the message is expanded in the caller and logged as text.
+//!
+//! Only positional "{}" arguments of the types above are supported (no
+//! inline captures, named or indexed arguments); the supported format
+//! specs are [<|>][#][0][width][x|X|o|b][?].
+
+use crate::{get_log_ring, with_log_ring};
+use core::fmt::{self, Write};
+use core::sync::atomic::{AtomicU16, Ordering};
+use log::Level;
+
+/// Record level flag for a format definition.
+pub const BINARY_DEFINE: u8 = 0x40;
+/// Record level flag for a deferred-format message.
+pub const BINARY_DATA: u8 = 0x80;
+/// Mask for the log::Level in the record level.
+pub const LEVEL_MASK: u8 = 0x0f;
+
+const ARG_UINT: u8 = 0;
+const ARG_INT: u8 = 1;
+const ARG_BOOL: u8 = 2;
+const ARG_CHAR: u8 = 3;
+const ARG_STR: u8 = 4;
+
+/// Space for the encoded arguments of one message; string arguments are
+/// truncated to fit.
+pub const MAX_ARGS_LEN: usize = 256;
+
+/// A raw log argument.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum Arg<'a> {
+    Uint(u64),
+    Int(i64),
+    Bool(bool),
+    Char(char),
+    Str(&'a str),
+}
+
+/// Types that can be passed to the bin_* macros.
+pub trait BinaryArg {
+    fn to_arg(&self) -> Arg<'_>;
+}
+macro_rules! binary_arg {
+    ($variant:ident, $as:ty, $($t:ty),*) => {
+        $(impl BinaryArg for $t {
+            fn to_arg(&self) -> Arg<'_> { Arg::$variant(*self as $as) }
+        })*
+    };
+}
+binary_arg!(Uint, u64, u8, u16, u32, u64, usize);
+binary_arg!(Int, i64, i8, i16, i32, i64, isize);
+impl BinaryArg for bool {
+    fn to_arg(&self) -> Arg<'_> { Arg::Bool(*self) }
+}
+impl BinaryArg for char {
+    fn to_arg(&self) -> Arg<'_> { Arg::Char(*self) }
+}
+impl BinaryArg for str {
+    fn to_arg(&self) -> Arg<'_> { Arg::Str(self) }
+}
+impl<T: BinaryArg + ?Sized> BinaryArg for &T {
+    fn to_arg(&self) -> Arg<'_> { (**self).to_arg() }
+}
+
+fn put_varint(buf: &mut [u8], mut v: u64) -> Option<usize> {
+    let mut n = 0;
+    loop {
+        let byte = (v & 0x7f) as u8;
+        v >>= 7;
+        *buf.get_mut(n)? = if v == 0 { byte } else { byte | 0x80 };
+        n += 1;
+        if v == 0 {
+            return Some(n);
+        }
+    }
+}
+
+fn get_varint(buf: &[u8]) -> Option<(u64, usize)> {
+    let mut v = 0u64;
+    for (n, &byte) in buf.iter().enumerate().take(10) {
+        v |= ((byte & 0x7f) as u64) << (7 * n);
+        if byte & 0x80 == 0 {
+            return Some((v, n + 1));
+        }
+    }
+    None
+}
+
+fn encode_arg(buf: &mut [u8], arg: &Arg) -> Option<usize> {
+    let (tag, rest) = buf.split_first_mut()?;
+    let n = match *arg {
+        Arg::Uint(v) => {
+            *tag = ARG_UINT;
+            put_varint(rest, v)?
+        }
+        Arg::Int(v) => {
+            *tag = ARG_INT;
+            put_varint(rest, ((v << 1) ^ (v >> 63)) as u64)?
+        }
+        Arg::Bool(v) => {
+            *tag = ARG_BOOL;
+            *rest.first_mut()? = v as u8;
+            1
+        }
+        Arg::Char(v) => {
+            *tag = ARG_CHAR;
+            put_varint(rest, v as u64)?
+        }
+        Arg::Str(s) => {
+            *tag = ARG_STR;
+            // Truncate (on a char boundary) to what fits; the length
+            // takes at most 2 bytes as MAX_ARGS_LEN is small.
+            let room = rest.len().checked_sub(2)?;
+            let mut len = core::cmp::min(s.len(), room);
+            while !s.is_char_boundary(len) {
+                len -= 1;
+            }
+            let n = put_varint(rest, len as u64)?;
+            rest[n..n + len].copy_from_slice(&s.as_bytes()[..len]);
+            n + len
+        }
+    };
+    Some(1 + n)
+}
+
+/// Encodes |args| into |buf| and returns the number of bytes used.
+/// Arguments that do not fit are left off (and expand as "<?>").
+pub fn encode_args(buf: &mut [u8], args: &[Arg]) -> usize {
+    let mut len = 0;
+    for arg in args {
+        match encode_arg(&mut buf[len..], arg) {
+            Some(n) => len += n,
+            None => break,
+        }
+    }
+    len
+}
+
+/// Iterator over the arguments encoded in a message. A malformed
+/// argument ends the iteration.
+pub struct ArgReader<'a> {
+    buf: &'a [u8],
+}
+impl<'a> ArgReader<'a> {
+    pub fn new(buf: &'a [u8]) -> Self { ArgReader { buf } }
+}
+impl<'a> Iterator for ArgReader<'a> {
+    type Item = Arg<'a>;
+
+    fn next(&mut self) -> Option<Arg<'a>> {
+        let (&tag, rest) = self.buf.split_first()?;
+        let (arg, n) = match tag {
+            ARG_UINT => get_varint(rest).map(|(v, n)| (Arg::Uint(v), n)),
+            ARG_INT => {
+                get_varint(rest).map(|(v, n)| (Arg::Int((v >> 1) as i64 ^ -((v & 1) as i64)), n))
+            }
+            ARG_BOOL => rest.first().map(|&v| (Arg::Bool(v != 0), 1)),
+            ARG_CHAR => get_varint(rest)
+                .and_then(|(v, n)| char::from_u32(v as u32).map(|c| (Arg::Char(c), n))),
+            ARG_STR => get_varint(rest).and_then(|(len, n)| {
+                let bytes = rest.get(n..n.checked_add(len as usize)?)?;
+                core::str::from_utf8(bytes)
+                    .ok()
+                    .map(|s| (Arg::Str(s), n + len as usize))
+            }),
+            _ => None,
+        }
+        .or_else(|| {
+            self.buf = &[];
+            None
+        })?;
+        self.buf = &rest[n..];
+        Some(arg)
+    }
+}
+
+// A parsed "{:...}" spec.
+#[derive(Default)]
+struct Spec {
+    align: Option<char>,
+    alternate: bool,
+    zero: bool,
+    width: usize,
+    radix: Option<char>,
+    debug: bool,
+}
+impl Spec {
+    fn parse(spec: &str) -> Self {
+        let mut s = Spec::default();
+        let mut chars = spec.strip_prefix(':').unwrap_or("").chars().peekable();
+        if let Some(&c @ ('<' | '>')) = chars.peek() {
+            s.align = Some(c);
+            chars.next();
+        }
+        if chars.peek() == Some(&'#') {
+            s.alternate = true;
+            chars.next();
+        }
+        if chars.peek() == Some(&'0') {
+            s.zero = true;
+            chars.next();
+        }
+        while let Some(d) = chars.peek().and_then(|c| c.to_digit(10)) {
+            s.width = s.width * 10 + d as usize;
+            chars.next();
+        }
+        for c in chars {
+            match c {
+                'x' | 'X' | 'o' | 'b' => s.radix = Some(c),
+                '?' => s.debug = true,
+                _ => {}
+            }
+        }
+        s
+    }
+}
+
+// A small stack buffer for formatting an argument before padding it.
+struct StackStr<const N: usize> {
+    buf: [u8; N],
+    len: usize,
+}
+impl<const N: usize> StackStr<N> {
+    fn new() -> Self {
+        StackStr {
+            buf: [0; N],
+            len: 0,
+        }
+    }
+    fn as_str(&self) -> &str { core::str::from_utf8(&self.buf[..self.len]).unwrap_or("") }
+}
+impl<const N: usize> Write for StackStr<N> {
+    fn write_str(&mut self, s: &str) -> fmt::Result {
+        let end = self.len + s.len();
+        self.buf
+            .get_mut(self.len..end)
+            .ok_or(fmt::Error)?
+            .copy_from_slice(s.as_bytes());
+        self.len = end;
+        Ok(())
+    }
+}
+
+// Writes |s| padded to the spec's width; |number| selects the default
+// alignment as with core::fmt.
+fn pad<W: Write>(out: &mut W, spec: &Spec, s: &str, number: bool) -> fmt::Result {
+    let right = spec.align.map_or(number, |c| c == '>');
+    let fill = spec.width.saturating_sub(s.chars().count());
+    if !right {
+        out.write_str(s)?;
+    }
+    for _ in 0..fill {
+        out.write_char(' ')?;
+    }
+    if right {
+        out.write_str(s)?;
+    }
+    Ok(())
+}
+
+fn write_arg<W: Write>(out: &mut W, spec: &Spec, arg: &Arg) -> fmt::Result {
+    let mut num = StackStr::<80>::new();
+    let (neg, v) = match *arg {
+        Arg::Uint(v) => (false, v),
+        Arg::Int(v) => (v < 0, v.unsigned_abs()),
+        Arg::Bool(v) => return pad(out, spec, if v { "true" } else { "false" }, false),
+        Arg::Char(c) if spec.debug => {
+            let mut s = StackStr::<16>::new();
+            let _ = write!(&mut s, "{:?}", c);
+            return pad(out, spec, s.as_str(), false);
+        }
+        Arg::Char(c) => {
+            let mut s = [0u8; 4];
+            return pad(out, spec, c.encode_utf8(&mut s), false);
+        }
+        Arg::Str(s) if spec.debug => return write!(out, "{:?}", s),
+        Arg::Str(s) => return pad(out, spec, s, false),
+    };
+    let prefix = match (spec.alternate, spec.radix) {
+        (true, Some('x')) | (true, Some('X')) => "0x",
+        (true, Some('o')) => "0o",
+        (true, Some('b')) => "0b",
+        _ => "",
+    };
+    let _ = match spec.radix {
+        Some('x') => write!(&mut num, "{:x}", v),
+        Some('X') => write!(&mut num, "{:X}", v),
+        Some('o') => write!(&mut num, "{:o}", v),
+        Some('b') => write!(&mut num, "{:b}", v),
+        _ => write!(&mut num, "{}", v),
+    };
+    let sign = if neg { "-" } else { "" };
+    if spec.zero && spec.align.is_none() {
+        out.write_str(sign)?;
+        out.write_str(prefix)?;
+        let used = sign.len() + prefix.len() + num.len;
+        for _ in 0..spec.width.saturating_sub(used) {
+            out.write_char('0')?;
+        }
+        out.write_str(num.as_str())
+    } else {
+        let mut s = StackStr::<84>::new();
+        let _ = write!(&mut s, "{}{}{}", sign, prefix, num.as_str());
+        pad(out, spec, s.as_str(), true)
+    }
+}
+
+/// Expands the format string |fmt| with the encoded |args|. Missing
+/// arguments are written as "<?>".
+pub fn expand<W: Write>(out: &mut W, fmt: &str, args: &[u8]) -> fmt::Result {
+    let mut args = ArgReader::new(args);
+    let mut rest = fmt;
+    while let Some(i) = rest.find(|c| c == '{' || c == '}') {
+        out.write_str(&rest[..i])?;
+        let c = rest.as_bytes()[i];
+        let tail = &rest[i + 1..];
+        if tail.as_bytes().first() == Some(&c) {
+            // "{{" or "}}"
+            out.write_char(c as char)?;
+            rest = &tail[1..];
+            continue;
+        }
+        if c == b'}' {
+            // Stray '}' (rejected by the compiler for the text macros).
+            out.write_char('}')?;
+            rest = tail;
+            continue;
+        }
+        let end = match tail.find('}') {
+            Some(end) => end,
+            None => return out.write_str(&rest[i..]),
+        };
+        match args.next() {
+            Some(arg) => write_arg(out, &Spec::parse(&tail[..end]), &arg)?,
+            None => out.write_str("<?>")?,
+        }
+        rest = &tail[end + 1..];
+    }
+    out.write_str(rest)
+}
+
+/// Displays a format string with encoded arguments.
+pub struct Expanded<'a> {
+    pub fmt: &'a str,
+    pub args: &'a [u8],
+}
+impl fmt::Display for Expanded<'_> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result { expand(f, self.fmt, self.args) }
+}
+
+// Next call site id; ids are assigned (and NEXT_ID advanced) only while
+// holding the log ring so they match the order of the definitions.
+static NEXT_ID: AtomicU16 = AtomicU16::new(1);
+
+/// A bin_* macro call site.
+pub struct LogSite {
+    target: &'static str,
+    fmt: &'static str,
+    id: AtomicU16, // 0 until the definition has been sent
+}
+impl LogSite {
+    pub const fn new(target: &'static str, fmt: &'static str) -> Self {
+        LogSite {
+            target,
+            fmt,
+            id: AtomicU16::new(0),
+        }
+    }
+
+    // Sends the message (and, the first time, the definition) to |ring|.
+    // Returns true if the DebugConsole needs a doorbell.
+    fn push(&self, ring: &crate::ring::LogRing, level: u8, args: &[u8]) -> bool {
+        let mut needs_doorbell = false;
+        let mut id = self.id.load(Ordering::Relaxed);
+        if id == 0 {
+            id = NEXT_ID.load(Ordering::Relaxed);
+            if id == 0 {
+                // Out of ids; log as text.
+                return false;
+            }
+            match ring.push_parts(
+                level | BINARY_DEFINE,
+                &[
+                    &id.to_le_bytes(),
+                    self.target.as_bytes(),
+                    b"::",
+                    self.fmt.as_bytes(),
+                ],
+            ) {
+                Ok(was_empty) => needs_doorbell = was_empty,
+                Err(()) => return false, // Dropped; retry next time.
+            }
+            NEXT_ID.store(id.wrapping_add(1), Ordering::Relaxed);
+            self.id.store(id, Ordering::Relaxed);
+        }
+        if let Ok(was_empty) = ring.push_parts(level | BINARY_DATA, &[&id.to_le_bytes(), args]) {
+            needs_doorbell |= was_empty;
+        }
+        needs_doorbell
+    }
+
+    /// Logs |args| formatted per this site's format string.
+    pub fn log(&self, level: Level, args: &[Arg]) {
+        let mut buf = [0u8; MAX_ARGS_LEN];
+        let len = encode_args(&mut buf, args);
+        if let Some(ring) = get_log_ring() {
+            if matches!(ring.max_level(), Some(max_level) if (level as u32) > max_level) {
+                return;
+            }
+            if with_log_ring(|| self.push(&ring, level as u8, &buf[..len])) {
+                return;
+            }
+        }
+        log::log!(
+            target: self.target,
+            level,
+            "{}",
+            Expanded {
+                fmt: self.fmt,
+                args: &buf[..len]
+            }
+        );
+    }
+}
+
+/// Logs a message with deferred formatting; see the module doc.
+#[macro_export]
+macro_rules! bin_log {
+    ($lvl:expr, $fmt:literal $(, $arg:expr)* $(,)?) => {{
+        let lvl = $lvl;
+        if lvl <= $crate::__log::STATIC_MAX_LEVEL && lvl <= $crate::__log::max_level() {
+            static SITE: $crate::binary::LogSite =
+                $crate::binary::LogSite::new(module_path!(), $fmt);
+            SITE.log(lvl, &[$($crate::binary::BinaryArg::to_arg(&$arg)),*]);
+        }
+    }};
+}
+#[macro_export]
+macro_rules! bin_error {
+    ($($t:tt)*) => { $crate::bin_log!($crate::__log::Level::Error, $($t)*) };
+}
+#[macro_export]
+macro_rules! bin_warn {
+    ($($t:tt)*) => { $crate::bin_log!($crate::__log::Level::Warn, $($t)*) };
+}
+#[macro_export]
+macro_rules! bin_info {
+    ($($t:tt)*) => { $crate::bin_log!($crate::__log::Level::Info, $($t)*) };
+}
+#[macro_export]
+macro_rules! bin_debug {
+    ($($t:tt)*) => { $crate::bin_log!($crate::__log::Level::Debug, $($t)*) };
+}
+#[macro_export]
+macro_rules! bin_trace {
+    ($($t:tt)*) => { $crate::bin_log!($crate::__log::Level::Trace, $($t)*) };
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn expand_args(fmt: &str, args: &[Arg]) -> String {
+        let mut buf = [0u8; MAX_ARGS_LEN];
+        let len = encode_args(&mut buf, args);
+        Expanded {
+            fmt,
+            args: &buf[..len],
+        }
+        .to_string()
+    }
+
+    #[test]
+    fn test_round_trip() {
+        let args = [
+            Arg::Uint(0),
+            Arg::Uint(u64::MAX),
+            Arg::Int(-1),
+            Arg::Int(i64::MIN),
+            Arg::Int(i64::MAX),
+            Arg::Bool(true),
+            Arg::Char('é'),
+            Arg::Str("hello"),
+            Arg::Str(""),
+        ];
+        let mut buf = [0u8; MAX_ARGS_LEN];
+        let len = encode_args(&mut buf, &args);
+        let decoded: Vec<Arg> = ArgReader::new(&buf[..len]).collect();
+        assert_eq!(decoded, args);
+    }
+
+    #[test]
+    fn test_expand_matches_core_fmt() {
+        assert_eq!(
+            expand_args(
+                "a {} b {} c {} d {:#x}",
+                &[
+                    99u32.to_arg(),
+                    "foo".to_arg(),
+                    (-3i8).to_arg(),
+                    32usize.to_arg()
+                ]
+            ),
+            format!("a {} b {} c {} d {:#x}", 99, "foo", -3, 32)
+        );
+        assert_eq!(
+            expand_args(
+                "{:x} {:X} {:o} {:b} {:#b} {:08x} {:#010x} {:5}|",
+                &[Arg::Uint(255); 8]
+            ),
+            format!(
+                "{:x} {:X} {:o} {:b} {:#b} {:08x} {:#010x} {:5}|",
+                255, 255, 255, 255, 255, 255, 255, 255
+            )
+        );
+        assert_eq!(
+            expand_args(
+                "{:?} {:?} {} {:>3}|{:4}|{:<4}|",
+                &[
+                    Arg::Str("a\"b"),
+                    Arg::Char('\n'),
+                    Arg::Bool(false),
+                    Arg::Int(-7),
+                    Arg::Str("ab"),
+                    Arg::Uint(5)
+                ]
+            ),
+            format!("{:?} {:?} {} {:>3}|{:4}|{:<4}|", "a\"b", '\n', false, -7, "ab", 5)
+        );
+        assert_eq!(expand_args("{:05}", &[Arg::Int(-42)]), format!("{:05}", -42));
+        assert_eq!(expand_args("{{}} {}}}", &[Arg::Uint(1)]), "{} 1}");
+    }
+
+    #[test]
+    fn test_missing_args() {
+        assert_eq!(expand_args("{} and {}", &[Arg::Uint(1)]), "1 and <?>");
+        assert_eq!(expand_args("unterminated {", &[]), "unterminated {");
+        // Malformed data stops decoding.
+        assert_eq!(
+            Expanded {
+                fmt: "{} {}",
+                args: &[ARG_UINT, 0x80]
+            }
+            .to_string(),
+            "<?> <?>"
+        );
+    }
+
+    #[test]
+    fn test_string_truncation() {
+        let long = "x".repeat(2 * MAX_ARGS_LEN);
+        let mut buf = [0u8; MAX_ARGS_LEN];
+        let len = encode_args(&mut buf, &[Arg::Uint(1), Arg::Str(&long), Arg::Uint(2)]);
+        assert_eq!(len, MAX_ARGS_LEN);
+        let decoded: Vec<Arg> = ArgReader::new(&buf[..len]).collect();
+        assert_eq!(decoded.len(), 2);
+        assert_eq!(decoded[1], Arg::Str(&long[..MAX_ARGS_LEN - 5]));
+
+        // Never splits a multi-byte char.
+        let wide = "é".repeat(MAX_ARGS_LEN);
+        let len = encode_args(&mut buf, &[Arg::Str(&wide)]);
+        assert!(matches!(ArgReader::new(&buf[..len]).next(), Some(Arg::Str(_))));
+    }
+}
@@ -20,25 +20,89 @@ extern "C" {
     //   logger_log will be undefined/null.
     #[linkage = "extern_weak"]
     static logger_log: *const ();
+    // NB: likewise components without a log_ring dataport & log_doorbell
+    //   fall back to logger_log.
+    #[linkage = "extern_weak"]
+    static log_ring: *const *mut u8;
+    #[linkage = "extern_weak"]
+    static log_doorbell_emit: *const ();
 }
 
+use core::sync::atomic::{AtomicBool, Ordering};
 use core2::io::{Cursor, Write};
 use cstr_core::CStr;
 use log::{Metadata, Record};
 
+pub mod binary;
+pub mod ring;
+use ring::LogRing;
+
+// For the bin_* macros.
+#[doc(hidden)]
+pub use log as __log;
+
 // TODO(sleffler): until we can copy directly into shared memory limit
 //   stack allocation (can be up to 4096).
 const MAX_MSG_LEN: usize = 2048;
 
+// Returns the component's log ring, if it has one.
+fn get_log_ring() -> Option<LogRing> {
+    unsafe {
+        if log_ring.is_null() || (*log_ring).is_null() || log_doorbell_emit.is_null() {
+            None
+        } else {
+            Some(LogRing::new(*log_ring))
+        }
+    }
+}
+
+// Serializes writers to the log ring. A thread that finds the ring busy
+// uses logger_log instead of spinning (possibly behind a preempted thread).
+static LOG_RING_BUSY: AtomicBool = AtomicBool::new(false);
+
+// Runs |f| with exclusive use of the log ring and rings the doorbell if
+// |f| says the DebugConsole may be idle. Returns false (without running
+// |f|) if another thread holds the ring.
+fn with_log_ring(f: impl FnOnce() -> bool) -> bool {
+    if LOG_RING_BUSY
+        .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
+        .is_err()
+    {
+        return false;
+    }
+    let needs_doorbell = f();
+    LOG_RING_BUSY.store(false, Ordering::Release);
+    if needs_doorbell {
+        let emit: extern "C" fn() = unsafe { core::mem::transmute(log_doorbell_emit) };
+        emit();
+    }
+    true
+}
+
+// Appends |msg| to |ring|. Returns false if another thread holds the ring.
+// Records that do not fit are dropped (and counted) rather than blocking
+// the caller.
+fn log_to_ring(ring: &LogRing, level: u8, msg: &[u8]) -> bool {
+    with_log_ring(|| ring.push(level, msg) == Ok(true))
+}
+
 pub struct CantripLogger;
 
 impl log::Log for CantripLogger {
-    fn enabled(&self, _metadata: &Metadata) -> bool { true }
+    // With a log ring the DebugConsole's level is honored here so messages
+    // it would discard are never formatted or sent.
+    fn enabled(&self, metadata: &Metadata) -> bool {
+        match get_log_ring().and_then(|ring| ring.max_level()) {
+            Some(max_level) => (metadata.level() as u32) <= max_level,
+            None => true,
+        }
+    }
 
     fn log(&self, record: &Record) {
         let typed_logger_log: Option<extern "C" fn(level: u8, msg: *const cstr_core::c_char)> =
             unsafe { core::mem::transmute(logger_log) };
-        if typed_logger_log.is_none() {
+        let ring = get_log_ring();
+        if typed_logger_log.is_none() && ring.is_none() {
             return;
         }
         if self.enabled(record.metadata()) {
@@ -64,14 +128,18 @@ impl log::Log for CantripLogger {
             }
             // NB: this releases the ref on buf held by the Cursor
             let pos = cur.position() as usize;
-            (typed_logger_log.unwrap())(
-                record.level() as u8,
-                match CStr::from_bytes_with_nul(&buf[..pos]) {
-                    Ok(cstr) => cstr,
-                    Err(_) => embedded_nul_cstr(&mut buf, record),
+            let msg = match CStr::from_bytes_with_nul(&buf[..pos]) {
+                Ok(cstr) => cstr,
+                Err(_) => embedded_nul_cstr(&mut buf, record),
+            };
+            if let Some(ring) = ring {
+                if log_to_ring(&ring, record.level() as u8, msg.to_bytes()) {
+                    return;
                 }
-                .as_ptr(),
-            );
+            }
+            if let Some(logger_log_fn) = typed_logger_log {
+                logger_log_fn(record.level() as u8, msg.as_ptr());
+            }
         }
     }
 
@@ -0,0 +1,279 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Shared-memory log ring.
+//!
+//! Each component that logs to the console gets a page shared with the
+//! DebugConsole (its log_ring dataport). The component appends records and
+//! rings the log_doorbell notification; the DebugConsole drains the ring
+//! and writes the records to the UART. Neither side blocks the other.
+//!
+//! The page starts with a LogRingHeader followed by the record data:
+//!   [level: u8][len: u16 (little-endian)][msg: len bytes]
+//! Records may wrap around the end of the data area. The ring is empty
+//! when head == tail and there is always one unused byte so a full ring
+//! can be told apart from an empty one.
+//!
+//! The DebugConsole also publishes its max log level in the header so
+//! records it would discard are never formatted by the component.
+
+use core::sync::atomic::{AtomicU32, Ordering};
+
+/// Size of the shared region (one page).
+pub const LOG_RING_SIZE: usize = 4096;
+
+/// Bytes of record overhead (level + len).
+pub const LOG_RECORD_HEADER_SIZE: usize = 3;
+
+#[repr(C)]
+pub struct LogRingHeader {
+    head: AtomicU32,      // next byte to write, written only by the producer
+    tail: AtomicU32,      // next byte to read, written only by the consumer
+    max_level: AtomicU32, // LevelFilter + 1 the consumer wants; 0 if unset
+    dropped: AtomicU32,   // records dropped because the ring was full
+}
+
+const LOG_RING_DATA_SIZE: usize = LOG_RING_SIZE - core::mem::size_of::<LogRingHeader>();
+
+/// Largest msg that fits in an empty ring.
+pub const LOG_RING_MAX_MSG: usize = LOG_RING_DATA_SIZE - 1 - LOG_RECORD_HEADER_SIZE;
+
+pub struct LogRing {
+    header: &'static LogRingHeader,
+    data: *mut u8,
+}
+// NB: access is coordinated through the header indices.
+unsafe impl Sync for LogRing {}
+unsafe impl Send for LogRing {}
+
+impl LogRing {
+    /// Wraps the LOG_RING_SIZE bytes at |region|.
+    ///
+    /// # Safety
+    ///
+    /// |region| must be page-aligned, LOG_RING_SIZE bytes, and live for
+    /// the life of the program (e.g. a CAmkES dataport).
+    pub unsafe fn new(region: *mut u8) -> Self {
+        LogRing {
+            header: &*(region as *const LogRingHeader),
+            data: region.add(core::mem::size_of::<LogRingHeader>()),
+        }
+    }
+
+    fn used(head: usize, tail: usize) -> usize {
+        (head + LOG_RING_DATA_SIZE - tail) % LOG_RING_DATA_SIZE
+    }
+
+    // Copies |bytes| into the data area starting at |pos|, wrapping as
+    // needed, and returns the position after them.
+    unsafe fn copy_in(&self, pos: usize, bytes: &[u8]) -> usize {
+        let first = core::cmp::min(bytes.len(), LOG_RING_DATA_SIZE - pos);
+        core::ptr::copy_nonoverlapping(bytes.as_ptr(), self.data.add(pos), first);
+        core::ptr::copy_nonoverlapping(bytes[first..].as_ptr(), self.data, bytes.len() - first);
+        (pos + bytes.len()) % LOG_RING_DATA_SIZE
+    }
+
+    // Copies bytes starting at |pos| into |buf|, wrapping as needed, and
+    // returns the position after them.
+    unsafe fn copy_out(&self, pos: usize, buf: &mut [u8]) -> usize {
+        let first = core::cmp::min(buf.len(), LOG_RING_DATA_SIZE - pos);
+        let len = buf.len();
+        core::ptr::copy_nonoverlapping(self.data.add(pos), buf.as_mut_ptr(), first);
+        core::ptr::copy_nonoverlapping(self.data, buf[first..].as_mut_ptr(), len - first);
+        (pos + len) % LOG_RING_DATA_SIZE
+    }
+
+    // Producer side; there may be at most one producer at a time.
+
+    /// Returns the most verbose level (a LevelFilter) the consumer accepts
+    /// or None if it has not said (e.g. it has not started yet).
+    pub fn max_level(&self) -> Option<u32> {
+        self.header.max_level.load(Ordering::Relaxed).checked_sub(1)
+    }
+
+    /// Appends a record. Returns Ok(true) if the ring was empty, in which
+    /// case the consumer may be idle and must be signaled. If the record
+    /// does not fit it is counted as dropped and Err is returned.
+    pub fn push(&self, level: u8, msg: &[u8]) -> Result<bool, ()> { self.push_parts(level, &[msg]) }
+
+    /// Like push but the msg is the concatenation of |parts|.
+    pub fn push_parts(&self, level: u8, parts: &[&[u8]]) -> Result<bool, ()> {
+        let len = core::cmp::min(parts.iter().map(|p| p.len()).sum(), LOG_RING_MAX_MSG);
+        let head = self.header.head.load(Ordering::Relaxed) as usize;
+        let tail = self.header.tail.load(Ordering::Acquire) as usize;
+        let free = LOG_RING_DATA_SIZE - 1 - Self::used(head, tail);
+        if LOG_RECORD_HEADER_SIZE + len > free {
+            self.header.dropped.fetch_add(1, Ordering::Relaxed);
+            return Err(());
+        }
+        let len_bytes = (len as u16).to_le_bytes();
+        let mut pos = unsafe { self.copy_in(head, &[level, len_bytes[0], len_bytes[1]]) };
+        let mut remain = len;
+        for part in parts {
+            let part = &part[..core::cmp::min(part.len(), remain)];
+            pos = unsafe { self.copy_in(pos, part) };
+            remain -= part.len();
+        }
+        // NB: SeqCst orders the publish before re-reading tail; paired with
+        //   the consumer's store of tail & re-read of head one side always
+        //   sees the other so a wakeup cannot be lost.
+        self.header.head.store(pos as u32, Ordering::SeqCst);
+        Ok(self.header.tail.load(Ordering::SeqCst) as usize == head)
+    }
+
+    // Consumer side; there may be at most one consumer.
+
+    /// Sets the most verbose level (a LevelFilter) the producer should send.
+    pub fn set_max_level(&self, level: u32) {
+        self.header.max_level.store(level + 1, Ordering::Relaxed)
+    }
+
+    /// Returns and clears the count of records dropped since the last call.
+    pub fn take_dropped(&self) -> u32 { self.header.dropped.swap(0, Ordering::Relaxed) }
+
+    /// Removes the oldest record, copying its msg to |buf| (truncated
+    /// if |buf| is too small). Returns the level and the msg length, or
+    /// None if the ring is empty.
+    pub fn pop(&self, buf: &mut [u8]) -> Option<(u8, usize)> {
+        let tail = self.header.tail.load(Ordering::Relaxed) as usize;
+        let head = self.header.head.load(Ordering::SeqCst) as usize;
+        if head == tail || head >= LOG_RING_DATA_SIZE {
+            return None;
+        }
+        if tail >= LOG_RING_DATA_SIZE {
+            // Corrupt index (a misbehaving producer); discard everything.
+            self.header.tail.store(head as u32, Ordering::SeqCst);
+            return None;
+        }
+        let used = Self::used(head, tail);
+        let mut hdr = [0u8; LOG_RECORD_HEADER_SIZE];
+        let pos = unsafe { self.copy_out(tail, &mut hdr) };
+        let len = u16::from_le_bytes([hdr[1], hdr[2]]) as usize;
+        if LOG_RECORD_HEADER_SIZE + len > used {
+            // Corrupt record (a misbehaving producer); discard everything.
+            self.header.tail.store(head as u32, Ordering::SeqCst);
+            return None;
+        }
+        let copied = core::cmp::min(len, buf.len());
+        unsafe { self.copy_out(pos, &mut buf[..copied]) };
+        let next = (pos + len) % LOG_RING_DATA_SIZE;
+        self.header.tail.store(next as u32, Ordering::SeqCst);
+        Some((hdr[0], copied))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[repr(align(4096))]
+    struct Page([u8; LOG_RING_SIZE]);
+
+    fn new_ring() -> LogRing {
+        let page = Box::leak(Box::new(Page([0; LOG_RING_SIZE])));
+        unsafe { LogRing::new(page.0.as_mut_ptr()) }
+    }
+
+    #[test]
+    fn test_push_pop() {
+        let ring = new_ring();
+        let mut buf = [0u8; 64];
+        assert_eq!(ring.pop(&mut buf), None);
+        assert_eq!(ring.push(3, b"hello"), Ok(true));
+        assert_eq!(ring.push(1, b"world!"), Ok(false));
+        assert_eq!(ring.pop(&mut buf), Some((3, 5)));
+        assert_eq!(&buf[..5], b"hello");
+        assert_eq!(ring.pop(&mut buf), Some((1, 6)));
+        assert_eq!(&buf[..6], b"world!");
+        assert_eq!(ring.pop(&mut buf), None);
+        // Empty again so the next push needs a doorbell.
+        assert_eq!(ring.push(2, b""), Ok(true));
+        assert_eq!(ring.pop(&mut buf), Some((2, 0)));
+    }
+
+    #[test]
+    fn test_wrap() {
+        let ring = new_ring();
+        let msg = [0x5au8; 100];
+        let mut buf = [0u8; 100];
+        // Push & pop enough to wrap the indices several times.
+        for i in 0..10 * LOG_RING_DATA_SIZE / msg.len() {
+            assert_eq!(ring.push(i as u8, &msg), Ok(true));
+            assert_eq!(ring.pop(&mut buf), Some((i as u8, msg.len())));
+            assert_eq!(buf, msg);
+        }
+    }
+
+    #[test]
+    fn test_full() {
+        let ring = new_ring();
+        let msg = [0u8; 100];
+        let mut pushed = 0;
+        while ring.push(1, &msg).is_ok() {
+            pushed += 1;
+        }
+        assert_eq!(
+            pushed,
+            (LOG_RING_DATA_SIZE - 1) / (LOG_RECORD_HEADER_SIZE + msg.len())
+        );
+        assert!(ring.push(1, &msg).is_err());
+        assert_eq!(ring.take_dropped(), 2);
+        assert_eq!(ring.take_dropped(), 0);
+
+        // Draining makes room again.
+        let mut buf = [0u8; 100];
+        assert!(ring.pop(&mut buf).is_some());
+        assert_eq!(ring.push(1, &msg), Ok(false));
+    }
+
+    #[test]
+    fn test_truncation() {
+        let ring = new_ring();
+        let msg = [7u8; LOG_RING_SIZE];
+        assert_eq!(ring.push(1, &msg), Ok(true));
+        let mut small = [0u8; 8];
+        assert_eq!(ring.pop(&mut small), Some((1, 8)));
+        assert_eq!(ring.pop(&mut small), None);
+
+        assert_eq!(ring.push(1, &msg), Ok(true));
+        let mut big = [0u8; LOG_RING_SIZE];
+        assert_eq!(ring.pop(&mut big), Some((1, LOG_RING_MAX_MSG)));
+    }
+
+    #[test]
+    fn test_push_parts() {
+        let ring = new_ring();
+        let mut buf = [0u8; 64];
+        assert_eq!(ring.push_parts(4, &[b"foo", b"", b"::bar"]), Ok(true));
+        assert_eq!(ring.pop(&mut buf), Some((4, 8)));
+        assert_eq!(&buf[..8], b"foo::bar");
+
+        // Truncation applies to the whole record.
+        let big = [1u8; LOG_RING_MAX_MSG];
+        assert_eq!(ring.push_parts(4, &[&big, b"tail"]), Ok(true));
+        let mut out = [0u8; LOG_RING_SIZE];
+        assert_eq!(ring.pop(&mut out), Some((4, LOG_RING_MAX_MSG)));
+        assert!(out[..LOG_RING_MAX_MSG].iter().all(|&b| b == 1));
+    }
+
+    #[test]
+    fn test_max_level() {
+        let ring = new_ring();
+        assert_eq!(ring.max_level(), None);
+        ring.set_max_level(0);
+        assert_eq!(ring.max_level(), Some(0));
+        ring.set_max_level(3);
+        assert_eq!(ring.max_level(), Some(3));
+    }
+}
@@ -14,7 +14,7 @@
 
 //! Cantrip OS seL4 scheduling primitives
 
-#![no_std]
+#![cfg_attr(not(test), no_std)]
 
 /// Scheduling domains configured for seL4 TCBs.
 ///
@@ -29,3 +29,81 @@
 pub enum Domain {
     System = 0,
 }
+
+/// The kernel domain schedule as a list of <domain>:<length> entries (see
+/// CantripDomainSchedule in easy-settings.cmake & kernel/domain_schedule.cmake).
+///
+/// The build passes the schedule in the CANTRIP_DOMAIN_SCHEDULE environment
+/// variable with entries separated by ','. Malformed entries are skipped;
+/// the build has already rejected them when generating the kernel schedule.
+#[derive(Debug, Copy, Clone)]
+pub struct DomainSchedule<'a>(&'a str);
+
+impl<'a> DomainSchedule<'a> {
+    pub const fn new(schedule: &'a str) -> Self { DomainSchedule(schedule) }
+
+    /// Returns the (domain, length) entries in schedule order.
+    pub fn entries(&self) -> impl Iterator<Item = (usize, u64)> + 'a {
+        self.0.split(|c| c == ',' || c == ';').filter_map(|entry| {
+            let mut parts = entry.trim().splitn(2, ':');
+            let domain = parts.next()?.parse::<usize>().ok()?;
+            let length = parts.next()?.parse::<u64>().ok()?;
+            Some((domain, length))
+        })
+    }
+
+    /// Returns the number of domains in the schedule.
+    pub fn num_domains(&self) -> usize {
+        self.entries()
+            .map(|(domain, _)| domain + 1)
+            .max()
+            .unwrap_or(1)
+    }
+
+    /// Returns the length of one pass through the schedule.
+    pub fn total_length(&self) -> u64 { self.entries().map(|(_, length)| length).sum() }
+
+    /// Returns |domain|'s share of one pass through the schedule.
+    pub fn domain_length(&self, domain: usize) -> u64 {
+        self.entries()
+            .filter(|&(d, _)| d == domain)
+            .map(|(_, length)| length)
+            .sum()
+    }
+}
+
+/// The domain schedule the system was built with.
+pub const CANTRIP_DOMAIN_SCHEDULE: DomainSchedule<'static> =
+    DomainSchedule::new(match option_env!("CANTRIP_DOMAIN_SCHEDULE") {
+        Some(schedule) => schedule,
+        None => "0:1",
+    });
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_domain_schedule() {
+        let schedule = DomainSchedule::new("0:7,1:1,0:2");
+        assert_eq!(schedule.num_domains(), 2);
+        assert_eq!(schedule.total_length(), 10);
+        assert_eq!(schedule.domain_length(0), 9);
+        assert_eq!(schedule.domain_length(1), 1);
+        assert_eq!(schedule.domain_length(2), 0);
+    }
+
+    #[test]
+    fn test_domain_schedule_default() {
+        let schedule = DomainSchedule::new("0:1");
+        assert_eq!(schedule.num_domains(), 1);
+        assert_eq!(schedule.domain_length(0), schedule.total_length());
+    }
+
+    #[test]
+    fn test_domain_schedule_malformed() {
+        let schedule = DomainSchedule::new("0:4,bogus,1:");
+        assert_eq!(schedule.num_domains(), 1);
+        assert_eq!(schedule.total_length(), 4);
+    }
+}
@@ -574,3 +574,32 @@ cfg_if! {
         }
     } // CONFIG_ENABLE_BENCHMARKS
 }
+
+cfg_if! {
+    if #[cfg(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION")] {
+        // NB: the results are written to the IPC buffer, see
+        // seL4_BenchmarkUtilisation & seL4_BenchmarkGetUtilisation.
+        #[inline(always)]
+        pub unsafe fn seL4_BenchmarkGetThreadUtilisation(tcb: seL4_TCB) {
+            asm!("svc 0",
+                in("x7") swinum!(SyscallId::BenchmarkGetThreadUtilisation),
+                in("x0") tcb,
+            );
+        }
+
+        #[inline(always)]
+        pub unsafe fn seL4_BenchmarkResetThreadUtilisation(tcb: seL4_TCB) {
+            asm!("svc 0",
+                in("x7") swinum!(SyscallId::BenchmarkResetThreadUtilisation),
+                in("x0") tcb,
+            );
+        }
+
+        /// Returns a value written by seL4_BenchmarkGetThreadUtilisation.
+        #[inline(always)]
+        pub unsafe fn seL4_BenchmarkGetUtilisation(index: seL4_BenchmarkUtilisation) -> u64 {
+            let msg = (*seL4_GetIPCBuffer()).msg.as_ptr() as *const u64;
+            msg.add(index as usize).read()
+        }
+    } // CONFIG_BENCHMARK_TRACK_UTILISATION
+}
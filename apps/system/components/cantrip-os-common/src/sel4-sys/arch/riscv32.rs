@@ -542,6 +542,36 @@ cfg_if! {
     } // CONFIG_ENABLE_BENCHMARKS
 }
 
+cfg_if! {
+    if #[cfg(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION")] {
+        // NB: the results are written to the IPC buffer, see
+        // seL4_BenchmarkUtilisation & seL4_BenchmarkGetUtilisation.
+        #[inline(always)]
+        pub unsafe fn seL4_BenchmarkGetThreadUtilisation(tcb: seL4_TCB) {
+            asm!("ecall",
+                in("a7") swinum!(SyscallId::BenchmarkGetThreadUtilisation),
+                in("a0") tcb,
+            );
+        }
+
+        #[inline(always)]
+        pub unsafe fn seL4_BenchmarkResetThreadUtilisation(tcb: seL4_TCB) {
+            asm!("ecall",
+                in("a7") swinum!(SyscallId::BenchmarkResetThreadUtilisation),
+                in("a0") tcb,
+            );
+        }
+
+        /// Returns a value written by seL4_BenchmarkGetThreadUtilisation.
+        #[inline(always)]
+        pub unsafe fn seL4_BenchmarkGetUtilisation(index: seL4_BenchmarkUtilisation) -> u64 {
+            // NB: u64's packed in 32-bit message registers may be unaligned
+            let msg = (*seL4_GetIPCBuffer()).msg.as_ptr() as *const u64;
+            core::ptr::read_unaligned(msg.add(index as usize))
+        }
+    } // CONFIG_BENCHMARK_TRACK_UTILISATION
+}
+
 #[cfg(feature = "CONFIG_SET_TLS_BASE_SELF")]
 pub unsafe fn seL4_SetTLSBase(tls_base: seL4_Word) {
     let info: seL4_Word = 0; // XXX does this dtrt?
@@ -276,6 +276,27 @@ pub const seL4_CapFault_DepthMismatch_BitsFound: seL4_Word = 5;
 pub const seL4_CapFault_GuardMismatch_GuardFound: seL4_Word = seL4_CapFault_DepthMismatch_BitsFound;
 pub const seL4_CapFault_GuardMismatch_BitsFound: seL4_Word = 6;
 
+// Results of seL4_BenchmarkGetThreadUtilisation from
+// libsel4/include/sel4/benchmark_track_types.h; each is a u64
+// stored in the IPC buffer message registers starting at msg[0].
+#[cfg(feature = "CONFIG_BENCHMARK_TRACK_UTILISATION")]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum seL4_BenchmarkUtilisation {
+    TcbUtilisation = 0,
+    TcbNumberSchedules,
+    TcbKernelUtilisation,
+    TcbNumberKernelEntries,
+    IdleLocalCpuUtilisation,
+    IdleTcbCpuUtilisation,
+    IdleNumberSchedules,
+    IdleKernelUtilisation,
+    IdleNumberKernelEntries,
+    TotalUtilisation,
+    TotalNumberSchedules,
+    TotalKernelUtilisation,
+    TotalNumberKernelEntries,
+}
+
 // Bootinfo
 
 // Fixed cap slots for root thread.
@@ -17,6 +17,11 @@ set(CARGO_OPTIONS
   -Z avoid-dev-deps
   CACHE INTERNAL "cargo cmd line arguments")
 
+# The kernel domain schedule (see easy-settings.cmake) for crates that need
+# it at compile time (e.g. ProcessManager's domain accounting) with ','
+# separating entries so it survives as a single argument.
+string(REPLACE ";" "," CANTRIP_DOMAIN_SCHEDULE "${CantripDomainSchedule}")
+
 # add_library but for rust libraries. Invokes cargo in the SOURCE_DIR that is provided,
 # all build output is placed in BUILD_DIR or CMAKE_CURRENT_BINARY_DIR if BUILD_DIR isn't provided.
 # lib_name: Name of library that is created
@@ -24,8 +29,9 @@ set(CARGO_OPTIONS
 # BUILD_DIR: directory for cargo build output
 # LIB_FILENAME: filename of library created by cargo
 # DEPENDS: And target or file dependencies that need to be run before cargo
+# FEATURES: cargo features enabled in addition to RUST_GLOBAL_FEATURES
 function(RustAddLibrary lib_name)
-    cmake_parse_arguments(PARSE_ARGV 1 RUST "" "SOURCE_DIR;BUILD_DIR;LIB_FILENAME" "DEPENDS")
+    cmake_parse_arguments(PARSE_ARGV 1 RUST "" "SOURCE_DIR;BUILD_DIR;LIB_FILENAME" "DEPENDS;FEATURES")
     if(NOT "${RUST_UNPARSED_ARGUMENTS}" STREQUAL "")
         message(FATAL_ERROR "Unknown arguments to RustAddLibrary ${RUST_UNPARSED_ARGUMENTS}")
     endif()
@@ -43,6 +49,9 @@ function(RustAddLibrary lib_name)
         set(CARGO_RELEASE "--release")
     endif()
 
+    set(CARGO_FEATURES ${RUST_GLOBAL_FEATURES} ${RUST_FEATURES})
+    string(REPLACE ";" "," CARGO_FEATURES "${CARGO_FEATURES}")
+
     add_custom_target(
         ${lib_name}_custom
         BYPRODUCTS
@@ -52,9 +61,10 @@ function(RustAddLibrary lib_name)
         WORKING_DIRECTORY ${RUST_SOURCE_DIR}
         COMMAND
             ${CMAKE_COMMAND} -E env RUSTFLAGS=${RUSTFLAGS}
+            CANTRIP_DOMAIN_SCHEDULE=${CANTRIP_DOMAIN_SCHEDULE}
             cargo "+$ENV{CANTRIP_RUST_VERSION}" build
             --target ${RUST_TARGET}
-            --features ${RUST_GLOBAL_FEATURES}
+            --features ${CARGO_FEATURES}
             ${CARGO_OPTIONS} ${CARGO_RELEASE}
             --target-dir ${RUST_BUILD_DIR}
             --out-dir ${RUST_BUILD_DIR}
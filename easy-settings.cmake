@@ -40,5 +40,42 @@ set(SIMULATION OFF CACHE BOOL "Whether to build simulate script")
 set(RELEASE OFF CACHE BOOL "Performance optimized build")
 # NB: UseRiscVBBL is set in the platform config
 
-set(KernelNumDomains 1 CACHE STRING "How many scheduling domains to build for")
-set(KernelDomainSchedule "${CMAKE_CURRENT_LIST_DIR}/kernel/round_robin_domain.c" CACHE INTERNAL "Domain scheduler algorithm")
+# Kernel domain schedule as <domain>:<length> entries that run in order and
+# repeat; e.g. "0:7;1:1" gives the system domain 7/8 of the CPU and a third
+# party application domain the rest. KernelNumDomains follows the schedule.
+set(CantripDomainSchedule "0:1" CACHE STRING "Kernel domain schedule (<domain>:<length> entries)")
+include(${CMAKE_CURRENT_LIST_DIR}/kernel/domain_schedule.cmake)
+cantrip_domain_schedule("${CantripDomainSchedule}" "${CMAKE_BINARY_DIR}/cantrip/domain_schedule.c")
+set(KernelDomainSchedule "${CMAKE_BINARY_DIR}/cantrip/domain_schedule.c" CACHE INTERNAL "Domain scheduler algorithm")
+# Tracing build: the kernel tracks per-thread CPU time so ProcessManager can
+# report busy vs idle time per domain (shell "domstats"). This adds work to
+# every context switch so leave it off otherwise.
+# Turning tracing on overrides KernelBenchmarks; the prior setting is kept in
+# CANTRIP_PRIOR_KERNEL_BENCHMARKS and restored when tracing is turned off.
+set(CantripDomainTracing OFF CACHE BOOL "Track per-domain busy and idle time")
+if(CantripDomainTracing)
+  if(NOT CANTRIP_DOMAIN_TRACING_ACTIVE)
+    if(DEFINED KernelBenchmarks)
+      set(CANTRIP_PRIOR_KERNEL_BENCHMARKS "${KernelBenchmarks}" CACHE INTERNAL "")
+    else()
+      unset(CANTRIP_PRIOR_KERNEL_BENCHMARKS CACHE)
+    endif()
+    set(CANTRIP_DOMAIN_TRACING_ACTIVE ON CACHE INTERNAL "")
+  endif()
+  if(NOT KernelBenchmarks STREQUAL "track_utilisation")
+    set(KernelBenchmarks "track_utilisation" CACHE STRING "" FORCE)
+  endif()
+elseif(CANTRIP_DOMAIN_TRACING_ACTIVE)
+  if(DEFINED CANTRIP_PRIOR_KERNEL_BENCHMARKS)
+    set(KernelBenchmarks "${CANTRIP_PRIOR_KERNEL_BENCHMARKS}" CACHE STRING "" FORCE)
+  else()
+    unset(KernelBenchmarks CACHE)
+  endif()
+  unset(CANTRIP_PRIOR_KERNEL_BENCHMARKS CACHE)
+  unset(CANTRIP_DOMAIN_TRACING_ACTIVE CACHE)
+endif()
+# The OpenTitanUARTDriver (sparrow) and the DebugConsole share the ring
+# layout in uart_ring.h; the DebugConsole gets the matching "uart_zero_copy"
+# feature (see apps/system/CMakeLists.txt).
+option(OpenTitanUARTZeroCopy
+    "OpenTitanUARTDriver uses the tx/rx dataports directly as shared rings" OFF)
@@ -0,0 +1,87 @@
+# Copyright 2022 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     https://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Generates the kernel's ksDomSchedule from a list of <domain>:<length>
+# entries (see CantripDomainSchedule in easy-settings.cmake).
+#
+# The entries run in order and then repeat, so "0:7;1:1" gives domain 0
+# seven slices for every one given to domain 1. With KernelIsMCS lengths
+# are in milliseconds, otherwise in kernel timer ticks.
+#
+# The number of domains is the highest domain in the schedule plus one;
+# every domain below that must appear in the schedule (an unscheduled
+# domain's threads never run). The result is the default for
+# KernelNumDomains and an explicitly set KernelNumDomains must agree.
+
+set(CANTRIP_DOMAIN_SCHEDULE_TEMPLATE "${CMAKE_CURRENT_LIST_DIR}/domain_schedule.c.in")
+
+function(cantrip_domain_schedule schedule output)
+  if("${schedule}" STREQUAL "")
+    message(FATAL_ERROR "Domain schedule is empty")
+  endif()
+
+  set(entries "")
+  set(domains "")
+  set(total 0)
+  set(max_domain 0)
+  foreach(entry IN LISTS schedule)
+    if(NOT entry MATCHES "^([0-9]+):([0-9]+)$")
+      message(FATAL_ERROR "Domain schedule entry \"${entry}\" is not <domain>:<length>")
+    endif()
+    set(domain ${CMAKE_MATCH_1})
+    set(length ${CMAKE_MATCH_2})
+    if(length EQUAL 0)
+      message(FATAL_ERROR "Domain schedule entry \"${entry}\" has a zero length")
+    endif()
+    if(domain GREATER max_domain)
+      set(max_domain ${domain})
+    endif()
+    if(NOT domain IN_LIST domains)
+      list(APPEND domains ${domain})
+      set(domain_total_${domain} 0)
+    endif()
+    math(EXPR total "${total} + ${length}")
+    math(EXPR domain_total_${domain} "${domain_total_${domain}} + ${length}")
+    string(APPEND entries "    {.domain = ${domain}, .length = ${length}},\n")
+  endforeach()
+  math(EXPR num_domains "${max_domain} + 1")
+
+  set(shares "")
+  foreach(domain RANGE ${max_domain})
+    if(NOT domain IN_LIST domains)
+      message(FATAL_ERROR "Domain ${domain} is missing from the domain schedule \"${schedule}\"")
+    endif()
+    math(EXPR percent "100 * ${domain_total_${domain}} / ${total}")
+    list(APPEND shares "${domain}: ${percent}%")
+  endforeach()
+
+  # NB: a cached KernelNumDomains is not replaced by set(... CACHE) so the
+  #   value last derived is remembered; while KernelNumDomains still holds
+  #   it (i.e. it was not set explicitly) it follows schedule changes.
+  if(NOT DEFINED KernelNumDomains OR
+     "${KernelNumDomains}" STREQUAL "${CANTRIP_DERIVED_NUM_DOMAINS}")
+    set(KernelNumDomains ${num_domains} CACHE STRING "How many scheduling domains to build for" FORCE)
+  endif()
+  set(CANTRIP_DERIVED_NUM_DOMAINS ${num_domains} CACHE INTERNAL "KernelNumDomains derived from the domain schedule")
+  if(NOT KernelNumDomains EQUAL num_domains)
+    message(FATAL_ERROR "KernelNumDomains is ${KernelNumDomains} but the domain schedule \"${schedule}\" uses ${num_domains} domain(s)")
+  endif()
+  string(REPLACE ";" ", " shares "${shares}")
+  message(STATUS "Domain schedule ${schedule} (${shares})")
+
+  set(CANTRIP_DOMAIN_SCHEDULE "${schedule}")
+  set(CANTRIP_DOMAIN_SCHEDULE_ENTRIES "${entries}")
+  set(CANTRIP_NUM_DOMAINS ${num_domains})
+  configure_file("${CANTRIP_DOMAIN_SCHEDULE_TEMPLATE}" "${output}" @ONLY)
+endfunction()